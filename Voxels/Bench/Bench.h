@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+// Benchmarks for the platform-neutral code. BENCHMARK(Name) defines one and
+// registers it; each prints its own table. With --quick every benchmark
+// shrinks its sizes and runs once, which is how ctest checks that they still
+// work; the numbers are only meaningful without it.
+//
+// Usage: VoxelsBench [--quick] [name ...]
+namespace Benchmarks {
+	typedef void (*BenchmarkFunction)();
+
+	struct Registrar {
+		Registrar(const char* name, BenchmarkFunction function);
+	};
+
+	bool Quick();
+	// Thread counts to sweep: 1, 2, 4, 8 and 16, or 1 and 2 with --quick
+	std::vector<unsigned int> ThreadCounts();
+
+	// Fastest of several runs of function, in milliseconds; a single run with --quick
+	template <typename Function>
+	double Measure(Function function, int runs = 5)
+	{
+		typedef std::chrono::steady_clock Clock;
+		double best = 0.0;
+		for (int run = 0; run < (Quick() ? 1 : runs); run++) {
+			Clock::time_point start = Clock::now();
+			function();
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			best = (run == 0 || ms < best ? ms : best);
+		}
+		return best;
+	}
+}
+
+#define BENCHMARK(name) \
+	static void name##_Benchmark(); \
+	static Benchmarks::Registrar name##_Registrar(#name, &name##_Benchmark); \
+	static void name##_Benchmark()
@@ -0,0 +1,71 @@
+#include "Bench.h"
+#include "ChunkSimulation.h"
+#include "VoxelDag.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace Benchmarks;
+using namespace Rendering;
+
+// Small blasts into the top of ever larger cubes of voxels. The indexed blast
+// only visits what is in reach, so its cost should stay put as the world
+// grows; the full scan it replaced drew random numbers for, and tested, every
+// voxel in the chunk.
+BENCHMARK(Blast)
+{
+	typedef std::chrono::steady_clock Clock;
+	const float pitch = 2.0f;
+	const int blasts = (Quick() ? 5 : 50);
+	std::vector<std::uint32_t> edges = (Quick() ? std::vector<std::uint32_t>{ 16, 32 } : std::vector<std::uint32_t>{ 25, 50, 100 });
+
+	std::printf("%10s %12s %14s %16s %14s\n", "voxels", "hits/blast", "indexed ms", "full scan ms", "ratio");
+	for (std::uint32_t edge : edges) {
+		std::uint32_t levels = 0;
+		while ((1u << levels) < edge) {
+			levels++;
+		}
+		VoxelDag world(levels);
+		const std::uint32_t minimum[3] = { 0, 0, 0 };
+		const std::uint32_t maximum[3] = { edge, edge, edge };
+		world.Fill(minimum, maximum, true);
+
+		ChunkSimulation simulation;
+		simulation.Store().Reserve(edge * edge * edge);
+		simulation.AddVoxels(world, minimum, maximum, pitch);
+		VoxelStore scan;
+		scan.Reserve(edge * edge * edge);
+		world.ForEachSolid(minimum, maximum, [&](std::uint32_t x, std::uint32_t y, std::uint32_t z) {
+			scan.Add(x * pitch, y * pitch, z * pitch, pitch * 0.5f);
+		});
+
+		// The first blast also builds the connectivity and the static index,
+		// which only happens once per chunk
+		float top = (edge - 1) * pitch;
+		simulation.SetMotionVectors(edge * pitch * 0.5f, top, edge * pitch * 0.5f);
+
+		double indexedMs = 0.0;
+		double scanMs = 0.0;
+		std::uint32_t hits = 0;
+		for (int blast = 0; blast < blasts; blast++) {
+			Random random(static_cast<std::uint32_t>(blast), 9);
+			float x = random.NextRange(0.0f, (edge - 1) * pitch);
+			float z = random.NextRange(0.0f, (edge - 1) * pitch);
+
+			std::uint32_t before = simulation.Store().ActiveCount();
+			Clock::time_point start = Clock::now();
+			simulation.SetMotionVectors(x, top, z);
+			indexedMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			hits += simulation.Store().ActiveCount() - before;
+
+			start = Clock::now();
+			for (std::uint32_t slot = 0; slot < scan.Count(); slot++) {
+				Random voxel(static_cast<std::uint32_t>(blast), scan.Id(slot));
+				scan.SetMotionVector(slot, x, top, z, voxel);
+			}
+			scanMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+
+		std::printf("%10u %12u %14.3f %16.3f %13.1fx\n", edge * edge * edge, hits / blasts, indexedMs / blasts, scanMs / blasts, scanMs / indexedMs);
+	}
+}
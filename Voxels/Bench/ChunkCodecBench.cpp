@@ -0,0 +1,87 @@
+#include "Bench.h"
+#include "ChunkCodec.h"
+#include "ChunkGrid.h"
+#include "TerrainGenerator.h"
+#include "VoxelStore.h"
+#include <cstdio>
+#include <vector>
+
+using namespace Benchmarks;
+using namespace Rendering;
+
+namespace {
+	ChunkGrid Noise(std::uint32_t materials)
+	{
+		std::vector<std::uint16_t> cells(ChunkGrid::VOLUME);
+		for (std::uint32_t cell = 0; cell < ChunkGrid::VOLUME; cell++) {
+			Random random(cell, materials);
+			cells[cell] = static_cast<std::uint16_t>(random.NextRange(0.0f, static_cast<float>(materials) + 0.999f));
+		}
+		ChunkGrid grid;
+		grid.Assign(cells.data());
+		return grid;
+	}
+
+	ChunkGrid Layers()
+	{
+		std::vector<std::uint16_t> cells(ChunkGrid::VOLUME);
+		for (std::uint32_t cell = 0; cell < ChunkGrid::VOLUME; cell++) {
+			std::uint32_t y = cell / ChunkGrid::SIZE % ChunkGrid::SIZE;
+			cells[cell] = static_cast<std::uint16_t>(y < 20 ? 1 + y / 7 : ChunkGrid::EMPTY_MATERIAL);
+		}
+		ChunkGrid grid;
+		grid.Assign(cells.data());
+		return grid;
+	}
+
+	// The lowest generated chunk the ground passes through
+	ChunkGrid Terrain()
+	{
+		TerrainGenerator terrain(1);
+		ChunkGrid grid;
+		for (std::int32_t y = 0; y < 8; y++) {
+			ChunkKey key = { 0, y, 0 };
+			terrain.Generate(key, grid);
+			if (!grid.IsUniform()) {
+				break;
+			}
+		}
+		return grid;
+	}
+}
+
+// Encoding and decoding one chunk of each kind the codec sees: uniform,
+// generated terrain, layers that come out as runs, and noise at 2, 8 and 16
+// bits per entry. GB/s is the in-memory grid decoded per second.
+BENCHMARK(ChunkCodec)
+{
+	const int repeats = (Quick() ? 20 : 2000);
+	const char* names[] = { "empty", "terrain", "flat layers", "noise, 3 materials", "noise, 200 materials", "noise, 5000 materials" };
+	ChunkGrid grids[] = { ChunkGrid(), Terrain(), Layers(), Noise(3), Noise(200), Noise(5000) };
+	const char* encodings[] = { "uniform", "packed", "runs" };
+
+	std::printf("%-22s %9s %5s %8s %11s %11s %8s\n", "chunk", "encoding", "bits", "bytes", "encode us", "decode us", "GB/s");
+	for (int c = 0; c < 6; c++) {
+		const ChunkGrid& grid = grids[c];
+		std::vector<std::uint8_t> data;
+		double encodeMs = Measure([&]() {
+			for (int r = 0; r < repeats; r++) {
+				data.clear();
+				ChunkCodec::Encode(grid, data);
+			}
+		});
+
+		// Into the same grid each time, as a loader reusing its chunks would
+		ChunkGrid decoded;
+		bool valid = true;
+		double decodeMs = Measure([&]() {
+			for (int r = 0; r < repeats; r++) {
+				valid = ChunkCodec::Decode(data.data(), data.size(), decoded) && valid;
+			}
+		});
+
+		double decodeUs = decodeMs * 1000.0 / repeats;
+		std::printf("%-22s %9s %5u %8zu %11.2f %11.2f %8.1f%s\n", names[c], encodings[data[6]], grid.BitsPerEntry(), data.size(), encodeMs * 1000.0 / repeats,
+			decodeUs, grid.MemoryBytes() / (decodeUs * 1000.0), (valid ? "" : "  decode failed"));
+	}
+}
@@ -0,0 +1,79 @@
+#include "Bench.h"
+#include "ChunkSimulation.h"
+#include "GameTime.h"
+#include "JobSystem.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace Benchmarks;
+using namespace Rendering;
+
+namespace {
+	// Hash of every voxel's position, to show the result does not depend on
+	// the thread count
+	std::uint32_t HashPositions(VoxelStore& store)
+	{
+		std::uint32_t hash = 0;
+		for (std::uint32_t slot = 0; slot < store.Count(); slot++) {
+			const float position[3] = { store.OriginX()[slot], store.OriginY()[slot], store.OriginZ()[slot] };
+			for (float value : position) {
+				std::uint32_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+				hash = Random::Combine(hash, bits ^ store.Id(slot));
+			}
+		}
+		return hash;
+	}
+}
+
+// A cube of voxels all knocked loose at once, as after a blast through the
+// whole chunk, simulated for a second at each thread count
+BENCHMARK(ChunkSimulation)
+{
+	const std::uint32_t edge = (Quick() ? 16 : 32);
+	const int frames = (Quick() ? 10 : 60);
+
+	std::printf("%u voxels, %d frames\n", edge * edge * edge, frames);
+	std::printf("%8s %14s %9s %10s %10s\n", "threads", "ms/frame", "speedup", "contacts", "hash");
+	double single = 0.0;
+	for (unsigned int threads : ThreadCounts()) {
+		JobSystem jobSystem(threads);
+		ChunkSimulation simulation(&jobSystem);
+		VoxelStore& store = simulation.Store();
+		store.Reserve(edge * edge * edge);
+
+		std::uint32_t levels = 0;
+		while ((1u << levels) < edge) {
+			levels++;
+		}
+		VoxelDag world(levels);
+		const std::uint32_t minimum[3] = { 0, 0, 0 };
+		const std::uint32_t maximum[3] = { edge, edge, edge };
+		world.Fill(minimum, maximum, true);
+		simulation.AddVoxels(world, minimum, maximum, 2.0f);
+
+		// Waking in ascending order only moves voxels at or below the one woken
+		for (std::uint32_t slot = 0; slot < store.Count(); slot++) {
+			Random random(store.Id(slot), 1);
+			store.VelocityX()[slot] = random.NextRange(-4.0f, 4.0f);
+			store.VelocityY()[slot] = random.NextRange(0.0f, 8.0f);
+			store.VelocityZ()[slot] = random.NextRange(-4.0f, 4.0f);
+			store.SetAngularVelocity(slot, random.NextRange(-5.0f, 5.0f), random.NextRange(-5.0f, 5.0f), random.NextRange(-5.0f, 5.0f));
+			store.Drop(slot);
+		}
+
+		GameTime gameTime;
+		std::uint32_t contacts = 0;
+		double ms = Measure([&]() {
+			for (int frame = 0; frame < frames; frame++) {
+				gameTime.SetElapsedGameTime(1.0 / 60.0);
+				gameTime.SetTotalGameTime(gameTime.TotalGameTime() + 1.0 / 60.0);
+				simulation.Update(gameTime);
+				contacts += simulation.Stats().Contacts;
+			}
+		}, 1) / frames;
+		single = (threads == 1 ? ms : single);
+
+		std::printf("%8u %14.2f %8.2fx %10u %10x\n", threads, ms, single / ms, contacts, HashPositions(store));
+	}
+}
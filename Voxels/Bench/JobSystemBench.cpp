@@ -0,0 +1,54 @@
+#include "Bench.h"
+#include "JobSystem.h"
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace Benchmarks;
+using namespace Library;
+
+// Scaling of ParallelFor over evenly split compute-bound work, and the cost
+// of scheduling many tiny jobs, at each thread count
+BENCHMARK(JobSystem)
+{
+	const std::uint32_t count = (Quick() ? 1 << 16 : 1 << 22);
+	const int tinyJobs = (Quick() ? 10000 : 200000);
+	std::vector<float> results(count);
+
+	std::printf("%8s %14s %9s %14s %14s\n", "threads", "compute ms", "speedup", "ns/tiny job", "ns/for range");
+	double single = 0.0;
+	for (unsigned int threads : ThreadCounts()) {
+		JobSystem jobSystem(threads);
+		double computeMs = Measure([&]() {
+			jobSystem.ParallelFor(count, 4096, [&results](std::uint32_t begin, std::uint32_t end) {
+				for (std::uint32_t i = begin; i < end; i++) {
+					float x = static_cast<float>(i);
+					results[i] = std::sin(x) * std::cos(x * 0.5f) + std::sqrt(x);
+				}
+			});
+		});
+		single = (threads == 1 ? computeMs : single);
+
+		std::atomic<int> done(0);
+		double tinyMs = Measure([&]() {
+			JobSystem::Job* root = jobSystem.CreateJob(JobSystem::JobFunction());
+			for (int i = 0; i < tinyJobs; i++) {
+				JobSystem::Job* child = jobSystem.CreateChildJob(root, [&done]() { done++; });
+				jobSystem.Run(child);
+				jobSystem.Release(child);
+			}
+			jobSystem.Run(root);
+			jobSystem.Wait(root);
+		});
+
+		// Grain of one: the per-range overhead of ParallelFor itself
+		double rangeMs = Measure([&]() {
+			jobSystem.ParallelFor(static_cast<std::uint32_t>(tinyJobs), 1, [&done](std::uint32_t begin, std::uint32_t end) {
+				done += static_cast<int>(end - begin);
+			});
+		});
+
+		std::printf("%8u %14.2f %8.2fx %14.1f %14.1f\n", threads, computeMs, single / computeMs, tinyMs * 1e6 / tinyJobs, rangeMs * 1e6 / tinyJobs);
+	}
+}
@@ -0,0 +1,73 @@
+#include "Bench.h"
+#include <cstdio>
+#include <cstring>
+
+namespace Benchmarks {
+	namespace {
+		struct Benchmark {
+			const char* Name;
+			BenchmarkFunction Function;
+		};
+
+		std::vector<Benchmark>& All()
+		{
+			static std::vector<Benchmark> benchmarks;
+			return benchmarks;
+		}
+
+		bool sQuick = false;
+	}
+
+	Registrar::Registrar(const char* name, BenchmarkFunction function)
+	{
+		Benchmark benchmark = { name, function };
+		All().push_back(benchmark);
+	}
+
+	bool Quick()
+	{
+		return sQuick;
+	}
+
+	std::vector<unsigned int> ThreadCounts()
+	{
+		if (sQuick) {
+			return std::vector<unsigned int>{ 1, 2 };
+		}
+		return std::vector<unsigned int>{ 1, 2, 4, 8, 16 };
+	}
+}
+
+using namespace Benchmarks;
+
+int main(int argc, char* argv[])
+{
+	std::vector<const char*> names;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--quick") == 0) {
+			sQuick = true;
+		}
+		else {
+			names.push_back(argv[i]);
+		}
+	}
+
+	int run = 0;
+	for (const Benchmark& benchmark : All()) {
+		bool selected = names.empty();
+		for (const char* name : names) {
+			selected = selected || std::strcmp(name, benchmark.Name) == 0;
+		}
+		if (!selected) {
+			continue;
+		}
+
+		std::printf("%s\n", benchmark.Name);
+		benchmark.Function();
+		std::printf("\n");
+		std::fflush(stdout);
+		run++;
+	}
+
+	return (run > 0 ? 0 : 1);
+}
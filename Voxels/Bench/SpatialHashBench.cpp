@@ -0,0 +1,84 @@
+#include "Bench.h"
+#include "ContactSolver.h"
+#include "JobSystem.h"
+#include "SpatialHash.h"
+#include "VoxelStore.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace Benchmarks;
+using namespace Rendering;
+
+// Debris of size 1 (the demo's) scattered uniformly at about three
+// neighbours each, packed into one box or spread over clumps far apart. For
+// each count it times building the hash with the solver's cell size, walking
+// every touching pair through it straight from the store, and a whole contact
+// solve, build included.
+BENCHMARK(SpatialHash)
+{
+	const float size = 1.0f;
+	std::vector<std::uint32_t> counts = (Quick() ? std::vector<std::uint32_t>{ 10000 } : std::vector<std::uint32_t>{ 10000, 100000, 200000 });
+	Library::JobSystem jobSystem;
+
+	std::printf("%u threads\n", jobSystem.ThreadCount());
+	std::printf("%10s %8s %8s %10s %12s %12s %12s\n", "voxels", "layout", "grid", "pairs", "build ms", "pairs ms", "solve ms");
+	for (std::uint32_t count : counts) {
+		for (int spread = 0; spread < 2; spread++) {
+			// Each clump has the density of the packed box
+			float side = std::cbrt(12.0f * count);
+			std::uint32_t clumps = (spread ? 64 : 1);
+			float clumpSide = side / std::cbrt(static_cast<float>(clumps));
+
+			VoxelStore store;
+			store.Reserve(count);
+			for (std::uint32_t i = 0; i < count; i++) {
+				Random clump(i % clumps, 1);
+				Random random(i, 2);
+				float offset = (spread ? 100.0f * side : 0.0f);
+				float x = clump.NextRange(-offset, offset) + random.NextRange(0.0f, clumpSide);
+				float y = clump.NextRange(-offset, offset) + random.NextRange(0.0f, clumpSide);
+				float z = clump.NextRange(-offset, offset) + random.NextRange(0.0f, clumpSide);
+				std::uint32_t id = store.Add(x, y, z, size);
+				store.Drop(store.Slot(id));
+			}
+
+			SpatialHash hash;
+			double buildMs = Measure([&]() { hash.Build(store.OriginX(), store.OriginY(), store.OriginZ(), count, size * 2.0f); });
+
+			const float* x = store.OriginX();
+			const float* y = store.OriginY();
+			const float* z = store.OriginZ();
+			std::uint32_t pairs = 0;
+			double pairsMs = Measure([&]() {
+				pairs = 0;
+				for (std::uint32_t p = 0; p < count; p++) {
+					std::uint32_t a = hash.Entry(p);
+					hash.ForEachNeighbourOf(p, [&](std::uint32_t q) {
+						std::uint32_t b = hash.Entry(q);
+						float dx = x[a] - x[b];
+						float dy = y[a] - y[b];
+						float dz = z[a] - z[b];
+						pairs += (a < b && dx * dx + dy * dy + dz * dz < 4.0f * size * size ? 1 : 0);
+					});
+				}
+			});
+
+			// Solving moves the voxels, so every run starts from the same copy
+			ContactSolver solver;
+			std::vector<float> startX(x, x + count);
+			std::vector<float> startY(y, y + count);
+			std::vector<float> startZ(z, z + count);
+			double solveMs = Measure([&]() {
+				std::copy(startX.begin(), startX.end(), store.OriginX());
+				std::copy(startY.begin(), startY.end(), store.OriginY());
+				std::copy(startZ.begin(), startZ.end(), store.OriginZ());
+				solver.Solve(store, count, &jobSystem);
+			});
+
+			std::printf("%10u %8s %8s %10u %12.2f %12.2f %12.2f\n", count, (spread ? "spread" : "packed"), (hash.IsDense() ? "dense" : "hashed"),
+				pairs, buildMs, pairsMs, solveMs);
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#include "Bench.h"
+#include "JobSystem.h"
+#include "Random.h"
+#include "TerrainGenerator.h"
+#include <cstdio>
+#include <vector>
+
+using namespace Benchmarks;
+using namespace Library;
+using namespace Rendering;
+
+// A 512x256x512 cell world, 16x8x16 chunks, generated one chunk per job at
+// each thread count. The ground rises from 64 cells up, so the world holds
+// air, surface and solid chunks as a streamed world would. The hash of every
+// cell shows the terrain does not depend on the thread count.
+BENCHMARK(TerrainGenerator)
+{
+	const int chunksX = (Quick() ? 4 : 16);
+	const int chunksY = 8;
+	const int chunksZ = (Quick() ? 4 : 16);
+	TerrainGenerator terrain(1, 64.0f);
+	std::vector<ChunkGrid> chunks(chunksX * chunksY * chunksZ);
+	double cells = static_cast<double>(chunks.size()) * ChunkGrid::VOLUME;
+
+	std::printf("%dx%dx%d cells, %zu chunks\n", chunksX * ChunkGrid::SIZE, chunksY * ChunkGrid::SIZE, chunksZ * ChunkGrid::SIZE, chunks.size());
+	std::printf("%8s %10s %9s %12s %9s %10s %10s\n", "threads", "ms", "speedup", "Mcells/s", "uniform", "bytes", "hash");
+	double single = 0.0;
+	for (unsigned int threads : ThreadCounts()) {
+		JobSystem jobSystem(threads);
+		double ms = Measure([&]() {
+			jobSystem.ParallelFor(static_cast<std::uint32_t>(chunks.size()), 1, [&](std::uint32_t begin, std::uint32_t end) {
+				for (std::uint32_t i = begin; i < end; i++) {
+					ChunkKey key = { static_cast<std::int32_t>(i % chunksX), static_cast<std::int32_t>(i / chunksX % chunksY), static_cast<std::int32_t>(i / (chunksX * chunksY)) };
+					terrain.Generate(key, chunks[i]);
+				}
+			});
+		}, 3);
+		single = (threads == 1 ? ms : single);
+
+		std::size_t bytes = 0;
+		std::uint32_t uniform = 0;
+		std::uint32_t hash = 0;
+		for (const ChunkGrid& chunk : chunks) {
+			bytes += chunk.MemoryBytes();
+			uniform += (chunk.IsUniform() ? 1 : 0);
+			for (std::uint32_t z = 0; z < ChunkGrid::SIZE; z++) {
+				for (std::uint32_t y = 0; y < ChunkGrid::SIZE; y++) {
+					for (std::uint32_t x = 0; x < ChunkGrid::SIZE; x++) {
+						hash = Random::Combine(hash, chunk.Get(x, y, z));
+					}
+				}
+			}
+		}
+		std::printf("%8u %10.1f %8.2fx %12.0f %9u %10zu %10x\n", threads, ms, single / ms, cells / (ms * 1000.0), uniform, bytes, hash);
+	}
+}
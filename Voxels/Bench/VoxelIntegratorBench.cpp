@@ -0,0 +1,160 @@
+#include "Bench.h"
+#include "SimdMath.h"
+#include "VoxelIntegrator.h"
+#include "VoxelStore.h"
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace Benchmarks;
+using namespace Rendering;
+
+namespace {
+	// Voxel::Update as it was before the integrator, frozen here as the
+	// baseline: one heap object per voxel, five matrix products, a pow() and
+	// a double-precision time every step. DirectXMath is not available off
+	// Windows, so the matrices are plain row-major floats with DirectXMath's
+	// conventions; XMMatrixMultiply's SSE would make the original somewhat
+	// faster than this copy.
+	struct OriginalVoxel {
+		float Origin[3];
+		float Vector[3];
+		float Gravity[3];
+		float PositionMatrix[16];
+		float RotationAngle[3];
+		bool Moving;
+
+		static void Multiply(float* a, const float* b)
+		{
+			float product[16];
+			for (int row = 0; row < 4; row++) {
+				for (int column = 0; column < 4; column++) {
+					product[row * 4 + column] = a[row * 4] * b[column] + a[row * 4 + 1] * b[4 + column] + a[row * 4 + 2] * b[8 + column] + a[row * 4 + 3] * b[12 + column];
+				}
+			}
+			for (int i = 0; i < 16; i++) {
+				a[i] = product[i];
+			}
+		}
+
+		static void Translation(float* m, float x, float y, float z)
+		{
+			const float translation[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, x, y, z, 1 };
+			for (int i = 0; i < 16; i++) {
+				m[i] = translation[i];
+			}
+		}
+
+		// About axis 0, 1 or 2
+		static void Rotation(float* m, int axis, float angle)
+		{
+			float s = std::sin(angle);
+			float c = std::cos(angle);
+			Translation(m, 0.0f, 0.0f, 0.0f);
+			int a = (axis + 1) % 3;
+			int b = (axis + 2) % 3;
+			m[a * 4 + a] = c;
+			m[a * 4 + b] = s;
+			m[b * 4 + a] = -s;
+			m[b * 4 + b] = c;
+		}
+
+		void Update(double elapsed)
+		{
+			if (!Moving) {
+				return;
+			}
+
+			const float decay = VoxelStore::DECAY_FACTOR;
+			double time = elapsed * VoxelStore::TIME_FACTOR;
+			float step[16];
+			Translation(step, -Origin[0], -Origin[1], -Origin[2]);
+			Multiply(PositionMatrix, step);
+			for (int axis = 0; axis < 3; axis++) {
+				Rotation(step, axis, RotationAngle[axis]);
+				Multiply(PositionMatrix, step);
+			}
+			Translation(step, Origin[0], Origin[1], Origin[2]);
+			Multiply(PositionMatrix, step);
+
+			float rotFalloff = static_cast<float>(std::pow(decay, 3));
+			for (int axis = 0; axis < 3; axis++) {
+				RotationAngle[axis] *= rotFalloff;
+			}
+
+			float v[3];
+			for (int axis = 0; axis < 3; axis++) {
+				v[axis] = static_cast<float>(Vector[axis] * time) + static_cast<float>(Gravity[axis] * time);
+				Origin[axis] += v[axis];
+			}
+			Translation(step, v[0], v[1], v[2]);
+			Multiply(PositionMatrix, step);
+			for (int axis = 0; axis < 3; axis++) {
+				Vector[axis] *= decay;
+				Gravity[axis] /= decay;
+			}
+		}
+	};
+}
+
+// One step over every voxel, all of them moving and spinning, for the
+// original per-voxel update, the scalar reference and the SIMD kernel.
+//
+// The scalar reference is not the original update. Since gravity became an
+// acceleration and orientation a quaternion, IntegrateScalar is the rewritten
+// step run one voxel at a time: the reference the SIMD kernel is checked
+// against, not the code it replaced. The original column is that code, and
+// its trajectories differ from both by design.
+BENCHMARK(VoxelIntegrator)
+{
+	std::vector<std::uint32_t> counts = (Quick() ? std::vector<std::uint32_t>{ 4096 } : std::vector<std::uint32_t>{ 4096, 65536, 1048576 });
+
+	std::printf("SIMD width %d\n", Simd::FloatN::Width);
+	std::printf("%10s %18s %16s %16s %12s %12s\n", "voxels", "original ns/voxel", "scalar ns/voxel", "SIMD ns/voxel", "vs original", "vs scalar");
+	for (std::uint32_t count : counts) {
+		VoxelStore store;
+		store.Reserve(count);
+		std::vector<std::unique_ptr<OriginalVoxel>> originals;
+		for (std::uint32_t i = 0; i < count; i++) {
+			Random random(i, 0);
+			float x = random.NextRange(-100.0f, 100.0f);
+			float y = random.NextRange(0.0f, 100.0f);
+			float z = random.NextRange(-100.0f, 100.0f);
+			std::uint32_t id = store.Add(x, y, z, 0.5f);
+			store.Drop(store.Slot(id));
+			std::uint32_t slot = store.Slot(id);
+			store.VelocityX()[slot] = random.NextRange(-5.0f, 5.0f);
+			store.VelocityZ()[slot] = random.NextRange(-5.0f, 5.0f);
+			store.SetAngularVelocity(slot, random.NextRange(-1.0f, 1.0f), random.NextRange(-1.0f, 1.0f), random.NextRange(-1.0f, 1.0f));
+
+			std::unique_ptr<OriginalVoxel> original(new OriginalVoxel());
+			const float state[4][3] = {
+				{ x, y, z },
+				{ store.VelocityX()[slot], store.VelocityY()[slot], store.VelocityZ()[slot] },
+				{ 0.0f, VoxelStore::GRAVITY, 0.0f },
+				{ store.AngularX()[slot], store.AngularY()[slot], store.AngularZ()[slot] }
+			};
+			for (int axis = 0; axis < 3; axis++) {
+				original->Origin[axis] = state[0][axis];
+				original->Vector[axis] = state[1][axis];
+				original->Gravity[axis] = state[2][axis];
+				original->RotationAngle[axis] = state[3][axis];
+			}
+			OriginalVoxel::Translation(original->PositionMatrix, x, y, z);
+			original->Moving = true;
+			originals.push_back(std::move(original));
+		}
+
+		double originalMs = Measure([&]() {
+			for (const std::unique_ptr<OriginalVoxel>& voxel : originals) {
+				voxel->Update(1.0 / 60.0);
+			}
+		});
+		double scalarMs = Measure([&]() { VoxelIntegrator::IntegrateScalar(store, 0, count, 1.0 / 60.0); });
+		double simdMs = Measure([&]() { VoxelIntegrator::Integrate(store, 0, count, 1.0 / 60.0); });
+
+		double scale = 1e6 / count;
+		std::printf("%10u %18.2f %16.2f %16.2f %11.1fx %11.1fx\n", count, originalMs * scale, scalarMs * scale, simdMs * scale, originalMs / simdMs, scalarMs / simdMs);
+	}
+}
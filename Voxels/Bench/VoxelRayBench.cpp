@@ -0,0 +1,105 @@
+#include "Bench.h"
+#include "VoxelRay.h"
+#include "VoxelStore.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace Benchmarks;
+using namespace Rendering;
+
+namespace {
+	// The pick loop the kernel replaced: every moving voxel tested as the
+	// sphere around its centre
+	std::uint32_t NearestSphere(const float origin[3], const float direction[3], const float* x, const float* y, const float* z, const float* size,
+		std::uint32_t count, float maxDistance, float& distance)
+	{
+		float lengthSq = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+		std::uint32_t nearest = count;
+		distance = maxDistance;
+		for (std::uint32_t i = 0; i < count; i++) {
+			float offset[3] = { origin[0] - x[i], origin[1] - y[i], origin[2] - z[i] };
+			float b = direction[0] * offset[0] + direction[1] * offset[1] + direction[2] * offset[2];
+			float c = offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2] - size[i] * size[i];
+			float discriminant = b * b - lengthSq * c;
+			if (discriminant < 0.0f) {
+				continue;
+			}
+
+			float root = std::sqrt(discriminant);
+			float t = (-b - root) / lengthSq;
+			t = (t >= 0.0f ? t : (-b + root) / lengthSq);
+			if (t < 0.0f || t >= distance) {
+				continue;
+			}
+
+			nearest = i;
+			distance = t;
+		}
+
+		return nearest;
+	}
+}
+
+// Nearest hit of a pick ray over random unit cubes, at the density of loose
+// debris, for the SIMD slab kernel, its scalar reference and the sphere loop
+// it replaced. Times are the mean per ray.
+BENCHMARK(VoxelRay)
+{
+	const int rays = (Quick() ? 16 : 64);
+	std::vector<std::uint32_t> counts = (Quick() ? std::vector<std::uint32_t>{ 4096 } : std::vector<std::uint32_t>{ 4096, 65536, 1 << 20 });
+
+	std::printf("%10s %14s %14s %14s %8s\n", "cubes", "kernel us", "scalar us", "sphere us", "hits");
+	for (std::uint32_t count : counts) {
+		float extent = std::cbrt(static_cast<float>(count)) * 2.0f;
+		std::vector<float> x(count);
+		std::vector<float> y(count);
+		std::vector<float> z(count);
+		std::vector<float> half(count, 0.5f);
+		for (std::uint32_t i = 0; i < count; i++) {
+			Random random(i, 1);
+			x[i] = random.NextRange(0.0f, extent);
+			y[i] = random.NextRange(0.0f, extent);
+			z[i] = random.NextRange(0.0f, extent);
+		}
+
+		std::vector<float> origins(rays * 3);
+		std::vector<float> directions(rays * 3);
+		for (int r = 0; r < rays; r++) {
+			Random random(static_cast<std::uint32_t>(r), 2);
+			for (int a = 0; a < 3; a++) {
+				origins[r * 3 + a] = random.NextRange(-extent, 0.0f);
+				directions[r * 3 + a] = random.NextRange(0.0f, extent) - origins[r * 3 + a];
+			}
+		}
+
+		const float maxDistance = 1e6f;
+		std::uint32_t hits = 0;
+		std::uint32_t scalarHits = 0;
+		std::uint32_t sphereHits = 0;
+		double kernelMs = Measure([&]() {
+			hits = 0;
+			for (int r = 0; r < rays; r++) {
+				float distance;
+				hits += (VoxelRay::NearestBox(&origins[r * 3], &directions[r * 3], x.data(), y.data(), z.data(), half.data(), 0, count, maxDistance, distance) != count ? 1 : 0);
+			}
+		});
+		double scalarMs = Measure([&]() {
+			scalarHits = 0;
+			for (int r = 0; r < rays; r++) {
+				float distance;
+				scalarHits += (VoxelRay::NearestBoxScalar(&origins[r * 3], &directions[r * 3], x.data(), y.data(), z.data(), half.data(), 0, count, maxDistance, distance) != count ? 1 : 0);
+			}
+		});
+		double sphereMs = Measure([&]() {
+			sphereHits = 0;
+			for (int r = 0; r < rays; r++) {
+				float distance;
+				sphereHits += (NearestSphere(&origins[r * 3], &directions[r * 3], x.data(), y.data(), z.data(), half.data(), count, maxDistance, distance) != count ? 1 : 0);
+			}
+		});
+
+		std::printf("%10u %14.2f %14.2f %14.2f %2u/%2u/%2u\n", count, kernelMs * 1000.0 / rays, scalarMs * 1000.0 / rays, sphereMs * 1000.0 / rays,
+			hits, scalarHits, sphereHits);
+	}
+}
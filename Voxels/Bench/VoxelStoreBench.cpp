@@ -0,0 +1,129 @@
+#include "Bench.h"
+#include "VoxelStore.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace Benchmarks;
+using namespace Rendering;
+
+namespace {
+	// The per-voxel object the store replaced: one heap allocation per voxel,
+	// with the physics fields scattered between a matrix and engine pointers
+	struct HeapVoxel {
+		void* Engine[4];
+		float World[16];
+		float Origin[3];
+		float Velocity[3];
+		float Gravity;
+		float Angular[3];
+		float Orientation[4];
+		float Size;
+		bool Moving;
+	};
+
+	void UpdateHeapVoxel(HeapVoxel& voxel, float time, float rotFalloff, float decay)
+	{
+		if (!voxel.Moving) {
+			return;
+		}
+
+		float speed = std::sqrt(voxel.Angular[0] * voxel.Angular[0] + voxel.Angular[1] * voxel.Angular[1] + voxel.Angular[2] * voxel.Angular[2]);
+		float halfAngle = speed * time * 0.5f;
+		float k = (speed > 1e-6f ? std::sin(halfAngle) / speed : time * 0.5f);
+		float c = std::cos(halfAngle);
+		float dx = voxel.Angular[0] * k;
+		float dy = voxel.Angular[1] * k;
+		float dz = voxel.Angular[2] * k;
+		float* q = voxel.Orientation;
+		float nx = c * q[0] + q[3] * dx + dy * q[2] - dz * q[1];
+		float ny = c * q[1] + q[3] * dy + dz * q[0] - dx * q[2];
+		float nz = c * q[2] + q[3] * dz + dx * q[1] - dy * q[0];
+		float nw = c * q[3] - dx * q[0] - dy * q[1] - dz * q[2];
+		float scale = 1.0f / std::sqrt(nx * nx + ny * ny + nz * nz + nw * nw);
+		q[0] = nx * scale;
+		q[1] = ny * scale;
+		q[2] = nz * scale;
+		q[3] = nw * scale;
+
+		for (int a = 0; a < 3; a++) {
+			voxel.Angular[a] *= rotFalloff;
+		}
+		voxel.Velocity[1] += voxel.Gravity * time;
+		for (int a = 0; a < 3; a++) {
+			voxel.Origin[a] += voxel.Velocity[a] * time;
+			voxel.Velocity[a] *= decay;
+		}
+	}
+}
+
+// One simulation step over every voxel, all of them moving, and building
+// their draw matrices, against the same step over one heap object per voxel
+// allocated in scattered order
+BENCHMARK(VoxelStore)
+{
+	const float time = static_cast<float>(1.0 / 60.0 * VoxelStore::TIME_FACTOR);
+	const float rotFalloff = VoxelStore::DECAY_FACTOR * VoxelStore::DECAY_FACTOR * VoxelStore::DECAY_FACTOR;
+	std::vector<std::uint32_t> counts = (Quick() ? std::vector<std::uint32_t>{ 4096 } : std::vector<std::uint32_t>{ 4096, 65536, 1048576 });
+
+	std::printf("%10s %16s %16s %16s\n", "voxels", "store ns/voxel", "matrix ns/voxel", "heap ns/voxel");
+	for (std::uint32_t count : counts) {
+		VoxelStore store;
+		store.Reserve(count);
+		std::vector<std::unique_ptr<HeapVoxel>> owned;
+		for (std::uint32_t i = 0; i < count; i++) {
+			Random random(i, 0);
+			float x = random.NextRange(-100.0f, 100.0f);
+			float y = random.NextRange(0.0f, 100.0f);
+			float z = random.NextRange(-100.0f, 100.0f);
+			float vx = random.NextRange(-5.0f, 5.0f);
+			float vz = random.NextRange(-5.0f, 5.0f);
+			float spin = random.NextRange(-1.0f, 1.0f);
+
+			std::uint32_t id = store.Add(x, y, z, 0.5f);
+			store.Drop(store.Slot(id));
+			std::uint32_t slot = store.Slot(id);
+			store.VelocityX()[slot] = vx;
+			store.VelocityZ()[slot] = vz;
+			store.SetAngularVelocity(slot, spin, spin, 0.0f);
+
+			std::unique_ptr<HeapVoxel> voxel(new HeapVoxel());
+			voxel->Origin[0] = x;
+			voxel->Origin[1] = y;
+			voxel->Origin[2] = z;
+			voxel->Velocity[0] = vx;
+			voxel->Velocity[2] = vz;
+			voxel->Gravity = VoxelStore::GRAVITY;
+			voxel->Angular[0] = spin;
+			voxel->Angular[1] = spin;
+			voxel->Orientation[3] = 1.0f;
+			voxel->Size = 0.5f;
+			voxel->Moving = true;
+			owned.push_back(std::move(voxel));
+		}
+
+		// Shuffle the pointers so the walk jumps around the heap as it did
+		// once voxels had been created and destroyed over a session
+		std::vector<HeapVoxel*> voxels;
+		for (std::unique_ptr<HeapVoxel>& voxel : owned) {
+			voxels.push_back(voxel.get());
+		}
+		for (std::uint32_t i = count; i-- > 1;) {
+			std::swap(voxels[i], voxels[Random(i, 1).Next() % (i + 1)]);
+		}
+
+		std::vector<float> matrices(static_cast<std::size_t>(count) * 16);
+		double storeMs = Measure([&]() { store.Integrate(1.0 / 60.0); });
+		double matrixMs = Measure([&]() { store.GetPositionMatrices(0, count, 0.5f, matrices.data()); });
+		double heapMs = Measure([&]() {
+			for (HeapVoxel* voxel : voxels) {
+				UpdateHeapVoxel(*voxel, time, rotFalloff, VoxelStore::DECAY_FACTOR);
+			}
+		});
+
+		double scale = 1e6 / count;
+		std::printf("%10u %16.2f %16.2f %16.2f\n", count, storeMs * scale, matrixMs * scale, heapMs * scale);
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+namespace Rendering {
+	// Growable array of trivially copyable elements whose storage is aligned for
+	// full-width SIMD loads. Used for the structure-of-arrays voxel data.
+	template <typename T, std::size_t Alignment = 32>
+	class AlignedArray {
+	public:
+		AlignedArray()
+			: mData(nullptr), mSize(0), mCapacity(0)
+		{
+		}
+
+		~AlignedArray()
+		{
+			Free(mData);
+		}
+
+		T* Data() { return mData; }
+		const T* Data() const { return mData; }
+		std::size_t Size() const { return mSize; }
+		std::size_t Capacity() const { return mCapacity; }
+
+		T& operator[](std::size_t index) { return mData[index]; }
+		const T& operator[](std::size_t index) const { return mData[index]; }
+
+		void Reserve(std::size_t capacity)
+		{
+			if (capacity <= mCapacity) {
+				return;
+			}
+
+			T* data = Allocate(capacity);
+			if (mSize > 0) {
+				std::memcpy(data, mData, mSize * sizeof(T));
+			}
+			Free(mData);
+			mData = data;
+			mCapacity = capacity;
+		}
+
+		void Resize(std::size_t size)
+		{
+			if (size > mCapacity) {
+				std::size_t capacity = mCapacity < 64 ? 64 : mCapacity;
+				while (capacity < size) {
+					capacity *= 2;
+				}
+				Reserve(capacity);
+			}
+			if (size > mSize) {
+				std::memset(mData + mSize, 0, (size - mSize) * sizeof(T));
+			}
+			mSize = size;
+		}
+
+		void PushBack(const T& value)
+		{
+			Resize(mSize + 1);
+			mData[mSize - 1] = value;
+		}
+
+		void Clear()
+		{
+			mSize = 0;
+		}
+
+	private:
+		AlignedArray(const AlignedArray& rhs);
+		AlignedArray& operator=(const AlignedArray& rhs);
+
+		static T* Allocate(std::size_t count)
+		{
+			// Round up so vector loops can always read a whole register past the end
+			std::size_t bytes = (count * sizeof(T) + Alignment - 1) & ~(Alignment - 1);
+#if defined(_MSC_VER)
+			void* data = _aligned_malloc(bytes, Alignment);
+#else
+			void* data = nullptr;
+			if (posix_memalign(&data, Alignment, bytes) != 0) {
+				data = nullptr;
+			}
+#endif
+			if (data == nullptr) {
+				throw std::bad_alloc();
+			}
+			return static_cast<T*>(data);
+		}
+
+		static void Free(T* data)
+		{
+#if defined(_MSC_VER)
+			_aligned_free(data);
+#else
+			std::free(data);
+#endif
+		}
+
+		T* mData;
+		std::size_t mSize;
+		std::size_t mCapacity;
+	};
+}
@@ -0,0 +1,560 @@
+#include "ChunkCodec.h"
+#include "ChunkGrid.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <cstring>
+
+namespace Rendering {
+	// "VXCK" read as a little-endian word
+	const std::uint32_t ChunkCodec::MAGIC = 0x4B435856;
+	const std::uint16_t ChunkCodec::VERSION = 1;
+	const std::size_t ChunkCodec::HEADER_SIZE = sizeof(ChunkCodec::Header);
+
+	namespace {
+		const std::uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+		const std::uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+
+		std::uint64_t RotateLeft(std::uint64_t value, int bits)
+		{
+			return (value << bits) | (value >> (64 - bits));
+		}
+
+		std::uint64_t Mix(std::uint64_t lane, std::uint64_t word)
+		{
+			return RotateLeft(lane ^ (word * PRIME2), 31) * PRIME1;
+		}
+
+		std::uint64_t LoadWord(const std::uint8_t* data)
+		{
+			std::uint64_t word;
+			std::memcpy(&word, data, sizeof(word));
+			return word;
+		}
+
+		std::size_t PadTo8(std::size_t bytes)
+		{
+			return (bytes + 7) & ~static_cast<std::size_t>(7);
+		}
+
+		// Every field of the given width, at most 16 bits, set to value
+		constexpr std::uint64_t Replicate(std::uint32_t value, std::uint32_t bits)
+		{
+			return ~0ull / ((1ull << bits) - 1) * value;
+		}
+
+		std::uint32_t CountBits(std::uint64_t bits)
+		{
+			bits -= (bits >> 1) & 0x5555555555555555ull;
+			bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+			bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+			return static_cast<std::uint32_t>((bits * 0x0101010101010101ull) >> 56);
+		}
+
+		// Groups of 2 * width low bits, one every 2 * width fields
+		constexpr std::uint64_t GroupMask(std::uint32_t bits, std::uint32_t width)
+		{
+			std::uint64_t group = (2 * width < 64 ? (1ull << (2 * width)) - 1 : ~0ull);
+			std::uint64_t mask = 0;
+			for (std::uint32_t position = 0; position < 64; position += 2 * width * bits) {
+				mask |= group << position;
+			}
+			return mask;
+		}
+
+		// Merges neighbouring groups of width flags, doubling until the flags of
+		// a word are adjacent. A template so each step's mask is a constant.
+		template <std::uint32_t Bits, std::uint32_t Width, bool Done = (Width >= 64 / Bits)>
+		struct Gather {
+			static std::uint64_t Apply(std::uint64_t solid)
+			{
+				solid = (solid | (solid >> (Width * Bits - Width))) & GroupMask(Bits, Width);
+				return Gather<Bits, Width * 2>::Apply(solid);
+			}
+		};
+
+		template <std::uint32_t Bits, std::uint32_t Width>
+		struct Gather<Bits, Width, true> {
+			static std::uint64_t Apply(std::uint64_t solid)
+			{
+				return solid;
+			}
+		};
+
+		// Sets bit i of the flags, one per cell, where packed entry i is not
+		// air. Each word's fields are compared with air all at once: XOR leaves
+		// a field zero where it is air, OR-folding a field down to its low bit
+		// leaves one flag per field, and the flags are gathered into adjacent
+		// bits by merging neighbouring groups, doubling each time. The width is
+		// a template argument so the steps unroll.
+		template <std::uint32_t Bits>
+		void SolidFlags(const std::uint64_t* words, std::uint32_t wordCount, std::uint32_t air, std::uint32_t* flags)
+		{
+			const std::uint32_t fields = 64 / Bits;
+			const std::uint64_t airPattern = Replicate(air, Bits);
+			const std::uint64_t lowBits = Replicate(1, Bits);
+			auto solidFields = [&](std::uint64_t word) {
+				std::uint64_t solid = word ^ airPattern;
+				for (std::uint32_t shift = 1; shift < Bits; shift *= 2) {
+					solid |= solid >> shift;
+				}
+				return Gather<Bits, 1>::Apply(solid & lowBits);
+			};
+
+			if (fields >= 32) {
+				for (std::uint32_t w = 0; w < wordCount; w++) {
+					std::uint64_t solid = solidFields(words[w]);
+					for (std::uint32_t part = 0; part < fields / 32; part++) {
+						flags[w * (fields / 32) + part] = static_cast<std::uint32_t>(solid >> (32 * part));
+					}
+				}
+				return;
+			}
+
+			// Wider fields take several words per row of flags; they are put
+			// together in a register before the store
+			const std::uint32_t wordsPerRow = 32 / fields;
+			for (std::uint32_t f = 0; f < wordCount / wordsPerRow; f++) {
+				std::uint32_t solid = 0;
+				for (std::uint32_t part = 0; part < wordsPerRow; part++) {
+					solid |= static_cast<std::uint32_t>(solidFields(words[f * wordsPerRow + part])) << (part * fields);
+				}
+				flags[f] = solid;
+			}
+		}
+
+#if defined(VOXELS_SIMD_SSE2)
+		// Byte and halfword entries are compared with air sixteen bytes at a
+		// time, and the comparison's sign bits are the row's flags
+		void SolidFlags8(const std::uint64_t* words, std::uint32_t wordCount, std::uint32_t air, std::uint32_t* flags)
+		{
+			const __m128i airs = _mm_set1_epi8(static_cast<char>(air));
+			const __m128i* rows = reinterpret_cast<const __m128i*>(words);
+			for (std::uint32_t f = 0; f < wordCount / 4; f++) {
+				__m128i low = _mm_cmpeq_epi8(_mm_loadu_si128(rows + 2 * f), airs);
+				__m128i high = _mm_cmpeq_epi8(_mm_loadu_si128(rows + 2 * f + 1), airs);
+				std::uint32_t solid = static_cast<std::uint32_t>(_mm_movemask_epi8(low)) | (static_cast<std::uint32_t>(_mm_movemask_epi8(high)) << 16);
+				flags[f] = ~solid;
+			}
+		}
+
+		void SolidFlags16(const std::uint64_t* words, std::uint32_t wordCount, std::uint32_t air, std::uint32_t* flags)
+		{
+			const __m128i airs = _mm_set1_epi16(static_cast<short>(air));
+			const __m128i* rows = reinterpret_cast<const __m128i*>(words);
+			for (std::uint32_t f = 0; f < wordCount / 8; f++) {
+				// Packing the halfword results to bytes keeps their order
+				__m128i low = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_loadu_si128(rows + 4 * f), airs),
+					_mm_cmpeq_epi16(_mm_loadu_si128(rows + 4 * f + 1), airs));
+				__m128i high = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_loadu_si128(rows + 4 * f + 2), airs),
+					_mm_cmpeq_epi16(_mm_loadu_si128(rows + 4 * f + 3), airs));
+				std::uint32_t solid = static_cast<std::uint32_t>(_mm_movemask_epi8(low)) | (static_cast<std::uint32_t>(_mm_movemask_epi8(high)) << 16);
+				flags[f] = ~solid;
+			}
+		}
+#endif
+
+		// Adds up the cells using each entry of a packed payload into counted,
+		// which has one counter per palette entry. Fails on an entry outside
+		// the palette.
+		//
+		// Entries of up to eight bits are counted a byte at a time: the bytes go
+		// into four histograms in turn, so runs of the same byte do not wait on
+		// one counter, and each byte value is then credited to the entries
+		// packed in it.
+		template <std::uint32_t Bits>
+		bool CountEntries(const std::uint8_t* payload, std::uint32_t paletteSize, std::uint32_t* counted)
+		{
+			const std::uint32_t byteCount = ChunkGrid::VOLUME * Bits / 8;
+			std::uint32_t histograms[4][256] = {};
+			for (std::uint32_t i = 0; i < byteCount; i += 4) {
+				histograms[0][payload[i]]++;
+				histograms[1][payload[i + 1]]++;
+				histograms[2][payload[i + 2]]++;
+				histograms[3][payload[i + 3]]++;
+			}
+
+			std::uint32_t entries[1 << Bits] = {};
+			for (std::uint32_t value = 0; value < 256; value++) {
+				std::uint32_t count = histograms[0][value] + histograms[1][value] + histograms[2][value] + histograms[3][value];
+				for (std::uint32_t shift = 0; shift < 8; shift += Bits) {
+					entries[(value >> shift) & ((1u << Bits) - 1)] += count;
+				}
+			}
+
+			for (std::uint32_t entry = 0; entry < (1u << Bits); entry++) {
+				if (entry >= paletteSize && entries[entry] != 0) {
+					return false;
+				}
+				if (entry < paletteSize) {
+					counted[entry] = entries[entry];
+				}
+			}
+			return true;
+		}
+
+		bool CountEntries16(const std::uint8_t* payload, std::uint32_t paletteSize, std::uint32_t* counted)
+		{
+			std::memset(counted, 0, paletteSize * sizeof(std::uint32_t));
+			for (std::uint32_t cell = 0; cell < ChunkGrid::VOLUME; cell++) {
+				std::uint16_t entry;
+				std::memcpy(&entry, payload + cell * sizeof(entry), sizeof(entry));
+				if (entry >= paletteSize) {
+					return false;
+				}
+				counted[entry]++;
+			}
+			return true;
+		}
+
+		// ORs pattern into bits [start, start + length) of the words
+		template <typename Word>
+		void FillBits(Word* words, std::uint64_t start, std::uint64_t length, Word pattern)
+		{
+			const std::uint32_t width = sizeof(Word) * 8;
+			std::uint64_t end = start + length - 1;
+			std::uint64_t first = start / width;
+			std::uint64_t last = end / width;
+			Word low = static_cast<Word>(~static_cast<Word>(0) << (start % width));
+			Word high = static_cast<Word>(~static_cast<Word>(0) >> (width - 1 - end % width));
+			if (first == last) {
+				words[first] |= pattern & low & high;
+				return;
+			}
+
+			words[first] |= pattern & low;
+			for (std::uint64_t w = first + 1; w < last; w++) {
+				words[w] = pattern;
+			}
+			words[last] |= pattern & high;
+		}
+	}
+
+	std::size_t ChunkCodec::Encode(const ChunkGrid& grid, std::vector<std::uint8_t>& data)
+	{
+		Header header;
+		header.Magic = MAGIC;
+		header.Version = VERSION;
+		header.Bits = static_cast<std::uint8_t>(grid.mBits);
+		header.PaletteSize = static_cast<std::uint32_t>(grid.mPalette.size());
+
+		std::size_t packedSize = ChunkGrid::VOLUME * grid.mBits / 8;
+		std::uint32_t runCount = (grid.mBits != 0 ? CountRuns(grid) : 0);
+		if (grid.mBits == 0) {
+			header.Encoding = UNIFORM;
+			header.PayloadSize = 0;
+		}
+		else if (runCount * 4 < packedSize) {
+			header.Encoding = RUNS;
+			header.PayloadSize = runCount * 4;
+		}
+		else {
+			header.Encoding = PACKED;
+			header.PayloadSize = static_cast<std::uint32_t>(packedSize);
+		}
+
+		std::size_t start = data.size();
+		std::size_t paletteBytes = PaletteBytes(header.PaletteSize);
+		std::size_t size = HEADER_SIZE + paletteBytes + header.PayloadSize;
+		data.resize(start + size, 0);
+		std::uint8_t* body = data.data() + start + HEADER_SIZE;
+
+		std::memcpy(body, grid.mPalette.data(), header.PaletteSize * sizeof(std::uint16_t));
+		std::memcpy(body + PadTo8(header.PaletteSize * sizeof(std::uint16_t)), grid.mCounts.data(), header.PaletteSize * sizeof(std::uint32_t));
+
+		std::uint8_t* payload = body + paletteBytes;
+		if (header.Encoding == PACKED) {
+			std::memcpy(payload, grid.mEntries.data(), packedSize);
+		}
+		else if (header.Encoding == RUNS) {
+			// Words that carry the current run on throughout are taken whole
+			std::uint32_t fields = 64 / grid.mBits;
+			std::uint32_t entry = grid.Entry(0);
+			std::uint32_t length = 0;
+			for (std::uint32_t cell = 0; cell <= ChunkGrid::VOLUME;) {
+				if (cell < ChunkGrid::VOLUME && cell % fields == 0 && grid.mEntries[cell / fields] == Replicate(entry, grid.mBits)) {
+					length += fields;
+					cell += fields;
+					continue;
+				}
+
+				std::uint32_t next = (cell < ChunkGrid::VOLUME ? grid.Entry(cell) : ~0u);
+				cell++;
+				if (next == entry) {
+					length++;
+					continue;
+				}
+
+				const std::uint16_t run[2] = { static_cast<std::uint16_t>(entry), static_cast<std::uint16_t>(length - 1) };
+				std::memcpy(payload, run, sizeof(run));
+				payload += sizeof(run);
+				entry = next;
+				length = 1;
+			}
+		}
+
+		header.Checksum = Checksum(body, paletteBytes + header.PayloadSize);
+		std::memcpy(data.data() + start, &header, HEADER_SIZE);
+		return size;
+	}
+
+	bool ChunkCodec::Decode(const std::uint8_t* data, std::size_t size, ChunkGrid& grid)
+	{
+		Header header;
+		if (!ReadHeader(data, size, header)) {
+			return false;
+		}
+
+		std::size_t paletteBytes = PaletteBytes(header.PaletteSize);
+		const std::uint8_t* body = data + HEADER_SIZE;
+		if (Checksum(body, paletteBytes + header.PayloadSize) != header.Checksum) {
+			return false;
+		}
+
+		// The counts must cover the chunk exactly
+		const std::uint8_t* counts = body + PadTo8(header.PaletteSize * sizeof(std::uint16_t));
+		std::uint64_t total = 0;
+		for (std::uint32_t entry = 0; entry < header.PaletteSize; entry++) {
+			std::uint32_t count;
+			std::memcpy(&count, counts + entry * sizeof(std::uint32_t), sizeof(count));
+			total += count;
+		}
+		if (total != ChunkGrid::VOLUME) {
+			return false;
+		}
+
+		const std::uint8_t* payload = body + paletteBytes;
+		if (header.Encoding == UNIFORM) {
+			std::uint16_t material;
+			std::memcpy(&material, body, sizeof(material));
+			grid.Fill(material);
+			return true;
+		}
+
+		// Check the payload before touching the grid: every entry must be in
+		// the palette, and each entry's count must be the cells that use it
+		std::uint32_t runCount = header.PayloadSize / 4;
+		thread_local std::vector<std::uint32_t> counted;
+		counted.resize(header.PaletteSize);
+		if (header.Encoding == RUNS) {
+			std::fill(counted.begin(), counted.end(), 0);
+			std::uint32_t cells = 0;
+			for (std::uint32_t r = 0; r < runCount; r++) {
+				std::uint16_t run[2];
+				std::memcpy(run, payload + r * sizeof(run), sizeof(run));
+				cells += run[1] + 1u;
+				if (run[0] >= header.PaletteSize || cells > ChunkGrid::VOLUME) {
+					return false;
+				}
+				counted[run[0]] += run[1] + 1u;
+			}
+		}
+		else if (!CountPackedEntries(payload, header.Bits, header.PaletteSize, counted.data())) {
+			return false;
+		}
+		if (std::memcmp(counted.data(), counts, header.PaletteSize * sizeof(std::uint32_t)) != 0) {
+			return false;
+		}
+
+		grid.mBits = header.Bits;
+		grid.mPalette.resize(header.PaletteSize);
+		grid.mCounts.resize(header.PaletteSize);
+		std::memcpy(grid.mPalette.data(), body, header.PaletteSize * sizeof(std::uint16_t));
+		std::memcpy(grid.mCounts.data(), counts, header.PaletteSize * sizeof(std::uint32_t));
+		grid.mEntries.resize(ChunkGrid::VOLUME * header.Bits / 64);
+		grid.mOccupancy.resize(ChunkGrid::SIZE * ChunkGrid::SIZE);
+
+		if (header.Encoding == PACKED) {
+			std::memcpy(grid.mEntries.data(), payload, header.PayloadSize);
+			DecodeOccupancy(grid);
+		}
+		else {
+			DecodeRuns(payload, runCount, grid);
+		}
+
+		grid.mSolidCount = ChunkGrid::VOLUME;
+		for (std::uint32_t entry = 0; entry < header.PaletteSize; entry++) {
+			if (grid.mCounts[entry] != 0 && grid.mPalette[entry] == ChunkGrid::EMPTY_MATERIAL) {
+				grid.mSolidCount -= grid.mCounts[entry];
+			}
+		}
+		return true;
+	}
+
+	std::size_t ChunkCodec::EncodedSize(const std::uint8_t* data, std::size_t size)
+	{
+		Header header;
+		if (size < HEADER_SIZE) {
+			return 0;
+		}
+		std::memcpy(&header, data, HEADER_SIZE);
+		if (header.Magic != MAGIC) {
+			return 0;
+		}
+		return HEADER_SIZE + PaletteBytes(header.PaletteSize) + header.PayloadSize;
+	}
+
+	std::uint64_t ChunkCodec::Checksum(const std::uint8_t* data, std::size_t size)
+	{
+		std::uint64_t lanes[4] = { PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1 };
+		std::size_t i = 0;
+		for (; i + 32 <= size; i += 32) {
+			for (int l = 0; l < 4; l++) {
+				lanes[l] = Mix(lanes[l], LoadWord(data + i + 8 * l));
+			}
+		}
+
+		std::uint64_t hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+		hash ^= static_cast<std::uint64_t>(size) * PRIME1;
+		for (; i + 8 <= size; i += 8) {
+			hash = Mix(hash, LoadWord(data + i));
+		}
+		for (; i < size; i++) {
+			hash = Mix(hash, data[i]);
+		}
+
+		hash ^= hash >> 33;
+		hash *= PRIME2;
+		hash ^= hash >> 29;
+		return hash;
+	}
+
+	std::size_t ChunkCodec::PaletteBytes(std::uint32_t paletteSize)
+	{
+		return PadTo8(paletteSize * sizeof(std::uint16_t)) + PadTo8(paletteSize * sizeof(std::uint32_t));
+	}
+
+	bool ChunkCodec::ReadHeader(const std::uint8_t* data, std::size_t size, Header& header)
+	{
+		if (size < HEADER_SIZE) {
+			return false;
+		}
+		std::memcpy(&header, data, HEADER_SIZE);
+		if (header.Magic != MAGIC || header.Version != VERSION || header.PaletteSize == 0 || header.PaletteSize > 0x10000) {
+			return false;
+		}
+		if (size < HEADER_SIZE + PaletteBytes(header.PaletteSize) + header.PayloadSize) {
+			return false;
+		}
+
+		switch (header.Encoding) {
+		case UNIFORM:
+			return header.Bits == 0 && header.PaletteSize == 1 && header.PayloadSize == 0;
+		case PACKED:
+		case RUNS:
+			// The palette must fit the entries, and the entries the words
+			if (header.Bits == 0 || header.Bits > 16 || (header.Bits & (header.Bits - 1)) != 0 || header.PaletteSize > (1u << header.Bits)) {
+				return false;
+			}
+			return (header.Encoding == PACKED
+				? header.PayloadSize == ChunkGrid::VOLUME * header.Bits / 8
+				: header.PayloadSize % 4 == 0);
+		default:
+			return false;
+		}
+	}
+
+	std::uint32_t ChunkCodec::CountRuns(const ChunkGrid& grid)
+	{
+		// A run starts at each field that differs from the one before it, so
+		// XOR each word with itself shifted up a field, carrying in the last
+		// field of the word before, and count the fields left nonzero
+		std::uint32_t bits = grid.mBits;
+		std::uint64_t lowBits = Replicate(1, bits);
+		std::uint64_t previous = grid.mEntries[0] << (64 - bits);
+		std::uint32_t runs = 1;
+		for (std::uint64_t word : grid.mEntries) {
+			std::uint64_t changed = word ^ ((word << bits) | (previous >> (64 - bits)));
+			for (std::uint32_t shift = 1; shift < bits; shift *= 2) {
+				changed |= changed >> shift;
+			}
+			runs += CountBits(changed & lowBits);
+			previous = word;
+		}
+		return runs;
+	}
+
+	bool ChunkCodec::CountPackedEntries(const std::uint8_t* payload, std::uint32_t bits, std::uint32_t paletteSize, std::uint32_t* counted)
+	{
+		switch (bits) {
+		case 1:
+			return CountEntries<1>(payload, paletteSize, counted);
+		case 2:
+			return CountEntries<2>(payload, paletteSize, counted);
+		case 4:
+			return CountEntries<4>(payload, paletteSize, counted);
+		case 8:
+			return CountEntries<8>(payload, paletteSize, counted);
+		default:
+			return CountEntries16(payload, paletteSize, counted);
+		}
+	}
+
+	void ChunkCodec::DecodeOccupancy(ChunkGrid& grid)
+	{
+		std::uint32_t bits = grid.mBits;
+		std::uint32_t* occupancy = grid.mOccupancy.data();
+		std::uint32_t air = ~0u;
+		for (std::uint32_t entry = 0; entry < grid.mPalette.size(); entry++) {
+			if (grid.mCounts[entry] != 0 && grid.mPalette[entry] == ChunkGrid::EMPTY_MATERIAL) {
+				air = entry;
+			}
+		}
+		if (air == ~0u) {
+			std::memset(occupancy, 0xFF, grid.mOccupancy.size() * sizeof(std::uint32_t));
+			return;
+		}
+
+		const std::uint64_t* words = grid.mEntries.data();
+		std::uint32_t wordCount = static_cast<std::uint32_t>(grid.mEntries.size());
+		switch (bits) {
+		case 1:
+			SolidFlags<1>(words, wordCount, air, occupancy);
+			break;
+		case 2:
+			SolidFlags<2>(words, wordCount, air, occupancy);
+			break;
+		case 4:
+			SolidFlags<4>(words, wordCount, air, occupancy);
+			break;
+#if defined(VOXELS_SIMD_SSE2)
+		case 8:
+			SolidFlags8(words, wordCount, air, occupancy);
+			break;
+		default:
+			SolidFlags16(words, wordCount, air, occupancy);
+			break;
+#else
+		case 8:
+			SolidFlags<8>(words, wordCount, air, occupancy);
+			break;
+		default:
+			SolidFlags<16>(words, wordCount, air, occupancy);
+			break;
+#endif
+		}
+	}
+
+	void ChunkCodec::DecodeRuns(const std::uint8_t* payload, std::uint32_t runCount, ChunkGrid& grid)
+	{
+		std::uint32_t bits = grid.mBits;
+		std::uint64_t* words = grid.mEntries.data();
+		std::uint32_t* occupancy = grid.mOccupancy.data();
+		std::memset(words, 0, grid.mEntries.size() * sizeof(std::uint64_t));
+		std::memset(occupancy, 0, grid.mOccupancy.size() * sizeof(std::uint32_t));
+
+		// Cells start out as entry zero and air, so only the rest is written
+		std::uint64_t cell = 0;
+		for (std::uint32_t r = 0; r < runCount; r++) {
+			std::uint16_t run[2];
+			std::memcpy(run, payload + r * sizeof(run), sizeof(run));
+			std::uint64_t length = run[1] + 1u;
+			if (run[0] != 0) {
+				FillBits<std::uint64_t>(words, cell * bits, length * bits, Replicate(run[0], bits));
+			}
+			if (grid.mPalette[run[0]] != ChunkGrid::EMPTY_MATERIAL) {
+				FillBits<std::uint32_t>(occupancy, cell, length, ~0u);
+			}
+			cell += length;
+		}
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Rendering {
+	class ChunkGrid;
+
+	// Binary format of a ChunkGrid, little-endian throughout:
+	//
+	//   header     magic, version, encoding, bits per entry, palette size,
+	//              payload size and a checksum of everything after the header
+	//   palette    the material of each entry, then the cells using each entry,
+	//              each array padded to eight bytes
+	//   payload    UNIFORM: nothing; the palette is the one material
+	//              PACKED:  the grid's packed entries as they are in memory
+	//              RUNS:    runs in cell order, each a 16-bit entry and a 16-bit
+	//                       length less one
+	//
+	// Encode() picks RUNS when it comes out smaller than PACKED. Decode()
+	// writes the palette and entries straight into the grid's own arrays, so a
+	// grid that is reused keeps its storage, and derives the occupancy words a
+	// row at a time from the entries. A payload is only trusted after its
+	// checksum and sizes check out, every entry in it is in the palette and
+	// the palette's counts match the cells that use each entry.
+	class ChunkCodec {
+	public:
+		enum Encoding {
+			UNIFORM,
+			PACKED,
+			RUNS
+		};
+
+		// Appends the encoded chunk to data and returns its size in bytes
+		static std::size_t Encode(const ChunkGrid& grid, std::vector<std::uint8_t>& data);
+		// Returns false, leaving the grid as it was, if data is not a whole
+		// valid chunk of this version
+		static bool Decode(const std::uint8_t* data, std::size_t size, ChunkGrid& grid);
+		// Size of the encoded chunk that data starts with, or zero if data does
+		// not start with a header
+		static std::size_t EncodedSize(const std::uint8_t* data, std::size_t size);
+
+		// Hash of the bytes, eight at a time in four independent lanes
+		static std::uint64_t Checksum(const std::uint8_t* data, std::size_t size);
+
+		static const std::uint32_t MAGIC;
+		static const std::uint16_t VERSION;
+		static const std::size_t HEADER_SIZE;
+
+	private:
+		struct Header {
+			std::uint32_t Magic;
+			std::uint16_t Version;
+			std::uint8_t Encoding;
+			std::uint8_t Bits;
+			std::uint32_t PaletteSize;
+			std::uint32_t PayloadSize;
+			std::uint64_t Checksum;
+		};
+
+		static std::size_t PaletteBytes(std::uint32_t paletteSize);
+		static bool ReadHeader(const std::uint8_t* data, std::size_t size, Header& header);
+		static std::uint32_t CountRuns(const ChunkGrid& grid);
+		static bool CountPackedEntries(const std::uint8_t* payload, std::uint32_t bits, std::uint32_t paletteSize, std::uint32_t* counted);
+		static void DecodeOccupancy(ChunkGrid& grid);
+		static void DecodeRuns(const std::uint8_t* payload, std::uint32_t runCount, ChunkGrid& grid);
+	};
+}
@@ -0,0 +1,283 @@
+#include "ChunkConnectivity.h"
+#include "VoxelStore.h"
+#include <cmath>
+
+namespace Rendering {
+	const std::uint32_t ChunkConnectivity::FILL_BUDGET = 65536;
+	const std::uint32_t ChunkConnectivity::EMPTY = 0xFFFFFFFF;
+
+	ChunkConnectivity::ChunkConnectivity()
+		: mBuilt(false), mPitch(1.0f), mOrigin(), mSize(), mFillCount(1)
+	{
+	}
+
+	void ChunkConnectivity::Build(const VoxelStore& store)
+	{
+		const float* originX = store.OriginX();
+		const float* originY = store.OriginY();
+		const float* originZ = store.OriginZ();
+		const float* size = store.Size();
+		const std::uint8_t* debris = store.Debris();
+		std::uint32_t count = store.Count();
+
+		mGrid.clear();
+		mCells.clear();
+		mFills.clear();
+		mSeeds.clear();
+		mBuilt = true;
+
+		// The lattice is taken from the first voxel that is part of the chunk
+		std::uint32_t first = 0;
+		while (first < count && debris[first]) {
+			first++;
+		}
+		if (first == count) {
+			mSize[0] = mSize[1] = mSize[2] = 0;
+			return;
+		}
+
+		mPitch = size[first] * 2.0f;
+		float base[3] = { originX[first], originY[first], originZ[first] };
+		auto lattice = [this, &base](float position, int axis) {
+			return static_cast<std::int32_t>(std::floor((position - base[axis]) / mPitch + 0.5f));
+		};
+
+		std::int32_t minimum[3] = { 0, 0, 0 };
+		std::int32_t maximum[3] = { 0, 0, 0 };
+		std::uint32_t ids = 0;
+		for (std::uint32_t i = 0; i < count; i++) {
+			ids = (store.Id(i) + 1 > ids ? store.Id(i) + 1 : ids);
+			if (debris[i]) {
+				continue;
+			}
+
+			std::int32_t cell[3] = { lattice(originX[i], 0), lattice(originY[i], 1), lattice(originZ[i], 2) };
+			for (int a = 0; a < 3; a++) {
+				minimum[a] = (cell[a] < minimum[a] ? cell[a] : minimum[a]);
+				maximum[a] = (cell[a] > maximum[a] ? cell[a] : maximum[a]);
+			}
+		}
+
+		for (int a = 0; a < 3; a++) {
+			mSize[a] = static_cast<std::uint32_t>(maximum[a] - minimum[a] + 1);
+			mOrigin[a] = base[a] + minimum[a] * mPitch;
+		}
+		std::size_t cells = static_cast<std::size_t>(mSize[0]) * mSize[1] * mSize[2];
+		mGrid.assign(cells, EMPTY);
+		mFills.assign(cells, 0);
+		mCells.assign(ids, EMPTY);
+
+		// Voxels that share a lattice point with an earlier one are left out
+		for (std::uint32_t i = 0; i < count; i++) {
+			if (debris[i]) {
+				continue;
+			}
+
+			std::uint32_t x = static_cast<std::uint32_t>(lattice(originX[i], 0) - minimum[0]);
+			std::uint32_t y = static_cast<std::uint32_t>(lattice(originY[i], 1) - minimum[1]);
+			std::uint32_t z = static_cast<std::uint32_t>(lattice(originZ[i], 2) - minimum[2]);
+			std::uint32_t cell = x + mSize[0] * (y + mSize[1] * z);
+			if (mGrid[cell] == EMPTY) {
+				mGrid[cell] = store.Id(i);
+				mCells[store.Id(i)] = cell;
+			}
+		}
+	}
+
+	bool ChunkConnectivity::IsBuilt() const
+	{
+		return mBuilt;
+	}
+
+	void ChunkConnectivity::Invalidate()
+	{
+		mBuilt = false;
+	}
+
+	bool ChunkConnectivity::Contains(std::uint32_t id) const
+	{
+		return id < mCells.size() && mCells[id] != EMPTY;
+	}
+
+	void ChunkConnectivity::Remove(std::uint32_t id)
+	{
+		if (!Contains(id)) {
+			return;
+		}
+
+		std::uint32_t cell = mCells[id];
+		mCells[id] = EMPTY;
+		mGrid[cell] = EMPTY;
+
+		std::uint32_t x = cell % mSize[0];
+		std::uint32_t y = (cell / mSize[0]) % mSize[1];
+		std::uint32_t z = cell / (mSize[0] * mSize[1]);
+		std::uint32_t strideY = mSize[0];
+		std::uint32_t strideZ = mSize[0] * mSize[1];
+		if (x > 0) mSeeds.push_back(cell - 1);
+		if (x + 1 < mSize[0]) mSeeds.push_back(cell + 1);
+		if (y > 0) mSeeds.push_back(cell - strideY);
+		if (y + 1 < mSize[1]) mSeeds.push_back(cell + strideY);
+		if (z > 0) mSeeds.push_back(cell - strideZ);
+		if (z + 1 < mSize[2]) mSeeds.push_back(cell + strideZ);
+	}
+
+	std::uint32_t ChunkConnectivity::FindIslands(float groundHeight, std::vector<std::uint32_t>& islands, std::vector<std::uint32_t>& ends)
+	{
+		std::uint32_t found = 0;
+		std::uint32_t firstFill = mFillCount;
+
+		for (std::size_t s = 0; s < mSeeds.size(); s++) {
+			std::uint32_t seed = mSeeds[s];
+			if (mGrid[seed] == EMPTY || mFills[seed] >= firstFill) {
+				continue;
+			}
+
+			if (!Fill(seed, mFillCount++, firstFill, groundHeight)) {
+				// The fill has seen the whole island, so it can be taken out
+				for (std::uint32_t cell : mVisited) {
+					std::uint32_t id = mGrid[cell];
+					islands.push_back(id);
+					mCells[id] = EMPTY;
+					mGrid[cell] = EMPTY;
+				}
+				ends.push_back(static_cast<std::uint32_t>(islands.size()));
+				found += static_cast<std::uint32_t>(mVisited.size());
+			}
+		}
+		mSeeds.clear();
+
+		return found;
+	}
+
+	bool ChunkConnectivity::Fill(std::uint32_t seed, std::uint32_t fill, std::uint32_t firstFill, float groundHeight)
+	{
+		// A cell rests on the ground if the bottom of its voxel is within a
+		// quarter of a voxel of it
+		float groundLayer = (groundHeight + mPitch * 0.75f - mOrigin[1]) / mPitch;
+		std::uint32_t strideY = mSize[0];
+		std::uint32_t strideZ = mSize[0] * mSize[1];
+
+		mStack.clear();
+		mVisited.clear();
+		mStack.push_back(seed);
+		mFills[seed] = fill;
+
+		while (!mStack.empty()) {
+			std::uint32_t cell = mStack.back();
+			mStack.pop_back();
+			mVisited.push_back(cell);
+
+			std::uint32_t x = cell % mSize[0];
+			std::uint32_t y = (cell / mSize[0]) % mSize[1];
+			std::uint32_t z = cell / strideZ;
+			if (static_cast<float>(y) <= groundLayer || mVisited.size() > FILL_BUDGET) {
+				return true;
+			}
+
+			// Pushed so the cell below comes off the stack first
+			std::uint32_t neighbours[6];
+			int count = 0;
+			if (y + 1 < mSize[1]) neighbours[count++] = cell + strideY;
+			if (x > 0) neighbours[count++] = cell - 1;
+			if (x + 1 < mSize[0]) neighbours[count++] = cell + 1;
+			if (z > 0) neighbours[count++] = cell - strideZ;
+			if (z + 1 < mSize[2]) neighbours[count++] = cell + strideZ;
+			if (y > 0) neighbours[count++] = cell - strideY;
+
+			for (int n = 0; n < count; n++) {
+				std::uint32_t next = neighbours[n];
+				if (mGrid[next] == EMPTY || mFills[next] == fill) {
+					continue;
+				}
+				if (mFills[next] >= firstFill) {
+					// Only a fill that stopped early, on support, can have left
+					// cells of the same structure unvisited
+					return true;
+				}
+
+				mFills[next] = fill;
+				mStack.push_back(next);
+			}
+		}
+
+		return false;
+	}
+
+	bool ChunkConnectivity::Raycast(const float origin[3], const float direction[3], float maxDistance, RayHit& hit) const
+	{
+		if (mGrid.empty()) {
+			return false;
+		}
+
+		// Each cell is the cube of the voxel at its lattice point
+		float half = mPitch * 0.5f;
+		float minimum[3];
+		float maximum[3];
+		for (int a = 0; a < 3; a++) {
+			minimum[a] = mOrigin[a] - half;
+			maximum[a] = minimum[a] + mSize[a] * mPitch;
+		}
+
+		float inverse[3];
+		float t;
+		float exit;
+		int axis;
+		VoxelRay::Inverse(direction, inverse);
+		if (!VoxelRay::Clip(origin, inverse, minimum, maximum, t, exit, axis)) {
+			return false;
+		}
+		if (t < 0.0f) {
+			// Starting inside the grid; the first cell counts as entered through
+			// the face the ray points away from
+			t = 0.0f;
+			float largest = 0.0f;
+			for (int a = 0; a < 3; a++) {
+				float component = std::fabs(direction[a]);
+				if (component > largest) {
+					largest = component;
+					axis = a;
+				}
+			}
+		}
+		exit = (exit < maxDistance ? exit : maxDistance);
+
+		std::int32_t cell[3];
+		std::int32_t step[3];
+		float next[3];
+		float delta[3];
+		for (int a = 0; a < 3; a++) {
+			float position = (origin[a] + direction[a] * t - minimum[a]) / mPitch;
+			std::int32_t index = static_cast<std::int32_t>(std::floor(position));
+			std::int32_t last = static_cast<std::int32_t>(mSize[a]) - 1;
+			cell[a] = (index < 0 ? 0 : (index > last ? last : index));
+
+			step[a] = (direction[a] > 0.0f ? 1 : (direction[a] < 0.0f ? -1 : 0));
+			delta[a] = std::fabs(mPitch * inverse[a]);
+			float boundary = minimum[a] + (cell[a] + (step[a] > 0 ? 1 : 0)) * mPitch;
+			next[a] = (step[a] != 0 ? (boundary - origin[a]) * inverse[a] : VoxelRay::PARALLEL);
+		}
+
+		// Visit cells in the order the ray enters them, starting with the one it
+		// enters the grid through
+		while (t <= exit) {
+			std::uint32_t index = static_cast<std::uint32_t>(cell[0]) + mSize[0] * (static_cast<std::uint32_t>(cell[1]) + mSize[1] * static_cast<std::uint32_t>(cell[2]));
+			if (mGrid[index] != EMPTY) {
+				hit.Id = mGrid[index];
+				hit.Distance = t;
+				VoxelRay::FaceNormal(direction, axis, hit.Normal);
+				return true;
+			}
+
+			axis = (next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2));
+			t = next[axis];
+			next[axis] += delta[axis];
+			cell[axis] += step[axis];
+			if (cell[axis] < 0 || cell[axis] >= static_cast<std::int32_t>(mSize[axis])) {
+				break;
+			}
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "VoxelRay.h"
+#include <cstdint>
+#include <vector>
+
+namespace Rendering {
+	class VoxelStore;
+
+	// Keeps track of which voxels of a chunk still hold together and rest on the
+	// ground. The voxels that are part of the chunk, rather than debris, are put
+	// in a dense grid with one cell per lattice point, two voxel sizes apart.
+	//
+	// Removing a voxel only records its six neighbours. FindIslands() then flood
+	// fills from each of them, stepping downwards first, and stops as soon as it
+	// reaches a cell resting on the ground or a cell an earlier fill already found
+	// supported. Only a fill that runs out of cells has found an island, so the
+	// work is proportional to the edited region and the path down from it, not to
+	// the size of the chunk. A fill that visits more than FILL_BUDGET cells is
+	// assumed to be supported.
+	//
+	// The same grid answers rays: Raycast() steps from cell to cell along the
+	// ray (Amanatides and Woo), so it only looks at the cells the ray crosses
+	// and hits the voxel cubes exactly.
+	class ChunkConnectivity {
+	public:
+		ChunkConnectivity();
+
+		// Indexes every voxel of the store that is not debris
+		void Build(const VoxelStore& store);
+		bool IsBuilt() const;
+		void Invalidate();
+
+		bool Contains(std::uint32_t id) const;
+		void Remove(std::uint32_t id);
+
+		// Appends the ids of the voxels cut off from the ground since the last
+		// call to islands and removes them; returns how many were appended. The
+		// end of each island in islands is appended to ends.
+		std::uint32_t FindIslands(float groundHeight, std::vector<std::uint32_t>& islands, std::vector<std::uint32_t>& ends);
+
+		// Finds the first voxel in the grid along the ray, if it is nearer than
+		// maxDistance
+		bool Raycast(const float origin[3], const float direction[3], float maxDistance, RayHit& hit) const;
+
+		static const std::uint32_t FILL_BUDGET;
+		static const std::uint32_t EMPTY;
+
+	private:
+		ChunkConnectivity(const ChunkConnectivity& rhs);
+		ChunkConnectivity& operator=(const ChunkConnectivity& rhs);
+
+		bool Fill(std::uint32_t seed, std::uint32_t fill, std::uint32_t firstFill, float groundHeight);
+
+		bool mBuilt;
+		float mPitch;
+		// World position of cell (0, 0, 0)
+		float mOrigin[3];
+		std::uint32_t mSize[3];
+		// Voxel id in each cell, or EMPTY
+		std::vector<std::uint32_t> mGrid;
+		// Cell of each voxel id, or EMPTY for voxels not in the grid
+		std::vector<std::uint32_t> mCells;
+		// Last fill to visit each cell; fills are numbered across calls, so
+		// nothing needs clearing between them
+		std::vector<std::uint32_t> mFills;
+		std::uint32_t mFillCount;
+		std::vector<std::uint32_t> mSeeds;
+		std::vector<std::uint32_t> mStack;
+		std::vector<std::uint32_t> mVisited;
+	};
+}
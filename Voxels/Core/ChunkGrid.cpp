@@ -0,0 +1,332 @@
+#include "ChunkGrid.h"
+#include <algorithm>
+
+namespace Rendering {
+	const std::uint32_t ChunkGrid::SIZE = 32;
+	const std::uint32_t ChunkGrid::VOLUME = SIZE * SIZE * SIZE;
+	const std::uint16_t ChunkGrid::EMPTY_MATERIAL = 0;
+
+	namespace {
+		std::uint32_t BitCount(std::uint32_t bits)
+		{
+			std::uint32_t count = 0;
+			for (; bits != 0; bits &= bits - 1) {
+				count++;
+			}
+			return count;
+		}
+	}
+
+	ChunkGrid::ChunkGrid()
+		: mBits(0), mPalette(1, EMPTY_MATERIAL), mCounts(1, VOLUME), mSolidCount(0)
+	{
+	}
+
+	std::uint16_t ChunkGrid::Get(std::uint32_t x, std::uint32_t y, std::uint32_t z) const
+	{
+		return (mBits == 0 ? mPalette[0] : mPalette[Entry(Cell(x, y, z))]);
+	}
+
+	void ChunkGrid::Set(std::uint32_t x, std::uint32_t y, std::uint32_t z, std::uint16_t material)
+	{
+		if (Get(x, y, z) == material) {
+			return;
+		}
+
+		if (mBits == 0) {
+			Expand();
+		}
+
+		std::uint32_t cell = Cell(x, y, z);
+		std::uint32_t entry = FindOrAddEntry(material);
+		std::uint32_t old = Entry(cell);
+		mCounts[old]--;
+		mCounts[entry]++;
+		SetEntry(cell, entry);
+
+		std::uint32_t bit = 1u << x;
+		std::uint32_t& row = mOccupancy[y | (z << 5)];
+		if (material != EMPTY_MATERIAL && (row & bit) == 0) {
+			row |= bit;
+			mSolidCount++;
+		}
+		else if (material == EMPTY_MATERIAL && (row & bit) != 0) {
+			row &= ~bit;
+			mSolidCount--;
+		}
+
+		if (mCounts[entry] == VOLUME) {
+			Fill(material);
+		}
+	}
+
+	bool ChunkGrid::IsSolid(std::uint32_t x, std::uint32_t y, std::uint32_t z) const
+	{
+		return ((Row(y, z) >> x) & 1) != 0;
+	}
+
+	void ChunkGrid::Fill(std::uint16_t material)
+	{
+		mBits = 0;
+		mPalette.assign(1, material);
+		mCounts.assign(1, VOLUME);
+		std::vector<std::uint64_t>().swap(mEntries);
+		std::vector<std::uint32_t>().swap(mOccupancy);
+		mSolidCount = (material != EMPTY_MATERIAL ? VOLUME : 0);
+	}
+
+	void ChunkGrid::Assign(const std::uint16_t* materials)
+	{
+		// Palette in order of first use. Runs of one material are common, so
+		// the palette is only searched where the material changes.
+		std::vector<std::uint16_t> palette(1, materials[0]);
+		std::uint16_t previous = materials[0];
+		for (std::uint32_t cell = 1; cell < VOLUME; cell++) {
+			if (materials[cell] != previous) {
+				previous = materials[cell];
+				if (std::find(palette.begin(), palette.end(), previous) == palette.end()) {
+					palette.push_back(previous);
+				}
+			}
+		}
+		if (palette.size() == 1) {
+			Fill(palette[0]);
+			return;
+		}
+
+		std::uint32_t bits = 1;
+		while ((1u << bits) < palette.size()) {
+			bits *= 2;
+		}
+
+		// Entries and occupancy are built up a word at a time
+		mBits = bits;
+		mPalette.swap(palette);
+		mCounts.assign(mPalette.size(), 0);
+		mEntries.assign(VOLUME * bits / 64, 0);
+		mOccupancy.assign(SIZE * SIZE, 0);
+		mSolidCount = 0;
+		previous = mPalette[0];
+		std::uint64_t entry = 0;
+		std::uint64_t word = 0;
+		std::uint32_t solid = 0;
+		for (std::uint32_t cell = 0; cell < VOLUME; cell++) {
+			std::uint16_t material = materials[cell];
+			if (material != previous) {
+				previous = material;
+				entry = static_cast<std::uint64_t>(std::find(mPalette.begin(), mPalette.end(), material) - mPalette.begin());
+			}
+			mCounts[entry]++;
+
+			std::uint32_t position = cell * bits;
+			word |= entry << (position & 63);
+			if (((position + bits) & 63) == 0) {
+				mEntries[position >> 6] = word;
+				word = 0;
+			}
+
+			solid |= (material != EMPTY_MATERIAL ? 1u : 0u) << (cell & (SIZE - 1));
+			if ((cell & (SIZE - 1)) == SIZE - 1) {
+				mOccupancy[cell / SIZE] = solid;
+				mSolidCount += BitCount(solid);
+				solid = 0;
+			}
+		}
+	}
+
+	void ChunkGrid::Compact()
+	{
+		if (mBits == 0) {
+			return;
+		}
+
+		std::uint32_t used = 0;
+		for (std::uint32_t entry = 0; entry < mPalette.size(); entry++) {
+			used += (mCounts[entry] != 0 ? 1 : 0);
+		}
+
+		if (used == 1) {
+			for (std::uint32_t entry = 0; entry < mPalette.size(); entry++) {
+				if (mCounts[entry] != 0) {
+					Fill(mPalette[entry]);
+					return;
+				}
+			}
+		}
+
+		std::uint32_t bits = 1;
+		while ((1u << bits) < used) {
+			bits *= 2;
+		}
+		if (used == mPalette.size() && bits == mBits) {
+			return;
+		}
+
+		// Renumber the used entries in order and rewrite every cell through the map
+		std::vector<std::uint32_t> map(mPalette.size(), 0);
+		std::vector<std::uint16_t> palette;
+		std::vector<std::uint32_t> counts;
+		for (std::uint32_t entry = 0; entry < mPalette.size(); entry++) {
+			if (mCounts[entry] != 0) {
+				map[entry] = static_cast<std::uint32_t>(palette.size());
+				palette.push_back(mPalette[entry]);
+				counts.push_back(mCounts[entry]);
+			}
+		}
+
+		std::vector<std::uint64_t> entries(VOLUME * bits / 64, 0);
+		for (std::uint32_t cell = 0; cell < VOLUME; cell++) {
+			std::uint32_t position = cell * bits;
+			entries[position >> 6] |= static_cast<std::uint64_t>(map[Entry(cell)]) << (position & 63);
+		}
+
+		mBits = bits;
+		mPalette.swap(palette);
+		mCounts.swap(counts);
+		mEntries.swap(entries);
+	}
+
+	bool ChunkGrid::IsUniform() const
+	{
+		return mBits == 0;
+	}
+
+	std::uint32_t ChunkGrid::Row(std::uint32_t y, std::uint32_t z) const
+	{
+		if (mBits == 0) {
+			return (mPalette[0] != EMPTY_MATERIAL ? 0xFFFFFFFFu : 0);
+		}
+		return mOccupancy[y | (z << 5)];
+	}
+
+	std::uint32_t ChunkGrid::ExposedRow(std::uint32_t y, std::uint32_t z, Face face) const
+	{
+		std::uint32_t row = Row(y, z);
+		std::uint32_t neighbours = 0;
+		switch (face) {
+		case NEGATIVE_X:
+			neighbours = row << 1;
+			break;
+		case POSITIVE_X:
+			neighbours = row >> 1;
+			break;
+		case NEGATIVE_Y:
+			neighbours = (y > 0 ? Row(y - 1, z) : 0);
+			break;
+		case POSITIVE_Y:
+			neighbours = (y + 1 < SIZE ? Row(y + 1, z) : 0);
+			break;
+		case NEGATIVE_Z:
+			neighbours = (z > 0 ? Row(y, z - 1) : 0);
+			break;
+		case POSITIVE_Z:
+			neighbours = (z + 1 < SIZE ? Row(y, z + 1) : 0);
+			break;
+		}
+		return row & ~neighbours;
+	}
+
+	std::uint32_t ChunkGrid::SolidCount() const
+	{
+		return mSolidCount;
+	}
+
+	std::uint32_t ChunkGrid::ExposedFaceCount() const
+	{
+		if (mBits == 0) {
+			return (mPalette[0] != EMPTY_MATERIAL ? 6 * SIZE * SIZE : 0);
+		}
+
+		std::uint32_t count = 0;
+		for (std::uint32_t z = 0; z < SIZE; z++) {
+			for (std::uint32_t y = 0; y < SIZE; y++) {
+				if (Row(y, z) == 0) {
+					continue;
+				}
+				for (int face = NEGATIVE_X; face <= POSITIVE_Z; face++) {
+					count += BitCount(ExposedRow(y, z, static_cast<Face>(face)));
+				}
+			}
+		}
+		return count;
+	}
+
+	std::uint32_t ChunkGrid::PaletteSize() const
+	{
+		return static_cast<std::uint32_t>(mPalette.size());
+	}
+
+	std::uint32_t ChunkGrid::BitsPerEntry() const
+	{
+		return mBits;
+	}
+
+	std::size_t ChunkGrid::MemoryBytes() const
+	{
+		return sizeof(ChunkGrid) + mPalette.capacity() * sizeof(std::uint16_t) + mCounts.capacity() * sizeof(std::uint32_t)
+			+ mEntries.capacity() * sizeof(std::uint64_t) + mOccupancy.capacity() * sizeof(std::uint32_t);
+	}
+
+	std::uint32_t ChunkGrid::Cell(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+	{
+		return x | (y << 5) | (z << 10);
+	}
+
+	std::uint32_t ChunkGrid::Entry(std::uint32_t cell) const
+	{
+		std::uint32_t position = cell * mBits;
+		return static_cast<std::uint32_t>(mEntries[position >> 6] >> (position & 63)) & ((1u << mBits) - 1);
+	}
+
+	void ChunkGrid::SetEntry(std::uint32_t cell, std::uint32_t entry)
+	{
+		std::uint32_t position = cell * mBits;
+		std::uint64_t mask = static_cast<std::uint64_t>((1u << mBits) - 1) << (position & 63);
+		std::uint64_t& word = mEntries[position >> 6];
+		word = (word & ~mask) | (static_cast<std::uint64_t>(entry) << (position & 63));
+	}
+
+	std::uint32_t ChunkGrid::FindOrAddEntry(std::uint16_t material)
+	{
+		std::uint32_t free = static_cast<std::uint32_t>(mPalette.size());
+		for (std::uint32_t entry = 0; entry < mPalette.size(); entry++) {
+			if (mCounts[entry] != 0 && mPalette[entry] == material) {
+				return entry;
+			}
+			if (mCounts[entry] == 0 && free == mPalette.size()) {
+				free = entry;
+			}
+		}
+
+		if (free < mPalette.size()) {
+			mPalette[free] = material;
+			return free;
+		}
+
+		if (free == (1u << mBits)) {
+			Repack(mBits * 2);
+		}
+		mPalette.push_back(material);
+		mCounts.push_back(0);
+		return free;
+	}
+
+	void ChunkGrid::Expand()
+	{
+		// Every cell points at entry zero, the uniform value
+		mBits = 1;
+		mEntries.assign(VOLUME / 64, 0);
+		mOccupancy.assign(SIZE * SIZE, (mPalette[0] != EMPTY_MATERIAL ? 0xFFFFFFFFu : 0));
+	}
+
+	void ChunkGrid::Repack(std::uint32_t bits)
+	{
+		std::vector<std::uint64_t> entries(VOLUME * bits / 64, 0);
+		for (std::uint32_t cell = 0; cell < VOLUME; cell++) {
+			std::uint32_t position = cell * bits;
+			entries[position >> 6] |= static_cast<std::uint64_t>(Entry(cell)) << (position & 63);
+		}
+		mBits = bits;
+		mEntries.swap(entries);
+	}
+}
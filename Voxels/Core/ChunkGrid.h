@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Rendering {
+	// Dense storage for a cube of SIZE cells on a side, each holding a material
+	// id, EMPTY_MATERIAL for air. Cell (x, y, z) is the x'th bit of row (y, z).
+	//
+	// Cells hold indices into a palette of the materials in use, packed at the
+	// fewest bits per entry that fit the palette: 1, 2, 4, 8 or 16, so no entry
+	// straddles a word. The palette counts its cells; an entry whose count
+	// drops to zero is reused by the next new material, and adding a material
+	// that does not fit doubles the bits per entry. A chunk of one material
+	// throughout collapses to that value and holds no arrays at all.
+	//
+	// Alongside the indices, one 32-bit word per row records which cells are
+	// solid, so whether a cell is solid and which faces of a row are exposed
+	// are answered from the occupancy words alone, a whole row at a time.
+	class ChunkGrid {
+	public:
+		// Faces of a cell, in the order -x, +x, -y, +y, -z, +z
+		enum Face {
+			NEGATIVE_X,
+			POSITIVE_X,
+			NEGATIVE_Y,
+			POSITIVE_Y,
+			NEGATIVE_Z,
+			POSITIVE_Z
+		};
+
+		ChunkGrid();
+
+		std::uint16_t Get(std::uint32_t x, std::uint32_t y, std::uint32_t z) const;
+		void Set(std::uint32_t x, std::uint32_t y, std::uint32_t z, std::uint16_t material);
+		bool IsSolid(std::uint32_t x, std::uint32_t y, std::uint32_t z) const;
+		// Sets every cell, collapsing the chunk to a single value
+		void Fill(std::uint16_t material);
+		// Sets every cell from VOLUME materials in cell order, x fastest then
+		// y then z. The palette is searched linearly where the material
+		// changes, so this suits chunks of a few materials, such as generated ones.
+		void Assign(const std::uint16_t* materials);
+		// Drops palette entries no cell uses and repacks at the fewest bits
+		// that fit, or collapses the chunk if one material is left
+		void Compact();
+
+		bool IsUniform() const;
+
+		// Bit x is set when cell (x, y, z) is solid
+		std::uint32_t Row(std::uint32_t y, std::uint32_t z) const;
+		// Solid cells of row (y, z) whose neighbour across face is air. Cells
+		// beyond the chunk count as air.
+		std::uint32_t ExposedRow(std::uint32_t y, std::uint32_t z, Face face) const;
+
+		std::uint32_t SolidCount() const;
+		// Solid faces that touch air, counted a row at a time
+		std::uint32_t ExposedFaceCount() const;
+		std::uint32_t PaletteSize() const;
+		std::uint32_t BitsPerEntry() const;
+		std::size_t MemoryBytes() const;
+
+		static const std::uint32_t SIZE;
+		static const std::uint32_t VOLUME;
+		static const std::uint16_t EMPTY_MATERIAL;
+
+	private:
+		// Reads and writes the arrays directly, so loading does not go
+		// through Set()
+		friend class ChunkCodec;
+
+		static std::uint32_t Cell(std::uint32_t x, std::uint32_t y, std::uint32_t z);
+		std::uint32_t Entry(std::uint32_t cell) const;
+		void SetEntry(std::uint32_t cell, std::uint32_t entry);
+		// Palette entry for material, added or reusing a free entry if need be
+		std::uint32_t FindOrAddEntry(std::uint16_t material);
+		void Expand();
+		void Repack(std::uint32_t bits);
+
+		// Zero while the chunk is uniform
+		std::uint32_t mBits;
+		std::vector<std::uint16_t> mPalette;
+		// Cells using each palette entry
+		std::vector<std::uint32_t> mCounts;
+		std::vector<std::uint64_t> mEntries;
+		std::vector<std::uint32_t> mOccupancy;
+		std::uint32_t mSolidCount;
+	};
+}
@@ -0,0 +1,427 @@
+#include "ChunkSimulation.h"
+#include "GameTime.h"
+#include "JobSystem.h"
+#include "SimdMath.h"
+#include "VoxelIntegrator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Rendering {
+	const std::uint32_t ChunkSimulation::UPDATE_GRAIN = 1024;
+	const float ChunkSimulation::BLAST_SPIN = 15.0f;
+	const float ChunkSimulation::DEBRIS_LIFETIME = 30.0f;
+	const float ChunkSimulation::PLAY_AREA_EXTENT = 256.0f;
+	const float ChunkSimulation::KILL_DEPTH = 16.0f;
+	const float ChunkSimulation::PICK_DISTANCE = 1e6f;
+	const std::uint32_t ChunkSimulation::RAY_GRAIN = 64;
+
+	namespace {
+		// Spreads the low ten bits of value out to every third bit
+		std::uint32_t SpreadBits(std::uint32_t value)
+		{
+			value &= 0x3FF;
+			value = (value | (value << 16)) & 0x030000FF;
+			value = (value | (value << 8)) & 0x0300F00F;
+			value = (value | (value << 4)) & 0x030C30C3;
+			value = (value | (value << 2)) & 0x09249249;
+			return value;
+		}
+
+		// Morton code of the ray's unit direction, so sorting by it puts rays
+		// that point the same way next to each other
+		std::uint32_t DirectionKey(const float direction[3])
+		{
+			float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+			float scale = (length > 0.0f ? 511.5f / length : 0.0f);
+			std::uint32_t key = 0;
+			for (int a = 0; a < 3; a++) {
+				key |= SpreadBits(static_cast<std::uint32_t>(direction[a] * scale + 511.5f)) << a;
+			}
+			return key;
+		}
+	}
+
+	ChunkSimulation::ChunkSimulation(JobSystem* jobSystem)
+		: mJobSystem(jobSystem), mStats(), mSeed(0), mBlastCount(0), mDebrisLifetime(DEBRIS_LIFETIME)
+		, mPlayAreaMinimum{ -PLAY_AREA_EXTENT, -PLAY_AREA_EXTENT, -PLAY_AREA_EXTENT }
+		, mPlayAreaMaximum{ PLAY_AREA_EXTENT, PLAY_AREA_EXTENT, PLAY_AREA_EXTENT }
+	{
+	}
+
+	void ChunkSimulation::AddVoxel(float x, float y, float z, float size)
+	{
+		mStore.Add(x, y, z, size);
+		mConnectivity.Invalidate();
+	}
+
+	void ChunkSimulation::AddVoxels(const VoxelDag& world, const std::uint32_t minimum[3], const std::uint32_t maximum[3], float pitch)
+	{
+		float size = pitch * 0.5f;
+		world.ForEachSolid(minimum, maximum, [&](std::uint32_t x, std::uint32_t y, std::uint32_t z) {
+			mStore.Add(x * pitch, y * pitch, z * pitch, size);
+		});
+		mConnectivity.Invalidate();
+	}
+
+	void ChunkSimulation::Update(const GameTime& gameTime)
+	{
+		// Simulate in fixed steps so debris behaves the same at any frame rate
+		std::uint32_t steps = mTimestep.Advance(gameTime);
+
+		mStats.Steps = steps;
+		mStats.Active = 0;
+		mStats.Contacts = 0;
+		mStats.Supported = 0;
+		mStats.FellAsleep = 0;
+		for (std::uint32_t i = 0; i < steps; i++) {
+			Step(mTimestep.StepTime());
+			mTimestep.CompleteStep();
+		}
+		mStats.Despawned = 0;
+		if (steps > 0) {
+			mStats.Despawned = Despawn(static_cast<float>(mTimestep.StepTime().TotalGameTime()));
+			mDebris.Update(mStore, mJobSystem);
+		}
+		mStats.Sleeping = mStore.SleepingCount();
+		mStats.Clusters = mClusters.Count();
+	}
+
+	void ChunkSimulation::Step(const GameTime& stepTime)
+	{
+		// Only the active prefix of the store is simulated
+		double elapsed = stepTime.ElapsedGameTime();
+		std::uint32_t count = mStore.ActiveCount();
+		mRangeMoving.assign((count + UPDATE_GRAIN - 1) / UPDATE_GRAIN, 0);
+
+		// Each range only touches its own voxels and its own result slot
+		auto integrate = [this, elapsed](std::uint32_t begin, std::uint32_t end) {
+			mStore.SavePrevious(begin, end);
+			mStore.ClearContacts(begin, end);
+			mRangeMoving[begin / UPDATE_GRAIN] = VoxelIntegrator::Integrate(mStore, begin, end, elapsed);
+		};
+
+		if (mJobSystem != nullptr) {
+			mJobSystem->ParallelFor(count, UPDATE_GRAIN, integrate);
+		}
+		else {
+			for (std::uint32_t begin = 0; begin < count; begin += UPDATE_GRAIN) {
+				integrate(begin, begin + UPDATE_GRAIN < count ? begin + UPDATE_GRAIN : count);
+			}
+		}
+
+		// Merge in range order so the result does not depend on scheduling
+		std::uint32_t active = 0;
+		for (std::uint32_t moving : mRangeMoving) {
+			active += moving;
+		}
+		mStats.Active = active;
+
+		// Push apart debris that the step moved into each other, then keep it out
+		// of the ground and the voxels at rest; only supported debris can sleep
+		mStats.Contacts = mContactSolver.Solve(mStore, count, mJobSystem);
+		mStats.Supported = mWorld.Collide(mStore, count, mJobSystem);
+		mStats.FellAsleep += mStore.SleepResting();
+
+		// Islands that came off in one piece move as rigid bodies; a body that
+		// settles goes back into the store asleep
+		mClusters.Integrate(elapsed);
+		mClusters.Collide(mWorld, mStore);
+		mStats.FellAsleep += mClusters.SleepResting(mStore);
+	}
+
+	std::uint32_t ChunkSimulation::Despawn(float now)
+	{
+		const float* originX = mStore.OriginX();
+		const float* originY = mStore.OriginY();
+		const float* originZ = mStore.OriginZ();
+		const std::uint8_t* debris = mStore.Debris();
+		const float* launchTime = mStore.LaunchTime();
+		float floor = mWorld.GroundHeight() - KILL_DEPTH;
+		std::uint32_t active = mStore.ActiveCount();
+		std::uint32_t removed = 0;
+
+		// Remove() only moves voxels from above index, so walking downwards
+		// every voxel is checked once. Sleeping voxels cannot have moved, so
+		// only their age is checked.
+		for (std::uint32_t i = mStore.Count(); i-- > 0;) {
+			if (!debris[i]) {
+				continue;
+			}
+
+			bool expired = (mDebrisLifetime > 0.0f && now - launchTime[i] >= mDebrisLifetime);
+			bool outside = false;
+			if (i < active) {
+				outside = originY[i] < floor
+					|| originX[i] < mPlayAreaMinimum[0] || originX[i] > mPlayAreaMaximum[0]
+					|| originY[i] < mPlayAreaMinimum[1] || originY[i] > mPlayAreaMaximum[1]
+					|| originZ[i] < mPlayAreaMinimum[2] || originZ[i] > mPlayAreaMaximum[2];
+			}
+
+			if (expired || outside) {
+				mStore.Remove(i);
+				removed++;
+			}
+		}
+
+		for (std::uint32_t b = mClusters.Count(); b-- > 0;) {
+			const float* position = mClusters.Position(b);
+			bool expired = (mDebrisLifetime > 0.0f && now - mClusters.LaunchTime(b) >= mDebrisLifetime);
+			bool outside = position[1] < floor
+				|| position[0] < mPlayAreaMinimum[0] || position[0] > mPlayAreaMaximum[0]
+				|| position[1] < mPlayAreaMinimum[1] || position[1] > mPlayAreaMaximum[1]
+				|| position[2] < mPlayAreaMinimum[2] || position[2] > mPlayAreaMaximum[2];
+			if (expired || outside) {
+				removed += mClusters.Remove(b);
+			}
+		}
+
+		return removed;
+	}
+
+	void ChunkSimulation::SetMotionVectors(float x, float y, float z)
+	{
+		const float p[3] = { x, y, z };
+		if (!mConnectivity.IsBuilt()) {
+			mConnectivity.Build(mStore);
+		}
+
+		// Only voxels within reach of the blast can be hit. The moving ones come
+		// from the debris tree and the sleeping ones from the static index, so a
+		// blast costs what it covers rather than what the chunk holds.
+		const float* originX = mStore.OriginX();
+		const float* originY = mStore.OriginY();
+		const float* originZ = mStore.OriginZ();
+		const float reach = VoxelStore::BLAST_REACH;
+		auto inReach = [&](std::uint32_t i) {
+			float dx = originX[i] - p[0];
+			float dy = originY[i] - p[1];
+			float dz = originZ[i] - p[2];
+			return dx * dx + dy * dy + dz * dz <= reach * reach;
+		};
+
+		mBlastSlots.clear();
+		mDebris.ForEachInSphere(p, reach, [&](std::uint32_t id) {
+			std::uint32_t i = mStore.Slot(id);
+			if (inReach(i)) {
+				mBlastSlots.push_back(i);
+			}
+		});
+		float minimum[3] = { p[0] - reach, p[1] - reach, p[2] - reach };
+		float maximum[3] = { p[0] + reach, p[1] + reach, p[2] + reach };
+		mWorld.ForEachStaticInBox(mStore, minimum, maximum, [&](std::uint32_t i) {
+			if (inReach(i)) {
+				mBlastSlots.push_back(i);
+			}
+		});
+		std::sort(mBlastSlots.begin(), mBlastSlots.end());
+
+		// Every voxel draws from its own generator, keyed by blast and voxel id, so
+		// a blast comes out the same however the ranges are split across threads
+		std::uint32_t blast = Random::Combine(mSeed, mBlastCount++);
+		float now = static_cast<float>(mTimestep.StepTime().TotalGameTime());
+		std::uint32_t count = static_cast<std::uint32_t>(mBlastSlots.size());
+		mBlastHits.assign(count, 0);
+		auto launch = [this, &p, blast, now](std::uint32_t begin, std::uint32_t end) {
+			for (std::uint32_t k = begin; k < end; k++) {
+				std::uint32_t i = mBlastSlots[k];
+				Random random(blast, mStore.Id(i));
+				if (mStore.SetMotionVector(i, p[0], p[1], p[2], random)) {
+					mStore.SetLaunchTime(i, now);
+					float x = random.NextRange(-BLAST_SPIN, BLAST_SPIN);
+					float y = random.NextRange(-BLAST_SPIN, BLAST_SPIN);
+					float z = random.NextRange(-BLAST_SPIN, BLAST_SPIN);
+					mStore.SetAngularVelocity(i, x, y, z);
+					mBlastHits[k] = 1;
+				}
+			}
+		};
+
+		if (mJobSystem != nullptr) {
+			mJobSystem->ParallelFor(count, UPDATE_GRAIN, launch);
+		}
+		else if (count > 0) {
+			launch(0, count);
+		}
+
+		// Waking in ascending slot order only moves voxels at or below the one
+		// being woken, so the slots still to come are unchanged
+		for (std::uint32_t k = 0; k < count; k++) {
+			if (mBlastHits[k]) {
+				mConnectivity.Remove(mStore.Id(mBlastSlots[k]));
+				mStore.Wake(mBlastSlots[k]);
+			}
+		}
+
+		// Whatever the blast has cut off from the ground falls too; an island of
+		// more than one voxel falls in one piece
+		mIslands.clear();
+		mIslandEnds.clear();
+		mConnectivity.FindIslands(mWorld.GroundHeight(), mIslands, mIslandEnds);
+		std::uint32_t begin = 0;
+		for (std::uint32_t end : mIslandEnds) {
+			if (end - begin > 1) {
+				mClusters.Create(mStore, mIslands.data() + begin, end - begin, now);
+			}
+			else {
+				std::uint32_t i = mStore.Slot(mIslands[begin]);
+				mStore.SetLaunchTime(i, now);
+				mStore.Drop(i);
+			}
+			begin = end;
+		}
+
+		// The tree has to cover the voxels that just started moving before the
+		// next pick or blast
+		mDebris.Update(mStore, mJobSystem);
+	}
+
+	bool ChunkSimulation::Raycast(const float origin[3], const float direction[3], RayHit& hit)
+	{
+		PrepareRaycast();
+		RaycastStatic(origin, direction, hit);
+		RayHit debris;
+		if (mDebris.Raycast(origin, direction, hit.Distance, debris)) {
+			hit = debris;
+		}
+
+		return hit.Distance < PICK_DISTANCE;
+	}
+
+	std::uint32_t ChunkSimulation::RaycastBatch(const Ray* rays, std::uint32_t count, RayHit* hits)
+	{
+		PrepareRaycast();
+
+		// Packets are cut from the rays in direction order, with the index in
+		// the low half of the key so equal directions keep the caller's order
+		mRayOrder.resize(count);
+		for (std::uint32_t r = 0; r < count; r++) {
+			mRayOrder[r] = (static_cast<std::uint64_t>(DirectionKey(rays[r].Direction)) << 32) | r;
+		}
+		std::sort(mRayOrder.begin(), mRayOrder.end());
+
+		// Each range only reads the chunk and writes the hits of its own rays
+		auto cast = [this, rays, hits](std::uint32_t begin, std::uint32_t end) {
+			Ray packet[Simd::FloatN::Width];
+			RayHit packetHits[Simd::FloatN::Width];
+			for (std::uint32_t first = begin; first < end; first += DebrisTree::PACKET_SIZE) {
+				std::uint32_t size = (end - first > DebrisTree::PACKET_SIZE ? DebrisTree::PACKET_SIZE : end - first);
+				for (std::uint32_t p = 0; p < size; p++) {
+					packet[p] = rays[static_cast<std::uint32_t>(mRayOrder[first + p])];
+					RaycastStatic(packet[p].Origin, packet[p].Direction, packetHits[p]);
+				}
+				mDebris.RaycastPacket(packet, size, packetHits);
+				for (std::uint32_t p = 0; p < size; p++) {
+					hits[static_cast<std::uint32_t>(mRayOrder[first + p])] = packetHits[p];
+				}
+			}
+		};
+
+		if (mJobSystem != nullptr) {
+			mJobSystem->ParallelFor(count, RAY_GRAIN, cast);
+		}
+		else if (count > 0) {
+			cast(0, count);
+		}
+
+		std::uint32_t hitCount = 0;
+		for (std::uint32_t r = 0; r < count; r++) {
+			if (hits[r].Distance < PICK_DISTANCE) {
+				hitCount++;
+			}
+			else {
+				hits[r].Id = VoxelStore::INVALID_SLOT;
+				hits[r].Distance = -1.0f;
+			}
+		}
+
+		return hitCount;
+	}
+
+	float ChunkSimulation::FindClosestVoxel(const float origin[3], const float direction[3])
+	{
+		RayHit hit;
+		return (Raycast(origin, direction, hit) ? hit.Distance : -1.0f);
+	}
+
+	std::uint32_t ChunkSimulation::VoxelCount() const
+	{
+		return mStore.Count() + mClusters.MemberCount();
+	}
+
+	void ChunkSimulation::GetPositionMatrices(float* matrices) const
+	{
+		// Blend between the last two simulation steps by the time left over
+		float alpha = static_cast<float>(mTimestep.Alpha());
+		std::uint32_t stored = mStore.Count();
+		if (stored > 0) {
+			mStore.GetPositionMatrices(0, stored, alpha, matrices);
+		}
+		if (mClusters.MemberCount() > 0) {
+			mClusters.GetPositionMatrices(alpha, matrices + stored * 16);
+		}
+	}
+
+	void ChunkSimulation::PrepareRaycast()
+	{
+		if (!mConnectivity.IsBuilt()) {
+			mConnectivity.Build(mStore);
+		}
+		mWorld.UpdateStatic(mStore);
+	}
+
+	void ChunkSimulation::RaycastStatic(const float origin[3], const float direction[3], RayHit& hit) const
+	{
+		// The intact chunk bounds the search for debris in front of it
+		hit.Distance = PICK_DISTANCE;
+		mConnectivity.Raycast(origin, direction, hit.Distance, hit);
+		RayHit debris;
+		if (mWorld.Raycast(mStore, origin, direction, hit.Distance, debris)) {
+			hit = debris;
+		}
+	}
+
+	VoxelStore& ChunkSimulation::Store()
+	{
+		return mStore;
+	}
+
+	const ChunkStats& ChunkSimulation::Stats() const
+	{
+		return mStats;
+	}
+
+	FixedTimestep& ChunkSimulation::Timestep()
+	{
+		return mTimestep;
+	}
+
+	WorldCollision& ChunkSimulation::World()
+	{
+		return mWorld;
+	}
+
+	void ChunkSimulation::SetSeed(std::uint32_t seed)
+	{
+		// Replaying the same blasts after this gives the same debris
+		mSeed = seed;
+		mBlastCount = 0;
+	}
+
+	float ChunkSimulation::DebrisLifetime() const
+	{
+		return mDebrisLifetime;
+	}
+
+	void ChunkSimulation::SetDebrisLifetime(float seconds)
+	{
+		mDebrisLifetime = seconds;
+	}
+
+	void ChunkSimulation::SetPlayArea(const float minimum[3], const float maximum[3])
+	{
+		for (int a = 0; a < 3; a++) {
+			mPlayAreaMinimum[a] = minimum[a];
+			mPlayAreaMaximum[a] = maximum[a];
+		}
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "ChunkConnectivity.h"
+#include "ContactSolver.h"
+#include "DebrisTree.h"
+#include "FixedTimestep.h"
+#include "RigidClusters.h"
+#include "VoxelDag.h"
+#include "VoxelStore.h"
+#include "WorldCollision.h"
+#include <cstdint>
+#include <vector>
+
+namespace Library {
+	class JobSystem;
+}
+
+using namespace Library;
+
+namespace Rendering {
+	// Per-frame simulation counters
+	struct ChunkStats {
+		std::uint32_t Steps;
+		std::uint32_t Active;
+		std::uint32_t Contacts;
+		std::uint32_t Supported;
+		std::uint32_t Sleeping;
+		std::uint32_t FellAsleep;
+		std::uint32_t Despawned;
+		std::uint32_t Clusters;
+	};
+
+	// Everything a chunk does apart from drawing: the voxel storage, blasts,
+	// picking and the debris physics, stepped at a fixed rate. It has no
+	// graphics, input or windowing dependencies, so it builds and runs headless;
+	// Chunk wraps it to draw the voxels.
+	class ChunkSimulation {
+	public:
+		// The job system is optional; without one every phase runs on the caller
+		explicit ChunkSimulation(JobSystem* jobSystem = nullptr);
+
+		void AddVoxel(float x, float y, float z, float size);
+		// Adds a voxel for every solid cell of the world from minimum up to but
+		// not including maximum, cell (x, y, z) centred at (x, y, z) * pitch with
+		// size pitch / 2
+		void AddVoxels(const VoxelDag& world, const std::uint32_t minimum[3], const std::uint32_t maximum[3], float pitch);
+		void Update(const GameTime& gameTime);
+		// Knocks loose every voxel the blast reaches, and whatever that leaves
+		// hanging
+		void SetMotionVectors(float x, float y, float z);
+		// Finds the nearest voxel along the ray. Intact voxels are found by
+		// stepping through the chunk's lattice and settled debris through the
+		// sleeping-voxel index, both only over the cells the ray crosses before
+		// the hit; moving voxels are found through the debris tree. Voxels held in
+		// rigid bodies are not picked.
+		bool Raycast(const float origin[3], const float direction[3], RayHit& hit);
+		// Casts count rays at once and writes a hit for each; a ray that hits
+		// nothing gets distance -1. The lattice and the sleeping-voxel index are
+		// walked ray by ray; the rays are sorted by direction and cut into
+		// packets that go through the debris tree together. Large batches are
+		// spread over the job system. Returns how many rays hit.
+		std::uint32_t RaycastBatch(const Ray* rays, std::uint32_t count, RayHit* hits);
+		// Returns the distance along the ray to the nearest voxel, or -1
+		float FindClosestVoxel(const float origin[3], const float direction[3]);
+
+		// Voxels to draw, loose or held in a rigid body
+		std::uint32_t VoxelCount() const;
+		// Writes VoxelCount() row-major matrices, blended between the last two steps
+		void GetPositionMatrices(float* matrices) const;
+
+		VoxelStore& Store();
+		const ChunkStats& Stats() const;
+		FixedTimestep& Timestep();
+		WorldCollision& World();
+		void SetSeed(std::uint32_t seed);
+
+		// Debris is removed once it has been loose for this many seconds of
+		// simulation time; zero keeps it forever
+		float DebrisLifetime() const;
+		void SetDebrisLifetime(float seconds);
+		// Debris whose centre leaves this box is removed
+		void SetPlayArea(const float minimum[3], const float maximum[3]);
+
+		// Voxels per update job; a multiple of the widest SIMD width
+		static const std::uint32_t UPDATE_GRAIN;
+		static const float BLAST_SPIN;
+		static const float DEBRIS_LIFETIME;
+		static const float PLAY_AREA_EXTENT;
+		// How far below the ground debris may fall before it is removed
+		static const float KILL_DEPTH;
+		// Farthest a ray can pick when nothing bounds it
+		static const float PICK_DISTANCE;
+		// Rays per batch job; a multiple of the packet size
+		static const std::uint32_t RAY_GRAIN;
+
+	private:
+		ChunkSimulation(const ChunkSimulation& rhs);
+		ChunkSimulation& operator=(const ChunkSimulation& rhs);
+
+		void Step(const GameTime& stepTime);
+		std::uint32_t Despawn(float now);
+		void PrepareRaycast();
+		// Nearest intact or sleeping voxel, or PICK_DISTANCE
+		void RaycastStatic(const float origin[3], const float direction[3], RayHit& hit) const;
+
+		VoxelStore mStore;
+		FixedTimestep mTimestep;
+		ContactSolver mContactSolver;
+		WorldCollision mWorld;
+		DebrisTree mDebris;
+		ChunkConnectivity mConnectivity;
+		RigidClusters mClusters;
+		JobSystem* mJobSystem;
+		std::vector<std::uint32_t> mRangeMoving;
+		// Direction key and index of each ray of the last batch, in cast order
+		std::vector<std::uint64_t> mRayOrder;
+		ChunkStats mStats;
+		std::uint32_t mSeed;
+		std::uint32_t mBlastCount;
+		std::vector<std::uint32_t> mBlastSlots;
+		std::vector<std::uint8_t> mBlastHits;
+		std::vector<std::uint32_t> mIslands;
+		std::vector<std::uint32_t> mIslandEnds;
+		float mDebrisLifetime;
+		float mPlayAreaMinimum[3];
+		float mPlayAreaMaximum[3];
+	};
+}
@@ -0,0 +1,113 @@
+#include "ChunkTable.h"
+
+namespace Rendering {
+	const std::uint32_t ChunkTable::EMPTY = 0xFFFFFFFF;
+	const std::uint32_t ChunkTable::INITIAL_CAPACITY = 64;
+
+	ChunkTable::ChunkTable()
+		: mMask(0), mCount(0)
+	{
+		Clear();
+	}
+
+	std::uint32_t ChunkTable::Find(const ChunkKey& key) const
+	{
+		for (std::uint32_t bucket = Bucket(key);; bucket = (bucket + 1) & mMask) {
+			const Entry& entry = mEntries[bucket];
+			if (entry.Value == EMPTY || Equal(entry.Key, key)) {
+				return entry.Value;
+			}
+		}
+	}
+
+	void ChunkTable::Insert(const ChunkKey& key, std::uint32_t value)
+	{
+		if ((mCount + 1) * 2 > mEntries.size()) {
+			Grow();
+		}
+
+		for (std::uint32_t bucket = Bucket(key);; bucket = (bucket + 1) & mMask) {
+			Entry& entry = mEntries[bucket];
+			if (entry.Value == EMPTY) {
+				entry.Key = key;
+				entry.Value = value;
+				mCount++;
+				return;
+			}
+			if (Equal(entry.Key, key)) {
+				entry.Value = value;
+				return;
+			}
+		}
+	}
+
+	bool ChunkTable::Erase(const ChunkKey& key)
+	{
+		std::uint32_t gap = Bucket(key);
+		for (;; gap = (gap + 1) & mMask) {
+			if (mEntries[gap].Value == EMPTY) {
+				return false;
+			}
+			if (Equal(mEntries[gap].Key, key)) {
+				break;
+			}
+		}
+
+		// Move back each later entry of the run that may sit in the gap, that
+		// is one whose bucket does not lie between the gap and where it is now
+		for (std::uint32_t next = (gap + 1) & mMask; mEntries[next].Value != EMPTY; next = (next + 1) & mMask) {
+			std::uint32_t home = Bucket(mEntries[next].Key);
+			if (((next - home) & mMask) >= ((next - gap) & mMask)) {
+				mEntries[gap] = mEntries[next];
+				gap = next;
+			}
+		}
+
+		mEntries[gap].Value = EMPTY;
+		mCount--;
+		return true;
+	}
+
+	void ChunkTable::Clear()
+	{
+		Entry empty = { { 0, 0, 0 }, EMPTY };
+		mEntries.assign(INITIAL_CAPACITY, empty);
+		mMask = INITIAL_CAPACITY - 1;
+		mCount = 0;
+	}
+
+	std::uint32_t ChunkTable::Count() const
+	{
+		return mCount;
+	}
+
+	bool ChunkTable::Equal(const ChunkKey& a, const ChunkKey& b)
+	{
+		return a.X == b.X && a.Y == b.Y && a.Z == b.Z;
+	}
+
+	std::uint32_t ChunkTable::Bucket(const ChunkKey& key) const
+	{
+		std::uint32_t hash = static_cast<std::uint32_t>(key.X) * 73856093u
+			^ static_cast<std::uint32_t>(key.Y) * 19349663u
+			^ static_cast<std::uint32_t>(key.Z) * 83492791u;
+		// Fold the high bits down, since the mask only keeps the low ones
+		hash ^= hash >> 16;
+		return hash & mMask;
+	}
+
+	void ChunkTable::Grow()
+	{
+		std::vector<Entry> entries;
+		entries.swap(mEntries);
+		Entry empty = { { 0, 0, 0 }, EMPTY };
+		mEntries.assign(entries.size() * 2, empty);
+		mMask = static_cast<std::uint32_t>(mEntries.size()) - 1;
+		mCount = 0;
+		for (const Entry& entry : entries) {
+			if (entry.Value != EMPTY) {
+				Insert(entry.Key, entry.Value);
+			}
+		}
+	}
+}
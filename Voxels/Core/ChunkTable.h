@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Rendering {
+	// Integer coordinates of a chunk of the world
+	struct ChunkKey {
+		std::int32_t X;
+		std::int32_t Y;
+		std::int32_t Z;
+	};
+
+	// Open-addressing hash table from chunk coordinates to a 32-bit value,
+	// usually a slot index. Entries sit in one flat array, probed linearly from
+	// the bucket the key hashes to, so a lookup is a hash and a short scan of
+	// adjacent memory. The table doubles before it is half full, and erasing
+	// shifts the entries after the gap back instead of leaving tombstones, so
+	// probe runs stay short however many chunks stream through.
+	class ChunkTable {
+	public:
+		ChunkTable();
+
+		// Returns the value stored for key, or EMPTY
+		std::uint32_t Find(const ChunkKey& key) const;
+		// Adds key or replaces its value
+		void Insert(const ChunkKey& key, std::uint32_t value);
+		bool Erase(const ChunkKey& key);
+		void Clear();
+		std::uint32_t Count() const;
+
+		static const std::uint32_t EMPTY;
+		static const std::uint32_t INITIAL_CAPACITY;
+
+	private:
+		struct Entry {
+			ChunkKey Key;
+			// EMPTY marks an unused entry
+			std::uint32_t Value;
+		};
+
+		static bool Equal(const ChunkKey& a, const ChunkKey& b);
+		std::uint32_t Bucket(const ChunkKey& key) const;
+		void Grow();
+
+		std::vector<Entry> mEntries;
+		std::uint32_t mMask;
+		std::uint32_t mCount;
+	};
+}
@@ -0,0 +1,216 @@
+#include "ContactSolver.h"
+#include "JobSystem.h"
+#include "VoxelStore.h"
+#include <cmath>
+
+using namespace Library;
+
+namespace Rendering {
+	const int ContactSolver::ITERATIONS = 2;
+	const float ContactSolver::SLOP = 0.01f;
+	const std::uint32_t ContactSolver::SOLVE_GRAIN = 1024;
+
+	ContactSolver::ContactSolver()
+	{
+	}
+
+	std::uint32_t ContactSolver::Solve(VoxelStore& store, std::uint32_t count, JobSystem* jobSystem)
+	{
+		if (count < 2) {
+			return 0;
+		}
+
+		// Two touching spheres are at most two of the largest radii apart
+		const float* size = store.Size();
+		float largest = 0.0f;
+		for (std::uint32_t i = 0; i < count; i++) {
+			largest = (size[i] > largest ? size[i] : largest);
+		}
+		mHash.Build(store.OriginX(), store.OriginY(), store.OriginZ(), count, largest * 2.0f);
+
+		mX.Resize(count);
+		mY.Resize(count);
+		mZ.Resize(count);
+		mVelocityX.Resize(count);
+		mVelocityY.Resize(count);
+		mVelocityZ.Resize(count);
+		mTouching.Resize(count);
+		mSize.Resize(count);
+		mCorrectionX.Resize(count);
+		mCorrectionY.Resize(count);
+		mCorrectionZ.Resize(count);
+		mImpulseX.Resize(count);
+		mImpulseY.Resize(count);
+		mImpulseZ.Resize(count);
+		mRangePairs.assign((count + SOLVE_GRAIN - 1) / SOLVE_GRAIN, 0);
+
+		auto load = [this, &store](std::uint32_t begin, std::uint32_t end) {
+			Load(store, begin, end);
+		};
+		auto gather = [this](std::uint32_t begin, std::uint32_t end) {
+			mRangePairs[begin / SOLVE_GRAIN] = Gather(begin, end);
+		};
+		auto apply = [this](std::uint32_t begin, std::uint32_t end) {
+			Apply(begin, end);
+		};
+		auto write = [this, &store](std::uint32_t begin, std::uint32_t end) {
+			Store(store, begin, end);
+		};
+		auto run = [jobSystem, count](const JobSystem::RangeFunction& function) {
+			if (jobSystem != nullptr) {
+				jobSystem->ParallelFor(count, SOLVE_GRAIN, function);
+			}
+			else {
+				function(0, count);
+			}
+		};
+
+		run(load);
+		std::uint32_t pairs = 0;
+		for (int iteration = 0; iteration < ITERATIONS; iteration++) {
+			run(gather);
+			run(apply);
+
+			if (iteration == 0) {
+				for (std::uint32_t rangePairs : mRangePairs) {
+					pairs += rangePairs;
+				}
+			}
+		}
+		run(write);
+
+		return pairs;
+	}
+
+	void ContactSolver::Load(const VoxelStore& store, std::uint32_t first, std::uint32_t last)
+	{
+		const float* originX = store.OriginX();
+		const float* originY = store.OriginY();
+		const float* originZ = store.OriginZ();
+		const float* velocityX = store.VelocityX();
+		const float* velocityY = store.VelocityY();
+		const float* velocityZ = store.VelocityZ();
+		const float* size = store.Size();
+
+		for (std::uint32_t p = first; p < last; p++) {
+			std::uint32_t i = mHash.Entry(p);
+			mX[p] = originX[i];
+			mY[p] = originY[i];
+			mZ[p] = originZ[i];
+			mVelocityX[p] = velocityX[i];
+			mVelocityY[p] = velocityY[i];
+			mVelocityZ[p] = velocityZ[i];
+			mSize[p] = size[i];
+		}
+	}
+
+	std::uint32_t ContactSolver::Gather(std::uint32_t first, std::uint32_t last)
+	{
+		std::uint32_t pairs = 0;
+
+		// Indices here are bucket-order positions, not store slots
+		for (std::uint32_t i = first; i < last; i++) {
+			float correction[3] = { 0.0f, 0.0f, 0.0f };
+			float impulse[3] = { 0.0f, 0.0f, 0.0f };
+			int contacts = 0;
+			float massI = mSize[i] * mSize[i] * mSize[i];
+
+			mHash.ForEachNeighbourOf(i, [&](std::uint32_t j) {
+				if (j == i) {
+					return;
+				}
+
+				float dx = mX[i] - mX[j];
+				float dy = mY[i] - mY[j];
+				float dz = mZ[i] - mZ[j];
+				float reach = mSize[i] + mSize[j];
+				float distanceSq = dx * dx + dy * dy + dz * dz;
+				if (distanceSq >= reach * reach) {
+					return;
+				}
+
+				float distance = std::sqrt(distanceSq);
+				float nx = 1.0f, ny = 0.0f, nz = 0.0f;
+				if (distance > 1e-6f) {
+					nx = dx / distance;
+					ny = dy / distance;
+					nz = dz / distance;
+				}
+				else if (j < i) {
+					// Coincident centres: pick opposite directions for the two voxels
+					nx = -1.0f;
+				}
+
+				if (j > i) {
+					pairs++;
+				}
+				contacts++;
+
+				// The lighter voxel takes the larger share of the push
+				float massJ = mSize[j] * mSize[j] * mSize[j];
+				float share = massJ / (massI + massJ);
+
+				float depth = reach - distance - SLOP;
+				if (depth > 0.0f) {
+					correction[0] += nx * depth * share;
+					correction[1] += ny * depth * share;
+					correction[2] += nz * depth * share;
+				}
+
+				float closing = (mVelocityX[i] - mVelocityX[j]) * nx + (mVelocityY[i] - mVelocityY[j]) * ny + (mVelocityZ[i] - mVelocityZ[j]) * nz;
+				if (closing < 0.0f) {
+					impulse[0] -= nx * closing * share;
+					impulse[1] -= ny * closing * share;
+					impulse[2] -= nz * closing * share;
+				}
+			});
+
+			// Averaging over the contacts keeps a voxel in a crowd from being
+			// pushed by the sum of every overlap at once
+			float scale = (contacts > 0 ? 1.0f / contacts : 0.0f);
+			mTouching[i] = (contacts > 0 ? 1 : 0);
+			mCorrectionX[i] = correction[0] * scale;
+			mCorrectionY[i] = correction[1] * scale;
+			mCorrectionZ[i] = correction[2] * scale;
+			mImpulseX[i] = impulse[0] * scale;
+			mImpulseY[i] = impulse[1] * scale;
+			mImpulseZ[i] = impulse[2] * scale;
+		}
+
+		return pairs;
+	}
+
+	void ContactSolver::Apply(std::uint32_t first, std::uint32_t last)
+	{
+		for (std::uint32_t i = first; i < last; i++) {
+			mX[i] += mCorrectionX[i];
+			mY[i] += mCorrectionY[i];
+			mZ[i] += mCorrectionZ[i];
+			mVelocityX[i] += mImpulseX[i];
+			mVelocityY[i] += mImpulseY[i];
+			mVelocityZ[i] += mImpulseZ[i];
+		}
+	}
+
+	void ContactSolver::Store(VoxelStore& store, std::uint32_t first, std::uint32_t last) const
+	{
+		float* originX = store.OriginX();
+		float* originY = store.OriginY();
+		float* originZ = store.OriginZ();
+		float* velocityX = store.VelocityX();
+		float* velocityY = store.VelocityY();
+		float* velocityZ = store.VelocityZ();
+		std::uint8_t* contact = store.Contact();
+
+		for (std::uint32_t p = first; p < last; p++) {
+			std::uint32_t i = mHash.Entry(p);
+			contact[i] |= mTouching[p];
+			originX[i] = mX[p];
+			originY[i] = mY[p];
+			originZ[i] = mZ[p];
+			velocityX[i] = mVelocityX[p];
+			velocityY[i] = mVelocityY[p];
+			velocityZ[i] = mVelocityZ[p];
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "AlignedArray.h"
+#include "SpatialHash.h"
+#include <cstdint>
+#include <vector>
+
+namespace Library {
+	class JobSystem;
+}
+
+namespace Rendering {
+	class VoxelStore;
+
+	// Keeps moving voxels from passing through each other. Each voxel is treated
+	// as the sphere inscribed in its cube. Every step the active voxels are
+	// hashed into a SpatialHash sized to the largest of them, then a few Jacobi
+	// iterations push overlapping pairs apart, weighted by mass, and remove the
+	// part of their relative velocity that closes the gap. Voxels that touch
+	// another are marked as in contact for the sleep test.
+	//
+	// The solver works on copies of the voxels laid out in bucket order, so
+	// neighbour lookups read memory close to each other, and writes the result
+	// back at the end. Each voxel only gathers its own correction and applies it
+	// in a second pass, so the ranges can run on any number of threads and still
+	// give the same result.
+	class ContactSolver {
+	public:
+		ContactSolver();
+
+		// Returns the number of overlapping pairs found before solving
+		std::uint32_t Solve(VoxelStore& store, std::uint32_t count, Library::JobSystem* jobSystem);
+
+		static const int ITERATIONS;
+		// Overlap left alone so voxels resting against each other do not jitter
+		static const float SLOP;
+		static const std::uint32_t SOLVE_GRAIN;
+
+	private:
+		ContactSolver(const ContactSolver& rhs);
+		ContactSolver& operator=(const ContactSolver& rhs);
+
+		void Load(const VoxelStore& store, std::uint32_t first, std::uint32_t last);
+		std::uint32_t Gather(std::uint32_t first, std::uint32_t last);
+		void Apply(std::uint32_t first, std::uint32_t last);
+		void Store(VoxelStore& store, std::uint32_t first, std::uint32_t last) const;
+
+		SpatialHash mHash;
+		AlignedArray<float> mX;
+		AlignedArray<float> mY;
+		AlignedArray<float> mZ;
+		AlignedArray<float> mVelocityX;
+		AlignedArray<float> mVelocityY;
+		AlignedArray<float> mVelocityZ;
+		AlignedArray<float> mSize;
+		AlignedArray<float> mCorrectionX;
+		AlignedArray<float> mCorrectionY;
+		AlignedArray<float> mCorrectionZ;
+		AlignedArray<float> mImpulseX;
+		AlignedArray<float> mImpulseY;
+		AlignedArray<float> mImpulseZ;
+		AlignedArray<std::uint8_t> mTouching;
+		std::vector<std::uint32_t> mRangePairs;
+	};
+}
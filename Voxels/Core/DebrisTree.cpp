@@ -0,0 +1,491 @@
+#include "DebrisTree.h"
+#include "JobSystem.h"
+#include "SimdMath.h"
+#include "VoxelStore.h"
+#include <algorithm>
+#include <cfloat>
+
+using namespace Library;
+
+namespace Rendering {
+	const std::uint32_t DebrisTree::LEAF_SIZE = 16;
+	const std::uint32_t DebrisTree::BIN_COUNT = 16;
+	const std::uint32_t DebrisTree::PACKET_SIZE = Simd::FloatN::Width;
+	const std::uint32_t DebrisTree::BUILD_GRAIN = 4096;
+	// A query's stack holds at most one entry per level plus one, so this keeps
+	// it within STACK_SIZE
+	const std::uint32_t DebrisTree::MAX_DEPTH = DebrisTree::STACK_SIZE - 2;
+	const std::uint32_t DebrisTree::REBUILD_INTERVAL = 60;
+	const float DebrisTree::REBUILD_GROWTH = 2.0f;
+
+	namespace {
+		typedef Simd::FloatN Lanes;
+
+		// Entry distance of every ray of the packet into the box, clamped to
+		// zero, and which rays hit it at all
+		Lanes::Mask ClipPacket(const Lanes origin[3], const Lanes inverse[3], const float minimum[3], const float maximum[3], Lanes& enter)
+		{
+			Lanes exit = Lanes::Set(VoxelRay::PARALLEL);
+			enter = Lanes::Set(0.0f);
+			for (int a = 0; a < 3; a++) {
+				Lanes low = (Lanes::Set(minimum[a]) - origin[a]) * inverse[a];
+				Lanes high = (Lanes::Set(maximum[a]) - origin[a]) * inverse[a];
+				enter = Simd::Max(enter, Simd::Min(low, high));
+				exit = Simd::Min(exit, Simd::Max(low, high));
+			}
+
+			return enter <= exit;
+		}
+	}
+
+	DebrisTree::DebrisTree()
+		: mMemberCount(0), mRefits(0), mArea(0.0f), mBuiltArea(0.0f)
+	{
+		Clear();
+	}
+
+	void DebrisTree::Build(const VoxelStore& store, JobSystem* jobSystem)
+	{
+		const float* originX = store.OriginX();
+		const float* originY = store.OriginY();
+		const float* originZ = store.OriginZ();
+		const float* size = store.Size();
+		std::uint32_t count = store.ActiveCount();
+		mPrimitives.resize(count);
+		for (std::uint32_t i = 0; i < count; i++) {
+			Primitive& primitive = mPrimitives[i];
+			primitive.Centre[0] = originX[i];
+			primitive.Centre[1] = originY[i];
+			primitive.Centre[2] = originZ[i];
+			primitive.Half = size[i];
+			primitive.Id = store.Id(i);
+		}
+
+		Node leaf = {};
+		mNodes.assign(count > 1 ? 2 * count - 1 : 1, leaf);
+		if (count > 0) {
+			BuildNode(0, 1, 0, count, 0, jobSystem);
+		}
+
+		mIds.resize(count);
+		mX.resize(count);
+		mY.resize(count);
+		mZ.resize(count);
+		mHalf.resize(count);
+		for (std::uint32_t m = 0; m < count; m++) {
+			const Primitive& primitive = mPrimitives[m];
+			mIds[m] = primitive.Id;
+			mX[m] = primitive.Centre[0];
+			mY[m] = primitive.Centre[1];
+			mZ[m] = primitive.Centre[2];
+			mHalf[m] = primitive.Half;
+		}
+
+		mMemberCount = count;
+		mRefits = 0;
+		mBuiltArea = Fit();
+		mArea = mBuiltArea;
+	}
+
+	void DebrisTree::Refit(const VoxelStore& store)
+	{
+		const float* originX = store.OriginX();
+		const float* originY = store.OriginY();
+		const float* originZ = store.OriginZ();
+		const float* size = store.Size();
+		std::uint32_t active = store.ActiveCount();
+
+		// A member that stopped moving is swapped to the end of its leaf and left
+		// out; its slot reads INVALID_SLOT once removed, which is never active
+		mMemberCount = 0;
+		for (Node& node : mNodes) {
+			if (node.Left != 0) {
+				continue;
+			}
+
+			std::uint32_t m = node.First;
+			while (m < node.First + node.Count) {
+				std::uint32_t slot = store.Slot(mIds[m]);
+				if (slot >= active) {
+					std::uint32_t last = node.First + --node.Count;
+					std::swap(mIds[m], mIds[last]);
+					continue;
+				}
+
+				mX[m] = originX[slot];
+				mY[m] = originY[slot];
+				mZ[m] = originZ[slot];
+				mHalf[m] = size[slot];
+				m++;
+			}
+			mMemberCount += node.Count;
+		}
+
+		mRefits++;
+		mArea = Fit();
+	}
+
+	void DebrisTree::Update(const VoxelStore& store, JobSystem* jobSystem)
+	{
+		Refit(store);
+
+		// Refitting never adds members, so voxels that started moving since the
+		// build need a new tree
+		if (mMemberCount != store.ActiveCount() || mRefits >= REBUILD_INTERVAL || mArea > mBuiltArea * REBUILD_GROWTH) {
+			Build(store, jobSystem);
+		}
+	}
+
+	void DebrisTree::Clear()
+	{
+		Node leaf = {};
+		mNodes.assign(1, leaf);
+		mPrimitives.clear();
+		mIds.clear();
+		mX.clear();
+		mY.clear();
+		mZ.clear();
+		mHalf.clear();
+		mMemberCount = 0;
+		mRefits = 0;
+		mBuiltArea = Fit();
+		mArea = mBuiltArea;
+	}
+
+	std::uint32_t DebrisTree::MemberCount() const
+	{
+		return mMemberCount;
+	}
+
+	bool DebrisTree::Raycast(const float origin[3], const float direction[3], float maxDistance, RayHit& hit) const
+	{
+		if (mMemberCount == 0) {
+			return false;
+		}
+
+		float inverse[3];
+		VoxelRay::Inverse(direction, inverse);
+
+		struct Entry {
+			std::uint32_t Node;
+			float Enter;
+		};
+		Entry stack[STACK_SIZE];
+		std::uint32_t depth = 0;
+		float enter;
+		float exit;
+		int axis;
+		if (!VoxelRay::Clip(origin, inverse, mNodes[0].Minimum, mNodes[0].Maximum, enter, exit, axis) || enter >= maxDistance) {
+			return false;
+		}
+		stack[depth++] = { 0, enter };
+
+		float best = maxDistance;
+		std::uint32_t none = static_cast<std::uint32_t>(mIds.size());
+		std::uint32_t nearest = none;
+		while (depth > 0) {
+			Entry entry = stack[--depth];
+			if (entry.Enter >= best) {
+				continue;
+			}
+
+			const Node& node = mNodes[entry.Node];
+			if (node.Left == 0) {
+				float distance;
+				std::uint32_t last = node.First + node.Count;
+				std::uint32_t member = VoxelRay::NearestBox(origin, direction, mX.data(), mY.data(), mZ.data(), mHalf.data(), node.First, last, best, distance);
+				if (member < last) {
+					best = distance;
+					nearest = member;
+				}
+				continue;
+			}
+
+			// Push the farther child first so the nearer one is searched first
+			Entry children[2];
+			std::uint32_t hits = 0;
+			for (std::uint32_t child = node.Left; child <= node.Left + 1; child++) {
+				if (!IsEmpty(mNodes[child]) && VoxelRay::Clip(origin, inverse, mNodes[child].Minimum, mNodes[child].Maximum, enter, exit, axis) && enter < best) {
+					children[hits++] = { child, enter };
+				}
+			}
+			if (hits == 2 && children[1].Enter > children[0].Enter) {
+				std::swap(children[0], children[1]);
+			}
+			for (std::uint32_t c = 0; c < hits; c++) {
+				stack[depth++] = children[c];
+			}
+		}
+
+		if (nearest == none) {
+			return false;
+		}
+
+		const float centre[3] = { mX[nearest], mY[nearest], mZ[nearest] };
+		VoxelRay::HitBox(origin, inverse, centre, mHalf[nearest], enter, axis);
+		hit.Id = mIds[nearest];
+		hit.Distance = best;
+		VoxelRay::FaceNormal(direction, axis, hit.Normal);
+		return true;
+	}
+
+	void DebrisTree::RaycastPacket(const Ray* rays, std::uint32_t count, RayHit* hits) const
+	{
+		if (mMemberCount == 0 || count == 0) {
+			return;
+		}
+
+		// Lanes past count stay idle with a negative bound, which no entry
+		// distance is below
+		float origins[3][Simd::FloatN::Width];
+		float inverses[3][Simd::FloatN::Width];
+		float bounds[Simd::FloatN::Width];
+		float heading[3] = { 0.0f, 0.0f, 0.0f };
+		for (std::uint32_t r = 0; r < PACKET_SIZE; r++) {
+			const Ray& ray = rays[r < count ? r : 0];
+			float inverse[3];
+			VoxelRay::Inverse(ray.Direction, inverse);
+			for (int a = 0; a < 3; a++) {
+				origins[a][r] = ray.Origin[a];
+				inverses[a][r] = inverse[a];
+				heading[a] += (r < count ? ray.Direction[a] : 0.0f);
+			}
+			bounds[r] = (r < count ? hits[r].Distance : -1.0f);
+		}
+
+		Lanes origin[3];
+		Lanes inverse[3];
+		for (int a = 0; a < 3; a++) {
+			origin[a] = Lanes::Load(origins[a]);
+			inverse[a] = Lanes::Load(inverses[a]);
+		}
+		Lanes best = Lanes::Load(bounds);
+		Lanes nearest = Lanes::Set(-1.0f);
+
+		// Nodes are clipped against the packet as they come off the stack, so
+		// a subtree is skipped once every ray has found something nearer
+		std::uint32_t stack[STACK_SIZE];
+		std::uint32_t depth = 0;
+		stack[depth++] = 0;
+		while (depth > 0) {
+			const Node& node = mNodes[stack[--depth]];
+			if (IsEmpty(node)) {
+				continue;
+			}
+			Lanes enter;
+			Lanes::Mask hit = ClipPacket(origin, inverse, node.Minimum, node.Maximum, enter);
+			if (!Simd::Any(hit & (enter < best))) {
+				continue;
+			}
+
+			if (node.Left == 0) {
+				// Member indices are carried as floats, which is exact below 2^24
+				for (std::uint32_t m = node.First; m < node.First + node.Count; m++) {
+					const float minimum[3] = { mX[m] - mHalf[m], mY[m] - mHalf[m], mZ[m] - mHalf[m] };
+					const float maximum[3] = { mX[m] + mHalf[m], mY[m] + mHalf[m], mZ[m] + mHalf[m] };
+					hit = ClipPacket(origin, inverse, minimum, maximum, enter);
+					hit = hit & (enter < best);
+					best = Simd::Select(hit, enter, best);
+					nearest = Simd::Select(hit, Lanes::Set(static_cast<float>(m)), nearest);
+				}
+				continue;
+			}
+
+			// Push the child further along the packet's heading first
+			const Node& left = mNodes[node.Left];
+			const Node& right = mNodes[node.Left + 1];
+			float along = 0.0f;
+			for (int a = 0; a < 3; a++) {
+				along += (right.Minimum[a] + right.Maximum[a] - left.Minimum[a] - left.Maximum[a]) * heading[a];
+			}
+			std::uint32_t nearChild = (along >= 0.0f ? node.Left : node.Left + 1);
+			stack[depth++] = (nearChild == node.Left ? node.Left + 1 : node.Left);
+			stack[depth++] = nearChild;
+		}
+
+		float distances[Simd::FloatN::Width];
+		float members[Simd::FloatN::Width];
+		best.Store(distances);
+		nearest.Store(members);
+		for (std::uint32_t r = 0; r < count; r++) {
+			if (members[r] < 0.0f) {
+				continue;
+			}
+
+			std::uint32_t m = static_cast<std::uint32_t>(members[r]);
+			const float centre[3] = { mX[m], mY[m], mZ[m] };
+			float inverseRay[3];
+			float distance;
+			int axis;
+			VoxelRay::Inverse(rays[r].Direction, inverseRay);
+			VoxelRay::HitBox(rays[r].Origin, inverseRay, centre, mHalf[m], distance, axis);
+			hits[r].Id = mIds[m];
+			hits[r].Distance = distances[r];
+			VoxelRay::FaceNormal(rays[r].Direction, axis, hits[r].Normal);
+		}
+	}
+
+	bool DebrisTree::IsEmpty(const Node& node)
+	{
+		return node.Minimum[0] > node.Maximum[0];
+	}
+
+	float DebrisTree::HalfArea(const float minimum[3], const float maximum[3])
+	{
+		float x = maximum[0] - minimum[0];
+		float y = maximum[1] - minimum[1];
+		float z = maximum[2] - minimum[2];
+		return x * y + y * z + z * x;
+	}
+
+	void DebrisTree::BuildNode(std::uint32_t node, std::uint32_t next, std::uint32_t first, std::uint32_t last, std::uint32_t depth, JobSystem* jobSystem)
+	{
+		std::uint32_t middle = (last - first > LEAF_SIZE && depth < MAX_DEPTH ? Split(first, last) : first);
+		if (middle == first) {
+			mNodes[node].Left = 0;
+			mNodes[node].First = first;
+			mNodes[node].Count = last - first;
+			return;
+		}
+
+		// The left subtree's own descendants fit in the 2n - 2 nodes after the
+		// two children, and the right subtree's after those
+		mNodes[node].Left = next;
+		std::uint32_t rightNext = next + 2 * (middle - first);
+		if (jobSystem != nullptr && last - first > BUILD_GRAIN) {
+			JobSystem::Job* job = jobSystem->CreateJob([=]() {
+				BuildNode(next, next + 2, first, middle, depth + 1, jobSystem);
+			});
+			jobSystem->Run(job);
+			BuildNode(next + 1, rightNext, middle, last, depth + 1, jobSystem);
+			jobSystem->Wait(job);
+		}
+		else {
+			BuildNode(next, next + 2, first, middle, depth + 1, jobSystem);
+			BuildNode(next + 1, rightNext, middle, last, depth + 1, jobSystem);
+		}
+	}
+
+	std::uint32_t DebrisTree::Split(std::uint32_t first, std::uint32_t last)
+	{
+		struct Bin {
+			float Minimum[3];
+			float Maximum[3];
+			std::uint32_t Count;
+		};
+
+		float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (std::uint32_t p = first; p < last; p++) {
+			for (int a = 0; a < 3; a++) {
+				low[a] = std::min(low[a], mPrimitives[p].Centre[a]);
+				high[a] = std::max(high[a], mPrimitives[p].Centre[a]);
+			}
+		}
+
+		// Bin along the axis the centres spread furthest on; all in one place
+		// cannot be split
+		int axis = 0;
+		for (int a = 1; a < 3; a++) {
+			axis = (high[a] - low[a] > high[axis] - low[axis] ? a : axis);
+		}
+		if (high[axis] <= low[axis]) {
+			return first;
+		}
+
+		Bin bins[BIN_COUNT];
+		for (Bin& bin : bins) {
+			bin = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX }, 0 };
+		}
+		float scale = BIN_COUNT / (high[axis] - low[axis]);
+		float origin = low[axis];
+		for (std::uint32_t p = first; p < last; p++) {
+			const Primitive& primitive = mPrimitives[p];
+			Bin& bin = bins[std::min(static_cast<std::uint32_t>((primitive.Centre[axis] - origin) * scale), BIN_COUNT - 1)];
+			for (int a = 0; a < 3; a++) {
+				bin.Minimum[a] = std::min(bin.Minimum[a], primitive.Centre[a] - primitive.Half);
+				bin.Maximum[a] = std::max(bin.Maximum[a], primitive.Centre[a] + primitive.Half);
+			}
+			bin.Count++;
+		}
+
+		// The cost of a split is each side's box area times its member count.
+		// Sweep from the right for every right side, then from the left to add
+		// the left sides.
+		float rightCost[BIN_COUNT];
+		Bin right = bins[BIN_COUNT - 1];
+		for (std::uint32_t b = BIN_COUNT - 1; b > 0; b--) {
+			rightCost[b] = (right.Count > 0 ? HalfArea(right.Minimum, right.Maximum) * right.Count : 0.0f);
+			for (int a = 0; a < 3; a++) {
+				right.Minimum[a] = std::min(right.Minimum[a], bins[b - 1].Minimum[a]);
+				right.Maximum[a] = std::max(right.Maximum[a], bins[b - 1].Maximum[a]);
+			}
+			right.Count += bins[b - 1].Count;
+		}
+
+		float bestCost = FLT_MAX;
+		std::uint32_t bestBin = 0;
+		Bin left = bins[0];
+		for (std::uint32_t b = 1; b < BIN_COUNT; b++) {
+			if (left.Count > 0 && left.Count < last - first) {
+				float cost = HalfArea(left.Minimum, left.Maximum) * left.Count + rightCost[b];
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestBin = b;
+				}
+			}
+			for (int a = 0; a < 3; a++) {
+				left.Minimum[a] = std::min(left.Minimum[a], bins[b].Minimum[a]);
+				left.Maximum[a] = std::max(left.Maximum[a], bins[b].Maximum[a]);
+			}
+			left.Count += bins[b].Count;
+		}
+
+		if (bestBin == 0) {
+			return first;
+		}
+
+		// Same binning as above, so the sides get exactly the counts costed
+		Primitive* middle = std::partition(mPrimitives.data() + first, mPrimitives.data() + last, [=](const Primitive& primitive) {
+			return std::min(static_cast<std::uint32_t>((primitive.Centre[axis] - origin) * scale), BIN_COUNT - 1) < bestBin;
+		});
+		return static_cast<std::uint32_t>(middle - mPrimitives.data());
+	}
+
+	float DebrisTree::Fit()
+	{
+		// Children always come after their parent, so walking the nodes backwards
+		// fits every child before its parent
+		float area = 0.0f;
+		for (std::uint32_t n = static_cast<std::uint32_t>(mNodes.size()); n-- > 0;) {
+			Node& node = mNodes[n];
+			for (int a = 0; a < 3; a++) {
+				node.Minimum[a] = FLT_MAX;
+				node.Maximum[a] = -FLT_MAX;
+			}
+
+			if (node.Left == 0) {
+				for (std::uint32_t m = node.First; m < node.First + node.Count; m++) {
+					const float centre[3] = { mX[m], mY[m], mZ[m] };
+					for (int a = 0; a < 3; a++) {
+						node.Minimum[a] = std::min(node.Minimum[a], centre[a] - mHalf[m]);
+						node.Maximum[a] = std::max(node.Maximum[a], centre[a] + mHalf[m]);
+					}
+				}
+				continue;
+			}
+
+			for (std::uint32_t child = node.Left; child <= node.Left + 1; child++) {
+				for (int a = 0; a < 3; a++) {
+					node.Minimum[a] = std::min(node.Minimum[a], mNodes[child].Minimum[a]);
+					node.Maximum[a] = std::max(node.Maximum[a], mNodes[child].Maximum[a]);
+				}
+			}
+			if (!IsEmpty(node)) {
+				area += HalfArea(node.Minimum, node.Maximum);
+			}
+		}
+
+		return area;
+	}
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "VoxelRay.h"
+#include <cstdint>
+#include <vector>
+
+namespace Library {
+	class JobSystem;
+}
+
+namespace Rendering {
+	class VoxelStore;
+
+	// Bounding volume hierarchy over the moving voxels of a store, which the
+	// grids over the chunk and the sleeping voxels cannot answer for once they
+	// leave their cells. Each voxel is its cube, centre plus or minus its size.
+	//
+	// Build() splits the voxels top down, choosing each split by the surface
+	// area heuristic over BIN_COUNT bins along the axis their centres spread
+	// furthest on, and builds large subtrees as jobs. A subtree of n voxels
+	// owns a fixed block of 2n - 1 nodes, so the layout does not depend on
+	// which thread built what. Members are copied out in leaf order with their
+	// ids.
+	//
+	// Refit() copies the new positions in and grows the boxes bottom up, and
+	// drops members that fell asleep or were removed by closing up their
+	// leaves, so a step of motion costs one pass over the members. Update()
+	// refits, or rebuilds instead when the tree no longer covers every moving
+	// voxel, when the boxes have grown REBUILD_GROWTH times larger than when
+	// built, or every REBUILD_INTERVAL refits.
+	//
+	// Queries report voxels by id and only read the tree, so they may run from
+	// several threads at once.
+	class DebrisTree {
+	public:
+		DebrisTree();
+
+		void Build(const VoxelStore& store, Library::JobSystem* jobSystem);
+		void Refit(const VoxelStore& store);
+		void Update(const VoxelStore& store, Library::JobSystem* jobSystem);
+		void Clear();
+
+		// Moving voxels the tree holds as of the last build or refit
+		std::uint32_t MemberCount() const;
+
+		// Finds the first member along the ray that is nearer than maxDistance.
+		// Leaves are tested with VoxelRay::NearestBox, nearer children first,
+		// and subtrees entered beyond the nearest hit are skipped.
+		bool Raycast(const float origin[3], const float direction[3], float maxDistance, RayHit& hit) const;
+
+		// Casts up to PACKET_SIZE rays together, testing each node and member
+		// against the whole packet at once. A member nearer than a ray's hit
+		// distance replaces its hit. Children are visited in the order the
+		// packet as a whole points, so rays with similar origins and directions
+		// share the traversal.
+		void RaycastPacket(const Ray* rays, std::uint32_t count, RayHit* hits) const;
+
+		// Calls function(id) for every member whose cube overlaps the box
+		template <typename Function>
+		void ForEachInBox(const float minimum[3], const float maximum[3], Function function) const
+		{
+			auto overlaps = [&](const float low[3], const float high[3]) {
+				return low[0] <= maximum[0] && high[0] >= minimum[0]
+					&& low[1] <= maximum[1] && high[1] >= minimum[1]
+					&& low[2] <= maximum[2] && high[2] >= minimum[2];
+			};
+			Visit(overlaps, function);
+		}
+
+		// Calls function(id) for every member whose cube overlaps the sphere
+		template <typename Function>
+		void ForEachInSphere(const float centre[3], float radius, Function function) const
+		{
+			auto overlaps = [&](const float low[3], const float high[3]) {
+				float distanceSq = 0.0f;
+				for (int a = 0; a < 3; a++) {
+					float outside = (centre[a] < low[a] ? low[a] - centre[a] : (centre[a] > high[a] ? centre[a] - high[a] : 0.0f));
+					distanceSq += outside * outside;
+				}
+				return distanceSq <= radius * radius;
+			};
+			Visit(overlaps, function);
+		}
+
+		// Largest number of members in a leaf, two registers' worth with AVX2
+		static const std::uint32_t LEAF_SIZE;
+		static const std::uint32_t BIN_COUNT;
+		// Rays in a packet, the SIMD width
+		static const std::uint32_t PACKET_SIZE;
+		// Subtrees with more members than this are built as separate jobs
+		static const std::uint32_t BUILD_GRAIN;
+		// Deeper nodes are made leaves, which bounds the query stack
+		static const std::uint32_t MAX_DEPTH;
+		static const std::uint32_t REBUILD_INTERVAL;
+		static const float REBUILD_GROWTH;
+
+	private:
+		DebrisTree(const DebrisTree& rhs);
+		DebrisTree& operator=(const DebrisTree& rhs);
+
+		// Left is the first of two adjacent children, or zero for a leaf of Count
+		// members from First; a node with nothing under it has Minimum above Maximum
+		struct Node {
+			float Minimum[3];
+			float Maximum[3];
+			std::uint32_t Left;
+			std::uint32_t First;
+			std::uint32_t Count;
+		};
+
+		struct Primitive {
+			float Centre[3];
+			float Half;
+			std::uint32_t Id;
+		};
+
+		static bool IsEmpty(const Node& node);
+		static float HalfArea(const float minimum[3], const float maximum[3]);
+		void BuildNode(std::uint32_t node, std::uint32_t next, std::uint32_t first, std::uint32_t last, std::uint32_t depth, Library::JobSystem* jobSystem);
+		// Partitions the primitives and returns where the right side starts, or
+		// first when they cannot be split
+		std::uint32_t Split(std::uint32_t first, std::uint32_t last);
+		// Sets every box from the members up and returns the summed half areas
+		// of the interior ones
+		float Fit();
+
+		// Calls function(id) for members in the leaves whose box overlaps(minimum, maximum) accepts
+		template <typename Overlaps, typename Function>
+		void Visit(Overlaps overlaps, Function function) const
+		{
+			if (mMemberCount == 0) {
+				return;
+			}
+
+			std::uint32_t stack[STACK_SIZE];
+			std::uint32_t depth = 0;
+			stack[depth++] = 0;
+			while (depth > 0) {
+				const Node& node = mNodes[stack[--depth]];
+				if (IsEmpty(node) || !overlaps(node.Minimum, node.Maximum)) {
+					continue;
+				}
+
+				if (node.Left != 0) {
+					stack[depth++] = node.Left + 1;
+					stack[depth++] = node.Left;
+					continue;
+				}
+
+				for (std::uint32_t m = node.First; m < node.First + node.Count; m++) {
+					const float low[3] = { mX[m] - mHalf[m], mY[m] - mHalf[m], mZ[m] - mHalf[m] };
+					const float high[3] = { mX[m] + mHalf[m], mY[m] + mHalf[m], mZ[m] + mHalf[m] };
+					if (overlaps(low, high)) {
+						function(mIds[m]);
+					}
+				}
+			}
+		}
+
+		static const std::uint32_t STACK_SIZE = 64;
+
+		std::vector<Node> mNodes;
+		std::vector<Primitive> mPrimitives;
+		std::vector<std::uint32_t> mIds;
+		std::vector<float> mX;
+		std::vector<float> mY;
+		std::vector<float> mZ;
+		std::vector<float> mHalf;
+		std::uint32_t mMemberCount;
+		std::uint32_t mRefits;
+		// Summed half areas of the interior boxes now and when built
+		float mArea;
+		float mBuiltArea;
+	};
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Rendering {
+	// Counter-based random numbers: the n-th draw of a generator is a pure hash of
+	// its key and n, with no shared state. Giving every voxel its own generator,
+	// keyed by blast and voxel id, makes the results independent of which thread
+	// handles the voxel and in what order. The hash is plain 32-bit integer
+	// arithmetic, so loops over it vectorise.
+	class Random {
+	public:
+		Random(std::uint32_t key, std::uint32_t stream)
+			: mKey(Combine(key, stream)), mCounter(0)
+		{
+		}
+
+		std::uint32_t Next() { return Hash(mKey, mCounter++); }
+		// Uniform in [0, 1)
+		float NextFloat() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+		// Uniform in [min, max)
+		float NextRange(float min, float max) { return min + (max - min) * NextFloat(); }
+
+		static std::uint32_t Mix(std::uint32_t x)
+		{
+			x ^= x >> 16;
+			x *= 0x21f0aaadu;
+			x ^= x >> 15;
+			x *= 0x735a2d97u;
+			x ^= x >> 15;
+			return x;
+		}
+
+		static std::uint32_t Combine(std::uint32_t a, std::uint32_t b)
+		{
+			return Mix(a ^ Mix(b + 0x9e3779b9u));
+		}
+
+		static std::uint32_t Hash(std::uint32_t key, std::uint32_t counter)
+		{
+			return Mix(key ^ (counter * 0x9e3779b9u));
+		}
+
+	private:
+		std::uint32_t mKey;
+		std::uint32_t mCounter;
+	};
+}
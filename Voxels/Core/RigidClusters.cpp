@@ -0,0 +1,514 @@
+#include "RigidClusters.h"
+#include "VoxelStore.h"
+#include "WorldCollision.h"
+#include <cmath>
+#include <utility>
+
+namespace Rendering {
+	const int RigidClusters::ITERATIONS = 4;
+	const float RigidClusters::SLEEP_ROTATION = 0.05f;
+
+	namespace {
+		// Rows of the rotation in the layout used for drawing, so a vector in
+		// body space turns into world space as the row vector local * rows
+		void RotationRows(const float q[4], float rows[9])
+		{
+			float x = q[0], y = q[1], z = q[2], w = q[3];
+			rows[0] = 1.0f - 2.0f * (y * y + z * z);
+			rows[1] = 2.0f * (x * y + w * z);
+			rows[2] = 2.0f * (x * z - w * y);
+			rows[3] = 2.0f * (x * y - w * z);
+			rows[4] = 1.0f - 2.0f * (x * x + z * z);
+			rows[5] = 2.0f * (y * z + w * x);
+			rows[6] = 2.0f * (x * z + w * y);
+			rows[7] = 2.0f * (y * z - w * x);
+			rows[8] = 1.0f - 2.0f * (x * x + y * y);
+		}
+
+		void ToWorld(const float rows[9], const float local[3], float world[3])
+		{
+			for (int i = 0; i < 3; i++) {
+				world[i] = local[0] * rows[i] + local[1] * rows[3 + i] + local[2] * rows[6 + i];
+			}
+		}
+
+		void Multiply(const float matrix[9], const float vector[3], float result[3])
+		{
+			for (int i = 0; i < 3; i++) {
+				result[i] = matrix[i * 3] * vector[0] + matrix[i * 3 + 1] * vector[1] + matrix[i * 3 + 2] * vector[2];
+			}
+		}
+
+		void Cross(const float a[3], const float b[3], float result[3])
+		{
+			result[0] = a[1] * b[2] - a[2] * b[1];
+			result[1] = a[2] * b[0] - a[0] * b[2];
+			result[2] = a[0] * b[1] - a[1] * b[0];
+		}
+
+		float Dot(const float a[3], const float b[3])
+		{
+			return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+		}
+
+		bool Invert(const float m[9], float result[9])
+		{
+			float c0 = m[4] * m[8] - m[5] * m[7];
+			float c1 = m[5] * m[6] - m[3] * m[8];
+			float c2 = m[3] * m[7] - m[4] * m[6];
+			float determinant = m[0] * c0 + m[1] * c1 + m[2] * c2;
+			if (std::fabs(determinant) < 1e-12f) {
+				return false;
+			}
+
+			float inverse = 1.0f / determinant;
+			result[0] = c0 * inverse;
+			result[1] = (m[2] * m[7] - m[1] * m[8]) * inverse;
+			result[2] = (m[1] * m[5] - m[2] * m[4]) * inverse;
+			result[3] = c1 * inverse;
+			result[4] = (m[0] * m[8] - m[2] * m[6]) * inverse;
+			result[5] = (m[2] * m[3] - m[0] * m[5]) * inverse;
+			result[6] = c2 * inverse;
+			result[7] = (m[1] * m[6] - m[0] * m[7]) * inverse;
+			result[8] = (m[0] * m[4] - m[1] * m[3]) * inverse;
+			return true;
+		}
+	}
+
+	RigidClusters::RigidClusters()
+		: mMemberCount(0)
+	{
+	}
+
+	void RigidClusters::Create(VoxelStore& store, const std::uint32_t* ids, std::uint32_t count, float launchTime)
+	{
+		const float* originX = store.OriginX();
+		const float* originY = store.OriginY();
+		const float* originZ = store.OriginZ();
+		const float* size = store.Size();
+
+		Body body = {};
+		body.Orientation[3] = 1.0f;
+		body.LaunchTime = launchTime;
+		body.Members.resize(count);
+
+		// Mass goes with volume, as in the contact solver
+		float mass = 0.0f;
+		float centre[3] = { 0.0f, 0.0f, 0.0f };
+		for (std::uint32_t m = 0; m < count; m++) {
+			std::uint32_t i = store.Slot(ids[m]);
+			float s = size[i];
+			float memberMass = s * s * s;
+			body.Members[m].Offset[0] = originX[i];
+			body.Members[m].Offset[1] = originY[i];
+			body.Members[m].Offset[2] = originZ[i];
+			body.Members[m].Size = s;
+			centre[0] += originX[i] * memberMass;
+			centre[1] += originY[i] * memberMass;
+			centre[2] += originZ[i] * memberMass;
+			mass += memberMass;
+		}
+		for (int a = 0; a < 3; a++) {
+			centre[a] /= mass;
+			body.Position[a] = centre[a];
+			body.PreviousPosition[a] = centre[a];
+		}
+		body.PreviousOrientation[3] = 1.0f;
+		body.InverseMass = 1.0f / mass;
+
+		// Each cube about its own centre, moved out to its offset
+		float inertia[9] = {};
+		for (Member& member : body.Members) {
+			float* d = member.Offset;
+			for (int a = 0; a < 3; a++) {
+				d[a] -= centre[a];
+			}
+
+			float s = member.Size;
+			float memberMass = s * s * s;
+			float diagonal = memberMass * (2.0f / 3.0f * s * s + Dot(d, d));
+			for (int r = 0; r < 3; r++) {
+				for (int c = 0; c < 3; c++) {
+					inertia[r * 3 + c] += (r == c ? diagonal : 0.0f) - memberMass * d[r] * d[c];
+				}
+			}
+		}
+		if (!Invert(inertia, body.InverseInertia)) {
+			body.InverseInertia[0] = body.InverseInertia[4] = body.InverseInertia[8] = 1.0f / inertia[0];
+		}
+
+		for (std::uint32_t m = 0; m < count; m++) {
+			store.Remove(store.Slot(ids[m]));
+		}
+		mMemberCount += count;
+		mBodies.push_back(std::move(body));
+	}
+
+	std::uint32_t RigidClusters::Remove(std::uint32_t body)
+	{
+		std::uint32_t members = static_cast<std::uint32_t>(mBodies[body].Members.size());
+		mMemberCount -= members;
+		if (body + 1 < mBodies.size()) {
+			mBodies[body] = std::move(mBodies.back());
+		}
+		mBodies.pop_back();
+
+		return members;
+	}
+
+	void RigidClusters::Clear()
+	{
+		mBodies.clear();
+		mMemberCount = 0;
+	}
+
+	std::uint32_t RigidClusters::Count() const
+	{
+		return static_cast<std::uint32_t>(mBodies.size());
+	}
+
+	std::uint32_t RigidClusters::MemberCount() const
+	{
+		return mMemberCount;
+	}
+
+	const float* RigidClusters::Position(std::uint32_t body) const
+	{
+		return mBodies[body].Position;
+	}
+
+	float RigidClusters::LaunchTime(std::uint32_t body) const
+	{
+		return mBodies[body].LaunchTime;
+	}
+
+	void RigidClusters::Integrate(double elapsed)
+	{
+		// The same motion as a loose voxel, once per body
+		const float time = static_cast<float>(elapsed * VoxelStore::TIME_FACTOR);
+		const float rotFalloff = VoxelStore::DECAY_FACTOR * VoxelStore::DECAY_FACTOR * VoxelStore::DECAY_FACTOR;
+		const float decay = VoxelStore::DECAY_FACTOR;
+
+		for (Body& body : mBodies) {
+			for (int a = 0; a < 3; a++) {
+				body.PreviousPosition[a] = body.Position[a];
+			}
+			for (int a = 0; a < 4; a++) {
+				body.PreviousOrientation[a] = body.Orientation[a];
+			}
+
+			float* w = body.Angular;
+			float* q = body.Orientation;
+			float speed = std::sqrt(Dot(w, w));
+			float halfAngle = speed * time * 0.5f;
+			float k = (speed > 1e-6f ? std::sin(halfAngle) / speed : time * 0.5f);
+			float c = std::cos(halfAngle);
+			float d[3] = { w[0] * k, w[1] * k, w[2] * k };
+			float n[4] = {
+				c * q[0] + q[3] * d[0] + d[1] * q[2] - d[2] * q[1],
+				c * q[1] + q[3] * d[1] + d[2] * q[0] - d[0] * q[2],
+				c * q[2] + q[3] * d[2] + d[0] * q[1] - d[1] * q[0],
+				c * q[3] - d[0] * q[0] - d[1] * q[1] - d[2] * q[2]
+			};
+			float scale = 1.0f / std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2] + n[3] * n[3]);
+			for (int a = 0; a < 4; a++) {
+				q[a] = n[a] * scale;
+			}
+			for (int a = 0; a < 3; a++) {
+				w[a] *= rotFalloff;
+			}
+
+			body.Velocity[1] += VoxelStore::GRAVITY * time;
+			for (int a = 0; a < 3; a++) {
+				body.Position[a] += body.Velocity[a] * time;
+				body.Velocity[a] *= decay;
+			}
+		}
+	}
+
+	std::uint32_t RigidClusters::Collide(WorldCollision& world, VoxelStore& store)
+	{
+		if (mBodies.empty()) {
+			return 0;
+		}
+
+		world.UpdateStatic(store);
+		std::uint32_t touching = 0;
+		for (Body& body : mBodies) {
+			CollideBody(body, world, store);
+			touching += (body.Contact ? 1 : 0);
+		}
+
+		return touching;
+	}
+
+	void RigidClusters::CollideBody(Body& body, const WorldCollision& world, const VoxelStore& store)
+	{
+		float rows[9];
+		RotationRows(body.Orientation, rows);
+		float ground = world.GroundHeight();
+
+		// Every member sphere against the sleeping voxels and the ground
+		mContacts.clear();
+		for (const Member& member : body.Members) {
+			float centre[3];
+			ToWorld(rows, member.Offset, centre);
+			for (int a = 0; a < 3; a++) {
+				centre[a] += body.Position[a];
+			}
+			float radius = member.Size;
+
+			auto add = [&](const float normal[3], float depth) {
+				Contact contact = {};
+				for (int a = 0; a < 3; a++) {
+					contact.Normal[a] = normal[a];
+					contact.Point[a] = centre[a] - normal[a] * radius;
+				}
+				contact.Depth = depth;
+				mContacts.push_back(contact);
+			};
+
+			world.ForEachStaticNear(store, centre, [&](const float boxCentre[3], float half) {
+				float normal[3];
+				float depth;
+				if (WorldCollision::SphereBoxContact(centre, radius, boxCentre, half, normal, depth)) {
+					add(normal, depth);
+				}
+			});
+			if (centre[1] - radius < ground) {
+				const float up[3] = { 0.0f, 1.0f, 0.0f };
+				add(up, ground - (centre[1] - radius));
+			}
+		}
+
+		body.Contact = !mContacts.empty();
+		if (!body.Contact) {
+			return;
+		}
+
+		// Push the body out; each contact only moves it as far as the ones
+		// before have not already
+		float correction[3] = { 0.0f, 0.0f, 0.0f };
+		for (const Contact& contact : mContacts) {
+			float remaining = contact.Depth - Dot(correction, contact.Normal);
+			if (remaining > 0.0f) {
+				for (int a = 0; a < 3; a++) {
+					correction[a] += contact.Normal[a] * remaining;
+				}
+			}
+		}
+		for (int a = 0; a < 3; a++) {
+			body.Position[a] += correction[a];
+		}
+
+		// Inverse inertia in world space: rows^T * body inverse * rows
+		float inverseInertia[9];
+		for (int i = 0; i < 3; i++) {
+			for (int k = 0; k < 3; k++) {
+				float sum = 0.0f;
+				for (int j = 0; j < 3; j++) {
+					for (int l = 0; l < 3; l++) {
+						sum += rows[j * 3 + i] * body.InverseInertia[j * 3 + l] * rows[l * 3 + k];
+					}
+				}
+				inverseInertia[i * 3 + k] = sum;
+			}
+		}
+
+		auto pointVelocity = [&body](const float arm[3], float velocity[3]) {
+			Cross(body.Angular, arm, velocity);
+			for (int a = 0; a < 3; a++) {
+				velocity[a] += body.Velocity[a];
+			}
+		};
+		auto applyImpulse = [&body, &inverseInertia](const float arm[3], const float direction[3], float impulse) {
+			float torque[3];
+			float turn[3];
+			Cross(arm, direction, torque);
+			Multiply(inverseInertia, torque, turn);
+			for (int a = 0; a < 3; a++) {
+				body.Velocity[a] += direction[a] * impulse * body.InverseMass;
+				body.Angular[a] += turn[a] * impulse;
+			}
+		};
+		auto effectiveMass = [&body, &inverseInertia](const float arm[3], const float direction[3]) {
+			float torque[3];
+			float turn[3];
+			float along[3];
+			Cross(arm, direction, torque);
+			Multiply(inverseInertia, torque, turn);
+			Cross(turn, arm, along);
+			return body.InverseMass + Dot(direction, along);
+		};
+
+		// A hard hit bounces back part of its approach speed; a slow one stops
+		for (Contact& contact : mContacts) {
+			float arm[3];
+			float velocity[3];
+			for (int a = 0; a < 3; a++) {
+				arm[a] = contact.Point[a] - body.Position[a];
+			}
+			pointVelocity(arm, velocity);
+			float approach = Dot(velocity, contact.Normal);
+			contact.TargetSpeed = (-approach > WorldCollision::REST_SPEED ? -approach * WorldCollision::RESTITUTION : 0.0f);
+		}
+
+		for (int iteration = 0; iteration < ITERATIONS; iteration++) {
+			for (Contact& contact : mContacts) {
+				float arm[3];
+				float velocity[3];
+				for (int a = 0; a < 3; a++) {
+					arm[a] = contact.Point[a] - body.Position[a];
+				}
+
+				// The total push along the normal may only ever be outwards
+				pointVelocity(arm, velocity);
+				float speed = Dot(velocity, contact.Normal);
+				float impulse = (contact.TargetSpeed - speed) / effectiveMass(arm, contact.Normal);
+				float total = contact.Impulse + impulse;
+				total = (total > 0.0f ? total : 0.0f);
+				applyImpulse(arm, contact.Normal, total - contact.Impulse);
+				contact.Impulse = total;
+
+				// Friction takes at most FRICTION times the push. It adds up as a
+				// vector and is clamped as a whole, so a later iteration can take
+				// back what an earlier one pushed the wrong way
+				pointVelocity(arm, velocity);
+				speed = Dot(velocity, contact.Normal);
+				float sliding[3];
+				for (int a = 0; a < 3; a++) {
+					sliding[a] = velocity[a] - contact.Normal[a] * speed;
+				}
+				float slide = std::sqrt(Dot(sliding, sliding));
+				float friction[3] = { contact.Friction[0], contact.Friction[1], contact.Friction[2] };
+				if (slide > 1e-6f) {
+					for (int a = 0; a < 3; a++) {
+						sliding[a] /= -slide;
+					}
+					float stop = slide / effectiveMass(arm, sliding);
+					for (int a = 0; a < 3; a++) {
+						friction[a] += sliding[a] * stop;
+					}
+				}
+				float allowed = WorldCollision::FRICTION * contact.Impulse;
+				float length = std::sqrt(Dot(friction, friction));
+				if (length > allowed) {
+					for (int a = 0; a < 3; a++) {
+						friction[a] *= allowed / length;
+					}
+				}
+
+				float change[3];
+				for (int a = 0; a < 3; a++) {
+					change[a] = friction[a] - contact.Friction[a];
+					contact.Friction[a] = friction[a];
+				}
+				float amount = std::sqrt(Dot(change, change));
+				if (amount > 0.0f) {
+					for (int a = 0; a < 3; a++) {
+						change[a] /= amount;
+					}
+					applyImpulse(arm, change, amount);
+				}
+			}
+		}
+
+		for (int a = 0; a < 3; a++) {
+			body.Angular[a] *= WorldCollision::SPIN_DAMPING;
+		}
+	}
+
+	std::uint32_t RigidClusters::SleepResting(VoxelStore& store)
+	{
+		const float sleepTurn = SLEEP_ROTATION * SLEEP_ROTATION / 8.0f;
+		std::uint32_t restored = 0;
+
+		for (std::uint32_t b = static_cast<std::uint32_t>(mBodies.size()); b-- > 0;) {
+			Body& body = mBodies[b];
+			if (!body.Contact) {
+				body.RestFrames = 0;
+				continue;
+			}
+
+			// Measure drift from where the body started resting; one minus the
+			// quaternion dot product is about an eighth of the angle squared
+			if (body.RestFrames == 0) {
+				for (int a = 0; a < 3; a++) {
+					body.RestPosition[a] = body.Position[a];
+				}
+				for (int a = 0; a < 4; a++) {
+					body.RestOrientation[a] = body.Orientation[a];
+				}
+			}
+
+			float drift[3];
+			for (int a = 0; a < 3; a++) {
+				drift[a] = body.Position[a] - body.RestPosition[a];
+			}
+			float limit = VoxelStore::SLEEP_DRIFT * body.Members[0].Size;
+			float turn = 1.0f - std::fabs(body.Orientation[0] * body.RestOrientation[0] + body.Orientation[1] * body.RestOrientation[1]
+				+ body.Orientation[2] * body.RestOrientation[2] + body.Orientation[3] * body.RestOrientation[3]);
+			if (Dot(drift, drift) > limit * limit || turn > sleepTurn) {
+				body.RestFrames = 0;
+				continue;
+			}
+
+			if (++body.RestFrames < VoxelStore::SLEEP_FRAMES) {
+				continue;
+			}
+
+			// Settled: the members go back into the store as sleeping debris
+			float rows[9];
+			RotationRows(body.Orientation, rows);
+			for (const Member& member : body.Members) {
+				float centre[3];
+				ToWorld(rows, member.Offset, centre);
+				store.AddDebris(body.Position[0] + centre[0], body.Position[1] + centre[1], body.Position[2] + centre[2], member.Size, body.Orientation, body.LaunchTime);
+			}
+			restored += Remove(b);
+		}
+
+		return restored;
+	}
+
+	void RigidClusters::GetPositionMatrices(float alpha, float* matrices) const
+	{
+		for (const Body& body : mBodies) {
+			// Blend the last two steps along the shorter arc, as for loose voxels
+			float q[4];
+			float sign = (Dot(body.PreviousOrientation, body.Orientation) + body.PreviousOrientation[3] * body.Orientation[3] < 0.0f ? -1.0f : 1.0f);
+			float length = 0.0f;
+			for (int a = 0; a < 4; a++) {
+				q[a] = body.PreviousOrientation[a] + (body.Orientation[a] * sign - body.PreviousOrientation[a]) * alpha;
+				length += q[a] * q[a];
+			}
+			float scale = 1.0f / std::sqrt(length);
+			for (int a = 0; a < 4; a++) {
+				q[a] *= scale;
+			}
+
+			float rows[9];
+			RotationRows(q, rows);
+			float position[3];
+			for (int a = 0; a < 3; a++) {
+				position[a] = body.PreviousPosition[a] + (body.Position[a] - body.PreviousPosition[a]) * alpha;
+			}
+
+			for (const Member& member : body.Members) {
+				float offset[3];
+				ToWorld(rows, member.Offset, offset);
+				for (int r = 0; r < 3; r++) {
+					matrices[r * 4] = rows[r * 3] * member.Size;
+					matrices[r * 4 + 1] = rows[r * 3 + 1] * member.Size;
+					matrices[r * 4 + 2] = rows[r * 3 + 2] * member.Size;
+					matrices[r * 4 + 3] = 0.0f;
+				}
+				matrices[12] = position[0] + offset[0];
+				matrices[13] = position[1] + offset[1];
+				matrices[14] = position[2] + offset[2];
+				matrices[15] = 1.0f;
+				matrices += 16;
+			}
+		}
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Rendering {
+	class VoxelStore;
+	class WorldCollision;
+
+	// Pieces of the chunk that come off in one piece, simulated as rigid bodies
+	// instead of one particle per voxel. Creating a body takes its voxels out of
+	// the store and keeps only their offsets from the centre of mass; a body has
+	// one position, orientation and velocity, and an inertia tensor summed from
+	// its voxels. Member transforms are only worked out when drawing.
+	//
+	// Each member is the sphere inscribed in its cube, as for loose voxels, and
+	// collides with the ground and the sleeping voxels. The contacts of a body
+	// are solved together with sequential impulses, so a body lands, tips over
+	// and slides as a whole. Bodies do not collide with loose debris or with each
+	// other. Once a body has rested on something for SLEEP_FRAMES steps without
+	// drifting, its members go back into the store as sleeping debris.
+	class RigidClusters {
+	public:
+		RigidClusters();
+
+		// Takes the voxels with the given ids out of the store and makes them one body
+		void Create(VoxelStore& store, const std::uint32_t* ids, std::uint32_t count, float launchTime);
+		// Returns the number of voxels the body held
+		std::uint32_t Remove(std::uint32_t body);
+		void Clear();
+
+		std::uint32_t Count() const;
+		std::uint32_t MemberCount() const;
+		const float* Position(std::uint32_t body) const;
+		float LaunchTime(std::uint32_t body) const;
+
+		void Integrate(double elapsed);
+		// Returns the number of bodies that touched the world
+		std::uint32_t Collide(WorldCollision& world, VoxelStore& store);
+		// Returns the number of voxels given back to the store
+		std::uint32_t SleepResting(VoxelStore& store);
+
+		// Writes MemberCount() row-major matrices, body by body
+		void GetPositionMatrices(float alpha, float* matrices) const;
+
+		static const int ITERATIONS;
+		static const float SLEEP_ROTATION;
+
+	private:
+		RigidClusters(const RigidClusters& rhs);
+		RigidClusters& operator=(const RigidClusters& rhs);
+
+		struct Member {
+			float Offset[3];
+			float Size;
+		};
+
+		struct Body {
+			float Position[3];
+			float Velocity[3];
+			float Orientation[4];
+			// World space, radians per unit of scaled time, as for loose voxels
+			float Angular[3];
+			float PreviousPosition[3];
+			float PreviousOrientation[4];
+			float InverseMass;
+			// In body space; rotated into world space when solving
+			float InverseInertia[9];
+			float LaunchTime;
+			float RestPosition[3];
+			float RestOrientation[4];
+			std::uint8_t RestFrames;
+			bool Contact;
+			std::vector<Member> Members;
+		};
+
+		struct Contact {
+			float Point[3];
+			float Normal[3];
+			float Depth;
+			float TargetSpeed;
+			// Accumulated over the iterations
+			float Impulse;
+			float Friction[3];
+		};
+
+		void CollideBody(Body& body, const WorldCollision& world, const VoxelStore& store);
+
+		std::vector<Body> mBodies;
+		std::vector<Contact> mContacts;
+		std::uint32_t mMemberCount;
+	};
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#define VOXELS_SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VOXELS_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace Rendering {
+	// Thin wrappers over the SSE2/AVX2 float registers, plus a one-lane scalar
+	// type with the same interface. Kernels are written once as templates over
+	// these types, and the scalar type finishes the tail of each range so every
+	// voxel goes through exactly the same arithmetic.
+	namespace Simd {
+		inline int CountBits(int bits)
+		{
+			int count = 0;
+			for (; bits != 0; bits &= bits - 1) {
+				count++;
+			}
+			return count;
+		}
+
+		struct Bool1 {
+			bool v;
+		};
+
+		struct Float1 {
+			typedef Bool1 Mask;
+			static const int Width = 1;
+
+			float v;
+
+			static Float1 Set(float x) { Float1 r = { x }; return r; }
+			static Float1 Load(const float* p) { return Set(*p); }
+			static Mask LoadMask(const std::uint8_t* p) { Mask r = { *p != 0 }; return r; }
+			void Store(float* p) const { *p = v; }
+		};
+
+		inline Float1 operator+(Float1 a, Float1 b) { return Float1::Set(a.v + b.v); }
+		inline Float1 operator-(Float1 a, Float1 b) { return Float1::Set(a.v - b.v); }
+		inline Float1 operator*(Float1 a, Float1 b) { return Float1::Set(a.v * b.v); }
+		inline Float1 operator/(Float1 a, Float1 b) { return Float1::Set(a.v / b.v); }
+		inline Float1 operator-(Float1 a) { return Float1::Set(-a.v); }
+		inline Bool1 operator<(Float1 a, Float1 b) { Bool1 r = { a.v < b.v }; return r; }
+		inline Bool1 operator>(Float1 a, Float1 b) { Bool1 r = { a.v > b.v }; return r; }
+		inline Bool1 operator<=(Float1 a, Float1 b) { Bool1 r = { a.v <= b.v }; return r; }
+		inline Bool1 operator&(Bool1 a, Bool1 b) { Bool1 r = { a.v && b.v }; return r; }
+		inline Bool1 operator|(Bool1 a, Bool1 b) { Bool1 r = { a.v || b.v }; return r; }
+		inline Float1 Select(Bool1 m, Float1 a, Float1 b) { return m.v ? a : b; }
+		inline bool Any(Bool1 m) { return m.v; }
+		inline int Count(Bool1 m) { return m.v ? 1 : 0; }
+		// Bit i set where lane i is
+		inline int BitMask(Bool1 m) { return m.v ? 1 : 0; }
+		inline Float1 Abs(Float1 a) { return Float1::Set(std::fabs(a.v)); }
+		inline Float1 Min(Float1 a, Float1 b) { return Float1::Set(b.v < a.v ? b.v : a.v); }
+		inline Float1 Max(Float1 a, Float1 b) { return Float1::Set(a.v < b.v ? b.v : a.v); }
+		inline Float1 Sqrt(Float1 a) { return Float1::Set(std::sqrt(a.v)); }
+		inline Float1 Round(Float1 a) { return Float1::Set(std::nearbyint(a.v)); }
+		inline Float1 Floor(Float1 a) { return Float1::Set(std::floor(a.v)); }
+
+#if defined(VOXELS_SIMD_SSE2)
+		struct Bool4 {
+			__m128 v;
+		};
+
+		struct Float4 {
+			typedef Bool4 Mask;
+			static const int Width = 4;
+
+			__m128 v;
+
+			static Float4 Set(float x) { Float4 r = { _mm_set1_ps(x) }; return r; }
+			static Float4 Load(const float* p) { Float4 r = { _mm_loadu_ps(p) }; return r; }
+			static Mask LoadMask(const std::uint8_t* p)
+			{
+				std::int32_t bytes;
+				std::memcpy(&bytes, p, sizeof(bytes));
+				__m128i zero = _mm_setzero_si128();
+				__m128i wide = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+				Mask r = { _mm_castsi128_ps(_mm_cmpgt_epi32(wide, zero)) };
+				return r;
+			}
+			void Store(float* p) const { _mm_storeu_ps(p, v); }
+		};
+
+		inline Float4 Make(__m128 v) { Float4 r = { v }; return r; }
+		inline Bool4 MakeMask(__m128 v) { Bool4 r = { v }; return r; }
+		inline Float4 operator+(Float4 a, Float4 b) { return Make(_mm_add_ps(a.v, b.v)); }
+		inline Float4 operator-(Float4 a, Float4 b) { return Make(_mm_sub_ps(a.v, b.v)); }
+		inline Float4 operator*(Float4 a, Float4 b) { return Make(_mm_mul_ps(a.v, b.v)); }
+		inline Float4 operator/(Float4 a, Float4 b) { return Make(_mm_div_ps(a.v, b.v)); }
+		inline Float4 operator-(Float4 a) { return Make(_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))); }
+		inline Bool4 operator<(Float4 a, Float4 b) { return MakeMask(_mm_cmplt_ps(a.v, b.v)); }
+		inline Bool4 operator>(Float4 a, Float4 b) { return MakeMask(_mm_cmpgt_ps(a.v, b.v)); }
+		inline Bool4 operator<=(Float4 a, Float4 b) { return MakeMask(_mm_cmple_ps(a.v, b.v)); }
+		inline Bool4 operator&(Bool4 a, Bool4 b) { return MakeMask(_mm_and_ps(a.v, b.v)); }
+		inline Bool4 operator|(Bool4 a, Bool4 b) { return MakeMask(_mm_or_ps(a.v, b.v)); }
+		inline Float4 Select(Bool4 m, Float4 a, Float4 b) { return Make(_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v))); }
+		inline bool Any(Bool4 m) { return _mm_movemask_ps(m.v) != 0; }
+		inline int Count(Bool4 m) { return CountBits(_mm_movemask_ps(m.v)); }
+		inline int BitMask(Bool4 m) { return _mm_movemask_ps(m.v); }
+		inline Float4 Abs(Float4 a) { return Make(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)); }
+		inline Float4 Min(Float4 a, Float4 b) { return Make(_mm_min_ps(a.v, b.v)); }
+		inline Float4 Max(Float4 a, Float4 b) { return Make(_mm_max_ps(a.v, b.v)); }
+		inline Float4 Sqrt(Float4 a) { return Make(_mm_sqrt_ps(a.v)); }
+		// Uses the default round-to-nearest-even mode; only valid for |a| < 2^31
+		inline Float4 Round(Float4 a) { return Make(_mm_cvtepi32_ps(_mm_cvtps_epi32(a.v))); }
+		// Rounds to nearest and steps down where that went up; same range as Round()
+		inline Float4 Floor(Float4 a)
+		{
+			Float4 r = Round(a);
+			return Make(_mm_sub_ps(r.v, _mm_and_ps(_mm_cmpgt_ps(r.v, a.v), _mm_set1_ps(1.0f))));
+		}
+#endif
+
+#if defined(VOXELS_SIMD_AVX2)
+		struct Bool8 {
+			__m256 v;
+		};
+
+		struct Float8 {
+			typedef Bool8 Mask;
+			static const int Width = 8;
+
+			__m256 v;
+
+			static Float8 Set(float x) { Float8 r = { _mm256_set1_ps(x) }; return r; }
+			static Float8 Load(const float* p) { Float8 r = { _mm256_loadu_ps(p) }; return r; }
+			static Mask LoadMask(const std::uint8_t* p)
+			{
+				__m256i wide = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+				Mask r = { _mm256_castsi256_ps(_mm256_cmpgt_epi32(wide, _mm256_setzero_si256())) };
+				return r;
+			}
+			void Store(float* p) const { _mm256_storeu_ps(p, v); }
+		};
+
+		inline Float8 Make(__m256 v) { Float8 r = { v }; return r; }
+		inline Bool8 MakeMask(__m256 v) { Bool8 r = { v }; return r; }
+		inline Float8 operator+(Float8 a, Float8 b) { return Make(_mm256_add_ps(a.v, b.v)); }
+		inline Float8 operator-(Float8 a, Float8 b) { return Make(_mm256_sub_ps(a.v, b.v)); }
+		inline Float8 operator*(Float8 a, Float8 b) { return Make(_mm256_mul_ps(a.v, b.v)); }
+		inline Float8 operator/(Float8 a, Float8 b) { return Make(_mm256_div_ps(a.v, b.v)); }
+		inline Float8 operator-(Float8 a) { return Make(_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))); }
+		inline Bool8 operator<(Float8 a, Float8 b) { return MakeMask(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)); }
+		inline Bool8 operator>(Float8 a, Float8 b) { return MakeMask(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)); }
+		inline Bool8 operator<=(Float8 a, Float8 b) { return MakeMask(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)); }
+		inline Bool8 operator&(Bool8 a, Bool8 b) { return MakeMask(_mm256_and_ps(a.v, b.v)); }
+		inline Bool8 operator|(Bool8 a, Bool8 b) { return MakeMask(_mm256_or_ps(a.v, b.v)); }
+		inline Float8 Select(Bool8 m, Float8 a, Float8 b) { return Make(_mm256_blendv_ps(b.v, a.v, m.v)); }
+		inline bool Any(Bool8 m) { return _mm256_movemask_ps(m.v) != 0; }
+		inline int Count(Bool8 m) { return CountBits(_mm256_movemask_ps(m.v)); }
+		inline int BitMask(Bool8 m) { return _mm256_movemask_ps(m.v); }
+		inline Float8 Abs(Float8 a) { return Make(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)); }
+		inline Float8 Min(Float8 a, Float8 b) { return Make(_mm256_min_ps(a.v, b.v)); }
+		inline Float8 Max(Float8 a, Float8 b) { return Make(_mm256_max_ps(a.v, b.v)); }
+		inline Float8 Sqrt(Float8 a) { return Make(_mm256_sqrt_ps(a.v)); }
+		inline Float8 Round(Float8 a) { return Make(_mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); }
+		inline Float8 Floor(Float8 a) { return Make(_mm256_floor_ps(a.v)); }
+#endif
+
+#if defined(VOXELS_SIMD_AVX2)
+		typedef Float8 FloatN;
+#elif defined(VOXELS_SIMD_SSE2)
+		typedef Float4 FloatN;
+#else
+		typedef Float1 FloatN;
+#endif
+
+		// Sine and cosine of every lane. The argument is reduced to [-pi, pi] with a
+		// two-part 2*pi, folded into [-pi/2, pi/2] and evaluated with the same
+		// minimax polynomials DirectXMath uses (absolute error below 2e-7 there).
+		template <typename V>
+		inline void SinCos(V x, V& sine, V& cosine)
+		{
+			V quotient = Round(x * V::Set(0.159154943f));
+			x = x - quotient * V::Set(6.28125f);
+			x = x - quotient * V::Set(1.93530717e-3f);
+
+			V sign = V::Set(1.0f);
+			typename V::Mask high = x > V::Set(1.57079637f);
+			typename V::Mask low = x < V::Set(-1.57079637f);
+			x = Select(high, V::Set(3.14159274f) - x, x);
+			x = Select(low, V::Set(-3.14159274f) - x, x);
+			sign = Select(high | low, V::Set(-1.0f), sign);
+
+			V x2 = x * x;
+			V s = V::Set(-2.3889859e-08f);
+			s = s * x2 + V::Set(2.7525562e-06f);
+			s = s * x2 - V::Set(1.9840874e-04f);
+			s = s * x2 + V::Set(8.3333310e-03f);
+			s = s * x2 - V::Set(1.6666667e-01f);
+			s = s * x2 + V::Set(1.0f);
+			sine = s * x;
+
+			V c = V::Set(-2.6051615e-07f);
+			c = c * x2 + V::Set(2.4760495e-05f);
+			c = c * x2 - V::Set(1.3888378e-03f);
+			c = c * x2 + V::Set(4.1666638e-02f);
+			c = c * x2 - V::Set(5.0e-01f);
+			c = c * x2 + V::Set(1.0f);
+			cosine = c * sign;
+		}
+	}
+}
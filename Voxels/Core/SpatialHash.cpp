@@ -0,0 +1,93 @@
+#include "SpatialHash.h"
+
+namespace Rendering {
+	const std::uint32_t SpatialHash::DENSE_CELLS = 8;
+
+	SpatialHash::SpatialHash()
+		: mCellSize(1.0f), mInverseCellSize(1.0f), mDense(false), mMinimum(), mMaximum(), mStrideY(0), mStrideZ(0), mTableSize(0)
+	{
+	}
+
+	void SpatialHash::Build(const float* x, const float* y, const float* z, std::uint32_t count, float cellSize)
+	{
+		mCellSize = cellSize;
+		mInverseCellSize = 1.0f / cellSize;
+
+		mKeys.resize(count);
+		Key minimum = { 0, 0, 0 };
+		Key maximum = { 0, 0, 0 };
+		for (std::uint32_t i = 0; i < count; i++) {
+			Key key = { Cell(x[i]), Cell(y[i]), Cell(z[i]) };
+			mKeys[i] = key;
+			if (i == 0) {
+				minimum = key;
+				maximum = key;
+			}
+			minimum.X = (key.X < minimum.X ? key.X : minimum.X);
+			minimum.Y = (key.Y < minimum.Y ? key.Y : minimum.Y);
+			minimum.Z = (key.Z < minimum.Z ? key.Z : minimum.Z);
+			maximum.X = (key.X > maximum.X ? key.X : maximum.X);
+			maximum.Y = (key.Y > maximum.Y ? key.Y : maximum.Y);
+			maximum.Z = (key.Z > maximum.Z ? key.Z : maximum.Z);
+		}
+
+		// A dense grid is worth it while it has at most DENSE_CELLS cells per point
+		std::uint64_t sizeX = static_cast<std::uint64_t>(static_cast<std::int64_t>(maximum.X) - minimum.X + 3);
+		std::uint64_t sizeY = static_cast<std::uint64_t>(static_cast<std::int64_t>(maximum.Y) - minimum.Y + 3);
+		std::uint64_t sizeZ = static_cast<std::uint64_t>(static_cast<std::int64_t>(maximum.Z) - minimum.Z + 3);
+		std::uint64_t cells = sizeX * sizeY * sizeZ;
+		mDense = (sizeX < 0x10000 && sizeY < 0x10000 && sizeZ < 0x10000 && cells <= static_cast<std::uint64_t>(count) * DENSE_CELLS + 64);
+
+		std::uint32_t tableSize;
+		if (mDense) {
+			mMinimum.X = minimum.X - 1;
+			mMinimum.Y = minimum.Y - 1;
+			mMinimum.Z = minimum.Z - 1;
+			mMaximum.X = maximum.X + 1;
+			mMaximum.Y = maximum.Y + 1;
+			mMaximum.Z = maximum.Z + 1;
+			mStrideY = static_cast<std::uint32_t>(sizeX);
+			mStrideZ = static_cast<std::uint32_t>(sizeX * sizeY);
+			tableSize = static_cast<std::uint32_t>(cells);
+		}
+		else {
+			// Twice as many buckets as points keeps unrelated cells from sharing
+			tableSize = 16;
+			while (tableSize < count * 2) {
+				tableSize *= 2;
+			}
+		}
+		mTableSize = tableSize;
+
+		mBuckets.resize(count);
+		mBucketStart.assign(tableSize + 1, 0);
+		for (std::uint32_t i = 0; i < count; i++) {
+			std::uint32_t bucket = Bucket(mKeys[i]);
+			mBuckets[i] = bucket;
+			mBucketStart[bucket + 1]++;
+		}
+
+		for (std::uint32_t b = 0; b < tableSize; b++) {
+			mBucketStart[b + 1] += mBucketStart[b];
+		}
+
+		// Scatter in index order; the start of each bucket is used as its cursor
+		// and shifted back into place afterwards
+		mEntries.resize(count);
+		mEntryKeys.resize(count);
+		for (std::uint32_t i = 0; i < count; i++) {
+			std::uint32_t position = mBucketStart[mBuckets[i]]++;
+			mEntries[position] = i;
+			mEntryKeys[position] = mKeys[i];
+		}
+		for (std::uint32_t b = tableSize; b > 0; b--) {
+			mBucketStart[b] = mBucketStart[b - 1];
+		}
+		mBucketStart[0] = 0;
+	}
+
+	float SpatialHash::CellSize() const
+	{
+		return mCellSize;
+	}
+}
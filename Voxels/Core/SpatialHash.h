@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace Rendering {
+	// Uniform grid over points, rebuilt from scratch each step with a counting
+	// sort, so building is linear in the point count and needs no per-cell
+	// allocation. With the cell size at least the largest interaction distance,
+	// every neighbour of a point lies in the 3x3x3 block of cells around it.
+	//
+	// While the points are packed closely enough the buckets are a dense grid
+	// over their bounds, so bucket order is also spatial order. Once they spread
+	// out, cells are hashed into a table twice the point count instead; each
+	// point keeps its cell coordinates so cells that share a bucket are told
+	// apart exactly. Points in a bucket are kept in index order, so queries
+	// visit neighbours in the same order every run.
+	class SpatialHash {
+	public:
+		SpatialHash();
+
+		void Build(const float* x, const float* y, const float* z, std::uint32_t count, float cellSize);
+		float CellSize() const;
+
+		// Calls function(position) for every point in the cells around (x, y, z),
+		// including the point itself if it is one of them. Points are identified by
+		// their position in bucket order; Entry() maps that back to the index
+		// they were built from.
+		template <typename Function>
+		void ForEachNeighbour(float x, float y, float z, Function function) const
+		{
+			Key key = { Cell(x), Cell(y), Cell(z) };
+			VisitCells(key, function);
+		}
+
+		// Same, around the cell the point at position was built into
+		template <typename Function>
+		void ForEachNeighbourOf(std::uint32_t position, Function function) const
+		{
+			VisitCells(mEntryKeys[position], function);
+		}
+
+		// Calls function(position) for every point in the cells overlapping the
+		// box from (minimumX, minimumY, minimumZ) to (maximumX, maximumY, maximumZ),
+		// so a query of any size only visits the cells it covers
+		template <typename Function>
+		void ForEachInBox(float minimumX, float minimumY, float minimumZ, float maximumX, float maximumY, float maximumZ, Function function) const
+		{
+			if (mEntries.empty()) {
+				return;
+			}
+
+			Key first = { Cell(minimumX), Cell(minimumY), Cell(minimumZ) };
+			Key last = { Cell(maximumX), Cell(maximumY), Cell(maximumZ) };
+			if (mDense) {
+				first.X = (first.X < mMinimum.X ? mMinimum.X : first.X);
+				first.Y = (first.Y < mMinimum.Y ? mMinimum.Y : first.Y);
+				first.Z = (first.Z < mMinimum.Z ? mMinimum.Z : first.Z);
+				last.X = (last.X > mMaximum.X ? mMaximum.X : last.X);
+				last.Y = (last.Y > mMaximum.Y ? mMaximum.Y : last.Y);
+				last.Z = (last.Z > mMaximum.Z ? mMaximum.Z : last.Z);
+			}
+			if (first.X > last.X || first.Y > last.Y || first.Z > last.Z) {
+				return;
+			}
+
+			std::uint64_t width = static_cast<std::uint64_t>(static_cast<std::int64_t>(last.X) - first.X + 1);
+			std::uint64_t cells = width
+				* static_cast<std::uint64_t>(static_cast<std::int64_t>(last.Y) - first.Y + 1)
+				* static_cast<std::uint64_t>(static_cast<std::int64_t>(last.Z) - first.Z + 1);
+			if (!mDense && cells > mEntries.size()) {
+				// Covering more cells than there are points; checking each point is cheaper
+				for (std::uint32_t e = 0; e < mEntries.size(); e++) {
+					const Key& entry = mEntryKeys[e];
+					if (entry.X >= first.X && entry.X <= last.X && entry.Y >= first.Y && entry.Y <= last.Y && entry.Z >= first.Z && entry.Z <= last.Z) {
+						function(e);
+					}
+				}
+				return;
+			}
+
+			for (std::int32_t z = first.Z; z <= last.Z; z++) {
+				for (std::int32_t y = first.Y; y <= last.Y; y++) {
+					Key key = { first.X, y, z };
+					if (mDense) {
+						std::uint32_t bucket = Bucket(key);
+						VisitRow(key, static_cast<std::uint32_t>(width), mBucketStart[bucket], mBucketStart[bucket + static_cast<std::uint32_t>(width)], function);
+						continue;
+					}
+
+					for (; key.X <= last.X; key.X++) {
+						std::uint32_t bucket = Bucket(key);
+						VisitRow(key, 1, mBucketStart[bucket], mBucketStart[bucket + 1], function);
+					}
+				}
+			}
+		}
+
+		// Points in bucket order. Walking them in this order keeps neighbouring
+		// queries on the same few buckets, and data copied into this order is
+		// read contiguously by the queries.
+		std::uint32_t EntryCount() const { return static_cast<std::uint32_t>(mEntries.size()); }
+		std::uint32_t Entry(std::uint32_t position) const { return mEntries[position]; }
+		bool IsDense() const { return mDense; }
+
+		static const std::uint32_t DENSE_CELLS;
+
+	private:
+		SpatialHash(const SpatialHash& rhs);
+		SpatialHash& operator=(const SpatialHash& rhs);
+
+		std::int32_t Cell(float position) const
+		{
+			return static_cast<std::int32_t>(std::floor(position * mInverseCellSize));
+		}
+
+		struct Key {
+			std::int32_t X;
+			std::int32_t Y;
+			std::int32_t Z;
+		};
+
+		template <typename Function>
+		void VisitCells(const Key& centre, Function& function) const
+		{
+			if (mEntries.empty()) {
+				return;
+			}
+
+			for (std::int32_t dz = -1; dz <= 1; dz++) {
+				for (std::int32_t dy = -1; dy <= 1; dy++) {
+					// The three cells of a row sit in consecutive buckets, so they are
+					// one run of entries unless the run leaves the table
+					Key key = { centre.X - 1, centre.Y + dy, centre.Z + dz };
+					if (mDense) {
+						std::int32_t last = centre.X + 1;
+						key.X = (key.X < mMinimum.X ? mMinimum.X : key.X);
+						last = (last > mMaximum.X ? mMaximum.X : last);
+						if (key.Y < mMinimum.Y || key.Y > mMaximum.Y || key.Z < mMinimum.Z || key.Z > mMaximum.Z || key.X > last) {
+							continue;
+						}
+						std::uint32_t bucket = Bucket(key);
+						VisitRow(key, 3, mBucketStart[bucket], mBucketStart[bucket + (last - key.X) + 1], function);
+						continue;
+					}
+
+					std::uint32_t bucket = Bucket(key);
+					if (bucket + 3 <= mTableSize) {
+						VisitRow(key, 3, mBucketStart[bucket], mBucketStart[bucket + 3], function);
+					}
+					else {
+						for (std::int32_t dx = 0; dx < 3; dx++, key.X++) {
+							bucket = Bucket(key);
+							VisitRow(key, 1, mBucketStart[bucket], mBucketStart[bucket + 1], function);
+						}
+					}
+				}
+			}
+		}
+
+		// Either way the cells of a row along x follow each other
+		std::uint32_t Bucket(const Key& key) const
+		{
+			if (mDense) {
+				return static_cast<std::uint32_t>(key.X - mMinimum.X)
+					+ mStrideY * static_cast<std::uint32_t>(key.Y - mMinimum.Y)
+					+ mStrideZ * static_cast<std::uint32_t>(key.Z - mMinimum.Z);
+			}
+
+			std::uint32_t row = static_cast<std::uint32_t>(key.Y) * 19349663u ^ static_cast<std::uint32_t>(key.Z) * 83492791u;
+			return (row + static_cast<std::uint32_t>(key.X)) & (mTableSize - 1);
+		}
+
+		// Visits the points of width cells along x starting at first. In a hashed
+		// table other cells can share the buckets; their points are skipped here and
+		// visited from their own cell, so nothing is seen twice.
+		template <typename Function>
+		void VisitRow(const Key& first, std::uint32_t width, std::uint32_t begin, std::uint32_t end, Function& function) const
+		{
+			if (mDense) {
+				for (std::uint32_t e = begin; e < end; e++) {
+					function(e);
+				}
+				return;
+			}
+
+			for (std::uint32_t e = begin; e < end; e++) {
+				const Key& entry = mEntryKeys[e];
+				std::uint32_t offset = static_cast<std::uint32_t>(entry.X - first.X);
+				if (offset < width && entry.Y == first.Y && entry.Z == first.Z) {
+					function(e);
+				}
+			}
+		}
+
+		float mCellSize;
+		float mInverseCellSize;
+		// Dense grids cover the points' bounds plus one cell all round, so every
+		// neighbouring cell of a point has its own bucket
+		bool mDense;
+		Key mMinimum;
+		Key mMaximum;
+		std::uint32_t mStrideY;
+		std::uint32_t mStrideZ;
+		std::uint32_t mTableSize;
+		// Bucket b holds mEntries[mBucketStart[b], mBucketStart[b + 1])
+		std::vector<std::uint32_t> mBucketStart;
+		std::vector<std::uint32_t> mEntries;
+		std::vector<Key> mEntryKeys;
+		std::vector<Key> mKeys;
+		std::vector<std::uint32_t> mBuckets;
+	};
+}
@@ -0,0 +1,365 @@
+#include "TerrainGenerator.h"
+#include "Random.h"
+#include "SimdMath.h"
+#include <algorithm>
+
+namespace Rendering {
+	const std::uint16_t TerrainGenerator::STONE = 1;
+	const std::uint16_t TerrainGenerator::DIRT = 2;
+	const std::uint16_t TerrainGenerator::GRASS = 3;
+
+	const float TerrainGenerator::HEIGHT_RANGE = 128.0f;
+	const float TerrainGenerator::HEIGHT_WAVELENGTH = 256.0f;
+	const std::uint32_t TerrainGenerator::HEIGHT_OCTAVES = 5;
+	const float TerrainGenerator::DENSITY_STRENGTH = 40.0f;
+	const float TerrainGenerator::DENSITY_WAVELENGTH = 32.0f;
+	const std::uint32_t TerrainGenerator::DENSITY_OCTAVES = 2;
+	const std::uint32_t TerrainGenerator::SAMPLE_SPACING = 4;
+	const std::uint32_t TerrainGenerator::DIRT_DEPTH = 3;
+
+	namespace {
+		const float LATTICE_PERIOD = 289.0f;
+		// fBm of gradient noise mostly stays well inside [-1, 1]; this spreads
+		// it over the range before it is clamped
+		const float HEIGHT_GAIN = 1.6f;
+		const float DENSITY_GAIN = 1.4f;
+
+		// x of each cell in a row, loaded a vector at a time
+		const float CELL_X[32] = {
+			0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f,
+			16.0f, 17.0f, 18.0f, 19.0f, 20.0f, 21.0f, 22.0f, 23.0f, 24.0f, 25.0f, 26.0f, 27.0f, 28.0f, 29.0f, 30.0f, 31.0f
+		};
+
+		template <typename V>
+		V Lerp(V a, V b, V t)
+		{
+			return a + (b - a) * t;
+		}
+
+		template <typename V>
+		V Fract(V x)
+		{
+			return x - Simd::Floor(x);
+		}
+
+		template <typename V>
+		V Mod289(V x)
+		{
+			return x - Simd::Floor(x * V::Set(1.0f / LATTICE_PERIOD)) * V::Set(LATTICE_PERIOD);
+		}
+
+		// Inputs below 578 keep every step an exact integer in a float
+		template <typename V>
+		V Permute(V x)
+		{
+			return Mod289((x * V::Set(34.0f) + V::Set(1.0f)) * x);
+		}
+
+		template <typename V>
+		V Fade(V t)
+		{
+			return t * t * t * (t * (t * V::Set(6.0f) - V::Set(15.0f)) + V::Set(10.0f));
+		}
+
+		// Approximates 1 / sqrt(r) for r near 0.7, which is where the squared
+		// lengths of the gradients below fall
+		template <typename V>
+		V InverseLength(V r)
+		{
+			return V::Set(1.79284291f) - V::Set(0.85373472f) * r;
+		}
+
+		// Dot product of (x, y) with a gradient picked by hash: 41 directions
+		// spread around the circle
+		template <typename V>
+		V Gradient(V hash, V x, V y)
+		{
+			V gx = Fract(hash * V::Set(1.0f / 41.0f)) * V::Set(2.0f) - V::Set(1.0f);
+			V gy = Simd::Abs(gx) - V::Set(0.5f);
+			gx = gx - Simd::Floor(gx + V::Set(0.5f));
+			return (gx * x + gy * y) * InverseLength(gx * gx + gy * gy);
+		}
+
+		// Dot product of (x, y, z) with a gradient picked by hash: 49 points of
+		// a square unfolded onto an octahedron
+		template <typename V>
+		V Gradient(V hash, V x, V y, V z)
+		{
+			V split = hash * V::Set(1.0f / 7.0f);
+			V gx = Fract(split) * V::Set(2.0f) - V::Set(1.0f);
+			V gy = Fract(Simd::Floor(split) * V::Set(1.0f / 7.0f)) * V::Set(2.0f) - V::Set(1.0f);
+			V gz = V::Set(1.0f) - Simd::Abs(gx) - Simd::Abs(gy);
+
+			// Points past the octahedron's equator fold over onto its lower half
+			typename V::Mask below = gz < V::Set(0.0f);
+			V signX = Simd::Select(gx < V::Set(0.0f), V::Set(-1.0f), V::Set(1.0f));
+			V signY = Simd::Select(gy < V::Set(0.0f), V::Set(-1.0f), V::Set(1.0f));
+			V foldX = (V::Set(1.0f) - Simd::Abs(gy)) * signX;
+			V foldY = (V::Set(1.0f) - Simd::Abs(gx)) * signY;
+			gx = Simd::Select(below, foldX, gx);
+			gy = Simd::Select(below, foldY, gy);
+			return (gx * x + gy * y + gz * z) * InverseLength(gx * gx + gy * gy + gz * gz);
+		}
+
+		// Gradient noise, roughly in [-1, 1]
+		template <typename V>
+		V Noise(V x, V y)
+		{
+			V cornerX = Simd::Floor(x);
+			V cornerY = Simd::Floor(y);
+			V fx = x - cornerX;
+			V fy = y - cornerY;
+			cornerX = Mod289(cornerX);
+			cornerY = Mod289(cornerY);
+
+			const V one = V::Set(1.0f);
+			V x0 = Permute(cornerX);
+			V x1 = Permute(cornerX + one);
+			V n00 = Gradient(Permute(x0 + cornerY), fx, fy);
+			V n10 = Gradient(Permute(x1 + cornerY), fx - one, fy);
+			V n01 = Gradient(Permute(x0 + cornerY + one), fx, fy - one);
+			V n11 = Gradient(Permute(x1 + cornerY + one), fx - one, fy - one);
+
+			V u = Fade(fx);
+			return Lerp(Lerp(n00, n10, u), Lerp(n01, n11, u), Fade(fy));
+		}
+
+		template <typename V>
+		V Noise(V x, V y, V z)
+		{
+			V cornerX = Simd::Floor(x);
+			V cornerY = Simd::Floor(y);
+			V cornerZ = Simd::Floor(z);
+			V fx = x - cornerX;
+			V fy = y - cornerY;
+			V fz = z - cornerZ;
+			cornerX = Mod289(cornerX);
+			cornerY = Mod289(cornerY);
+			cornerZ = Mod289(cornerZ);
+
+			const V one = V::Set(1.0f);
+			V x0 = Permute(cornerX);
+			V x1 = Permute(cornerX + one);
+			V x0y0 = Permute(x0 + cornerY);
+			V x1y0 = Permute(x1 + cornerY);
+			V x0y1 = Permute(x0 + cornerY + one);
+			V x1y1 = Permute(x1 + cornerY + one);
+			V n000 = Gradient(Permute(x0y0 + cornerZ), fx, fy, fz);
+			V n100 = Gradient(Permute(x1y0 + cornerZ), fx - one, fy, fz);
+			V n010 = Gradient(Permute(x0y1 + cornerZ), fx, fy - one, fz);
+			V n110 = Gradient(Permute(x1y1 + cornerZ), fx - one, fy - one, fz);
+			V n001 = Gradient(Permute(x0y0 + cornerZ + one), fx, fy, fz - one);
+			V n101 = Gradient(Permute(x1y0 + cornerZ + one), fx - one, fy, fz - one);
+			V n011 = Gradient(Permute(x0y1 + cornerZ + one), fx, fy - one, fz - one);
+			V n111 = Gradient(Permute(x1y1 + cornerZ + one), fx - one, fy - one, fz - one);
+
+			V u = Fade(fx);
+			V v = Fade(fy);
+			V near = Lerp(Lerp(n000, n100, u), Lerp(n010, n110, u), v);
+			V far = Lerp(Lerp(n001, n101, u), Lerp(n011, n111, u), v);
+			return Lerp(near, far, Fade(fz));
+		}
+
+		// Octaves of 2D noise, each twice the frequency and half the amplitude
+		// of the last, scaled and clamped to [-1, 1]
+		template <typename V>
+		V Fractal(V x, V z, float wavelength, const std::vector<float>& offsets, float gain)
+		{
+			V sum = V::Set(0.0f);
+			float frequency = 1.0f / wavelength;
+			float amplitude = 1.0f;
+			float total = 0.0f;
+			for (std::size_t octave = 0; octave * 2 < offsets.size(); octave++) {
+				V noise = Noise(x * V::Set(frequency) + V::Set(offsets[octave * 2]), z * V::Set(frequency) + V::Set(offsets[octave * 2 + 1]));
+				sum = sum + noise * V::Set(amplitude);
+				total += amplitude;
+				frequency *= 2.0f;
+				amplitude *= 0.5f;
+			}
+			sum = sum * V::Set(gain / total);
+			return Simd::Max(Simd::Min(sum, V::Set(1.0f)), V::Set(-1.0f));
+		}
+
+		template <typename V>
+		V Fractal(V x, V y, V z, float wavelength, const std::vector<float>& offsets, float gain)
+		{
+			V sum = V::Set(0.0f);
+			float frequency = 1.0f / wavelength;
+			float amplitude = 1.0f;
+			float total = 0.0f;
+			for (std::size_t octave = 0; octave * 3 < offsets.size(); octave++) {
+				V noise = Noise(x * V::Set(frequency) + V::Set(offsets[octave * 3]), y * V::Set(frequency) + V::Set(offsets[octave * 3 + 1]),
+					z * V::Set(frequency) + V::Set(offsets[octave * 3 + 2]));
+				sum = sum + noise * V::Set(amplitude);
+				total += amplitude;
+				frequency *= 2.0f;
+				amplitude *= 0.5f;
+			}
+			sum = sum * V::Set(gain / total);
+			return Simd::Max(Simd::Min(sum, V::Set(1.0f)), V::Set(-1.0f));
+		}
+	}
+
+	TerrainGenerator::TerrainGenerator(std::uint32_t seed, float baseHeight)
+		: mSeed(seed), mBaseHeight(baseHeight)
+	{
+		// Offsets anywhere in the lattice's period give unrelated terrain
+		Random heightRandom(seed, 0);
+		for (std::uint32_t i = 0; i < HEIGHT_OCTAVES * 2; i++) {
+			mHeightOffsets.push_back(heightRandom.NextRange(0.0f, LATTICE_PERIOD));
+		}
+		Random densityRandom(seed, 1);
+		for (std::uint32_t i = 0; i < DENSITY_OCTAVES * 3; i++) {
+			mDensityOffsets.push_back(densityRandom.NextRange(0.0f, LATTICE_PERIOD));
+		}
+	}
+
+	void TerrainGenerator::Generate(const ChunkKey& key, ChunkGrid& grid) const
+	{
+		typedef Simd::FloatN V;
+		const std::uint32_t size = ChunkGrid::SIZE;
+
+		std::vector<float> heights(size * size);
+		Heights(key, heights.data());
+		float lowest = *std::min_element(heights.begin(), heights.end());
+		float highest = *std::max_element(heights.begin(), heights.end());
+
+		// Cell y is solid below height + DENSITY_STRENGTH * noise. Layering
+		// looks at the DIRT_DEPTH + 1 cells above each cell, so those rows
+		// of the chunk above are needed too.
+		const std::uint32_t rows = size + DIRT_DEPTH + 1;
+		float bottom = static_cast<float>(key.Y * static_cast<std::int32_t>(size));
+		if (bottom >= highest + DENSITY_STRENGTH) {
+			grid.Fill(ChunkGrid::EMPTY_MATERIAL);
+			return;
+		}
+		if (bottom + rows <= lowest - DENSITY_STRENGTH) {
+			grid.Fill(STONE);
+			return;
+		}
+
+		const std::uint32_t samplesY = (rows - 1 + SAMPLE_SPACING - 1) / SAMPLE_SPACING + 1;
+		std::vector<float> lines((size / SAMPLE_SPACING + 1) * samplesY * size);
+		DensityLines(key, samplesY, lines.data());
+
+		// Solid cells of every row, blending the four lines around it
+		std::vector<std::uint32_t> solid(size * rows);
+		const float step = 1.0f / SAMPLE_SPACING;
+		for (std::uint32_t z = 0; z < size; z++) {
+			std::uint32_t lineZ = z / SAMPLE_SPACING;
+			V weightZ = V::Set((z % SAMPLE_SPACING) * step);
+			for (std::uint32_t y = 0; y < rows; y++) {
+				std::uint32_t lineY = y / SAMPLE_SPACING;
+				V weightY = V::Set((y % SAMPLE_SPACING) * step);
+				const float* line00 = &lines[(lineZ * samplesY + lineY) * size];
+				const float* line01 = line00 + size;
+				const float* line10 = line00 + samplesY * size;
+				const float* line11 = line10 + size;
+				V cellY = V::Set(bottom + y);
+
+				std::uint32_t row = 0;
+				for (std::uint32_t x = 0; x < size; x += V::Width) {
+					V noise = Lerp(Lerp(V::Load(line00 + x), V::Load(line01 + x), weightY), Lerp(V::Load(line10 + x), V::Load(line11 + x), weightY), weightZ);
+					V ground = V::Load(&heights[z * size + x]) + noise * V::Set(DENSITY_STRENGTH);
+					row |= static_cast<std::uint32_t>(Simd::BitMask(cellY < ground)) << x;
+				}
+				solid[z * rows + y] = row;
+			}
+		}
+
+		// Layer the materials a row at a time from the rows above
+		std::vector<std::uint16_t> materials(ChunkGrid::VOLUME, ChunkGrid::EMPTY_MATERIAL);
+		for (std::uint32_t z = 0; z < size; z++) {
+			for (std::uint32_t y = 0; y < size; y++) {
+				const std::uint32_t* column = &solid[z * rows + y];
+				std::uint32_t cells = column[0];
+				std::uint32_t grass = cells & ~column[1];
+				std::uint32_t covered = cells;
+				for (std::uint32_t depth = 1; depth <= DIRT_DEPTH + 1; depth++) {
+					covered &= column[depth];
+				}
+
+				std::uint16_t* row = &materials[(z * size + y) * size];
+				if (covered == 0xFFFFFFFFu) {
+					std::fill_n(row, size, STONE);
+					continue;
+				}
+				for (std::uint32_t x = 0; x < size; x++) {
+					std::uint32_t bit = 1u << x;
+					if ((cells & bit) != 0) {
+						row[x] = ((covered & bit) != 0 ? STONE : ((grass & bit) != 0 ? GRASS : DIRT));
+					}
+				}
+			}
+		}
+
+		grid.Assign(materials.data());
+	}
+
+	float TerrainGenerator::Height(float x, float z) const
+	{
+		Simd::Float1 height = Fractal(Simd::Float1::Set(x), Simd::Float1::Set(z), HEIGHT_WAVELENGTH, mHeightOffsets, HEIGHT_GAIN);
+		return mBaseHeight + 0.5f * HEIGHT_RANGE * (height.v + 1.0f);
+	}
+
+	std::uint32_t TerrainGenerator::Seed() const
+	{
+		return mSeed;
+	}
+
+	float TerrainGenerator::BaseHeight() const
+	{
+		return mBaseHeight;
+	}
+
+	void TerrainGenerator::Heights(const ChunkKey& key, float* heights) const
+	{
+		typedef Simd::FloatN V;
+		const std::uint32_t size = ChunkGrid::SIZE;
+		V cornerX = V::Set(static_cast<float>(key.X * static_cast<std::int32_t>(size)));
+		float cornerZ = static_cast<float>(key.Z * static_cast<std::int32_t>(size));
+		for (std::uint32_t z = 0; z < size; z++) {
+			for (std::uint32_t x = 0; x < size; x += V::Width) {
+				V height = Fractal(cornerX + V::Load(CELL_X + x), V::Set(cornerZ + z), HEIGHT_WAVELENGTH, mHeightOffsets, HEIGHT_GAIN);
+				(V::Set(mBaseHeight) + V::Set(0.5f * HEIGHT_RANGE) * (height + V::Set(1.0f))).Store(heights + z * size + x);
+			}
+		}
+	}
+
+	void TerrainGenerator::DensityLines(const ChunkKey& key, std::uint32_t samplesY, float* lines) const
+	{
+		typedef Simd::FloatN V;
+		const std::uint32_t size = ChunkGrid::SIZE;
+		const std::uint32_t samplesX = size / SAMPLE_SPACING + 1;
+		const std::uint32_t samplesZ = samplesX;
+		std::int32_t corner[3] = { key.X * static_cast<std::int32_t>(size), key.Y * static_cast<std::int32_t>(size), key.Z * static_cast<std::int32_t>(size) };
+
+		// Every lattice point of the chunk, padded to whole vectors
+		std::uint32_t count = samplesX * samplesY * samplesZ;
+		std::uint32_t padded = (count + V::Width - 1) / V::Width * V::Width;
+		std::vector<float> points(padded * 4, 0.0f);
+		float* pointX = points.data();
+		float* pointY = pointX + padded;
+		float* pointZ = pointY + padded;
+		float* samples = pointZ + padded;
+		for (std::uint32_t i = 0; i < count; i++) {
+			pointX[i] = static_cast<float>(corner[0] + static_cast<std::int32_t>(i % samplesX * SAMPLE_SPACING));
+			pointY[i] = static_cast<float>(corner[1] + static_cast<std::int32_t>(i / samplesX % samplesY * SAMPLE_SPACING));
+			pointZ[i] = static_cast<float>(corner[2] + static_cast<std::int32_t>(i / (samplesX * samplesY) * SAMPLE_SPACING));
+		}
+		for (std::uint32_t i = 0; i < padded; i += V::Width) {
+			Fractal(V::Load(pointX + i), V::Load(pointY + i), V::Load(pointZ + i), DENSITY_WAVELENGTH, mDensityOffsets, DENSITY_GAIN).Store(samples + i);
+		}
+
+		// Stretch each row of samples along x to one value per cell
+		const float step = 1.0f / SAMPLE_SPACING;
+		for (std::uint32_t line = 0; line < samplesY * samplesZ; line++) {
+			const float* sample = samples + line * samplesX;
+			for (std::uint32_t x = 0; x < size; x++) {
+				std::uint32_t left = x / SAMPLE_SPACING;
+				float weight = (x % SAMPLE_SPACING) * step;
+				lines[line * size + x] = sample[left] + (sample[left + 1] - sample[left]) * weight;
+			}
+		}
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ChunkGrid.h"
+#include "ChunkTable.h"
+#include <cstdint>
+#include <vector>
+
+namespace Rendering {
+	// Procedural terrain for VoxelWorld chunks. Every chunk is a pure function
+	// of the seed and its key, so the world comes out the same whichever
+	// threads generate it and in whatever order.
+	//
+	// A heightmap of HEIGHT_OCTAVES of 2D gradient noise sets the ground for
+	// each column, between the base height and HEIGHT_RANGE above it. Near the
+	// ground, DENSITY_OCTAVES of 3D gradient noise push it up or down by up to
+	// DENSITY_STRENGTH cells, which makes overhangs and arches. The 3D noise
+	// is sampled every SAMPLE_SPACING cells and interpolated in between, since
+	// that is all the detail its lowest frequency has. Solid cells with air
+	// above are GRASS, the DIRT_DEPTH cells under them DIRT and the rest STONE.
+	//
+	// Noise is evaluated SIMD-wide over SimdMath's float types. Lattice points
+	// are hashed with a permutation polynomial, (34x^2 + x) mod 289, which is
+	// exact in floats, so the vector code needs no integer arithmetic. The
+	// pattern repeats every 289 lattice cells of an octave, more than 70000
+	// cells for the lowest octave. Chunks wholly above or below the band the
+	// ground can reach are filled without evaluating any 3D noise.
+	//
+	// Generate() only reads the generator, so it can run on many threads at once.
+	class TerrainGenerator {
+	public:
+		explicit TerrainGenerator(std::uint32_t seed, float baseHeight = 0.0f);
+
+		// Fills a chunk, replacing whatever the grid held
+		void Generate(const ChunkKey& key, ChunkGrid& grid) const;
+		// Heightmap at the cell column (x, z), before the 3D noise moves it
+		float Height(float x, float z) const;
+
+		std::uint32_t Seed() const;
+		float BaseHeight() const;
+
+		static const std::uint16_t STONE;
+		static const std::uint16_t DIRT;
+		static const std::uint16_t GRASS;
+
+		// In cells
+		static const float HEIGHT_RANGE;
+		static const float HEIGHT_WAVELENGTH;
+		static const std::uint32_t HEIGHT_OCTAVES;
+		static const float DENSITY_STRENGTH;
+		static const float DENSITY_WAVELENGTH;
+		static const std::uint32_t DENSITY_OCTAVES;
+		static const std::uint32_t SAMPLE_SPACING;
+		static const std::uint32_t DIRT_DEPTH;
+
+	private:
+		// Heightmap of the chunk's columns, x fastest
+		void Heights(const ChunkKey& key, float* heights) const;
+		// 3D noise along each row of SAMPLE_SPACING lattice points in y and z,
+		// interpolated to every cell in x
+		void DensityLines(const ChunkKey& key, std::uint32_t samplesY, float* lines) const;
+
+		std::uint32_t mSeed;
+		float mBaseHeight;
+		// Lattice offsets drawn from the seed, x and z of each height octave
+		// and x, y and z of each density octave
+		std::vector<float> mHeightOffsets;
+		std::vector<float> mDensityOffsets;
+	};
+}
@@ -0,0 +1,468 @@
+#include "VoxelDag.h"
+#include "VoxelRay.h"
+#include <algorithm>
+
+namespace Rendering {
+	const std::uint32_t VoxelDag::EMPTY = 0xFFFFFFFF;
+	const std::uint32_t VoxelDag::BRICK_LEVELS = 2;
+	// Voxel corners are worked out in floats, which are exact up to 2^24
+	const std::uint32_t VoxelDag::MAX_LEVELS = 24;
+	const std::uint32_t VoxelDag::COMPACT_GROWTH = 4;
+	const std::size_t VoxelDag::COMPACT_MINIMUM = 1 << 16;
+
+	VoxelDag::VoxelDag(std::uint32_t levels)
+		: mLevels(std::min(std::max(levels, BRICK_LEVELS), MAX_LEVELS)), mHeight(mLevels - BRICK_LEVELS), mRoot(EMPTY), mCompactedSize(0)
+	{
+		Reset();
+	}
+
+	std::uint32_t VoxelDag::Levels() const
+	{
+		return mLevels;
+	}
+
+	std::uint32_t VoxelDag::Size() const
+	{
+		return 1u << mLevels;
+	}
+
+	bool VoxelDag::IsSolid(std::uint32_t x, std::uint32_t y, std::uint32_t z) const
+	{
+		if (x >= Size() || y >= Size() || z >= Size()) {
+			return false;
+		}
+
+		std::uint32_t node = mRoot;
+		for (std::uint32_t height = mHeight; height > 0 && node != EMPTY; height--) {
+			std::uint32_t shift = height + 1;
+			std::uint32_t child = ((x >> shift) & 1) | (((y >> shift) & 1) << 1) | (((z >> shift) & 1) << 2);
+			std::uint32_t mask = mNodes[node];
+			if ((mask & (1u << child)) == 0) {
+				return false;
+			}
+			node = mNodes[node + 1 + ChildCount(mask & ((1u << child) - 1))];
+		}
+
+		return node != EMPTY && ((mBricks[node] >> BrickBit(x & 3, y & 3, z & 3)) & 1) != 0;
+	}
+
+	void VoxelDag::Set(std::uint32_t x, std::uint32_t y, std::uint32_t z, bool solid)
+	{
+		if (x < Size() && y < Size() && z < Size()) {
+			mRoot = SetNode(mRoot, mHeight, x, y, z, solid);
+			CompactIfGrown();
+		}
+	}
+
+	void VoxelDag::Fill(const std::uint32_t minimum[3], const std::uint32_t maximum[3], bool solid)
+	{
+		const std::uint32_t base[3] = { 0, 0, 0 };
+		mRoot = FillNode(mRoot, mHeight, base, minimum, maximum, solid);
+		CompactIfGrown();
+	}
+
+	void VoxelDag::Clear()
+	{
+		Reset();
+		mRoot = EMPTY;
+		mCompactedSize = 0;
+	}
+
+	void VoxelDag::Compact()
+	{
+		// Copying from the root re-adds only what is still reachable, each
+		// subtree once
+		std::vector<std::uint32_t> nodes;
+		std::vector<std::uint64_t> bricks;
+		nodes.swap(mNodes);
+		bricks.swap(mBricks);
+		Reset();
+
+		std::vector<std::uint32_t> nodeMap(nodes.size(), EMPTY);
+		std::vector<std::uint32_t> brickMap(bricks.size(), EMPTY);
+		if (mRoot != EMPTY) {
+			mRoot = CopyNode(nodes, bricks, mRoot, mHeight, nodeMap, brickMap);
+		}
+		mNodes.shrink_to_fit();
+		mBricks.shrink_to_fit();
+		mCompactedSize = StorageSize();
+	}
+
+	bool VoxelDag::Raycast(const float origin[3], const float direction[3], float maxDistance, Hit& hit) const
+	{
+		if (mRoot == EMPTY) {
+			return false;
+		}
+
+		Walk walk;
+		walk.Origin = origin;
+		walk.Direction = direction;
+		VoxelRay::Inverse(direction, walk.Inverse);
+		walk.Order = (direction[0] < 0.0f ? 1 : 0) | (direction[1] < 0.0f ? 2 : 0) | (direction[2] < 0.0f ? 4 : 0);
+		walk.MaxDistance = maxDistance;
+
+		const float base[3] = { 0.0f, 0.0f, 0.0f };
+		const float size = static_cast<float>(Size());
+		const float maximum[3] = { size, size, size };
+		float enter;
+		float exit;
+		int axis;
+		if (!VoxelRay::Clip(origin, walk.Inverse, base, maximum, enter, exit, axis) || enter >= maxDistance) {
+			return false;
+		}
+
+		return (mHeight == 0 ? RaycastBrick(walk, mBricks[mRoot], base, hit) : RaycastNode(walk, mRoot, mHeight, base, hit));
+	}
+
+	std::uint64_t VoxelDag::SolidCount() const
+	{
+		// Shared subtrees are counted once and their count reused
+		std::unordered_map<std::uint32_t, std::uint64_t> counts;
+		return (mRoot != EMPTY ? CountNode(mRoot, mHeight, counts) : 0);
+	}
+
+	std::uint32_t VoxelDag::NodeCount() const
+	{
+		std::uint32_t count = 0;
+		for (const NodeLookup& lookup : mNodeLookup) {
+			count += static_cast<std::uint32_t>(lookup.size());
+		}
+		return count;
+	}
+
+	std::uint32_t VoxelDag::BrickCount() const
+	{
+		return static_cast<std::uint32_t>(mBricks.size());
+	}
+
+	std::size_t VoxelDag::MemoryBytes() const
+	{
+		std::size_t bytes = mNodes.capacity() * sizeof(std::uint32_t) + mBricks.capacity() * sizeof(std::uint64_t);
+		for (const NodeLookup& lookup : mNodeLookup) {
+			bytes += lookup.bucket_count() * sizeof(void*) + lookup.size() * (sizeof(std::uint32_t) + 2 * sizeof(void*));
+		}
+		bytes += mBrickLookup.bucket_count() * sizeof(void*) + mBrickLookup.size() * (sizeof(std::uint64_t) + 2 * sizeof(void*));
+		return bytes;
+	}
+
+	std::size_t VoxelDag::NodeHash::operator()(std::uint32_t node) const
+	{
+		const std::uint32_t* words = Nodes->data() + node;
+		int count = 1 + ChildCount(words[0]);
+		std::uint64_t hash = 14695981039346656037ull;
+		for (int w = 0; w < count; w++) {
+			hash = (hash ^ words[w]) * 1099511628211ull;
+		}
+		return static_cast<std::size_t>(hash ^ (hash >> 32));
+	}
+
+	bool VoxelDag::NodeEqual::operator()(std::uint32_t a, std::uint32_t b) const
+	{
+		const std::uint32_t* wordsA = Nodes->data() + a;
+		const std::uint32_t* wordsB = Nodes->data() + b;
+		return wordsA[0] == wordsB[0] && std::equal(wordsA + 1, wordsA + 1 + ChildCount(wordsA[0]), wordsB + 1);
+	}
+
+	std::uint32_t VoxelDag::BrickBit(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+	{
+		return x | (y << 2) | (z << 4);
+	}
+
+	int VoxelDag::ChildCount(std::uint32_t mask)
+	{
+		int count = 0;
+		for (; mask != 0; mask &= mask - 1) {
+			count++;
+		}
+		return count;
+	}
+
+	std::uint64_t VoxelDag::BrickMask(const std::uint32_t minimum[3], const std::uint32_t maximum[3])
+	{
+		std::uint64_t bits = 0;
+		for (std::uint32_t z = minimum[2]; z < maximum[2]; z++) {
+			for (std::uint32_t y = minimum[1]; y < maximum[1]; y++) {
+				for (std::uint32_t x = minimum[0]; x < maximum[0]; x++) {
+					bits |= 1ull << BrickBit(x, y, z);
+				}
+			}
+		}
+		return bits;
+	}
+
+	void VoxelDag::Reset()
+	{
+		mNodes.clear();
+		mBricks.clear();
+		NodeHash hash = { &mNodes };
+		NodeEqual equal = { &mNodes };
+		mNodeLookup.clear();
+		for (std::uint32_t height = 0; height <= mHeight; height++) {
+			mNodeLookup.push_back(NodeLookup(16, hash, equal));
+		}
+		mBrickLookup.clear();
+		mFull.assign(mHeight + 1, EMPTY);
+	}
+
+	std::size_t VoxelDag::StorageSize() const
+	{
+		return mNodes.size() + mBricks.size();
+	}
+
+	void VoxelDag::CompactIfGrown()
+	{
+		std::size_t size = StorageSize();
+		if (size > COMPACT_MINIMUM && size > COMPACT_GROWTH * mCompactedSize) {
+			Compact();
+		}
+	}
+
+	std::uint32_t VoxelDag::AddBrick(std::uint64_t bits)
+	{
+		if (bits == 0) {
+			return EMPTY;
+		}
+
+		auto found = mBrickLookup.find(bits);
+		if (found != mBrickLookup.end()) {
+			return found->second;
+		}
+
+		std::uint32_t brick = static_cast<std::uint32_t>(mBricks.size());
+		mBricks.push_back(bits);
+		mBrickLookup.emplace(bits, brick);
+		return brick;
+	}
+
+	std::uint32_t VoxelDag::AddNode(std::uint32_t height, const std::uint32_t children[8])
+	{
+		// The candidate is written at the end of the pool so the table can
+		// compare it in place, and taken off again if it is already there
+		std::uint32_t node = static_cast<std::uint32_t>(mNodes.size());
+		mNodes.push_back(0);
+		for (std::uint32_t c = 0; c < 8; c++) {
+			if (children[c] != EMPTY) {
+				mNodes[node] |= 1u << c;
+				mNodes.push_back(children[c]);
+			}
+		}
+		if (mNodes[node] == 0) {
+			mNodes.resize(node);
+			return EMPTY;
+		}
+
+		NodeLookup& lookup = mNodeLookup[height];
+		auto found = lookup.find(node);
+		if (found != lookup.end()) {
+			mNodes.resize(node);
+			return *found;
+		}
+
+		lookup.insert(node);
+		return node;
+	}
+
+	void VoxelDag::GetChildren(std::uint32_t node, std::uint32_t children[8]) const
+	{
+		std::uint32_t mask = (node != EMPTY ? mNodes[node] : 0);
+		std::uint32_t next = node + 1;
+		for (std::uint32_t c = 0; c < 8; c++) {
+			children[c] = ((mask >> c) & 1 ? mNodes[next++] : EMPTY);
+		}
+	}
+
+	std::uint32_t VoxelDag::Full(std::uint32_t height)
+	{
+		if (mFull[height] == EMPTY) {
+			if (height == 0) {
+				mFull[height] = AddBrick(~0ull);
+			}
+			else {
+				std::uint32_t child = Full(height - 1);
+				const std::uint32_t children[8] = { child, child, child, child, child, child, child, child };
+				mFull[height] = AddNode(height, children);
+			}
+		}
+		return mFull[height];
+	}
+
+	std::uint32_t VoxelDag::SetNode(std::uint32_t node, std::uint32_t height, std::uint32_t x, std::uint32_t y, std::uint32_t z, bool solid)
+	{
+		if (height == 0) {
+			std::uint64_t bits = (node != EMPTY ? mBricks[node] : 0);
+			std::uint64_t bit = 1ull << BrickBit(x & 3, y & 3, z & 3);
+			std::uint64_t changed = (solid ? bits | bit : bits & ~bit);
+			return (changed == bits ? node : AddBrick(changed));
+		}
+
+		std::uint32_t children[8];
+		GetChildren(node, children);
+		std::uint32_t shift = height + 1;
+		std::uint32_t c = ((x >> shift) & 1) | (((y >> shift) & 1) << 1) | (((z >> shift) & 1) << 2);
+		std::uint32_t child = SetNode(children[c], height - 1, x, y, z, solid);
+		if (child == children[c]) {
+			return node;
+		}
+
+		children[c] = child;
+		return AddNode(height, children);
+	}
+
+	std::uint32_t VoxelDag::FillNode(std::uint32_t node, std::uint32_t height, const std::uint32_t base[3], const std::uint32_t minimum[3],
+		const std::uint32_t maximum[3], bool solid)
+	{
+		std::uint32_t side = 4u << height;
+		bool inside = true;
+		for (int a = 0; a < 3; a++) {
+			if (base[a] >= maximum[a] || base[a] + side <= minimum[a]) {
+				return node;
+			}
+			inside = inside && minimum[a] <= base[a] && base[a] + side <= maximum[a];
+		}
+		if (inside) {
+			return (solid ? Full(height) : EMPTY);
+		}
+
+		if (height == 0) {
+			std::uint32_t low[3];
+			std::uint32_t high[3];
+			for (int a = 0; a < 3; a++) {
+				low[a] = std::max(minimum[a], base[a]) - base[a];
+				high[a] = std::min(maximum[a], base[a] + side) - base[a];
+			}
+			std::uint64_t bits = (node != EMPTY ? mBricks[node] : 0);
+			std::uint64_t box = BrickMask(low, high);
+			std::uint64_t changed = (solid ? bits | box : bits & ~box);
+			return (changed == bits ? node : AddBrick(changed));
+		}
+
+		std::uint32_t children[8];
+		GetChildren(node, children);
+		std::uint32_t half = side / 2;
+		bool same = true;
+		for (std::uint32_t c = 0; c < 8; c++) {
+			const std::uint32_t childBase[3] = { base[0] + (c & 1) * half, base[1] + ((c >> 1) & 1) * half, base[2] + (c >> 2) * half };
+			std::uint32_t child = FillNode(children[c], height - 1, childBase, minimum, maximum, solid);
+			same = same && child == children[c];
+			children[c] = child;
+		}
+
+		return (same ? node : AddNode(height, children));
+	}
+
+	std::uint32_t VoxelDag::CopyNode(const std::vector<std::uint32_t>& nodes, const std::vector<std::uint64_t>& bricks, std::uint32_t node,
+		std::uint32_t height, std::vector<std::uint32_t>& nodeMap, std::vector<std::uint32_t>& brickMap)
+	{
+		if (height == 0) {
+			if (brickMap[node] == EMPTY) {
+				brickMap[node] = AddBrick(bricks[node]);
+			}
+			return brickMap[node];
+		}
+
+		if (nodeMap[node] == EMPTY) {
+			std::uint32_t children[8];
+			std::uint32_t mask = nodes[node];
+			std::uint32_t next = node + 1;
+			for (std::uint32_t c = 0; c < 8; c++) {
+				children[c] = ((mask >> c) & 1 ? CopyNode(nodes, bricks, nodes[next++], height - 1, nodeMap, brickMap) : EMPTY);
+			}
+			nodeMap[node] = AddNode(height, children);
+		}
+		return nodeMap[node];
+	}
+
+	std::uint64_t VoxelDag::CountNode(std::uint32_t node, std::uint32_t height, std::unordered_map<std::uint32_t, std::uint64_t>& counts) const
+	{
+		if (height == 0) {
+			std::uint64_t count = 0;
+			for (std::uint64_t bits = mBricks[node]; bits != 0; bits &= bits - 1) {
+				count++;
+			}
+			return count;
+		}
+
+		auto found = counts.find(node);
+		if (found != counts.end()) {
+			return found->second;
+		}
+
+		std::uint32_t children[8];
+		GetChildren(node, children);
+		std::uint64_t count = 0;
+		for (std::uint32_t c = 0; c < 8; c++) {
+			count += (children[c] != EMPTY ? CountNode(children[c], height - 1, counts) : 0);
+		}
+		counts.emplace(node, count);
+		return count;
+	}
+
+	bool VoxelDag::RaycastNode(const Walk& walk, std::uint32_t node, std::uint32_t height, const float base[3], Hit& hit) const
+	{
+		std::uint32_t children[8];
+		GetChildren(node, children);
+		float half = static_cast<float>(2u << height);
+		for (std::uint32_t i = 0; i < 8; i++) {
+			std::uint32_t c = i ^ walk.Order;
+			if (children[c] == EMPTY) {
+				continue;
+			}
+
+			const float minimum[3] = { base[0] + (c & 1) * half, base[1] + ((c >> 1) & 1) * half, base[2] + (c >> 2) * half };
+			const float maximum[3] = { minimum[0] + half, minimum[1] + half, minimum[2] + half };
+			float enter;
+			float exit;
+			int axis;
+			if (!VoxelRay::Clip(walk.Origin, walk.Inverse, minimum, maximum, enter, exit, axis) || enter >= walk.MaxDistance) {
+				continue;
+			}
+
+			bool found = (height == 1
+				? RaycastBrick(walk, mBricks[children[c]], minimum, hit)
+				: RaycastNode(walk, children[c], height - 1, minimum, hit));
+			if (found) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool VoxelDag::RaycastBrick(const Walk& walk, std::uint64_t bits, const float base[3], Hit& hit) const
+	{
+		// The brick is walked as two more levels of octants, so the same order
+		// keeps the voxels front to back
+		for (std::uint32_t i = 0; i < 8; i++) {
+			std::uint32_t block = i ^ walk.Order;
+			const std::uint32_t corner[3] = { (block & 1) * 2, ((block >> 1) & 1) * 2, (block >> 2) * 2 };
+			const std::uint32_t end[3] = { corner[0] + 2, corner[1] + 2, corner[2] + 2 };
+			if ((bits & BrickMask(corner, end)) == 0) {
+				continue;
+			}
+
+			for (std::uint32_t j = 0; j < 8; j++) {
+				std::uint32_t v = j ^ walk.Order;
+				const std::uint32_t local[3] = { corner[0] + (v & 1), corner[1] + ((v >> 1) & 1), corner[2] + (v >> 2) };
+				if (((bits >> BrickBit(local[0], local[1], local[2])) & 1) == 0) {
+					continue;
+				}
+
+				const float minimum[3] = { base[0] + local[0], base[1] + local[1], base[2] + local[2] };
+				const float maximum[3] = { minimum[0] + 1.0f, minimum[1] + 1.0f, minimum[2] + 1.0f };
+				float enter;
+				float exit;
+				int axis;
+				if (VoxelRay::Clip(walk.Origin, walk.Inverse, minimum, maximum, enter, exit, axis) && enter < walk.MaxDistance) {
+					for (int a = 0; a < 3; a++) {
+						hit.Voxel[a] = static_cast<std::uint32_t>(minimum[a]);
+					}
+					hit.Distance = (enter > 0.0f ? enter : 0.0f);
+					VoxelRay::FaceNormal(walk.Direction, axis, hit.Normal);
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Rendering {
+	// Which cells of a cubic world 2^levels voxels on a side are solid, held as
+	// a sparse voxel octree in which identical subtrees are stored once, so a
+	// world that is mostly empty or mostly solid costs a small fraction of a
+	// bit per voxel.
+	//
+	// The bottom of the tree is bricks of 4x4x4 voxels, each a 64-bit mask.
+	// Above them, a node is a child mask followed by the indices of its
+	// non-empty children; empty subtrees are not stored at all. Every brick
+	// and node is looked up by content before it is added, so two regions that
+	// look the same share one subtree, and a region that is solid throughout
+	// is a single path of full nodes.
+	//
+	// Nodes are never changed once added. An edit builds new nodes along the
+	// path it touches and shares the rest, leaving the old path behind. Once
+	// the storage has grown COMPACT_GROWTH times past what was live at the
+	// last compaction, the edit compacts it, dropping what the root no longer
+	// reaches.
+	//
+	// Queries only read the tree, so they may run from several threads at once.
+	class VoxelDag {
+	public:
+		struct Hit {
+			std::uint32_t Voxel[3];
+			float Distance;
+			float Normal[3];
+		};
+
+		explicit VoxelDag(std::uint32_t levels);
+
+		std::uint32_t Levels() const;
+		// Voxels per side
+		std::uint32_t Size() const;
+
+		bool IsSolid(std::uint32_t x, std::uint32_t y, std::uint32_t z) const;
+		void Set(std::uint32_t x, std::uint32_t y, std::uint32_t z, bool solid);
+		// Sets every voxel from minimum up to but not including maximum; whole
+		// subtrees inside the box are replaced without visiting their voxels
+		void Fill(const std::uint32_t minimum[3], const std::uint32_t maximum[3], bool solid);
+		void Clear();
+		// Rebuilds the storage from what the root still reaches
+		void Compact();
+
+		// Finds the first solid voxel along the ray that is nearer than
+		// maxDistance. Voxel (x, y, z) is the unit cube from (x, y, z). Children
+		// are visited front to back, so the first hit found is the nearest.
+		bool Raycast(const float origin[3], const float direction[3], float maxDistance, Hit& hit) const;
+
+		// Calls function(x, y, z) for every solid voxel from minimum up to but
+		// not including maximum, skipping empty subtrees
+		template <typename Function>
+		void ForEachSolid(const std::uint32_t minimum[3], const std::uint32_t maximum[3], Function function) const
+		{
+			if (mRoot != EMPTY) {
+				const std::uint32_t base[3] = { 0, 0, 0 };
+				VisitSolid(mRoot, mHeight, base, minimum, maximum, function);
+			}
+		}
+
+		std::uint64_t SolidCount() const;
+		std::uint32_t NodeCount() const;
+		std::uint32_t BrickCount() const;
+		// Bytes held by the nodes, the bricks and the tables that look them up
+		// by content, the last estimated from their bucket and entry counts
+		std::size_t MemoryBytes() const;
+
+		static const std::uint32_t EMPTY;
+		static const std::uint32_t BRICK_LEVELS;
+		static const std::uint32_t MAX_LEVELS;
+		static const std::uint32_t COMPACT_GROWTH;
+		// Storage, in node words plus bricks, below which edits never compact
+		static const std::size_t COMPACT_MINIMUM;
+
+	private:
+		VoxelDag(const VoxelDag& rhs);
+		VoxelDag& operator=(const VoxelDag& rhs);
+
+		// Hashes and compares nodes in place in the node pool
+		struct NodeHash {
+			const std::vector<std::uint32_t>* Nodes;
+			std::size_t operator()(std::uint32_t node) const;
+		};
+
+		struct NodeEqual {
+			const std::vector<std::uint32_t>* Nodes;
+			bool operator()(std::uint32_t a, std::uint32_t b) const;
+		};
+
+		typedef std::unordered_set<std::uint32_t, NodeHash, NodeEqual> NodeLookup;
+
+		// A ray on its way down the tree. Visiting children in index order with
+		// the bits of the axes the ray runs down flipped never puts a child
+		// ahead of one in front of it.
+		struct Walk {
+			const float* Origin;
+			const float* Direction;
+			float Inverse[3];
+			std::uint32_t Order;
+			float MaxDistance;
+		};
+
+		static std::uint32_t BrickBit(std::uint32_t x, std::uint32_t y, std::uint32_t z);
+		static int ChildCount(std::uint32_t mask);
+		// Which brick bits lie from minimum up to but not including maximum,
+		// in brick-local coordinates
+		static std::uint64_t BrickMask(const std::uint32_t minimum[3], const std::uint32_t maximum[3]);
+
+		void Reset();
+		std::size_t StorageSize() const;
+		void CompactIfGrown();
+		std::uint32_t AddBrick(std::uint64_t bits);
+		std::uint32_t AddNode(std::uint32_t height, const std::uint32_t children[8]);
+		void GetChildren(std::uint32_t node, std::uint32_t children[8]) const;
+		std::uint32_t Full(std::uint32_t height);
+		std::uint32_t SetNode(std::uint32_t node, std::uint32_t height, std::uint32_t x, std::uint32_t y, std::uint32_t z, bool solid);
+		std::uint32_t FillNode(std::uint32_t node, std::uint32_t height, const std::uint32_t base[3], const std::uint32_t minimum[3],
+			const std::uint32_t maximum[3], bool solid);
+		std::uint32_t CopyNode(const std::vector<std::uint32_t>& nodes, const std::vector<std::uint64_t>& bricks, std::uint32_t node,
+			std::uint32_t height, std::vector<std::uint32_t>& nodeMap, std::vector<std::uint32_t>& brickMap);
+		std::uint64_t CountNode(std::uint32_t node, std::uint32_t height, std::unordered_map<std::uint32_t, std::uint64_t>& counts) const;
+		bool RaycastNode(const Walk& walk, std::uint32_t node, std::uint32_t height, const float base[3], Hit& hit) const;
+		bool RaycastBrick(const Walk& walk, std::uint64_t bits, const float base[3], Hit& hit) const;
+
+		template <typename Function>
+		void VisitSolid(std::uint32_t node, std::uint32_t height, const std::uint32_t base[3], const std::uint32_t minimum[3],
+			const std::uint32_t maximum[3], Function& function) const
+		{
+			std::uint32_t side = 4u << height;
+			for (int a = 0; a < 3; a++) {
+				if (base[a] >= maximum[a] || base[a] + side <= minimum[a]) {
+					return;
+				}
+			}
+
+			if (height == 0) {
+				std::uint64_t bits = mBricks[node];
+				for (; bits != 0; bits &= bits - 1) {
+					std::uint32_t bit = 0;
+					while (((bits >> bit) & 1) == 0) {
+						bit++;
+					}
+					const std::uint32_t voxel[3] = { base[0] + (bit & 3), base[1] + ((bit >> 2) & 3), base[2] + (bit >> 4) };
+					if (voxel[0] >= minimum[0] && voxel[0] < maximum[0] && voxel[1] >= minimum[1] && voxel[1] < maximum[1]
+						&& voxel[2] >= minimum[2] && voxel[2] < maximum[2]) {
+						function(voxel[0], voxel[1], voxel[2]);
+					}
+				}
+				return;
+			}
+
+			std::uint32_t children[8];
+			GetChildren(node, children);
+			std::uint32_t half = side / 2;
+			for (std::uint32_t c = 0; c < 8; c++) {
+				if (children[c] != EMPTY) {
+					const std::uint32_t childBase[3] = { base[0] + (c & 1) * half, base[1] + ((c >> 1) & 1) * half, base[2] + (c >> 2) * half };
+					VisitSolid(children[c], height - 1, childBase, minimum, maximum, function);
+				}
+			}
+		}
+
+		std::uint32_t mLevels;
+		// Height of the root above the bricks
+		std::uint32_t mHeight;
+		std::uint32_t mRoot;
+		std::vector<std::uint32_t> mNodes;
+		std::vector<std::uint64_t> mBricks;
+		// One table per height, since a node's child indices mean different
+		// things at different heights
+		std::vector<NodeLookup> mNodeLookup;
+		std::unordered_map<std::uint64_t, std::uint32_t> mBrickLookup;
+		// The all-solid subtree of each height, once it has been needed
+		std::vector<std::uint32_t> mFull;
+		// Storage left by the last compaction
+		std::size_t mCompactedSize;
+	};
+}
@@ -0,0 +1,159 @@
+#include "VoxelIntegrator.h"
+#include "VoxelStore.h"
+#include "SimdMath.h"
+#include <cmath>
+
+namespace Rendering {
+	const float VoxelIntegrator::TOLERANCE = 1e-4f;
+
+	namespace {
+		template <typename V>
+		int IntegrateBlock(VoxelStore& store, std::uint32_t i, V time, V rotFalloff, V decay)
+		{
+			typename V::Mask moving = V::LoadMask(store.Moving() + i);
+			if (!Simd::Any(moving)) {
+				return 0;
+			}
+
+			// Turn by the angular velocity over this step: the step rotation is the
+			// quaternion (axis * sin(angle / 2), cos(angle / 2)), applied in world space
+			V wx = V::Load(store.AngularX() + i);
+			V wy = V::Load(store.AngularY() + i);
+			V wz = V::Load(store.AngularZ() + i);
+			V halfTime = time * V::Set(0.5f);
+			V speed = Simd::Sqrt(wx * wx + wy * wy + wz * wz);
+			V sine, cosine;
+			Simd::SinCos(speed * halfTime, sine, cosine);
+			V k = Simd::Select(speed > V::Set(1e-6f), sine / speed, halfTime);
+			V dx = wx * k;
+			V dy = wy * k;
+			V dz = wz * k;
+
+			V qx = V::Load(store.OrientationX() + i);
+			V qy = V::Load(store.OrientationY() + i);
+			V qz = V::Load(store.OrientationZ() + i);
+			V qw = V::Load(store.OrientationW() + i);
+			V nx = cosine * qx + qw * dx + dy * qz - dz * qy;
+			V ny = cosine * qy + qw * dy + dz * qx - dx * qz;
+			V nz = cosine * qz + qw * dz + dx * qy - dy * qx;
+			V nw = cosine * qw - dx * qx - dy * qy - dz * qz;
+			V scale = V::Set(1.0f) / Simd::Sqrt(nx * nx + ny * ny + nz * nz + nw * nw);
+			Simd::Select(moving, nx * scale, qx).Store(store.OrientationX() + i);
+			Simd::Select(moving, ny * scale, qy).Store(store.OrientationY() + i);
+			Simd::Select(moving, nz * scale, qz).Store(store.OrientationZ() + i);
+			Simd::Select(moving, nw * scale, qw).Store(store.OrientationW() + i);
+
+			Simd::Select(moving, wx * rotFalloff, wx).Store(store.AngularX() + i);
+			Simd::Select(moving, wy * rotFalloff, wy).Store(store.AngularY() + i);
+			Simd::Select(moving, wz * rotFalloff, wz).Store(store.AngularZ() + i);
+
+			V vx = V::Load(store.VelocityX() + i);
+			V vy = V::Load(store.VelocityY() + i);
+			V vz = V::Load(store.VelocityZ() + i);
+			V gravity = V::Load(store.Gravity() + i);
+			V ox = V::Load(store.OriginX() + i);
+			V oy = V::Load(store.OriginY() + i);
+			V oz = V::Load(store.OriginZ() + i);
+
+			// Gravity is an acceleration; decay acts as drag and caps the fall speed
+			vy = Simd::Select(moving, vy + gravity * time, vy);
+			Simd::Select(moving, ox + vx * time, ox).Store(store.OriginX() + i);
+			Simd::Select(moving, oy + vy * time, oy).Store(store.OriginY() + i);
+			Simd::Select(moving, oz + vz * time, oz).Store(store.OriginZ() + i);
+
+			Simd::Select(moving, vx * decay, vx).Store(store.VelocityX() + i);
+			Simd::Select(moving, vy * decay, vy).Store(store.VelocityY() + i);
+			Simd::Select(moving, vz * decay, vz).Store(store.VelocityZ() + i);
+
+			return Simd::Count(moving);
+		}
+	}
+
+	std::uint32_t VoxelIntegrator::Integrate(VoxelStore& store, std::uint32_t first, std::uint32_t last, double elapsed)
+	{
+		const float time = static_cast<float>(elapsed * VoxelStore::TIME_FACTOR);
+		const float rotFalloff = VoxelStore::DECAY_FACTOR * VoxelStore::DECAY_FACTOR * VoxelStore::DECAY_FACTOR;
+		const float decay = VoxelStore::DECAY_FACTOR;
+
+		typedef Simd::FloatN V;
+		std::uint32_t moving = 0;
+		std::uint32_t i = first;
+		for (; i + V::Width <= last; i += V::Width) {
+			moving += IntegrateBlock<V>(store, i, V::Set(time), V::Set(rotFalloff), V::Set(decay));
+		}
+		for (; i < last; i++) {
+			moving += IntegrateBlock<Simd::Float1>(store, i, Simd::Float1::Set(time), Simd::Float1::Set(rotFalloff), Simd::Float1::Set(decay));
+		}
+
+		return moving;
+	}
+
+	std::uint32_t VoxelIntegrator::IntegrateScalar(VoxelStore& store, std::uint32_t first, std::uint32_t last, double elapsed)
+	{
+		const float time = static_cast<float>(elapsed * VoxelStore::TIME_FACTOR);
+		const float rotFalloff = VoxelStore::DECAY_FACTOR * VoxelStore::DECAY_FACTOR * VoxelStore::DECAY_FACTOR;
+		const float decay = VoxelStore::DECAY_FACTOR;
+
+		float* originX = store.OriginX();
+		float* originY = store.OriginY();
+		float* originZ = store.OriginZ();
+		float* velocityX = store.VelocityX();
+		float* velocityY = store.VelocityY();
+		float* velocityZ = store.VelocityZ();
+		const float* gravity = store.Gravity();
+		float* angularX = store.AngularX();
+		float* angularY = store.AngularY();
+		float* angularZ = store.AngularZ();
+		float* orientationX = store.OrientationX();
+		float* orientationY = store.OrientationY();
+		float* orientationZ = store.OrientationZ();
+		float* orientationW = store.OrientationW();
+		const std::uint8_t* moving = store.Moving();
+		std::uint32_t advanced = 0;
+
+		for (std::uint32_t i = first; i < last; i++) {
+			if (!moving[i]) {
+				continue;
+			}
+			advanced++;
+
+			// Rotate about the angular velocity axis by speed * time, in world space
+			float speed = std::sqrt(angularX[i] * angularX[i] + angularY[i] * angularY[i] + angularZ[i] * angularZ[i]);
+			float halfAngle = speed * time * 0.5f;
+			float k = (speed > 1e-6f ? std::sin(halfAngle) / speed : time * 0.5f);
+			float c = std::cos(halfAngle);
+			float dx = angularX[i] * k;
+			float dy = angularY[i] * k;
+			float dz = angularZ[i] * k;
+
+			float qx = orientationX[i];
+			float qy = orientationY[i];
+			float qz = orientationZ[i];
+			float qw = orientationW[i];
+			float nx = c * qx + qw * dx + dy * qz - dz * qy;
+			float ny = c * qy + qw * dy + dz * qx - dx * qz;
+			float nz = c * qz + qw * dz + dx * qy - dy * qx;
+			float nw = c * qw - dx * qx - dy * qy - dz * qz;
+			float scale = 1.0f / std::sqrt(nx * nx + ny * ny + nz * nz + nw * nw);
+			orientationX[i] = nx * scale;
+			orientationY[i] = ny * scale;
+			orientationZ[i] = nz * scale;
+			orientationW[i] = nw * scale;
+
+			angularX[i] *= rotFalloff;
+			angularY[i] *= rotFalloff;
+			angularZ[i] *= rotFalloff;
+
+			velocityY[i] += gravity[i] * time;
+			originX[i] += velocityX[i] * time;
+			originY[i] += velocityY[i] * time;
+			originZ[i] += velocityZ[i] * time;
+
+			velocityX[i] *= decay;
+			velocityY[i] *= decay;
+			velocityZ[i] *= decay;
+		}
+
+		return advanced;
+	}
+}
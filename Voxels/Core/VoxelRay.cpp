@@ -0,0 +1,130 @@
+#include "VoxelRay.h"
+#include "SimdMath.h"
+
+namespace Rendering {
+	namespace VoxelRay {
+		namespace {
+			template <typename V>
+			struct RayLanes {
+				V Origin[3];
+				V Inverse[3];
+			};
+
+			// Entry distance of the ray into each lane's cube, clamped to zero,
+			// and whether it hits at all
+			template <typename V>
+			typename V::Mask HitBlock(const RayLanes<V>& ray, const float* x, const float* y, const float* z, const float* half, std::uint32_t i, V& enter)
+			{
+				const float* centres[3] = { x + i, y + i, z + i };
+				V h = V::Load(half + i);
+				V exit = V::Set(PARALLEL);
+				enter = V::Set(0.0f);
+				for (int a = 0; a < 3; a++) {
+					V centre = V::Load(centres[a]);
+					V low = (centre - h - ray.Origin[a]) * ray.Inverse[a];
+					V high = (centre + h - ray.Origin[a]) * ray.Inverse[a];
+					enter = Simd::Max(enter, Simd::Min(low, high));
+					exit = Simd::Min(exit, Simd::Max(low, high));
+				}
+
+				return enter <= exit;
+			}
+
+			template <typename V>
+			RayLanes<V> MakeRay(const float origin[3], const float direction[3])
+			{
+				float inverse[3];
+				Inverse(direction, inverse);
+				RayLanes<V> ray;
+				for (int a = 0; a < 3; a++) {
+					ray.Origin[a] = V::Set(origin[a]);
+					ray.Inverse[a] = V::Set(inverse[a]);
+				}
+				return ray;
+			}
+		}
+
+		std::uint32_t NearestBox(const float origin[3], const float direction[3], const float* x, const float* y, const float* z, const float* half,
+			std::uint32_t first, std::uint32_t last, float maxDistance, float& distance)
+		{
+			typedef Simd::FloatN V;
+			const int width = V::Width;
+			const float lanes[16] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f };
+			RayLanes<V> ray = MakeRay<V>(origin, direction);
+
+			// Each lane keeps its own nearest hit; a later cube only replaces it
+			// when strictly nearer, so within a lane ties keep the lower index.
+			// Indices are carried as floats, which is exact below 2^24.
+			V bestA = V::Set(maxDistance);
+			V bestB = bestA;
+			V indexA = V::Set(0.0f);
+			V indexB = indexA;
+			V laneA = V::Load(lanes);
+			V laneB = V::Load(lanes + width);
+			std::uint32_t i = first;
+			for (; i + 2 * width <= last; i += 2 * width) {
+				V enterA;
+				V enterB;
+				typename V::Mask hitA = HitBlock(ray, x, y, z, half, i, enterA);
+				typename V::Mask hitB = HitBlock(ray, x, y, z, half, i + width, enterB);
+				hitA = hitA & (enterA < bestA);
+				hitB = hitB & (enterB < bestB);
+				V base = V::Set(static_cast<float>(i - first));
+				bestA = Simd::Select(hitA, enterA, bestA);
+				bestB = Simd::Select(hitB, enterB, bestB);
+				indexA = Simd::Select(hitA, base + laneA, indexA);
+				indexB = Simd::Select(hitB, base + laneB, indexB);
+			}
+
+			float bests[32];
+			float indices[32];
+			bestA.Store(bests);
+			bestB.Store(bests + width);
+			indexA.Store(indices);
+			indexB.Store(indices + width);
+
+			std::uint32_t nearest = last;
+			distance = maxDistance;
+			for (int lane = 0; lane < 2 * width; lane++) {
+				std::uint32_t index = first + static_cast<std::uint32_t>(indices[lane]);
+				if (bests[lane] < distance || (bests[lane] == distance && bests[lane] < maxDistance && index < nearest)) {
+					distance = bests[lane];
+					nearest = index;
+				}
+			}
+
+			// The tail goes through the same arithmetic one cube at a time
+			RayLanes<Simd::Float1> single = MakeRay<Simd::Float1>(origin, direction);
+			for (; i < last; i++) {
+				Simd::Float1 enter;
+				if (HitBlock(single, x, y, z, half, i, enter).v && enter.v < distance) {
+					distance = enter.v;
+					nearest = i;
+				}
+			}
+
+			return nearest;
+		}
+
+		std::uint32_t NearestBoxScalar(const float origin[3], const float direction[3], const float* x, const float* y, const float* z, const float* half,
+			std::uint32_t first, std::uint32_t last, float maxDistance, float& distance)
+		{
+			float inverse[3];
+			Inverse(direction, inverse);
+
+			std::uint32_t nearest = last;
+			distance = maxDistance;
+			for (std::uint32_t i = first; i < last; i++) {
+				const float centre[3] = { x[i], y[i], z[i] };
+				float enter;
+				int axis;
+				if (HitBox(origin, inverse, centre, half[i], enter, axis) && enter < distance) {
+					distance = enter;
+					nearest = i;
+				}
+			}
+
+			return nearest;
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Rendering {
+	// Result of casting a ray into the voxels. Distance is measured along the
+	// ray in units of its direction's length; Normal is the face the ray came
+	// in through.
+	struct RayHit {
+		std::uint32_t Id;
+		float Distance;
+		float Normal[3];
+	};
+
+	// One ray of a batch; distances come out in units of the direction's length
+	struct Ray {
+		float Origin[3];
+		float Direction[3];
+	};
+
+	namespace VoxelRay {
+		// Stands in for the reciprocal of a zero direction component, so the slab
+		// arithmetic stays finite
+		const float PARALLEL = 1e30f;
+
+		inline void Inverse(const float direction[3], float inverse[3])
+		{
+			for (int a = 0; a < 3; a++) {
+				inverse[a] = (direction[a] != 0.0f ? 1.0f / direction[a] : (direction[a] < 0.0f ? -PARALLEL : PARALLEL));
+			}
+		}
+
+		// Slab test of a ray against the box from minimum to maximum. On a hit,
+		// enter and exit are where the ray is inside the box and axis is the axis
+		// of the face it enters through.
+		inline bool Clip(const float origin[3], const float inverse[3], const float minimum[3], const float maximum[3], float& enter, float& exit, int& axis)
+		{
+			enter = -PARALLEL;
+			exit = PARALLEL;
+			axis = 0;
+			for (int a = 0; a < 3; a++) {
+				float low = (minimum[a] - origin[a]) * inverse[a];
+				float high = (maximum[a] - origin[a]) * inverse[a];
+				if (low > high) {
+					float swap = low;
+					low = high;
+					high = swap;
+				}
+				if (low > enter) {
+					enter = low;
+					axis = a;
+				}
+				exit = (high < exit ? high : exit);
+			}
+
+			return enter <= exit && exit >= 0.0f;
+		}
+
+		// Cube of half extent half around centre. A ray that starts inside hits
+		// at zero.
+		inline bool HitBox(const float origin[3], const float inverse[3], const float centre[3], float half, float& distance, int& axis)
+		{
+			const float minimum[3] = { centre[0] - half, centre[1] - half, centre[2] - half };
+			const float maximum[3] = { centre[0] + half, centre[1] + half, centre[2] + half };
+			float exit;
+			if (!Clip(origin, inverse, minimum, maximum, distance, exit, axis)) {
+				return false;
+			}
+
+			distance = (distance > 0.0f ? distance : 0.0f);
+			return true;
+		}
+
+		// Outward normal of the face on axis that a ray along direction enters
+		inline void FaceNormal(const float direction[3], int axis, float normal[3])
+		{
+			normal[0] = normal[1] = normal[2] = 0.0f;
+			normal[axis] = (direction[axis] > 0.0f ? -1.0f : 1.0f);
+		}
+
+		// Nearest of the cubes [first, last), given as structure-of-arrays centres
+		// and half extents, that the ray hits closer than maxDistance. Returns its
+		// index and sets distance, or returns last on a miss; ties go to the lower
+		// index.
+		//
+		// NearestBox slab-tests two registers of cubes per iteration, 16 with
+		// AVX2 (8 with SSE2), keeping the nearest hit per lane and reducing the
+		// lanes at the end. NearestBoxScalar is the plain reference version; the
+		// two give the same result.
+		std::uint32_t NearestBox(const float origin[3], const float direction[3], const float* x, const float* y, const float* z, const float* half,
+			std::uint32_t first, std::uint32_t last, float maxDistance, float& distance);
+		std::uint32_t NearestBoxScalar(const float origin[3], const float direction[3], const float* x, const float* y, const float* z, const float* half,
+			std::uint32_t first, std::uint32_t last, float maxDistance, float& distance);
+	}
+}
@@ -0,0 +1,442 @@
+#include "VoxelStore.h"
+#include "VoxelIntegrator.h"
+#include "SimdMath.h"
+#include <cmath>
+#include <cstring>
+
+namespace Rendering {
+	const float VoxelStore::DECAY_FACTOR = 0.98f;
+	const float VoxelStore::TIME_FACTOR = 5.0f;
+	const float VoxelStore::SCALE_FACTOR = 0.5f;
+	const float VoxelStore::GRAVITY = -9.81f;
+	const float VoxelStore::BLAST_LENGTH = 5.0f;
+	const float VoxelStore::BLAST_DISPLACEMENT = 5.0f;
+	// The random displacement moves the centre by up to sqrt(3) times its
+	// range; rounded up a little so float error never misses a voxel
+	const float VoxelStore::BLAST_REACH = BLAST_LENGTH / SCALE_FACTOR + BLAST_DISPLACEMENT * 1.7320508f + 0.01f;
+	const float VoxelStore::SLEEP_DRIFT = 0.05f;
+	const float VoxelStore::SLEEP_ROTATION = 0.01f;
+	const std::uint8_t VoxelStore::SLEEP_FRAMES = 30;
+	const std::uint32_t VoxelStore::INVALID_SLOT = 0xFFFFFFFF;
+
+	VoxelStore::VoxelStore()
+		: mCount(0), mActiveCount(0), mSleepCounter(0)
+	{
+	}
+
+	VoxelStore::~VoxelStore()
+	{
+	}
+
+	template <typename Function>
+	void VoxelStore::ForEachArray(Function function)
+	{
+		function(mOriginX);
+		function(mOriginY);
+		function(mOriginZ);
+		function(mVelocityX);
+		function(mVelocityY);
+		function(mVelocityZ);
+		function(mGravity);
+		function(mAngularX);
+		function(mAngularY);
+		function(mAngularZ);
+		function(mOrientationX);
+		function(mOrientationY);
+		function(mOrientationZ);
+		function(mOrientationW);
+		function(mPreviousOriginX);
+		function(mPreviousOriginY);
+		function(mPreviousOriginZ);
+		function(mPreviousOrientationX);
+		function(mPreviousOrientationY);
+		function(mPreviousOrientationZ);
+		function(mPreviousOrientationW);
+		function(mSize);
+		function(mMoving);
+		function(mContact);
+		function(mDebris);
+		function(mLaunchTime);
+		function(mRestFrames);
+		function(mRestX);
+		function(mRestY);
+		function(mRestZ);
+		function(mIds);
+	}
+
+	std::uint32_t VoxelStore::Add(float x, float y, float z, float size)
+	{
+		std::uint32_t index = mCount++;
+		std::uint32_t id;
+		if (!mFreeIds.empty()) {
+			id = mFreeIds.back();
+			mFreeIds.pop_back();
+		}
+		else {
+			id = static_cast<std::uint32_t>(mSlots.size());
+			mSlots.push_back(INVALID_SLOT);
+			mSleepStamps.push_back(0);
+		}
+
+		// New voxels start asleep, at the end of the sleeping partition
+		ForEachArray([index](auto& array) { array.Resize(index + 1); });
+		mOriginX[index] = x;
+		mOriginY[index] = y;
+		mOriginZ[index] = z;
+		mPreviousOriginX[index] = x;
+		mPreviousOriginY[index] = y;
+		mPreviousOriginZ[index] = z;
+		mOrientationW[index] = 1.0f;
+		mPreviousOrientationW[index] = 1.0f;
+		mSize[index] = size;
+		mIds[index] = id;
+		mSlots[id] = index;
+		LogSleep(index);
+
+		return id;
+	}
+
+	std::uint32_t VoxelStore::AddDebris(float x, float y, float z, float size, const float orientation[4], float launchTime)
+	{
+		std::uint32_t id = Add(x, y, z, size);
+		std::uint32_t index = mSlots[id];
+		mOrientationX[index] = orientation[0];
+		mOrientationY[index] = orientation[1];
+		mOrientationZ[index] = orientation[2];
+		mOrientationW[index] = orientation[3];
+		SavePrevious(index, index + 1);
+		mDebris[index] = 1;
+		mLaunchTime[index] = launchTime;
+
+		return id;
+	}
+
+	void VoxelStore::Reserve(std::uint32_t capacity)
+	{
+		ForEachArray([capacity](auto& array) { array.Reserve(capacity); });
+		mSlots.reserve(capacity);
+		mSleepStamps.reserve(capacity);
+	}
+
+	void VoxelStore::Clear()
+	{
+		mCount = 0;
+		mActiveCount = 0;
+		ForEachArray([](auto& array) { array.Clear(); });
+		mSlots.clear();
+		mFreeIds.clear();
+		mSleepStamps.clear();
+		mSleepLog.clear();
+	}
+
+	std::uint32_t VoxelStore::Count() const
+	{
+		return mCount;
+	}
+
+	std::uint32_t VoxelStore::ActiveCount() const
+	{
+		return mActiveCount;
+	}
+
+	std::uint32_t VoxelStore::SleepingCount() const
+	{
+		return mCount - mActiveCount;
+	}
+
+	std::uint32_t VoxelStore::SleepStamp(std::uint32_t id) const
+	{
+		// Ids from before a Clear() read as awake
+		return (id < mSleepStamps.size() ? mSleepStamps[id] : 0);
+	}
+
+	const std::vector<VoxelStore::SleepRecord>& VoxelStore::SleepLog() const
+	{
+		return mSleepLog;
+	}
+
+	void VoxelStore::ClearSleepLog()
+	{
+		mSleepLog.clear();
+	}
+
+	std::uint32_t VoxelStore::Id(std::uint32_t index) const
+	{
+		return mIds[index];
+	}
+
+	std::uint32_t VoxelStore::Slot(std::uint32_t id) const
+	{
+		return (id < mSlots.size() ? mSlots[id] : INVALID_SLOT);
+	}
+
+	void VoxelStore::Remove(std::uint32_t index)
+	{
+		// Only the last slot of each partition is moved, so callers walking the
+		// store downwards may keep going after removing the voxel at index
+		if (index < mActiveCount) {
+			mActiveCount--;
+			Swap(index, mActiveCount);
+			index = mActiveCount;
+		}
+		mCount--;
+		Swap(index, mCount);
+
+		std::uint32_t id = mIds[mCount];
+		mSlots[id] = INVALID_SLOT;
+		mSleepStamps[id] = 0;
+		mFreeIds.push_back(id);
+		ForEachArray([this](auto& array) { array.Resize(mCount); });
+	}
+
+	void VoxelStore::SetAngularVelocity(std::uint32_t index, float x, float y, float z)
+	{
+		mAngularX[index] = x;
+		mAngularY[index] = y;
+		mAngularZ[index] = z;
+	}
+
+	void VoxelStore::SetLaunchTime(std::uint32_t index, float time)
+	{
+		mLaunchTime[index] = time;
+	}
+
+	bool VoxelStore::SetMotionVector(std::uint32_t index, float x, float y, float z, Random& random)
+	{
+		float adjX = (mOriginX[index] - x + GetRandomDisplacement(random)) * SCALE_FACTOR;
+		float adjY = (mOriginY[index] - y + GetRandomDisplacement(random)) * SCALE_FACTOR;
+		float adjZ = (mOriginZ[index] - z + GetRandomDisplacement(random)) * SCALE_FACTOR;
+		float length = std::sqrt(adjX * adjX + adjY * adjY + adjZ * adjZ);
+		if (length >= BLAST_LENGTH) {
+			return false;
+		}
+
+		mVelocityX[index] = adjX;
+		mVelocityY[index] = adjY;
+		mVelocityZ[index] = adjZ;
+		mGravity[index] = GRAVITY;
+		mDebris[index] = 1;
+		mMoving[index] = 1;
+		mRestFrames[index] = 0;
+		return true;
+	}
+
+	void VoxelStore::Wake(std::uint32_t index)
+	{
+		// Swapping with the first sleeper only disturbs slots at or before index,
+		// so callers may keep walking the store upwards while waking voxels
+		mMoving[index] = 1;
+		mRestFrames[index] = 0;
+		if (index >= mActiveCount) {
+			mSleepStamps[mIds[index]] = 0;
+			Swap(index, mActiveCount);
+			mActiveCount++;
+		}
+	}
+
+	void VoxelStore::Drop(std::uint32_t index)
+	{
+		// Loosened without a push, so the voxel just falls
+		mGravity[index] = GRAVITY;
+		mDebris[index] = 1;
+		Wake(index);
+	}
+
+	std::uint32_t VoxelStore::WakeMoving()
+	{
+		// Sleepers below index have already been checked, so the one swapped
+		// into index is never a voxel that still needs waking
+		std::uint32_t woken = 0;
+		for (std::uint32_t i = mActiveCount; i < mCount; i++) {
+			if (mMoving[i]) {
+				Wake(i);
+				woken++;
+			}
+		}
+
+		return woken;
+	}
+
+	std::uint32_t VoxelStore::SleepResting()
+	{
+		const float sleepRotation = SLEEP_ROTATION * SLEEP_ROTATION;
+		std::uint32_t slept = 0;
+
+		// Walk downwards so the voxel swapped into a slot has already been checked
+		for (std::uint32_t i = mActiveCount; i-- > 0;) {
+			float rotation = mAngularX[i] * mAngularX[i] + mAngularY[i] * mAngularY[i] + mAngularZ[i] * mAngularZ[i];
+			if (!mContact[i] || rotation >= sleepRotation) {
+				mRestFrames[i] = 0;
+				continue;
+			}
+
+			// Measure drift from where the voxel started resting
+			if (mRestFrames[i] == 0) {
+				mRestX[i] = mOriginX[i];
+				mRestY[i] = mOriginY[i];
+				mRestZ[i] = mOriginZ[i];
+			}
+			float dx = mOriginX[i] - mRestX[i];
+			float dy = mOriginY[i] - mRestY[i];
+			float dz = mOriginZ[i] - mRestZ[i];
+			float drift = SLEEP_DRIFT * mSize[i];
+			if (dx * dx + dy * dy + dz * dz >= drift * drift) {
+				mRestFrames[i] = 0;
+				continue;
+			}
+
+			if (++mRestFrames[i] >= SLEEP_FRAMES) {
+				Sleep(i);
+				slept++;
+			}
+		}
+
+		return slept;
+	}
+
+	void VoxelStore::ClearContacts(std::uint32_t first, std::uint32_t last)
+	{
+		std::memset(mContact.Data() + first, 0, last - first);
+	}
+
+	void VoxelStore::SavePrevious(std::uint32_t first, std::uint32_t last)
+	{
+		std::size_t bytes = (last - first) * sizeof(float);
+		std::memcpy(mPreviousOriginX.Data() + first, mOriginX.Data() + first, bytes);
+		std::memcpy(mPreviousOriginY.Data() + first, mOriginY.Data() + first, bytes);
+		std::memcpy(mPreviousOriginZ.Data() + first, mOriginZ.Data() + first, bytes);
+		std::memcpy(mPreviousOrientationX.Data() + first, mOrientationX.Data() + first, bytes);
+		std::memcpy(mPreviousOrientationY.Data() + first, mOrientationY.Data() + first, bytes);
+		std::memcpy(mPreviousOrientationZ.Data() + first, mOrientationZ.Data() + first, bytes);
+		std::memcpy(mPreviousOrientationW.Data() + first, mOrientationW.Data() + first, bytes);
+	}
+
+	std::uint32_t VoxelStore::Integrate(double elapsed)
+	{
+		SavePrevious(0, mActiveCount);
+		std::uint32_t moving = VoxelIntegrator::Integrate(*this, 0, mActiveCount, elapsed);
+		SleepResting();
+
+		return moving;
+	}
+
+	void VoxelStore::GetPositionMatrix(std::uint32_t index, float alpha, float* matrix) const
+	{
+		BuildMatrixBlock(index, Simd::Float1::Set(alpha), matrix);
+	}
+
+	void VoxelStore::GetPositionMatrices(std::uint32_t first, std::uint32_t last, float alpha, float* matrices) const
+	{
+		// Writes one 4x4 matrix per voxel, starting at matrices[0] for voxel first
+		typedef Simd::FloatN V;
+		std::uint32_t i = first;
+		for (; i + V::Width <= last; i += V::Width) {
+			BuildMatrixBlock(i, V::Set(alpha), matrices + (i - first) * 16);
+		}
+		for (; i < last; i++) {
+			BuildMatrixBlock(i, Simd::Float1::Set(alpha), matrices + (i - first) * 16);
+		}
+	}
+
+	template <typename V>
+	void VoxelStore::BuildMatrixBlock(std::uint32_t index, V alpha, float* matrices) const
+	{
+		// Blend the last two steps along the shorter arc and renormalise
+		V px = V::Load(mPreviousOrientationX.Data() + index);
+		V py = V::Load(mPreviousOrientationY.Data() + index);
+		V pz = V::Load(mPreviousOrientationZ.Data() + index);
+		V pw = V::Load(mPreviousOrientationW.Data() + index);
+		V cx = V::Load(mOrientationX.Data() + index);
+		V cy = V::Load(mOrientationY.Data() + index);
+		V cz = V::Load(mOrientationZ.Data() + index);
+		V cw = V::Load(mOrientationW.Data() + index);
+		V sign = Simd::Select(px * cx + py * cy + pz * cz + pw * cw < V::Set(0.0f), V::Set(-1.0f), V::Set(1.0f));
+		V x = px + (cx * sign - px) * alpha;
+		V y = py + (cy * sign - py) * alpha;
+		V z = pz + (cz * sign - pz) * alpha;
+		V w = pw + (cw * sign - pw) * alpha;
+		V scale = V::Set(1.0f) / Simd::Sqrt(x * x + y * y + z * z + w * w);
+		x = x * scale;
+		y = y * scale;
+		z = z * scale;
+		w = w * scale;
+
+		// Scale the unit cube, rotate it about its centre, then move it to the origin
+		V size = V::Load(mSize.Data() + index);
+		V two = V::Set(2.0f);
+		V one = V::Set(1.0f);
+		V zero = V::Set(0.0f);
+		V ox = V::Load(mPreviousOriginX.Data() + index);
+		V oy = V::Load(mPreviousOriginY.Data() + index);
+		V oz = V::Load(mPreviousOriginZ.Data() + index);
+		V elements[16] = {
+			(one - two * (y * y + z * z)) * size, two * (x * y + w * z) * size, two * (x * z - w * y) * size, zero,
+			two * (x * y - w * z) * size, (one - two * (x * x + z * z)) * size, two * (y * z + w * x) * size, zero,
+			two * (x * z + w * y) * size, two * (y * z - w * x) * size, (one - two * (x * x + y * y)) * size, zero,
+			ox + (V::Load(mOriginX.Data() + index) - ox) * alpha,
+			oy + (V::Load(mOriginY.Data() + index) - oy) * alpha,
+			oz + (V::Load(mOriginZ.Data() + index) - oz) * alpha,
+			one
+		};
+
+		// Transpose the lanes out into one row-major matrix per voxel
+		float lanes[V::Width];
+		for (int element = 0; element < 16; element++) {
+			elements[element].Store(lanes);
+			for (int lane = 0; lane < V::Width; lane++) {
+				matrices[lane * 16 + element] = lanes[lane];
+			}
+		}
+	}
+
+	float VoxelStore::GetRandomDisplacement(Random& random)
+	{
+		return random.NextRange(-BLAST_DISPLACEMENT, BLAST_DISPLACEMENT);
+	}
+
+	void VoxelStore::Swap(std::uint32_t a, std::uint32_t b)
+	{
+		if (a == b) {
+			return;
+		}
+
+		ForEachArray([a, b](auto& array) {
+			auto value = array[a];
+			array[a] = array[b];
+			array[b] = value;
+		});
+		mSlots[mIds[a]] = a;
+		mSlots[mIds[b]] = b;
+	}
+
+	void VoxelStore::Sleep(std::uint32_t index)
+	{
+		mMoving[index] = 0;
+		mRestFrames[index] = 0;
+		mVelocityX[index] = 0.0f;
+		mVelocityY[index] = 0.0f;
+		mVelocityZ[index] = 0.0f;
+		mGravity[index] = 0.0f;
+		mAngularX[index] = 0.0f;
+		mAngularY[index] = 0.0f;
+		mAngularZ[index] = 0.0f;
+		SavePrevious(index, index + 1);
+
+		mActiveCount--;
+		Swap(index, mActiveCount);
+		LogSleep(mActiveCount);
+	}
+
+	void VoxelStore::LogSleep(std::uint32_t index)
+	{
+		// Zero is kept for voxels that are not asleep
+		if (++mSleepCounter == 0) {
+			mSleepCounter = 1;
+		}
+
+		std::uint32_t id = mIds[index];
+		mSleepStamps[id] = mSleepCounter;
+		SleepRecord record = { id, mSleepCounter };
+		mSleepLog.push_back(record);
+	}
+}
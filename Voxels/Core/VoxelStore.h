@@ -0,0 +1,180 @@
+#pragma once
+
+#include "AlignedArray.h"
+#include "Random.h"
+#include <cstdint>
+#include <vector>
+
+namespace Rendering {
+	// Structure-of-arrays storage for every voxel in a chunk. Each attribute lives
+	// in its own contiguous, aligned array so the per-frame loops stream through
+	// memory linearly instead of chasing one heap object per voxel.
+	//
+	// The store is partitioned: slots [0, ActiveCount()) hold the moving voxels
+	// and the rest are asleep, so per-frame work only walks the active prefix.
+	// Waking or sleeping a voxel swaps it across the boundary, which moves it to
+	// a different slot; use its id to keep track of it.
+	//
+	// SetMotionVector only touches its own slot, so a blast can be applied from
+	// several threads at once; WakeMoving() then moves the hit voxels across.
+	//
+	// A moving voxel only falls asleep once it has rested on something for
+	// SLEEP_FRAMES steps without drifting more than SLEEP_DRIFT of its size, so
+	// debris in flight is never frozen in mid-air, while debris wedged between
+	// contacts that keep nudging it back and forth still settles.
+	// Each time a voxel falls asleep, or is added, it gets a new sleep stamp and
+	// is appended to the sleep log; its stamp reads zero while it is awake or
+	// removed. An index over the sleeping voxels can drain the log to pick up
+	// new sleepers and compare stamps to skip entries that have gone stale,
+	// instead of being rebuilt whenever the sleeping set changes.
+	//
+	// Remove() closes the gap by moving the last voxel of each partition down,
+	// so the arrays stay packed. The storage is kept and the removed id goes on
+	// a free list, so voxels added later reuse both instead of growing them.
+	class VoxelStore {
+	public:
+		struct SleepRecord {
+			std::uint32_t Id;
+			std::uint32_t Stamp;
+		};
+
+		VoxelStore();
+		~VoxelStore();
+
+		std::uint32_t Add(float x, float y, float z, float size);
+		// Adds a voxel that already came loose and has settled, asleep
+		std::uint32_t AddDebris(float x, float y, float z, float size, const float orientation[4], float launchTime);
+		void Reserve(std::uint32_t capacity);
+		void Clear();
+		std::uint32_t Count() const;
+		std::uint32_t ActiveCount() const;
+		std::uint32_t SleepingCount() const;
+		std::uint32_t SleepStamp(std::uint32_t id) const;
+		const std::vector<SleepRecord>& SleepLog() const;
+		void ClearSleepLog();
+
+		std::uint32_t Id(std::uint32_t index) const;
+		// Returns INVALID_SLOT for ids that have been removed
+		std::uint32_t Slot(std::uint32_t id) const;
+		void Remove(std::uint32_t index);
+
+		void SetAngularVelocity(std::uint32_t index, float x, float y, float z);
+		void SetLaunchTime(std::uint32_t index, float time);
+		bool SetMotionVector(std::uint32_t index, float x, float y, float z, Random& random);
+		void Wake(std::uint32_t index);
+		void Drop(std::uint32_t index);
+		std::uint32_t WakeMoving();
+		std::uint32_t SleepResting();
+		void ClearContacts(std::uint32_t first, std::uint32_t last);
+		void SavePrevious(std::uint32_t first, std::uint32_t last);
+		std::uint32_t Integrate(double elapsed);
+		void GetPositionMatrix(std::uint32_t index, float alpha, float* matrix) const;
+		void GetPositionMatrices(std::uint32_t first, std::uint32_t last, float alpha, float* matrices) const;
+
+		float* OriginX() { return mOriginX.Data(); }
+		float* OriginY() { return mOriginY.Data(); }
+		float* OriginZ() { return mOriginZ.Data(); }
+		float* VelocityX() { return mVelocityX.Data(); }
+		float* VelocityY() { return mVelocityY.Data(); }
+		float* VelocityZ() { return mVelocityZ.Data(); }
+		float* Gravity() { return mGravity.Data(); }
+		float* AngularX() { return mAngularX.Data(); }
+		float* AngularY() { return mAngularY.Data(); }
+		float* AngularZ() { return mAngularZ.Data(); }
+		float* OrientationX() { return mOrientationX.Data(); }
+		float* OrientationY() { return mOrientationY.Data(); }
+		float* OrientationZ() { return mOrientationZ.Data(); }
+		float* OrientationW() { return mOrientationW.Data(); }
+		float* Size() { return mSize.Data(); }
+		std::uint8_t* Moving() { return mMoving.Data(); }
+		std::uint8_t* Contact() { return mContact.Data(); }
+
+		const float* OriginX() const { return mOriginX.Data(); }
+		const float* OriginY() const { return mOriginY.Data(); }
+		const float* OriginZ() const { return mOriginZ.Data(); }
+		const float* VelocityX() const { return mVelocityX.Data(); }
+		const float* VelocityY() const { return mVelocityY.Data(); }
+		const float* VelocityZ() const { return mVelocityZ.Data(); }
+		const float* Gravity() const { return mGravity.Data(); }
+		const float* OrientationX() const { return mOrientationX.Data(); }
+		const float* OrientationY() const { return mOrientationY.Data(); }
+		const float* OrientationZ() const { return mOrientationZ.Data(); }
+		const float* OrientationW() const { return mOrientationW.Data(); }
+		const float* Size() const { return mSize.Data(); }
+		const std::uint8_t* Moving() const { return mMoving.Data(); }
+		const std::uint8_t* Contact() const { return mContact.Data(); }
+		const std::uint8_t* Debris() const { return mDebris.Data(); }
+		const float* LaunchTime() const { return mLaunchTime.Data(); }
+
+		static const float DECAY_FACTOR;
+		static const float TIME_FACTOR;
+		static const float SCALE_FACTOR;
+		static const float GRAVITY;
+		static const float BLAST_LENGTH;
+		static const float BLAST_DISPLACEMENT;
+		// Farthest a voxel centre can be from a blast and still be hit
+		static const float BLAST_REACH;
+		static const float SLEEP_DRIFT;
+		static const float SLEEP_ROTATION;
+		static const std::uint8_t SLEEP_FRAMES;
+		static const std::uint32_t INVALID_SLOT;
+
+	private:
+		VoxelStore(const VoxelStore& rhs);
+		VoxelStore& operator=(const VoxelStore& rhs);
+
+		static float GetRandomDisplacement(Random& random);
+		void Swap(std::uint32_t a, std::uint32_t b);
+		template <typename Function> void ForEachArray(Function function);
+		void Sleep(std::uint32_t index);
+		void LogSleep(std::uint32_t index);
+		template <typename V> void BuildMatrixBlock(std::uint32_t index, V alpha, float* matrices) const;
+
+		std::uint32_t mCount;
+		std::uint32_t mActiveCount;
+		std::uint32_t mSleepCounter;
+
+		AlignedArray<float> mOriginX;
+		AlignedArray<float> mOriginY;
+		AlignedArray<float> mOriginZ;
+		AlignedArray<float> mVelocityX;
+		AlignedArray<float> mVelocityY;
+		AlignedArray<float> mVelocityZ;
+		AlignedArray<float> mGravity;
+		// Angular velocity in world space, radians per unit of scaled time
+		AlignedArray<float> mAngularX;
+		AlignedArray<float> mAngularY;
+		AlignedArray<float> mAngularZ;
+		// Unit quaternion; the 4x4 matrix is only built when drawing
+		AlignedArray<float> mOrientationX;
+		AlignedArray<float> mOrientationY;
+		AlignedArray<float> mOrientationZ;
+		AlignedArray<float> mOrientationW;
+		// Transform at the start of the last simulation step, for interpolation
+		AlignedArray<float> mPreviousOriginX;
+		AlignedArray<float> mPreviousOriginY;
+		AlignedArray<float> mPreviousOriginZ;
+		AlignedArray<float> mPreviousOrientationX;
+		AlignedArray<float> mPreviousOrientationY;
+		AlignedArray<float> mPreviousOrientationZ;
+		AlignedArray<float> mPreviousOrientationW;
+		AlignedArray<float> mSize;
+		AlignedArray<std::uint8_t> mMoving;
+		// Set while the voxel is touching the ground or another voxel this step
+		AlignedArray<std::uint8_t> mContact;
+		// Set once a blast has knocked the voxel loose from the chunk
+		AlignedArray<std::uint8_t> mDebris;
+		// Simulation time of the last blast that hit the voxel
+		AlignedArray<float> mLaunchTime;
+		// Consecutive steps spent supported and near the rest anchor
+		AlignedArray<std::uint8_t> mRestFrames;
+		AlignedArray<float> mRestX;
+		AlignedArray<float> mRestY;
+		AlignedArray<float> mRestZ;
+		AlignedArray<std::uint32_t> mIds;
+		std::vector<std::uint32_t> mSlots;
+		std::vector<std::uint32_t> mFreeIds;
+		std::vector<std::uint32_t> mSleepStamps;
+		std::vector<SleepRecord> mSleepLog;
+	};
+}
@@ -0,0 +1,305 @@
+#include "VoxelWorld.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Rendering {
+	const std::uint32_t VoxelWorld::VIEW_DISTANCE = 6;
+	const std::uint32_t VoxelWorld::UNLOAD_MARGIN = 1;
+	const std::size_t VoxelWorld::MEMORY_BUDGET = 256 * 1024 * 1024;
+	const std::uint32_t VoxelWorld::LOADS_IN_FLIGHT = 16;
+	const float VoxelWorld::VIEW_WEIGHT = 2.0f;
+	const float VoxelWorld::REPLAN_TURN = 0.95f;
+
+	namespace {
+		std::int32_t FloorDivide(std::int32_t value, std::int32_t divisor)
+		{
+			std::int32_t quotient = value / divisor;
+			return (value % divisor < 0 ? quotient - 1 : quotient);
+		}
+
+		bool Normalize(const float vector[3], float normalized[3])
+		{
+			float length = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+			for (int a = 0; a < 3; a++) {
+				normalized[a] = (length > 0.0f ? vector[a] / length : 0.0f);
+			}
+			return length > 0.0f;
+		}
+	}
+
+	VoxelWorld::VoxelWorld(const Generator& generator, float pitch, JobSystem* jobSystem)
+		: mGenerator(generator), mPitch(pitch), mJobSystem(jobSystem), mPlanned(false), mPlanCentre(), mPlanDirection(), mUpdateCount(0),
+		mViewDistance(VIEW_DISTANCE), mMemoryBudget(MEMORY_BUDGET), mLoadedCount(0), mLoadedBytes(0)
+	{
+	}
+
+	VoxelWorld::~VoxelWorld()
+	{
+		for (std::uint32_t slot : mLoading) {
+			mJobSystem->Wait(mSlots[slot].Job);
+		}
+		for (JobSystem::Job* job : mUnloading) {
+			mJobSystem->Wait(job);
+		}
+		for (Slot& slot : mSlots) {
+			delete slot.Grid;
+		}
+	}
+
+	void VoxelWorld::Update(const float position[3], const float direction[3])
+	{
+		mUpdateCount++;
+		FinishLoads();
+		FinishUnloads();
+
+		ChunkKey centre = ChunkAt(position);
+		float heading[3];
+		Normalize(direction, heading);
+		float turn = heading[0] * mPlanDirection[0] + heading[1] * mPlanDirection[1] + heading[2] * mPlanDirection[2];
+		if (!mPlanned || centre.X != mPlanCentre.X || centre.Y != mPlanCentre.Y || centre.Z != mPlanCentre.Z || turn < REPLAN_TURN) {
+			Plan(centre, heading);
+		}
+
+		// Keep or load chunks in order of priority until the budget runs out
+		std::size_t estimate = EstimatedBytes();
+		std::size_t bytes = 0;
+		std::uint32_t starts = (HasWorkers() ? LOADS_IN_FLIGHT - std::min(LOADS_IN_FLIGHT, static_cast<std::uint32_t>(mLoading.size())) : 1);
+		for (const Candidate& candidate : mPlan) {
+			std::uint32_t slot = mTable.Find(candidate.Key);
+			if (slot != ChunkTable::EMPTY) {
+				std::size_t size = (mSlots[slot].Job != nullptr ? estimate : mSlots[slot].Bytes);
+				if (bytes + size > mMemoryBudget) {
+					break;
+				}
+				bytes += size;
+				mSlots[slot].Kept = mUpdateCount;
+				continue;
+			}
+
+			if (!candidate.Load || starts == 0) {
+				continue;
+			}
+			if (bytes + estimate > mMemoryBudget) {
+				break;
+			}
+			StartLoad(candidate.Key);
+			bytes += estimate;
+			starts--;
+		}
+
+		// Loads in flight are left to finish; if they are still not wanted
+		// they go on a later update
+		for (std::uint32_t slot = 0; slot < mSlots.size(); slot++) {
+			if (mSlots[slot].Grid != nullptr && mSlots[slot].Job == nullptr && mSlots[slot].Kept != mUpdateCount) {
+				Unload(slot);
+			}
+		}
+	}
+
+	const ChunkGrid* VoxelWorld::Find(const ChunkKey& key) const
+	{
+		std::uint32_t slot = mTable.Find(key);
+		return (slot != ChunkTable::EMPTY && mSlots[slot].Job == nullptr ? mSlots[slot].Grid : nullptr);
+	}
+
+	std::uint16_t VoxelWorld::Get(std::int32_t x, std::int32_t y, std::int32_t z) const
+	{
+		std::int32_t size = static_cast<std::int32_t>(ChunkGrid::SIZE);
+		ChunkKey key = { FloorDivide(x, size), FloorDivide(y, size), FloorDivide(z, size) };
+		const ChunkGrid* grid = Find(key);
+		if (grid == nullptr) {
+			return ChunkGrid::EMPTY_MATERIAL;
+		}
+		return grid->Get(static_cast<std::uint32_t>(x - key.X * size), static_cast<std::uint32_t>(y - key.Y * size),
+			static_cast<std::uint32_t>(z - key.Z * size));
+	}
+
+	bool VoxelWorld::IsSolid(std::int32_t x, std::int32_t y, std::int32_t z) const
+	{
+		return Get(x, y, z) != ChunkGrid::EMPTY_MATERIAL;
+	}
+
+	ChunkKey VoxelWorld::ChunkAt(const float position[3]) const
+	{
+		// Cell centres sit on multiples of the pitch, so cells start half a pitch before
+		float size = static_cast<float>(ChunkGrid::SIZE);
+		ChunkKey key;
+		key.X = static_cast<std::int32_t>(std::floor((position[0] / mPitch + 0.5f) / size));
+		key.Y = static_cast<std::int32_t>(std::floor((position[1] / mPitch + 0.5f) / size));
+		key.Z = static_cast<std::int32_t>(std::floor((position[2] / mPitch + 0.5f) / size));
+		return key;
+	}
+
+	std::uint32_t VoxelWorld::ViewDistance() const
+	{
+		return mViewDistance;
+	}
+
+	void VoxelWorld::SetViewDistance(std::uint32_t chunks)
+	{
+		mViewDistance = chunks;
+		mPlanned = false;
+	}
+
+	std::size_t VoxelWorld::MemoryBudget() const
+	{
+		return mMemoryBudget;
+	}
+
+	void VoxelWorld::SetMemoryBudget(std::size_t bytes)
+	{
+		mMemoryBudget = bytes;
+	}
+
+	std::uint32_t VoxelWorld::LoadedCount() const
+	{
+		return mLoadedCount;
+	}
+
+	std::uint32_t VoxelWorld::LoadingCount() const
+	{
+		return static_cast<std::uint32_t>(mLoading.size());
+	}
+
+	std::size_t VoxelWorld::MemoryBytes() const
+	{
+		return mLoadedBytes;
+	}
+
+	bool VoxelWorld::HasWorkers() const
+	{
+		return mJobSystem != nullptr && mJobSystem->ThreadCount() > 1;
+	}
+
+	void VoxelWorld::Plan(const ChunkKey& centre, const float direction[3])
+	{
+		mPlan.clear();
+		std::int32_t reach = static_cast<std::int32_t>(mViewDistance + UNLOAD_MARGIN);
+		for (std::int32_t dz = -reach; dz <= reach; dz++) {
+			for (std::int32_t dy = -reach; dy <= reach; dy++) {
+				for (std::int32_t dx = -reach; dx <= reach; dx++) {
+					const float offset[3] = { static_cast<float>(dx), static_cast<float>(dy), static_cast<float>(dz) };
+					float distance = std::sqrt(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+					if (distance > static_cast<float>(reach)) {
+						continue;
+					}
+
+					// A chunk straight ahead counts at its distance and one straight
+					// behind at VIEW_WEIGHT times it
+					float away[3];
+					float facing = (Normalize(offset, away) ? away[0] * direction[0] + away[1] * direction[1] + away[2] * direction[2] : 1.0f);
+					Candidate candidate;
+					candidate.Key.X = centre.X + dx;
+					candidate.Key.Y = centre.Y + dy;
+					candidate.Key.Z = centre.Z + dz;
+					candidate.Priority = distance * (1.0f + (VIEW_WEIGHT - 1.0f) * 0.5f * (1.0f - facing));
+					candidate.Load = distance <= static_cast<float>(mViewDistance);
+					mPlan.push_back(candidate);
+				}
+			}
+		}
+
+		std::stable_sort(mPlan.begin(), mPlan.end(), [](const Candidate& a, const Candidate& b) { return a.Priority < b.Priority; });
+		mPlanned = true;
+		mPlanCentre = centre;
+		for (int a = 0; a < 3; a++) {
+			mPlanDirection[a] = direction[a];
+		}
+	}
+
+	void VoxelWorld::FinishLoads()
+	{
+		for (std::uint32_t i = 0; i < mLoading.size();) {
+			Slot& slot = mSlots[mLoading[i]];
+			if (!mJobSystem->IsComplete(slot.Job)) {
+				i++;
+				continue;
+			}
+
+			mJobSystem->Release(slot.Job);
+			slot.Job = nullptr;
+			slot.Bytes = slot.Grid->MemoryBytes();
+			mLoadedBytes += slot.Bytes;
+			mLoadedCount++;
+			mLoading[i] = mLoading.back();
+			mLoading.pop_back();
+		}
+	}
+
+	void VoxelWorld::FinishUnloads()
+	{
+		for (std::uint32_t i = 0; i < mUnloading.size();) {
+			if (!mJobSystem->IsComplete(mUnloading[i])) {
+				i++;
+				continue;
+			}
+
+			mJobSystem->Release(mUnloading[i]);
+			mUnloading[i] = mUnloading.back();
+			mUnloading.pop_back();
+		}
+	}
+
+	void VoxelWorld::StartLoad(const ChunkKey& key)
+	{
+		std::uint32_t index;
+		if (mFreeSlots.empty()) {
+			index = static_cast<std::uint32_t>(mSlots.size());
+			mSlots.push_back(Slot());
+		}
+		else {
+			index = mFreeSlots.back();
+			mFreeSlots.pop_back();
+		}
+
+		Slot& slot = mSlots[index];
+		slot.Key = key;
+		slot.Grid = new ChunkGrid();
+		slot.Job = nullptr;
+		slot.Bytes = 0;
+		slot.Kept = mUpdateCount;
+		mTable.Insert(key, index);
+
+		ChunkGrid* grid = slot.Grid;
+		if (!HasWorkers()) {
+			mGenerator(key, *grid);
+			slot.Bytes = grid->MemoryBytes();
+			mLoadedBytes += slot.Bytes;
+			mLoadedCount++;
+			return;
+		}
+
+		slot.Job = mJobSystem->CreateJob([this, key, grid]() {
+			mGenerator(key, *grid);
+		});
+		mJobSystem->RunInBackground(slot.Job);
+		mLoading.push_back(index);
+	}
+
+	void VoxelWorld::Unload(std::uint32_t index)
+	{
+		Slot& slot = mSlots[index];
+		mTable.Erase(slot.Key);
+		mLoadedBytes -= slot.Bytes;
+		mLoadedCount--;
+
+		ChunkGrid* grid = slot.Grid;
+		slot.Grid = nullptr;
+		mFreeSlots.push_back(index);
+		if (!HasWorkers()) {
+			delete grid;
+			return;
+		}
+
+		JobSystem::Job* job = mJobSystem->CreateJob([grid]() {
+			delete grid;
+		});
+		mJobSystem->RunInBackground(job);
+		mUnloading.push_back(job);
+	}
+
+	std::size_t VoxelWorld::EstimatedBytes() const
+	{
+		return (mLoadedCount > 0 ? mLoadedBytes / mLoadedCount : sizeof(ChunkGrid));
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "ChunkGrid.h"
+#include "ChunkTable.h"
+#include "JobSystem.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+using namespace Library;
+
+namespace Rendering {
+	// A world of ChunkGrid chunks, streamed in and out around a viewer. Cell
+	// (x, y, z) of the world is centred at (x, y, z) * pitch, and chunk (X, Y, Z)
+	// holds the cells from (X, Y, Z) * ChunkGrid::SIZE.
+	//
+	// Update() plans which chunks to hold: those within the view distance of
+	// the viewer's chunk, nearest first, with chunks behind the viewer counted
+	// up to VIEW_WEIGHT times farther away than those ahead. It walks the plan
+	// adding up the memory of each chunk, measured for chunks held and estimated
+	// from their average for the rest, and stops at the memory budget. Chunks
+	// it reaches are kept or queued to load, at most LOADS_IN_FLIGHT at a time;
+	// every other chunk is unloaded. Chunks stay held until they are
+	// UNLOAD_MARGIN chunks past the view distance, so walking back and forth
+	// across a chunk boundary does not reload anything.
+	//
+	// Chunks are generated and freed as background jobs, so Update() only
+	// looks up and hands out work, and the frame's own Wait() and ParallelFor()
+	// calls never pick a load up. A chunk is visible to Find() once its load
+	// has finished. Without worker threads, Update() generates one chunk
+	// itself each call. The generator is called from the worker threads, so it
+	// must be safe to run several at once.
+	class VoxelWorld {
+	public:
+		// Fills the grid of a newly loaded chunk; the grid starts out empty
+		typedef std::function<void(const ChunkKey& key, ChunkGrid& grid)> Generator;
+
+		VoxelWorld(const Generator& generator, float pitch, JobSystem* jobSystem = nullptr);
+		~VoxelWorld();
+
+		// Streams chunks around the viewer at position, looking along direction
+		void Update(const float position[3], const float direction[3]);
+
+		// The chunk if it is loaded, or nullptr
+		const ChunkGrid* Find(const ChunkKey& key) const;
+		// Material of a cell, or ChunkGrid::EMPTY_MATERIAL if its chunk is not loaded
+		std::uint16_t Get(std::int32_t x, std::int32_t y, std::int32_t z) const;
+		bool IsSolid(std::int32_t x, std::int32_t y, std::int32_t z) const;
+		ChunkKey ChunkAt(const float position[3]) const;
+
+		// In chunks
+		std::uint32_t ViewDistance() const;
+		void SetViewDistance(std::uint32_t chunks);
+		std::size_t MemoryBudget() const;
+		void SetMemoryBudget(std::size_t bytes);
+
+		std::uint32_t LoadedCount() const;
+		std::uint32_t LoadingCount() const;
+		// Bytes held by the loaded chunks
+		std::size_t MemoryBytes() const;
+
+		static const std::uint32_t VIEW_DISTANCE;
+		static const std::uint32_t UNLOAD_MARGIN;
+		static const std::size_t MEMORY_BUDGET;
+		static const std::uint32_t LOADS_IN_FLIGHT;
+		static const float VIEW_WEIGHT;
+		// The plan is redone when the viewer turns further than this, as the
+		// cosine of the angle since it was made
+		static const float REPLAN_TURN;
+
+	private:
+		VoxelWorld(const VoxelWorld& rhs);
+		VoxelWorld& operator=(const VoxelWorld& rhs);
+
+		struct Slot {
+			ChunkKey Key;
+			ChunkGrid* Grid;
+			// Load in flight, or nullptr once the grid is ready
+			JobSystem::Job* Job;
+			std::size_t Bytes;
+			// Last update whose plan kept the chunk
+			std::uint32_t Kept;
+		};
+
+		struct Candidate {
+			ChunkKey Key;
+			float Priority;
+			// Chunks in the margin past the view distance are kept, not loaded
+			bool Load;
+		};
+
+		bool HasWorkers() const;
+		void Plan(const ChunkKey& centre, const float direction[3]);
+		void FinishLoads();
+		void FinishUnloads();
+		void StartLoad(const ChunkKey& key);
+		void Unload(std::uint32_t slot);
+		std::size_t EstimatedBytes() const;
+
+		Generator mGenerator;
+		float mPitch;
+		JobSystem* mJobSystem;
+		ChunkTable mTable;
+		std::vector<Slot> mSlots;
+		std::vector<std::uint32_t> mFreeSlots;
+		std::vector<std::uint32_t> mLoading;
+		std::vector<JobSystem::Job*> mUnloading;
+		// Chunks in reach of the viewer, highest priority first
+		std::vector<Candidate> mPlan;
+		bool mPlanned;
+		ChunkKey mPlanCentre;
+		float mPlanDirection[3];
+		std::uint32_t mUpdateCount;
+		std::uint32_t mViewDistance;
+		std::size_t mMemoryBudget;
+		std::uint32_t mLoadedCount;
+		std::size_t mLoadedBytes;
+	};
+}
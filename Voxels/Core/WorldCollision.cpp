@@ -0,0 +1,372 @@
+#include "WorldCollision.h"
+#include "JobSystem.h"
+#include "VoxelStore.h"
+#include <cmath>
+
+using namespace Library;
+
+namespace Rendering {
+	const float WorldCollision::GROUND_HEIGHT = -1.0f;
+	const float WorldCollision::RESTITUTION = 0.3f;
+	const float WorldCollision::REST_SPEED = 1.0f;
+	const float WorldCollision::FRICTION = 0.5f;
+	const float WorldCollision::SPIN_DAMPING = 0.9f;
+	const std::uint32_t WorldCollision::COLLIDE_GRAIN = 1024;
+	const std::uint32_t WorldCollision::RECENT_LIMIT = 4096;
+
+	namespace {
+		struct Body {
+			float Position[3];
+			float Velocity[3];
+			bool Touching;
+		};
+
+		void Resolve(Body& body, const float normal[3], float depth)
+		{
+			for (int a = 0; a < 3; a++) {
+				body.Position[a] += normal[a] * depth;
+			}
+			body.Touching = true;
+
+			float approach = body.Velocity[0] * normal[0] + body.Velocity[1] * normal[1] + body.Velocity[2] * normal[2];
+			if (approach >= 0.0f) {
+				return;
+			}
+
+			// Bounce back part of a hard hit; a slow one just stops
+			float bounce = (-approach > WorldCollision::REST_SPEED ? -approach * WorldCollision::RESTITUTION : 0.0f);
+			float change = bounce - approach;
+			for (int a = 0; a < 3; a++) {
+				body.Velocity[a] += normal[a] * change;
+			}
+
+			// Friction can take away at most FRICTION times the normal change
+			float along = body.Velocity[0] * normal[0] + body.Velocity[1] * normal[1] + body.Velocity[2] * normal[2];
+			float sliding[3];
+			for (int a = 0; a < 3; a++) {
+				sliding[a] = body.Velocity[a] - normal[a] * along;
+			}
+			float speed = std::sqrt(sliding[0] * sliding[0] + sliding[1] * sliding[1] + sliding[2] * sliding[2]);
+			float limit = WorldCollision::FRICTION * change;
+			float removed = (speed <= limit ? 1.0f : limit / speed);
+			for (int a = 0; a < 3; a++) {
+				body.Velocity[a] -= sliding[a] * removed;
+			}
+		}
+	}
+
+	WorldCollision::WorldCollision()
+		: mGroundHeight(GROUND_HEIGHT), mCellSize(1.0f), mStaticBuilt(false)
+	{
+	}
+
+	float WorldCollision::GroundHeight() const
+	{
+		return mGroundHeight;
+	}
+
+	void WorldCollision::SetGroundHeight(float height)
+	{
+		mGroundHeight = height;
+	}
+
+	std::uint32_t WorldCollision::Collide(VoxelStore& store, std::uint32_t count, JobSystem* jobSystem)
+	{
+		UpdateStatic(store);
+
+		mRangeTouching.assign((count + COLLIDE_GRAIN - 1) / COLLIDE_GRAIN, 0);
+		auto collide = [this, &store](std::uint32_t begin, std::uint32_t end) {
+			mRangeTouching[begin / COLLIDE_GRAIN] = CollideRange(store, begin, end);
+		};
+
+		if (jobSystem != nullptr) {
+			jobSystem->ParallelFor(count, COLLIDE_GRAIN, collide);
+		}
+		else if (count > 0) {
+			collide(0, count);
+		}
+
+		std::uint32_t touching = 0;
+		for (std::uint32_t rangeTouching : mRangeTouching) {
+			touching += rangeTouching;
+		}
+
+		return touching;
+	}
+
+	void WorldCollision::UpdateStatic(VoxelStore& store)
+	{
+		if (!mStaticBuilt) {
+			BuildStatic(store);
+			return;
+		}
+
+		const std::vector<VoxelStore::SleepRecord>& log = store.SleepLog();
+		bool slept = !log.empty();
+		mRecentRecords.insert(mRecentRecords.end(), log.begin(), log.end());
+		store.ClearSleepLog();
+
+		// Voxels that woke or were removed leave stale entries behind
+		std::size_t indexed = mStatic.Ids.size() + mRecentRecords.size();
+		if (mRecentRecords.size() > RECENT_LIMIT + mStatic.Ids.size() / 64 || indexed > store.SleepingCount() * 2 + RECENT_LIMIT) {
+			BuildStatic(store);
+		}
+		else if (slept) {
+			BuildRecent(store);
+		}
+	}
+
+	void WorldCollision::BuildStatic(VoxelStore& store)
+	{
+		// A sphere of the largest size touches a box of the largest size while
+		// their centres are less than size * (1 + sqrt(3)) apart
+		const float* size = store.Size();
+		float largest = 0.0f;
+		for (std::uint32_t i = 0; i < store.Count(); i++) {
+			largest = (size[i] > largest ? size[i] : largest);
+		}
+		mCellSize = (largest > 0.0f ? largest * 2.7320508f : 1.0f);
+
+		mSlots.clear();
+		for (std::uint32_t i = store.ActiveCount(); i < store.Count(); i++) {
+			mSlots.push_back(i);
+		}
+		BuildSet(mStatic, store, mSlots, mCellSize);
+
+		mRecentRecords.clear();
+		mSlots.clear();
+		BuildSet(mRecent, store, mSlots, mCellSize);
+		store.ClearSleepLog();
+		mStaticBuilt = true;
+	}
+
+	void WorldCollision::BuildRecent(const VoxelStore& store)
+	{
+		// Drop records of voxels that have woken, been removed or fallen asleep
+		// again since; the last only leaves its latest record
+		const float* size = store.Size();
+		float largest = 0.0f;
+		std::size_t kept = 0;
+		mSlots.clear();
+		for (const VoxelStore::SleepRecord& record : mRecentRecords) {
+			if (store.SleepStamp(record.Id) != record.Stamp) {
+				continue;
+			}
+
+			std::uint32_t slot = store.Slot(record.Id);
+			largest = (size[slot] > largest ? size[slot] : largest);
+			mSlots.push_back(slot);
+			mRecentRecords[kept++] = record;
+		}
+		mRecentRecords.resize(kept);
+
+		float cellSize = largest * 2.7320508f;
+		BuildSet(mRecent, store, mSlots, cellSize > mCellSize ? cellSize : mCellSize);
+	}
+
+	void WorldCollision::BuildSet(StaticSet& set, const VoxelStore& store, const std::vector<std::uint32_t>& slots, float cellSize)
+	{
+		const float* originX = store.OriginX();
+		const float* originY = store.OriginY();
+		const float* originZ = store.OriginZ();
+		const float* size = store.Size();
+		std::uint32_t count = static_cast<std::uint32_t>(slots.size());
+
+		mX.resize(count);
+		mY.resize(count);
+		mZ.resize(count);
+		for (std::uint32_t k = 0; k < count; k++) {
+			mX[k] = originX[slots[k]];
+			mY[k] = originY[slots[k]];
+			mZ[k] = originZ[slots[k]];
+		}
+		set.Hash.Build(mX.data(), mY.data(), mZ.data(), count, cellSize);
+
+		// Copied out in bucket order so the queries read neighbouring boxes
+		// from neighbouring memory
+		set.Ids.resize(count);
+		set.Stamps.resize(count);
+		set.X.resize(count);
+		set.Y.resize(count);
+		set.Z.resize(count);
+		set.Size.resize(count);
+		for (int a = 0; a < 3; a++) {
+			set.Minimum[a] = 0.0f;
+			set.Maximum[a] = -1.0f;
+		}
+		for (std::uint32_t p = 0; p < count; p++) {
+			std::uint32_t k = set.Hash.Entry(p);
+			std::uint32_t slot = slots[k];
+			set.Ids[p] = store.Id(slot);
+			set.Stamps[p] = store.SleepStamp(set.Ids[p]);
+			set.X[p] = mX[k];
+			set.Y[p] = mY[k];
+			set.Z[p] = mZ[k];
+			set.Size[p] = size[slot];
+
+			const float centre[3] = { mX[k], mY[k], mZ[k] };
+			for (int a = 0; a < 3; a++) {
+				float low = centre[a] - size[slot];
+				float high = centre[a] + size[slot];
+				set.Minimum[a] = (p == 0 || low < set.Minimum[a] ? low : set.Minimum[a]);
+				set.Maximum[a] = (p == 0 || high > set.Maximum[a] ? high : set.Maximum[a]);
+			}
+		}
+	}
+
+	bool WorldCollision::Raycast(const VoxelStore& store, const float origin[3], const float direction[3], float maxDistance, RayHit& hit) const
+	{
+		hit.Distance = maxDistance;
+		RaycastSet(mStatic, store, origin, direction, hit);
+		RaycastSet(mRecent, store, origin, direction, hit);
+		return hit.Distance < maxDistance;
+	}
+
+	void WorldCollision::RaycastSet(const StaticSet& set, const VoxelStore& store, const float origin[3], const float direction[3], RayHit& hit) const
+	{
+		if (set.Ids.empty()) {
+			return;
+		}
+
+		float inverse[3];
+		float t;
+		float exit;
+		int axis;
+		VoxelRay::Inverse(direction, inverse);
+		if (!VoxelRay::Clip(origin, inverse, set.Minimum, set.Maximum, t, exit, axis)) {
+			return;
+		}
+		t = (t > 0.0f ? t : 0.0f);
+
+		// A box reaches at most one cell past the cell of its centre, so the
+		// boxes the ray can hit inside a cell are all in the block around it
+		float cellSize = set.Hash.CellSize();
+		std::int32_t cell[3];
+		std::int32_t step[3];
+		float next[3];
+		float delta[3];
+		for (int a = 0; a < 3; a++) {
+			cell[a] = static_cast<std::int32_t>(std::floor((origin[a] + direction[a] * t) / cellSize));
+			step[a] = (direction[a] > 0.0f ? 1 : (direction[a] < 0.0f ? -1 : 0));
+			delta[a] = std::fabs(cellSize * inverse[a]);
+			float boundary = (cell[a] + (step[a] > 0 ? 1 : 0)) * cellSize;
+			next[a] = (step[a] != 0 ? (boundary - origin[a]) * inverse[a] : VoxelRay::PARALLEL);
+		}
+
+		while (t <= exit && t < hit.Distance) {
+			const float centre[3] = { (cell[0] + 0.5f) * cellSize, (cell[1] + 0.5f) * cellSize, (cell[2] + 0.5f) * cellSize };
+			set.Hash.ForEachNeighbour(centre[0], centre[1], centre[2], [&](std::uint32_t position) {
+				if (store.SleepStamp(set.Ids[position]) != set.Stamps[position]) {
+					return;
+				}
+
+				const float box[3] = { set.X[position], set.Y[position], set.Z[position] };
+				float distance;
+				int face;
+				if (VoxelRay::HitBox(origin, inverse, box, set.Size[position], distance, face) && distance < hit.Distance) {
+					hit.Id = set.Ids[position];
+					hit.Distance = distance;
+					VoxelRay::FaceNormal(direction, face, hit.Normal);
+				}
+			});
+
+			int a = (next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2));
+			t = next[a];
+			next[a] += delta[a];
+			cell[a] += step[a];
+		}
+	}
+
+	bool WorldCollision::SphereBoxContact(const float position[3], float radius, const float centre[3], float half, float normal[3], float& depth)
+	{
+		float offset[3];
+		float distanceSq = 0.0f;
+		for (int a = 0; a < 3; a++) {
+			float low = centre[a] - half;
+			float high = centre[a] + half;
+			float nearest = (position[a] < low ? low : (position[a] > high ? high : position[a]));
+			offset[a] = position[a] - nearest;
+			distanceSq += offset[a] * offset[a];
+		}
+		if (distanceSq >= radius * radius) {
+			return false;
+		}
+
+		if (distanceSq > 1e-12f) {
+			float distance = std::sqrt(distanceSq);
+			for (int a = 0; a < 3; a++) {
+				normal[a] = offset[a] / distance;
+			}
+			depth = radius - distance;
+			return true;
+		}
+
+		// The centre is inside the box; leave through the nearest face
+		int axis = 0;
+		float shallowest = half - std::fabs(position[0] - centre[0]);
+		for (int a = 1; a < 3; a++) {
+			float inside = half - std::fabs(position[a] - centre[a]);
+			if (inside < shallowest) {
+				shallowest = inside;
+				axis = a;
+			}
+		}
+		normal[0] = normal[1] = normal[2] = 0.0f;
+		normal[axis] = (position[axis] >= centre[axis] ? 1.0f : -1.0f);
+		depth = radius + shallowest;
+		return true;
+	}
+
+	std::uint32_t WorldCollision::CollideRange(VoxelStore& store, std::uint32_t first, std::uint32_t last) const
+	{
+		float* originX = store.OriginX();
+		float* originY = store.OriginY();
+		float* originZ = store.OriginZ();
+		float* velocityX = store.VelocityX();
+		float* velocityY = store.VelocityY();
+		float* velocityZ = store.VelocityZ();
+		float* angularX = store.AngularX();
+		float* angularY = store.AngularY();
+		float* angularZ = store.AngularZ();
+		std::uint8_t* contact = store.Contact();
+		const float* size = store.Size();
+		std::uint32_t touching = 0;
+
+		for (std::uint32_t i = first; i < last; i++) {
+			Body body = { { originX[i], originY[i], originZ[i] }, { velocityX[i], velocityY[i], velocityZ[i] }, false };
+			float radius = size[i];
+
+			// Sphere against each sleeping box nearby
+			ForEachStaticNear(store, body.Position, [&](const float centre[3], float half) {
+				float normal[3];
+				float depth;
+				if (SphereBoxContact(body.Position, radius, centre, half, normal, depth)) {
+					Resolve(body, normal, depth);
+				}
+			});
+
+			// The ground goes last so nothing can be pushed through it
+			float ground = mGroundHeight + radius - body.Position[1];
+			if (ground > 0.0f) {
+				const float up[3] = { 0.0f, 1.0f, 0.0f };
+				Resolve(body, up, ground);
+			}
+
+			if (body.Touching) {
+				originX[i] = body.Position[0];
+				originY[i] = body.Position[1];
+				originZ[i] = body.Position[2];
+				velocityX[i] = body.Velocity[0];
+				velocityY[i] = body.Velocity[1];
+				velocityZ[i] = body.Velocity[2];
+				angularX[i] *= SPIN_DAMPING;
+				angularY[i] *= SPIN_DAMPING;
+				angularZ[i] *= SPIN_DAMPING;
+				contact[i] = 1;
+				touching++;
+			}
+		}
+
+		return touching;
+	}
+}
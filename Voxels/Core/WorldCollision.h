@@ -0,0 +1,132 @@
+#pragma once
+
+#include "SpatialHash.h"
+#include "VoxelRay.h"
+#include "VoxelStore.h"
+#include <cstdint>
+#include <vector>
+
+namespace Library {
+	class JobSystem;
+}
+
+namespace Rendering {
+	// Collides moving voxels with everything that does not move: a horizontal
+	// ground plane and the sleeping voxels of the store, which are either still
+	// part of the chunk or debris that has settled. Moving voxels are spheres
+	// inscribed in their cubes and sleeping voxels are axis-aligned boxes.
+	//
+	// A contact pushes the voxel fully out, reflects RESTITUTION of its
+	// approach speed (none below REST_SPEED, so resting voxels stop bouncing),
+	// applies Coulomb friction to the sliding speed and damps the spin. Touching
+	// anything marks the voxel as in contact, which is what lets it fall asleep.
+	//
+	// The sleeping voxels are indexed by two SpatialHashes: a main one, and a
+	// small one over voxels that fell asleep since, filled from the store's
+	// sleep log. Entries keep the voxel's id and sleep stamp, and are skipped
+	// once the voxel wakes or is removed. The main index is only rebuilt once
+	// the recent or stale entries outgrow a fraction of it, so a blast or a
+	// few voxels settling costs what they touch, not the whole chunk.
+	//
+	// Each moving voxel only writes its own slot, so the ranges can run on any
+	// number of threads.
+	class WorldCollision {
+	public:
+		WorldCollision();
+
+		float GroundHeight() const;
+		void SetGroundHeight(float height);
+
+		// Returns the number of moving voxels that touched the world
+		std::uint32_t Collide(VoxelStore& store, std::uint32_t count, Library::JobSystem* jobSystem);
+
+		// Picks up voxels that fell asleep, woke or were removed since the last call
+		void UpdateStatic(VoxelStore& store);
+
+		// Calls function(slot) for every sleeping voxel whose cell overlaps the
+		// box, bringing the index up to date with the store first
+		template <typename Function>
+		void ForEachStaticInBox(VoxelStore& store, const float minimum[3], const float maximum[3], Function function)
+		{
+			UpdateStatic(store);
+			for (const StaticSet* set : { &mStatic, &mRecent }) {
+				set->Hash.ForEachInBox(minimum[0], minimum[1], minimum[2], maximum[0], maximum[1], maximum[2], [&](std::uint32_t position) {
+					if (store.SleepStamp(set->Ids[position]) == set->Stamps[position]) {
+						function(store.Slot(set->Ids[position]));
+					}
+				});
+			}
+		}
+
+		// Calls function(centre, half) for every sleeping voxel whose box may touch
+		// a sphere at position no larger than the largest voxel. The index must
+		// be up to date.
+		template <typename Function>
+		void ForEachStaticNear(const VoxelStore& store, const float position[3], Function function) const
+		{
+			for (const StaticSet* set : { &mStatic, &mRecent }) {
+				set->Hash.ForEachNeighbour(position[0], position[1], position[2], [&](std::uint32_t index) {
+					if (store.SleepStamp(set->Ids[index]) == set->Stamps[index]) {
+						const float centre[3] = { set->X[index], set->Y[index], set->Z[index] };
+						function(centre, set->Size[index]);
+					}
+				});
+			}
+		}
+
+		// Finds the first sleeping voxel along the ray that is nearer than
+		// maxDistance. Walks the index cells the ray crosses in order and stops
+		// at the first cell beyond the nearest hit. The index must be up to date.
+		bool Raycast(const VoxelStore& store, const float origin[3], const float direction[3], float maxDistance, RayHit& hit) const;
+
+		// Returns whether the sphere overlaps the box, and if so the direction
+		// and distance that would push it out
+		static bool SphereBoxContact(const float position[3], float radius, const float centre[3], float half, float normal[3], float& depth);
+
+		static const float GROUND_HEIGHT;
+		static const float RESTITUTION;
+		static const float REST_SPEED;
+		static const float FRICTION;
+		static const float SPIN_DAMPING;
+		static const std::uint32_t COLLIDE_GRAIN;
+		// Voxels that may fall asleep before the main index is rebuilt, on top
+		// of a sixty-fourth of its size
+		static const std::uint32_t RECENT_LIMIT;
+
+	private:
+		WorldCollision(const WorldCollision& rhs);
+		WorldCollision& operator=(const WorldCollision& rhs);
+
+		// Sleeping voxels with their id, stamp and box copied out in bucket order
+		struct StaticSet {
+			SpatialHash Hash;
+			std::vector<std::uint32_t> Ids;
+			std::vector<std::uint32_t> Stamps;
+			std::vector<float> X;
+			std::vector<float> Y;
+			std::vector<float> Z;
+			std::vector<float> Size;
+			// Bounds of the boxes
+			float Minimum[3];
+			float Maximum[3];
+		};
+
+		void BuildStatic(VoxelStore& store);
+		void BuildRecent(const VoxelStore& store);
+		void BuildSet(StaticSet& set, const VoxelStore& store, const std::vector<std::uint32_t>& slots, float cellSize);
+		std::uint32_t CollideRange(VoxelStore& store, std::uint32_t first, std::uint32_t last) const;
+		void RaycastSet(const StaticSet& set, const VoxelStore& store, const float origin[3], const float direction[3], RayHit& hit) const;
+
+		float mGroundHeight;
+		StaticSet mStatic;
+		StaticSet mRecent;
+		float mCellSize;
+		bool mStaticBuilt;
+		std::vector<VoxelStore::SleepRecord> mRecentRecords;
+		std::vector<std::uint32_t> mSlots;
+		std::vector<float> mX;
+		std::vector<float> mY;
+		std::vector<float> mZ;
+		std::vector<std::uint32_t> mRangeTouching;
+	};
+}
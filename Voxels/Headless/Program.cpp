@@ -0,0 +1,113 @@
+#include "ChunkSimulation.h"
+#include "GameTime.h"
+#include "JobSystem.h"
+#include "TerrainGenerator.h"
+#include "VoxelWorld.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace Library;
+using namespace Rendering;
+
+// Runs the demo scene without a window: a cube of voxels, a few blasts into
+// it, and the simulation stepped at 60 frames per second until the debris
+// settles. Prints how long the frames took, then walks a viewer across
+// generated terrain for a few seconds of 60 Hz frames while the world
+// streams around it. Terrain generation throughput is timed in VoxelsBench.
+//
+// Usage: VoxelsHeadless [voxels per edge] [blasts] [threads]
+int main(int argc, char* argv[])
+{
+	int edge = (argc > 1 ? std::atoi(argv[1]) : 16);
+	int blasts = (argc > 2 ? std::atoi(argv[2]) : 4);
+	unsigned int threads = (argc > 3 ? static_cast<unsigned int>(std::atoi(argv[3])) : 0);
+
+	JobSystem jobSystem(threads);
+	ChunkSimulation simulation(&jobSystem);
+	simulation.Store().Reserve(static_cast<std::uint32_t>(edge * edge * edge));
+	std::uint32_t levels = 0;
+	while ((1 << levels) < edge) {
+		levels++;
+	}
+	VoxelDag world(levels);
+	const std::uint32_t minimum[3] = { 0, 0, 0 };
+	const std::uint32_t maximum[3] = { static_cast<std::uint32_t>(edge), static_cast<std::uint32_t>(edge), static_cast<std::uint32_t>(edge) };
+	world.Fill(minimum, maximum, true);
+	simulation.AddVoxels(world, minimum, maximum, 2.0f);
+
+	typedef std::chrono::steady_clock Clock;
+	const double frameTime = 1.0 / 60.0;
+	const int settleFrames = 60 * 30;
+	GameTime gameTime;
+	double totalMs = 0.0;
+	double worstMs = 0.0;
+	int frames = 0;
+
+	for (int blast = 0; blast < blasts; blast++) {
+		// Walk the blasts across the top face of the cube, aiming at voxel centres
+		float along = static_cast<int>((blast + 0.5f) / blasts * edge) * 2.0f;
+		float centre = (edge / 2) * 2.0f;
+		const float origin[3] = { along, edge * 4.0f, centre };
+		const float down[3] = { 0.0f, -1.0f, 0.0f };
+		float distance = simulation.FindClosestVoxel(origin, down);
+		if (distance >= 0.0f) {
+			simulation.SetMotionVectors(along, origin[1] - distance, centre);
+		}
+
+		for (int frame = 0; frame < settleFrames; frame++) {
+			gameTime.SetElapsedGameTime(frameTime);
+			gameTime.SetTotalGameTime(gameTime.TotalGameTime() + frameTime);
+
+			Clock::time_point start = Clock::now();
+			simulation.Update(gameTime);
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			totalMs += ms;
+			worstMs = (ms > worstMs ? ms : worstMs);
+			frames++;
+
+			const ChunkStats& stats = simulation.Stats();
+			if (simulation.Store().ActiveCount() == 0 && stats.Clusters == 0) {
+				break;
+			}
+		}
+	}
+
+	const ChunkStats& stats = simulation.Stats();
+	std::printf("%d voxels, %d blasts, %u threads\n", edge * edge * edge, blasts, jobSystem.ThreadCount());
+	std::printf("world %u^3 held in %u nodes and %u bricks, %zu bytes\n", world.Size(), world.NodeCount(), world.BrickCount(), world.MemoryBytes());
+	std::printf("%d frames, %.3f ms mean, %.3f ms worst\n", frames, (frames > 0 ? totalMs / frames : 0.0), worstMs);
+	std::printf("%u voxels left, %u asleep, %u moving, %u in rigid bodies\n", simulation.VoxelCount(), stats.Sleeping,
+		simulation.Store().ActiveCount(), simulation.VoxelCount() - simulation.Store().Count());
+
+	TerrainGenerator terrain(1, 64.0f);
+
+	// Same lattice as the demo's chunk: cells two units apart. The viewer
+	// skims the top of the hills, crossing a chunk every 16 frames.
+	const float pitch = 2.0f;
+	const int walkFrames = 240;
+	VoxelWorld streamed([&terrain](const ChunkKey& key, ChunkGrid& grid) { terrain.Generate(key, grid); }, pitch, &jobSystem);
+	float viewer[3] = { 0.0f, (64.0f + TerrainGenerator::HEIGHT_RANGE) * pitch, 0.0f };
+	const float heading[3] = { 1.0f, 0.0f, 0.0f };
+	double streamMs = 0.0;
+	double streamWorstMs = 0.0;
+	std::size_t peakBytes = 0;
+	Clock::time_point next = Clock::now();
+	for (int frame = 0; frame < walkFrames; frame++) {
+		Clock::time_point frameStart = Clock::now();
+		streamed.Update(viewer, heading);
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+		streamMs += ms;
+		streamWorstMs = (ms > streamWorstMs ? ms : streamWorstMs);
+		peakBytes = (streamed.MemoryBytes() > peakBytes ? streamed.MemoryBytes() : peakBytes);
+
+		viewer[0] += ChunkGrid::SIZE * pitch / 16.0f;
+		next += std::chrono::microseconds(16667);
+		std::this_thread::sleep_until(next);
+	}
+	std::printf("streaming %d frames, update %.3f ms mean, %.3f ms worst, %u chunks loaded, %u loading, %zu bytes peak\n", walkFrames,
+		streamMs / walkFrames, streamWorstMs, streamed.LoadedCount(), streamed.LoadingCount(), peakBytes);
+
+	return 0;
+}
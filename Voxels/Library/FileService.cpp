@@ -0,0 +1,657 @@
+#include "FileService.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(VOXELS_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace Library
+{
+	RTTI_DEFINITIONS(FileService)
+
+	const std::uint32_t FileService::QueueDepth = 64;
+	const std::uint64_t FileService::MaximumTransfer = 1 << 30;
+
+	namespace
+	{
+		const std::intptr_t NoFile = -1;
+
+#if defined(_WIN32)
+		std::intptr_t OpenFile(const std::string& path)
+		{
+			HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			return (file != INVALID_HANDLE_VALUE ? reinterpret_cast<std::intptr_t>(file) : NoFile);
+		}
+
+		void CloseFile(std::intptr_t file)
+		{
+			CloseHandle(reinterpret_cast<HANDLE>(file));
+		}
+
+		bool FileSize(std::intptr_t file, std::uint64_t& size)
+		{
+			LARGE_INTEGER length;
+			if (!GetFileSizeEx(reinterpret_cast<HANDLE>(file), &length))
+			{
+				return false;
+			}
+			size = static_cast<std::uint64_t>(length.QuadPart);
+			return true;
+		}
+
+		// Bytes read, zero at the end of the file or -1 on failure
+		std::int64_t ReadAt(std::intptr_t file, std::uint8_t* buffer, std::uint64_t size, std::uint64_t offset)
+		{
+			OVERLAPPED position = {};
+			position.Offset = static_cast<DWORD>(offset);
+			position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+			DWORD read = 0;
+			if (!ReadFile(reinterpret_cast<HANDLE>(file), buffer, static_cast<DWORD>(size), &read, &position))
+			{
+				return (GetLastError() == ERROR_HANDLE_EOF ? 0 : -1);
+			}
+			return read;
+		}
+#else
+		std::intptr_t OpenFile(const std::string& path)
+		{
+			return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		}
+
+		void CloseFile(std::intptr_t file)
+		{
+			close(static_cast<int>(file));
+		}
+
+		bool FileSize(std::intptr_t file, std::uint64_t& size)
+		{
+			struct stat status;
+			if (fstat(static_cast<int>(file), &status) != 0)
+			{
+				return false;
+			}
+			size = static_cast<std::uint64_t>(status.st_size);
+			return true;
+		}
+
+		// Bytes read, zero at the end of the file or -1 on failure
+		std::int64_t ReadAt(std::intptr_t file, std::uint8_t* buffer, std::uint64_t size, std::uint64_t offset)
+		{
+			for (;;)
+			{
+				ssize_t read = pread(static_cast<int>(file), buffer, static_cast<std::size_t>(size), static_cast<off_t>(offset));
+				if (read >= 0 || errno != EINTR)
+				{
+					return read;
+				}
+			}
+		}
+#endif
+	}
+
+#if defined(VOXELS_IO_URING)
+	// The submission and completion queues of an io_uring, driven with the raw
+	// system calls. Only the worker thread touches it.
+	class FileService::Ring
+	{
+	public:
+		explicit Ring(std::uint32_t entries)
+			: mFile(-1), mSubmissionRing(MAP_FAILED), mCompletionRing(MAP_FAILED), mEntries(static_cast<io_uring_sqe*>(MAP_FAILED)),
+			mSubmissionSize(0), mCompletionSize(0), mEntriesSize(0), mUnsubmitted(0)
+		{
+			io_uring_params parameters;
+			std::memset(&parameters, 0, sizeof(parameters));
+			int file = static_cast<int>(syscall(__NR_io_uring_setup, entries, &parameters));
+			if (file < 0)
+			{
+				return;
+			}
+			mFile = file;
+
+			mSubmissionSize = parameters.sq_off.array + parameters.sq_entries * sizeof(std::uint32_t);
+			mCompletionSize = parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe);
+			mEntriesSize = parameters.sq_entries * sizeof(io_uring_sqe);
+			bool single = (parameters.features & IORING_FEAT_SINGLE_MMAP) != 0;
+			if (single)
+			{
+				mSubmissionSize = std::max(mSubmissionSize, mCompletionSize);
+			}
+
+			mSubmissionRing = mmap(nullptr, mSubmissionSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, file, IORING_OFF_SQ_RING);
+			if (single)
+			{
+				mCompletionRing = mSubmissionRing;
+			}
+			else
+			{
+				mCompletionRing = mmap(nullptr, mCompletionSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, file, IORING_OFF_CQ_RING);
+			}
+			mEntries = static_cast<io_uring_sqe*>(mmap(nullptr, mEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, file, IORING_OFF_SQES));
+			if (mSubmissionRing == MAP_FAILED || mCompletionRing == MAP_FAILED || mEntries == MAP_FAILED)
+			{
+				return;
+			}
+
+			std::uint8_t* submission = static_cast<std::uint8_t*>(mSubmissionRing);
+			mSubmissionTail = reinterpret_cast<std::uint32_t*>(submission + parameters.sq_off.tail);
+			mSubmissionMask = *reinterpret_cast<std::uint32_t*>(submission + parameters.sq_off.ring_mask);
+			mSubmissionArray = reinterpret_cast<std::uint32_t*>(submission + parameters.sq_off.array);
+
+			std::uint8_t* completion = static_cast<std::uint8_t*>(mCompletionRing);
+			mCompletionHead = reinterpret_cast<std::uint32_t*>(completion + parameters.cq_off.head);
+			mCompletionTail = reinterpret_cast<std::uint32_t*>(completion + parameters.cq_off.tail);
+			mCompletionMask = *reinterpret_cast<std::uint32_t*>(completion + parameters.cq_off.ring_mask);
+			mCompletions = reinterpret_cast<io_uring_cqe*>(completion + parameters.cq_off.cqes);
+		}
+
+		~Ring()
+		{
+			if (mEntries != MAP_FAILED)
+			{
+				munmap(mEntries, mEntriesSize);
+			}
+			if (mCompletionRing != MAP_FAILED && mCompletionRing != mSubmissionRing)
+			{
+				munmap(mCompletionRing, mCompletionSize);
+			}
+			if (mSubmissionRing != MAP_FAILED)
+			{
+				munmap(mSubmissionRing, mSubmissionSize);
+			}
+			if (mFile >= 0)
+			{
+				close(mFile);
+			}
+		}
+
+		bool IsOpen() const
+		{
+			return mFile >= 0 && mSubmissionRing != MAP_FAILED && mCompletionRing != MAP_FAILED && mEntries != MAP_FAILED;
+		}
+
+		// Queues a read; the caller keeps no more reads in flight than the ring has entries
+		void Push(std::intptr_t file, std::uint8_t* buffer, std::uint32_t size, std::uint64_t offset, std::uint64_t tag)
+		{
+			std::uint32_t tail = *mSubmissionTail;
+			std::uint32_t index = tail & mSubmissionMask;
+			io_uring_sqe& entry = mEntries[index];
+			std::memset(&entry, 0, sizeof(entry));
+			entry.opcode = IORING_OP_READ;
+			entry.fd = static_cast<int>(file);
+			entry.addr = reinterpret_cast<std::uintptr_t>(buffer);
+			entry.len = size;
+			entry.off = offset;
+			entry.user_data = tag;
+			mSubmissionArray[index] = index;
+			__atomic_store_n(mSubmissionTail, tail + 1, __ATOMIC_RELEASE);
+			mUnsubmitted++;
+		}
+
+		// Hands the queued reads to the kernel and waits until at least one
+		// read has completed
+		bool Submit()
+		{
+			for (;;)
+			{
+				long submitted = syscall(__NR_io_uring_enter, mFile, mUnsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+				if (submitted >= 0)
+				{
+					mUnsubmitted -= static_cast<std::uint32_t>(submitted);
+					return true;
+				}
+				if (errno != EINTR)
+				{
+					return false;
+				}
+			}
+		}
+
+		// Waits until at least one read the kernel holds has completed, without
+		// handing it any more
+		bool Wait()
+		{
+			for (;;)
+			{
+				if (syscall(__NR_io_uring_enter, mFile, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) >= 0)
+				{
+					return true;
+				}
+				if (errno != EINTR)
+				{
+					return false;
+				}
+			}
+		}
+
+		// Reads queued that the kernel has not taken yet
+		std::uint32_t Unsubmitted() const
+		{
+			return mUnsubmitted;
+		}
+
+		// Takes the next completion off the queue, if there is one
+		bool Next(std::uint64_t& tag, int& result)
+		{
+			std::uint32_t head = *mCompletionHead;
+			if (head == __atomic_load_n(mCompletionTail, __ATOMIC_ACQUIRE))
+			{
+				return false;
+			}
+
+			const io_uring_cqe& entry = mCompletions[head & mCompletionMask];
+			tag = entry.user_data;
+			result = entry.res;
+			__atomic_store_n(mCompletionHead, head + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+
+	private:
+		Ring(const Ring& rhs);
+		Ring& operator=(const Ring& rhs);
+
+		int mFile;
+		void* mSubmissionRing;
+		void* mCompletionRing;
+		io_uring_sqe* mEntries;
+		std::size_t mSubmissionSize;
+		std::size_t mCompletionSize;
+		std::size_t mEntriesSize;
+		std::uint32_t* mSubmissionTail;
+		std::uint32_t mSubmissionMask;
+		std::uint32_t* mSubmissionArray;
+		std::uint32_t* mCompletionHead;
+		std::uint32_t* mCompletionTail;
+		std::uint32_t mCompletionMask;
+		io_uring_cqe* mCompletions;
+		std::uint32_t mUnsubmitted;
+	};
+#else
+	class FileService::Ring
+	{
+	};
+#endif
+
+	FileService::FileService(bool useRing)
+		: mThread(), mRing(nullptr), mMutex(), mQueued(), mFinished(), mRequests(), mCompleted(), mPending(0), mAbandonedBuffers(0), mStopping(false)
+	{
+#if defined(VOXELS_IO_URING)
+		if (useRing)
+		{
+			mRing = new Ring(QueueDepth);
+			if (!mRing->IsOpen())
+			{
+				delete mRing;
+				mRing = nullptr;
+			}
+		}
+#else
+		(void)useRing;
+#endif
+
+		mThread = std::thread(&FileService::WorkerMain, this);
+	}
+
+	FileService::~FileService()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStopping = true;
+		}
+		mQueued.notify_all();
+		mThread.join();
+
+		// Reads that never ran or were never called back are dropped
+		for (Request* request : mRequests)
+		{
+			delete request;
+		}
+		for (Request* request : mCompleted)
+		{
+			delete[] request->Data;
+			delete request;
+		}
+		delete mRing;
+	}
+
+	void FileService::Read(const std::string& path, const ReadCallback& callback)
+	{
+		Queue(path, 0, 0, true, callback);
+	}
+
+	void FileService::Read(const std::string& path, std::uint64_t offset, std::uint64_t size, const ReadCallback& callback)
+	{
+		Queue(path, offset, size, false, callback);
+	}
+
+	std::uint32_t FileService::Update()
+	{
+		std::vector<Request*> completed;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			completed.swap(mCompleted);
+		}
+
+		// Callbacks may queue more reads, so they run without the lock
+		for (Request* request : completed)
+		{
+			if (request->Succeeded)
+			{
+				request->Callback(true, request->Data, static_cast<std::size_t>(request->Size));
+			}
+			else
+			{
+				request->Callback(false, nullptr, 0);
+			}
+			delete[] request->Data;
+			delete request;
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mPending -= static_cast<std::uint32_t>(completed.size());
+		return static_cast<std::uint32_t>(completed.size());
+	}
+
+	void FileService::Flush()
+	{
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				if (mPending == 0)
+				{
+					return;
+				}
+				mFinished.wait(lock, [this]() { return !mCompleted.empty(); });
+			}
+			Update();
+		}
+	}
+
+	std::uint32_t FileService::PendingCount() const
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mPending;
+	}
+
+	std::uint32_t FileService::AbandonedBuffers() const
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mAbandonedBuffers;
+	}
+
+	bool FileService::UsesRing() const
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mRing != nullptr;
+	}
+
+	void FileService::Queue(const std::string& path, std::uint64_t offset, std::uint64_t size, bool wholeFile, const ReadCallback& callback)
+	{
+		Request* request = new Request();
+		request->Path = path;
+		request->Offset = offset;
+		request->Size = size;
+		request->WholeFile = wholeFile;
+		request->Callback = callback;
+		request->Data = nullptr;
+		request->Done = 0;
+		request->File = NoFile;
+		request->Succeeded = false;
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mRequests.push_back(request);
+			mPending++;
+		}
+		mQueued.notify_one();
+	}
+
+	void FileService::WorkerMain()
+	{
+		std::vector<Request*> batch;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mQueued.wait(lock, [this]() { return mStopping || !mRequests.empty(); });
+				if (mStopping)
+				{
+					return;
+				}
+
+				while (!mRequests.empty() && batch.size() < QueueDepth)
+				{
+					batch.push_back(mRequests.front());
+					mRequests.pop_front();
+				}
+			}
+
+			for (Request* request : batch)
+			{
+				request->Succeeded = Prepare(*request);
+			}
+
+			if (mRing != nullptr)
+			{
+				ReadBatch(batch);
+			}
+			else
+			{
+				for (Request* request : batch)
+				{
+					if (request->Succeeded)
+					{
+						ReadDirect(*request);
+					}
+				}
+			}
+
+			for (Request* request : batch)
+			{
+				Complete(*request);
+			}
+			batch.clear();
+		}
+	}
+
+	bool FileService::Prepare(Request& request)
+	{
+		request.File = OpenFile(request.Path);
+		if (request.File == NoFile)
+		{
+			return false;
+		}
+
+		if (request.WholeFile && !FileSize(request.File, request.Size))
+		{
+			return false;
+		}
+		if (request.Size > std::numeric_limits<std::size_t>::max())
+		{
+			return false;
+		}
+
+		// Left uninitialized; every byte is read into before it is handed out
+		request.Data = new (std::nothrow) std::uint8_t[static_cast<std::size_t>(request.Size)];
+		return request.Data != nullptr;
+	}
+
+	void FileService::ReadBatch(std::vector<Request*>& batch)
+	{
+#if defined(VOXELS_IO_URING)
+		// Each request has at most one read in flight, and a batch is no
+		// bigger than the ring, so the ring never fills up
+		std::uint32_t inFlight = 0;
+		// Reads the kernel has taken and not yet completed, and the reads
+		// queued in the ring it has not taken yet, oldest first
+		std::vector<bool> handedOver(batch.size(), false);
+		std::deque<std::uint64_t> queued;
+		auto pushNext = [&](std::uint64_t index) {
+			Request& request = *batch[index];
+			std::uint64_t size = std::min(request.Size - request.Done, MaximumTransfer);
+			mRing->Push(request.File, request.Data + request.Done, static_cast<std::uint32_t>(size), request.Offset + request.Done, index);
+			queued.push_back(index);
+			inFlight++;
+		};
+		// The kernel takes queued reads in order
+		auto markHandedOver = [&]() {
+			while (queued.size() > mRing->Unsubmitted())
+			{
+				handedOver[queued.front()] = true;
+				queued.pop_front();
+			}
+		};
+
+		for (std::uint64_t index = 0; index < batch.size(); index++)
+		{
+			if (batch[index]->Succeeded && batch[index]->Size > 0)
+			{
+				pushNext(index);
+			}
+		}
+
+		while (inFlight > 0)
+		{
+			std::uint64_t index;
+			int result;
+			bool submitted = mRing->Submit();
+			markHandedOver();
+			if (!submitted)
+			{
+				// The kernel may still be writing into the buffers of the reads
+				// it was handed, and closing the ring does not wait for them, so
+				// their completions are collected first. Reads still queued in
+				// the ring never reached the kernel.
+				std::uint32_t running = inFlight - static_cast<std::uint32_t>(queued.size());
+				while (running > 0)
+				{
+					if (mRing->Next(index, result))
+					{
+						running--;
+						handedOver[index] = false;
+						Request& request = *batch[index];
+						request.Done += (result > 0 ? static_cast<std::uint64_t>(result) : 0);
+						request.Succeeded = request.Succeeded && result != 0;
+					}
+					else if (!mRing->Wait())
+					{
+						break;
+					}
+				}
+
+				// If even waiting fails, a read that may still be running keeps
+				// its buffer, which is left to it, and the request goes on in a
+				// fresh one
+				for (std::uint64_t r = 0; r < batch.size() && running > 0; r++)
+				{
+					Request& request = *batch[r];
+					if (handedOver[r])
+					{
+						std::uint8_t* data = new (std::nothrow) std::uint8_t[static_cast<std::size_t>(request.Size)];
+						if (data != nullptr)
+						{
+							std::memcpy(data, request.Data, static_cast<std::size_t>(request.Done));
+						}
+						request.Data = data;
+						request.Succeeded = request.Succeeded && data != nullptr;
+
+						std::lock_guard<std::mutex> lock(mMutex);
+						mAbandonedBuffers++;
+					}
+				}
+
+				Ring* ring = mRing;
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					mRing = nullptr;
+				}
+				delete ring;
+				for (Request* request : batch)
+				{
+					if (request->Succeeded && request->Done < request->Size)
+					{
+						ReadDirect(*request);
+					}
+				}
+				return;
+			}
+
+			while (mRing->Next(index, result))
+			{
+				inFlight--;
+				handedOver[index] = false;
+				Request& request = *batch[index];
+				if (result > 0)
+				{
+					request.Done += static_cast<std::uint64_t>(result);
+				}
+				else if (result == 0)
+				{
+					// The file ends before the range does
+					request.Succeeded = false;
+				}
+				else if (result != -EINTR && result != -EAGAIN)
+				{
+					// Kernels before 5.6 have rings but no plain read; finish it directly
+					ReadDirect(request);
+					continue;
+				}
+
+				if (request.Succeeded && request.Done < request.Size)
+				{
+					pushNext(index);
+				}
+			}
+		}
+#else
+		(void)batch;
+#endif
+	}
+
+	void FileService::ReadDirect(Request& request)
+	{
+		while (request.Done < request.Size)
+		{
+			std::uint64_t size = std::min(request.Size - request.Done, MaximumTransfer);
+			std::int64_t read = ReadAt(request.File, request.Data + request.Done, size, request.Offset + request.Done);
+			if (read <= 0)
+			{
+				request.Succeeded = false;
+				return;
+			}
+			request.Done += static_cast<std::uint64_t>(read);
+		}
+	}
+
+	void FileService::Complete(Request& request)
+	{
+		if (request.File != NoFile)
+		{
+			CloseFile(request.File);
+			request.File = NoFile;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mCompleted.push_back(&request);
+		}
+		mFinished.notify_all();
+	}
+}
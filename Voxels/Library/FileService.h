@@ -0,0 +1,107 @@
+#pragma once
+
+#include "RTTI.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Library
+{
+	// Reads files on a background thread and hands them back on the thread
+	// that calls Update(), normally once a frame from the game loop, so
+	// loading never blocks a frame.
+	//
+	// Reads are taken off the queue in batches of up to QueueDepth. On Linux,
+	// when built with VOXELS_IO_URING, a batch is submitted to an io_uring all
+	// at once and the reads complete in whatever order the disk serves them;
+	// otherwise, or if the kernel turns the ring down, each read is a plain
+	// positioned read in turn. Either way the data goes straight from the
+	// kernel into the buffer handed to the callback, with no copy in between.
+	// Files that only need looking at in place are better opened as a
+	// MappedFile.
+	class FileService : public RTTI
+	{
+		RTTI_DECLARATIONS(FileService, RTTI)
+
+	public:
+		// The data is only valid during the call; it is nullptr with a size of
+		// zero if the read failed
+		typedef std::function<void(bool succeeded, const std::uint8_t* data, std::size_t size)> ReadCallback;
+
+		// Without useRing, reads are plain positioned reads even where a ring
+		// is available
+		explicit FileService(bool useRing = true);
+		~FileService();
+
+		// Reads the whole file
+		void Read(const std::string& path, const ReadCallback& callback);
+		// Reads size bytes from offset; fails if the file is shorter
+		void Read(const std::string& path, std::uint64_t offset, std::uint64_t size, const ReadCallback& callback);
+
+		// Calls back for every read that has finished and returns how many
+		// there were
+		std::uint32_t Update();
+		// Blocks until every read so far has finished and calls them back
+		void Flush();
+
+		// Reads queued or in flight whose callbacks have not run yet
+		std::uint32_t PendingCount() const;
+		bool UsesRing() const;
+		// Buffers left to the kernel because the ring failed while reads into
+		// them might still be running; each one leaks, so this stays zero
+		// unless the ring breaks mid-batch
+		std::uint32_t AbandonedBuffers() const;
+
+		static const std::uint32_t QueueDepth;
+		// Largest read handed to the kernel in one go; longer reads are split
+		static const std::uint64_t MaximumTransfer;
+
+	private:
+		FileService(const FileService& rhs);
+		FileService& operator=(const FileService& rhs);
+
+		struct Request
+		{
+			std::string Path;
+			std::uint64_t Offset;
+			// Whole file when WholeFile is set, filled in once the file is open
+			std::uint64_t Size;
+			bool WholeFile;
+			ReadCallback Callback;
+			std::uint8_t* Data;
+			std::uint64_t Done;
+			// File descriptor or handle, -1 while the file is not open
+			std::intptr_t File;
+			bool Succeeded;
+		};
+
+		class Ring;
+
+		void Queue(const std::string& path, std::uint64_t offset, std::uint64_t size, bool wholeFile, const ReadCallback& callback);
+		void WorkerMain();
+		// Opens the file and allocates the buffer, or fails the request
+		bool Prepare(Request& request);
+		void ReadBatch(std::vector<Request*>& batch);
+		void ReadDirect(Request& request);
+		void Complete(Request& request);
+
+		std::thread mThread;
+		// Belongs to the worker thread, which uses it without the lock and
+		// only clears it under the lock; UsesRing() takes the lock to read it
+		Ring* mRing;
+		mutable std::mutex mMutex;
+		std::condition_variable mQueued;
+		std::condition_variable mFinished;
+		std::deque<Request*> mRequests;
+		std::vector<Request*> mCompleted;
+		std::uint32_t mPending;
+		std::uint32_t mAbandonedBuffers;
+		bool mStopping;
+	};
+}
@@ -0,0 +1,91 @@
+#include "FixedTimestep.h"
+
+namespace Library
+{
+	const double FixedTimestep::DefaultStepSize = 1.0 / 60.0;
+	const unsigned int FixedTimestep::DefaultMaxSubsteps = 4;
+
+	FixedTimestep::FixedTimestep()
+		: mStepSize(DefaultStepSize), mMaxSubsteps(DefaultMaxSubsteps), mAccumulator(0.0), mDroppedTime(0.0), mStepTime()
+	{
+		mStepTime.SetElapsedGameTime(mStepSize);
+	}
+
+	FixedTimestep::FixedTimestep(double stepSize, unsigned int maxSubsteps)
+		: mStepSize(stepSize), mMaxSubsteps(maxSubsteps), mAccumulator(0.0), mDroppedTime(0.0), mStepTime()
+	{
+		mStepTime.SetElapsedGameTime(mStepSize);
+	}
+
+	double FixedTimestep::StepSize() const
+	{
+		return mStepSize;
+	}
+
+	void FixedTimestep::SetStepSize(double stepSize)
+	{
+		mStepSize = stepSize;
+		mStepTime.SetElapsedGameTime(mStepSize);
+	}
+
+	unsigned int FixedTimestep::MaxSubsteps() const
+	{
+		return mMaxSubsteps;
+	}
+
+	void FixedTimestep::SetMaxSubsteps(unsigned int maxSubsteps)
+	{
+		mMaxSubsteps = maxSubsteps;
+	}
+
+	unsigned int FixedTimestep::Advance(const GameTime& gameTime)
+	{
+		// A clock that stepped backwards takes no steps rather than unwinding
+		// the ones already taken
+		if (gameTime.ElapsedGameTime() > 0.0)
+		{
+			mAccumulator += gameTime.ElapsedGameTime();
+		}
+
+		unsigned int steps = static_cast<unsigned int>(mAccumulator / mStepSize);
+		mDroppedTime = 0.0;
+		if (steps > mMaxSubsteps)
+		{
+			// Keep the fractional part so interpolation stays smooth after a hitch
+			double kept = mAccumulator - steps * mStepSize;
+			mDroppedTime = (steps - mMaxSubsteps) * mStepSize;
+			steps = mMaxSubsteps;
+			mAccumulator = steps * mStepSize + kept;
+		}
+
+		return steps;
+	}
+
+	void FixedTimestep::Reset()
+	{
+		mAccumulator = 0.0;
+		mDroppedTime = 0.0;
+		mStepTime.SetTotalGameTime(0.0);
+	}
+
+	const GameTime& FixedTimestep::StepTime() const
+	{
+		return mStepTime;
+	}
+
+	void FixedTimestep::CompleteStep()
+	{
+		mAccumulator -= mStepSize;
+		mStepTime.SetTotalGameTime(mStepTime.TotalGameTime() + mStepSize);
+	}
+
+	double FixedTimestep::Alpha() const
+	{
+		return mAccumulator / mStepSize;
+	}
+
+	double FixedTimestep::DroppedTime() const
+	{
+		return mDroppedTime;
+	}
+}
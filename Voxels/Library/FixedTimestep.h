@@ -0,0 +1,42 @@
+#pragma once
+
+#include "GameTime.h"
+
+namespace Library
+{
+	// Turns the variable frame time reported by GameClock into a whole number of
+	// fixed simulation steps. Leftover time is carried to the next frame and
+	// exposed as an interpolation factor for drawing between the last two
+	// steps. At most MaxSubsteps() steps are taken per frame; time beyond that
+	// is dropped so a slow frame cannot snowball into ever longer ones. A
+	// zero or negative frame time takes no steps and leaves Alpha() as it was.
+	class FixedTimestep
+	{
+	public:
+		FixedTimestep();
+		FixedTimestep(double stepSize, unsigned int maxSubsteps);
+
+		double StepSize() const;
+		void SetStepSize(double stepSize);
+		unsigned int MaxSubsteps() const;
+		void SetMaxSubsteps(unsigned int maxSubsteps);
+
+		unsigned int Advance(const GameTime& gameTime);
+		void Reset();
+
+		const GameTime& StepTime() const;
+		void CompleteStep();
+		double Alpha() const;
+		double DroppedTime() const;
+
+		static const double DefaultStepSize;
+		static const unsigned int DefaultMaxSubsteps;
+
+	private:
+		double mStepSize;
+		unsigned int mMaxSubsteps;
+		double mAccumulator;
+		double mDroppedTime;
+		GameTime mStepTime;
+	};
+}
@@ -1,5 +1,4 @@
 #include "GameTime.h"
-#include "stdafx.h"
 
 namespace Library
 {
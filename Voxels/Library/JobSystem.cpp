@@ -0,0 +1,395 @@
+#include "JobSystem.h"
+
+namespace Library
+{
+	RTTI_DEFINITIONS(JobSystem)
+
+	class JobSystem::Job
+	{
+	public:
+		Job(const JobFunction& function, Job* parent)
+			: Function(function), Parent(parent), Unfinished(1), Dependencies(1), References(1), Finished(false), Background(false)
+		{
+		}
+
+		JobFunction Function;
+		Job* Parent;
+
+		// The job itself plus every child that has not finished yet
+		std::atomic<int> Unfinished;
+		// One token released by Run() plus one per unfinished predecessor
+		std::atomic<int> Dependencies;
+		std::atomic<int> References;
+
+		std::mutex ContinuationMutex;
+		std::vector<Job*> Continuations;
+		bool Finished;
+
+		// Set by RunInBackground() before the job is first submitted
+		bool Background;
+	};
+
+	namespace
+	{
+		thread_local const JobSystem* sCurrentSystem = nullptr;
+		thread_local unsigned int sCurrentQueue = 0;
+
+		const int SpinCount = 64;
+	}
+
+	JobSystem::JobSystem(unsigned int threadCount)
+		: mThreads(), mQueues(), mBackgroundQueue(), mQueuedJobs(0), mBackgroundJobs(0), mSleepingThreads(0), mStopping(false)
+	{
+		if (threadCount == 0)
+		{
+			threadCount = std::thread::hardware_concurrency();
+		}
+		if (threadCount == 0)
+		{
+			threadCount = 1;
+		}
+
+		for (unsigned int i = 0; i < threadCount; i++)
+		{
+			mQueues.push_back(new WorkQueue());
+		}
+
+		sCurrentSystem = this;
+		sCurrentQueue = 0;
+
+		for (unsigned int i = 1; i < threadCount; i++)
+		{
+			mThreads.push_back(std::thread(&JobSystem::WorkerMain, this, i));
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mSleepMutex);
+			mStopping = true;
+		}
+		mSleepCondition.notify_all();
+
+		for (std::thread& thread : mThreads)
+		{
+			thread.join();
+		}
+
+		for (WorkQueue* queue : mQueues)
+		{
+			delete queue;
+		}
+
+		if (sCurrentSystem == this)
+		{
+			sCurrentSystem = nullptr;
+		}
+	}
+
+	unsigned int JobSystem::ThreadCount() const
+	{
+		return static_cast<unsigned int>(mQueues.size());
+	}
+
+	JobSystem::Job* JobSystem::CreateJob(const JobFunction& function)
+	{
+		return new Job(function, nullptr);
+	}
+
+	JobSystem::Job* JobSystem::CreateChildJob(Job* parent, const JobFunction& function)
+	{
+		parent->Unfinished++;
+		AddReference(parent);
+
+		return new Job(function, parent);
+	}
+
+	void JobSystem::AddContinuation(Job* job, Job* continuation)
+	{
+		// Must be called before Run(continuation); a job that has already
+		// finished does not hold the continuation back
+		std::lock_guard<std::mutex> lock(job->ContinuationMutex);
+		if (job->Finished == false)
+		{
+			continuation->Dependencies++;
+			AddReference(continuation);
+			job->Continuations.push_back(continuation);
+		}
+	}
+
+	void JobSystem::Run(Job* job)
+	{
+		// Reference held until the job and all of its children have finished
+		AddReference(job);
+		Submit(job);
+	}
+
+	void JobSystem::RunInBackground(Job* job)
+	{
+		job->Background = true;
+		Run(job);
+	}
+
+	void JobSystem::Wait(Job* job)
+	{
+		while (IsComplete(job) == false)
+		{
+			if (TryRunOne() == false)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		Release(job);
+	}
+
+	void JobSystem::Release(Job* job)
+	{
+		if (job->References.fetch_sub(1) == 1)
+		{
+			delete job;
+		}
+	}
+
+	bool JobSystem::IsComplete(const Job* job) const
+	{
+		return job->Unfinished.load() == 0;
+	}
+
+	void JobSystem::ParallelFor(std::uint32_t count, std::uint32_t grainSize, const RangeFunction& function)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		if (grainSize == 0)
+		{
+			grainSize = 1;
+		}
+
+		if (count <= grainSize || mQueues.size() == 1)
+		{
+			function(0, count);
+			return;
+		}
+
+		Job* root = CreateJob(JobFunction());
+		for (std::uint32_t begin = 0; begin < count; begin += grainSize)
+		{
+			std::uint32_t end = (count - begin > grainSize ? begin + grainSize : count);
+			Job* child = CreateChildJob(root, [&function, begin, end]() { function(begin, end); });
+			Run(child);
+			Release(child);
+		}
+
+		Run(root);
+		Wait(root);
+	}
+
+	void JobSystem::WorkerMain(unsigned int index)
+	{
+		sCurrentSystem = this;
+		sCurrentQueue = index;
+
+		int idle = 0;
+		while (mStopping == false)
+		{
+			if (TryRunOne())
+			{
+				idle = 0;
+				continue;
+			}
+
+			if (++idle < SpinCount)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(mSleepMutex);
+			mSleepingThreads++;
+			mSleepCondition.wait(lock, [this]() { return mQueuedJobs.load() > 0 || mBackgroundJobs.load() > 0 || mStopping; });
+			mSleepingThreads--;
+			idle = 0;
+		}
+	}
+
+	unsigned int JobSystem::CurrentQueue() const
+	{
+		// Threads that do not belong to this system share the first queue
+		return (sCurrentSystem == this ? sCurrentQueue : 0);
+	}
+
+	void JobSystem::Push(Job* job)
+	{
+		bool background = false;
+		for (const Job* owner = job; owner != nullptr && background == false; owner = owner->Parent)
+		{
+			background = owner->Background;
+		}
+
+		if (background)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mBackgroundQueue.Mutex);
+				mBackgroundQueue.Jobs.push_back(job);
+			}
+			mBackgroundJobs++;
+		}
+		else
+		{
+			WorkQueue* queue = mQueues[CurrentQueue()];
+			{
+				std::lock_guard<std::mutex> lock(queue->Mutex);
+				queue->Jobs.push_back(job);
+			}
+			mQueuedJobs++;
+		}
+
+		if (mSleepingThreads.load() > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mSleepMutex);
+			}
+			mSleepCondition.notify_one();
+		}
+	}
+
+	JobSystem::Job* JobSystem::Pop(unsigned int index)
+	{
+		// The owner works on its newest job, which is the one most likely to be in cache
+		WorkQueue* queue = mQueues[index];
+		std::lock_guard<std::mutex> lock(queue->Mutex);
+		if (queue->Jobs.empty())
+		{
+			return nullptr;
+		}
+
+		Job* job = queue->Jobs.back();
+		queue->Jobs.pop_back();
+		mQueuedJobs--;
+
+		return job;
+	}
+
+	JobSystem::Job* JobSystem::Steal(unsigned int thief)
+	{
+		// Thieves take the oldest job, which tends to be the largest piece of work
+		unsigned int count = static_cast<unsigned int>(mQueues.size());
+		for (unsigned int i = 1; i < count; i++)
+		{
+			WorkQueue* queue = mQueues[(thief + i) % count];
+			std::lock_guard<std::mutex> lock(queue->Mutex);
+			if (queue->Jobs.empty() == false)
+			{
+				Job* job = queue->Jobs.front();
+				queue->Jobs.pop_front();
+				mQueuedJobs--;
+
+				return job;
+			}
+		}
+
+		return nullptr;
+	}
+
+	JobSystem::Job* JobSystem::PopBackground()
+	{
+		// Background jobs run in the order they were queued
+		std::lock_guard<std::mutex> lock(mBackgroundQueue.Mutex);
+		if (mBackgroundQueue.Jobs.empty())
+		{
+			return nullptr;
+		}
+
+		Job* job = mBackgroundQueue.Jobs.front();
+		mBackgroundQueue.Jobs.pop_front();
+		mBackgroundJobs--;
+
+		return job;
+	}
+
+	bool JobSystem::TryRunOne()
+	{
+		unsigned int index = CurrentQueue();
+		Job* job = nullptr;
+		if (mQueuedJobs.load() > 0)
+		{
+			job = Pop(index);
+			if (job == nullptr)
+			{
+				job = Steal(index);
+			}
+		}
+
+		// Worker 0 and outside threads leave background jobs to the workers
+		bool worker = (sCurrentSystem == this && sCurrentQueue != 0);
+		if (job == nullptr && mBackgroundJobs.load() > 0 && (worker || mThreads.empty()))
+		{
+			job = PopBackground();
+		}
+
+		if (job == nullptr)
+		{
+			return false;
+		}
+
+		Execute(job);
+		return true;
+	}
+
+	void JobSystem::Execute(Job* job)
+	{
+		if (job->Function)
+		{
+			job->Function();
+		}
+
+		Finish(job);
+	}
+
+	void JobSystem::Finish(Job* job)
+	{
+		if (job->Unfinished.fetch_sub(1) != 1)
+		{
+			return;
+		}
+
+		std::vector<Job*> continuations;
+		{
+			std::lock_guard<std::mutex> lock(job->ContinuationMutex);
+			job->Finished = true;
+			continuations.swap(job->Continuations);
+		}
+
+		for (Job* continuation : continuations)
+		{
+			Submit(continuation);
+			Release(continuation);
+		}
+
+		Job* parent = job->Parent;
+		if (parent != nullptr)
+		{
+			Finish(parent);
+			Release(parent);
+		}
+
+		Release(job);
+	}
+
+	void JobSystem::Submit(Job* job)
+	{
+		if (job->Dependencies.fetch_sub(1) == 1)
+		{
+			Push(job);
+		}
+	}
+
+	void JobSystem::AddReference(Job* job)
+	{
+		job->References++;
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "RTTI.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Library
+{
+	// Fixed pool of worker threads, each with its own work-stealing deque. The
+	// thread that creates the system acts as worker 0 while it waits, so
+	// Wait() and ParallelFor() run jobs instead of blocking.
+	//
+	// Jobs passed to RunInBackground() go on a separate queue that only the
+	// worker threads take from, and only when they have nothing else to do, so
+	// long work such as streaming never runs inside a Wait() on the main
+	// thread. Children run after their parent was passed to RunInBackground()
+	// are background jobs too. With no worker threads, Wait() runs background
+	// jobs as well, or they would never run.
+	//
+	// A Job handle returned by CreateJob()/CreateChildJob() is owned by the
+	// caller until it is passed to Wait() or Release(); the system keeps its own
+	// references for as long as the job is queued, has running children or has
+	// continuations waiting on it.
+	class JobSystem : public RTTI
+	{
+		RTTI_DECLARATIONS(JobSystem, RTTI)
+
+	public:
+		class Job;
+		typedef std::function<void()> JobFunction;
+		typedef std::function<void(std::uint32_t begin, std::uint32_t end)> RangeFunction;
+
+		explicit JobSystem(unsigned int threadCount = 0);
+		~JobSystem();
+
+		unsigned int ThreadCount() const;
+
+		Job* CreateJob(const JobFunction& function);
+		Job* CreateChildJob(Job* parent, const JobFunction& function);
+		void AddContinuation(Job* job, Job* continuation);
+		void Run(Job* job);
+		void RunInBackground(Job* job);
+		void Wait(Job* job);
+		void Release(Job* job);
+		bool IsComplete(const Job* job) const;
+
+		void ParallelFor(std::uint32_t count, std::uint32_t grainSize, const RangeFunction& function);
+
+	private:
+		JobSystem(const JobSystem& rhs);
+		JobSystem& operator=(const JobSystem& rhs);
+
+		struct WorkQueue
+		{
+			std::mutex Mutex;
+			std::deque<Job*> Jobs;
+		};
+
+		void WorkerMain(unsigned int index);
+		unsigned int CurrentQueue() const;
+		void Push(Job* job);
+		Job* Pop(unsigned int queue);
+		Job* Steal(unsigned int thief);
+		Job* PopBackground();
+		bool TryRunOne();
+		void Execute(Job* job);
+		void Finish(Job* job);
+		void Submit(Job* job);
+		void AddReference(Job* job);
+
+		std::vector<std::thread> mThreads;
+		std::vector<WorkQueue*> mQueues;
+		WorkQueue mBackgroundQueue;
+		std::atomic<int> mQueuedJobs;
+		std::atomic<int> mBackgroundJobs;
+		std::atomic<int> mSleepingThreads;
+		std::atomic<bool> mStopping;
+		std::mutex mSleepMutex;
+		std::condition_variable mSleepCondition;
+	};
+}
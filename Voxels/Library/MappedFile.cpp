@@ -0,0 +1,158 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Library
+{
+	MappedFile::MappedFile()
+		: mOpen(false), mData(nullptr), mSize(0)
+#if defined(_WIN32)
+		, mFile(INVALID_HANDLE_VALUE), mMapping(nullptr)
+#endif
+	{
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+#if defined(_WIN32)
+	bool MappedFile::Open(const std::string& path)
+	{
+		Close();
+
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size))
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		mFile = file;
+		mSize = static_cast<std::uint64_t>(size.QuadPart);
+		mOpen = true;
+		if (mSize == 0)
+		{
+			return true;
+		}
+
+		// A mapping can not be made of an empty file, hence the check above
+		mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mMapping != nullptr)
+		{
+			mData = static_cast<const std::uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+		}
+		if (mData == nullptr)
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (mData != nullptr)
+		{
+			UnmapViewOfFile(mData);
+		}
+		if (mMapping != nullptr)
+		{
+			CloseHandle(mMapping);
+		}
+		if (mFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(mFile);
+		}
+
+		mOpen = false;
+		mData = nullptr;
+		mSize = 0;
+		mFile = INVALID_HANDLE_VALUE;
+		mMapping = nullptr;
+	}
+#else
+	bool MappedFile::Open(const std::string& path)
+	{
+		Close();
+
+		int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (file < 0)
+		{
+			return false;
+		}
+
+		struct stat status;
+		if (fstat(file, &status) != 0)
+		{
+			close(file);
+			return false;
+		}
+
+		// The mapping holds its own reference to the file
+		std::uint64_t size = static_cast<std::uint64_t>(status.st_size);
+		void* data = nullptr;
+		if (size > 0)
+		{
+			data = mmap(nullptr, static_cast<std::size_t>(size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (data == MAP_FAILED)
+			{
+				close(file);
+				return false;
+			}
+			madvise(data, static_cast<std::size_t>(size), MADV_SEQUENTIAL);
+		}
+		close(file);
+
+		mOpen = true;
+		mData = static_cast<const std::uint8_t*>(data);
+		mSize = size;
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (mData != nullptr)
+		{
+			munmap(const_cast<std::uint8_t*>(mData), static_cast<std::size_t>(mSize));
+		}
+
+		mOpen = false;
+		mData = nullptr;
+		mSize = 0;
+	}
+#endif
+
+	bool MappedFile::IsOpen() const
+	{
+		return mOpen;
+	}
+
+	const std::uint8_t* MappedFile::Data() const
+	{
+		return mData;
+	}
+
+	std::uint64_t MappedFile::Size() const
+	{
+		return mSize;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Library
+{
+	// A file mapped read-only into memory. Data() points straight at the
+	// operating system's page cache, so nothing is copied and pages are only
+	// read from disk when they are first touched. The view stays valid until
+	// Close() or the destructor.
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		// Returns false if the file could not be opened or mapped. An empty
+		// file opens with no data.
+		bool Open(const std::string& path);
+		void Close();
+
+		bool IsOpen() const;
+		const std::uint8_t* Data() const;
+		std::uint64_t Size() const;
+
+	private:
+		MappedFile(const MappedFile& rhs);
+		MappedFile& operator=(const MappedFile& rhs);
+
+		bool mOpen;
+		const std::uint8_t* mData;
+		std::uint64_t mSize;
+#if defined(_WIN32)
+		void* mFile;
+		void* mMapping;
+#endif
+	};
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 namespace Library
@@ -66,5 +67,8 @@ namespace Library
 	   private:                                                                                              \
             static unsigned int sRunTimeTypeId;
 
-    #define RTTI_DEFINITIONS(Type) unsigned int Type::sRunTimeTypeId = (unsigned int)& Type::sRunTimeTypeId;
+    // The id is the low bits of the address of the type's own id, which differ
+    // between types within one image; a plain pointer cast does not compile
+    // where pointers are wider than unsigned int
+    #define RTTI_DEFINITIONS(Type) unsigned int Type::sRunTimeTypeId = static_cast<unsigned int>(reinterpret_cast<std::uintptr_t>(&Type::sRunTimeTypeId));
 }
\ No newline at end of file
@@ -12,7 +12,6 @@ namespace Library
 		static void GetFileName(const std::string& inputPath, std::string& filename);
 		static void GetDirectory(const std::string& inputPath, std::string& directory);
 		static void GetFileNameAndDirectory(const std::string& inputPath, std::string& directory, std::string& filename);
-		static void LoadBinaryFile(const std::wstring& filename, std::vector<char>& data);
 		static void ToWideString(const std::string& source, std::wstring& dest);
 		static std::wstring ToWideString(const std::string& source);
 		static void PathJoin(std::wstring& dest, const std::wstring& sourceDirectory, const std::wstring& sourceFile);
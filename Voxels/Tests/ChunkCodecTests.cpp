@@ -0,0 +1,260 @@
+#include "Test.h"
+#include "ChunkCodec.h"
+#include "ChunkGrid.h"
+#include "VoxelStore.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace Rendering;
+
+namespace {
+	// Header fields the tests rewrite, by byte offset
+	const std::size_t ENCODING_OFFSET = 6;
+	const std::size_t PAYLOAD_SIZE_OFFSET = 12;
+	const std::size_t CHECKSUM_OFFSET = 16;
+
+	// Cells drawn at random from air and materials 1 to materials
+	ChunkGrid Noise(std::uint32_t materials, std::uint32_t stream)
+	{
+		std::vector<std::uint16_t> cells(ChunkGrid::VOLUME);
+		for (std::uint32_t cell = 0; cell < ChunkGrid::VOLUME; cell++) {
+			Random random(cell, stream);
+			std::uint32_t material = static_cast<std::uint32_t>(random.NextRange(0.0f, static_cast<float>(materials) + 0.999f));
+			cells[cell] = static_cast<std::uint16_t>(material);
+		}
+		ChunkGrid grid;
+		grid.Assign(cells.data());
+		return grid;
+	}
+
+	// Horizontal layers a few cells thick, which encode as runs
+	ChunkGrid Layers()
+	{
+		std::vector<std::uint16_t> cells(ChunkGrid::VOLUME);
+		for (std::uint32_t cell = 0; cell < ChunkGrid::VOLUME; cell++) {
+			std::uint32_t y = cell / ChunkGrid::SIZE % ChunkGrid::SIZE;
+			cells[cell] = static_cast<std::uint16_t>(y < 20 ? 1 + y / 7 : ChunkGrid::EMPTY_MATERIAL);
+		}
+		ChunkGrid grid;
+		grid.Assign(cells.data());
+		return grid;
+	}
+
+	bool SameCells(const ChunkGrid& a, const ChunkGrid& b)
+	{
+		if (a.SolidCount() != b.SolidCount() || a.ExposedFaceCount() != b.ExposedFaceCount()) {
+			return false;
+		}
+		for (std::uint32_t z = 0; z < ChunkGrid::SIZE; z++) {
+			for (std::uint32_t y = 0; y < ChunkGrid::SIZE; y++) {
+				if (a.Row(y, z) != b.Row(y, z)) {
+					return false;
+				}
+				for (std::uint32_t x = 0; x < ChunkGrid::SIZE; x++) {
+					if (a.Get(x, y, z) != b.Get(x, y, z)) {
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	std::uint8_t Encoding(const std::vector<std::uint8_t>& data)
+	{
+		return data[ENCODING_OFFSET];
+	}
+
+	std::size_t CountsOffset(const ChunkGrid& grid)
+	{
+		return ChunkCodec::HEADER_SIZE + (grid.PaletteSize() * sizeof(std::uint16_t) + 7) / 8 * 8;
+	}
+
+	std::size_t PayloadOffset(const ChunkGrid& grid)
+	{
+		return CountsOffset(grid) + (grid.PaletteSize() * sizeof(std::uint32_t) + 7) / 8 * 8;
+	}
+
+	void AddToCount(std::vector<std::uint8_t>& data, const ChunkGrid& grid, std::uint32_t entry, std::int32_t change)
+	{
+		std::uint32_t count;
+		std::memcpy(&count, data.data() + CountsOffset(grid) + entry * sizeof(count), sizeof(count));
+		count += change;
+		std::memcpy(data.data() + CountsOffset(grid) + entry * sizeof(count), &count, sizeof(count));
+	}
+
+	// Recomputes the checksum after a test has edited the body, so the
+	// decoder's later checks are the ones that have to catch the edit
+	void Reseal(std::vector<std::uint8_t>& data)
+	{
+		std::uint64_t checksum = ChunkCodec::Checksum(data.data() + ChunkCodec::HEADER_SIZE, data.size() - ChunkCodec::HEADER_SIZE);
+		std::memcpy(data.data() + CHECKSUM_OFFSET, &checksum, sizeof(checksum));
+	}
+
+	// Decoding into a grid that already holds a chunk must leave it alone
+	bool DecodeFails(const std::vector<std::uint8_t>& data)
+	{
+		ChunkGrid grid = Layers();
+		ChunkGrid before = Layers();
+		bool decoded = ChunkCodec::Decode(data.data(), data.size(), grid);
+		return !decoded && SameCells(grid, before);
+	}
+
+	void CheckRoundTrip(const ChunkGrid& grid, ChunkCodec::Encoding encoding)
+	{
+		std::vector<std::uint8_t> data;
+		std::size_t size = ChunkCodec::Encode(grid, data);
+		REQUIRE(size == data.size());
+		CHECK(Encoding(data) == encoding);
+		CHECK(ChunkCodec::EncodedSize(data.data(), data.size()) == size);
+
+		ChunkGrid fresh;
+		CHECK(ChunkCodec::Decode(data.data(), data.size(), fresh));
+		CHECK(SameCells(fresh, grid));
+		CHECK(fresh.PaletteSize() == grid.PaletteSize());
+		CHECK(fresh.BitsPerEntry() == grid.BitsPerEntry());
+
+		// A reused grid of another width takes the chunk over whole
+		ChunkGrid reused = Noise(300, 9);
+		CHECK(ChunkCodec::Decode(data.data(), data.size(), reused));
+		CHECK(SameCells(reused, grid));
+
+		// And decodes on after an edit, the same as the original would
+		reused.Set(3, 4, 5, 7);
+		ChunkGrid edited = grid;
+		edited.Set(3, 4, 5, 7);
+		CHECK(SameCells(reused, edited));
+	}
+}
+
+TEST(ChunkCodec, RoundTripUniform)
+{
+	ChunkGrid empty;
+	CheckRoundTrip(empty, ChunkCodec::UNIFORM);
+	ChunkGrid full;
+	full.Fill(3);
+	CheckRoundTrip(full, ChunkCodec::UNIFORM);
+}
+
+TEST(ChunkCodec, RoundTripPacked)
+{
+	// One grid at each width from 1 to 16 bits per entry
+	const std::uint32_t materials[] = { 1, 3, 12, 200, 5000 };
+	for (std::uint32_t count : materials) {
+		ChunkGrid grid = Noise(count, count);
+		CheckRoundTrip(grid, ChunkCodec::PACKED);
+	}
+}
+
+TEST(ChunkCodec, RoundTripRuns)
+{
+	CheckRoundTrip(Layers(), ChunkCodec::RUNS);
+
+	// A run that spans whole words, then single cells at its ends
+	ChunkGrid grid = Layers();
+	grid.Set(0, 0, 0, 9);
+	grid.Set(31, 31, 31, 9);
+	CheckRoundTrip(grid, ChunkCodec::RUNS);
+}
+
+TEST(ChunkCodec, RejectsPackedEntryOutsidePalette)
+{
+	// Air and two materials at two bits per entry leave the value 3 unused
+	ChunkGrid grid = Noise(2, 1);
+	REQUIRE(grid.PaletteSize() == 3);
+	REQUIRE(grid.BitsPerEntry() == 2);
+	std::vector<std::uint8_t> data;
+	ChunkCodec::Encode(grid, data);
+	REQUIRE(Encoding(data) == ChunkCodec::PACKED);
+
+	data[PayloadOffset(grid) + 100] |= 0x03;
+	Reseal(data);
+	CHECK(DecodeFails(data));
+}
+
+TEST(ChunkCodec, RejectsRunEntryOutsidePalette)
+{
+	ChunkGrid grid = Layers();
+	std::vector<std::uint8_t> data;
+	ChunkCodec::Encode(grid, data);
+	REQUIRE(Encoding(data) == ChunkCodec::RUNS);
+
+	std::uint16_t entry = static_cast<std::uint16_t>(grid.PaletteSize());
+	std::memcpy(data.data() + PayloadOffset(grid) + 4, &entry, sizeof(entry));
+	Reseal(data);
+	CHECK(DecodeFails(data));
+}
+
+TEST(ChunkCodec, RejectsPackedCountMismatch)
+{
+	ChunkGrid grid = Noise(3, 2);
+	std::vector<std::uint8_t> data;
+	ChunkCodec::Encode(grid, data);
+	REQUIRE(Encoding(data) == ChunkCodec::PACKED);
+
+	// The counts still add up to the chunk, but not entry by entry
+	AddToCount(data, grid, 0, 1);
+	AddToCount(data, grid, 1, -1);
+	Reseal(data);
+	CHECK(DecodeFails(data));
+
+	// A cell moved to another entry while the counts stay as they were
+	data.clear();
+	ChunkCodec::Encode(grid, data);
+	data[PayloadOffset(grid) + 10] ^= 0x01;
+	Reseal(data);
+	CHECK(DecodeFails(data));
+}
+
+TEST(ChunkCodec, RejectsRunCountMismatch)
+{
+	ChunkGrid grid = Layers();
+	std::vector<std::uint8_t> data;
+	ChunkCodec::Encode(grid, data);
+	REQUIRE(Encoding(data) == ChunkCodec::RUNS);
+
+	AddToCount(data, grid, 1, 5);
+	AddToCount(data, grid, 2, -5);
+	Reseal(data);
+	CHECK(DecodeFails(data));
+
+	// Runs that stop short of the chunk, and runs that run past it
+	for (std::int32_t change = -1; change <= 1; change += 2) {
+		data.clear();
+		ChunkCodec::Encode(grid, data);
+		std::uint16_t length;
+		std::memcpy(&length, data.data() + PayloadOffset(grid) + 2, sizeof(length));
+		length = static_cast<std::uint16_t>(length + change);
+		std::memcpy(data.data() + PayloadOffset(grid) + 2, &length, sizeof(length));
+		Reseal(data);
+		CHECK(DecodeFails(data));
+	}
+}
+
+TEST(ChunkCodec, RejectsTruncatedPayload)
+{
+	ChunkGrid empty;
+	const ChunkGrid grids[] = { empty, Noise(3, 3), Layers() };
+	for (const ChunkGrid& grid : grids) {
+		std::vector<std::uint8_t> data;
+		ChunkCodec::Encode(grid, data);
+		std::uint32_t accepted = 0;
+		for (std::size_t size = 0; size < data.size(); size++) {
+			accepted += (ChunkCodec::Decode(data.data(), size, empty) ? 1 : 0);
+		}
+		CHECK(accepted == 0);
+		CHECK(empty.IsUniform() && empty.SolidCount() == 0);
+
+		// A header that claims less payload than the encoding needs
+		if (Encoding(data) != ChunkCodec::UNIFORM) {
+			std::uint32_t payloadSize;
+			std::memcpy(&payloadSize, data.data() + PAYLOAD_SIZE_OFFSET, sizeof(payloadSize));
+			payloadSize -= 4;
+			std::memcpy(data.data() + PAYLOAD_SIZE_OFFSET, &payloadSize, sizeof(payloadSize));
+			data.resize(data.size() - 4);
+			Reseal(data);
+			CHECK(DecodeFails(data));
+		}
+	}
+}
@@ -0,0 +1,199 @@
+#include "Test.h"
+#include "ChunkConnectivity.h"
+#include "Random.h"
+#include "VoxelStore.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace Rendering;
+
+namespace {
+	const std::int32_t SIZE_X = 20;
+	const std::int32_t SIZE_Y = 20;
+	const std::int32_t SIZE_Z = 20;
+	// Voxels one unit apart with their bottoms on the ground
+	const float GROUND = -0.5f;
+
+	std::int32_t CellOf(std::int32_t x, std::int32_t y, std::int32_t z)
+	{
+		return x + SIZE_X * (y + SIZE_Y * z);
+	}
+
+	// A table on four legs with a tower standing on it, one voxel per cell,
+	// and the dense grid of voxel ids it was built from
+	void BuildTable(VoxelStore& store, std::vector<std::uint32_t>& ids)
+	{
+		ids.assign(SIZE_X * SIZE_Y * SIZE_Z, ChunkConnectivity::EMPTY);
+		for (std::int32_t z = 0; z < SIZE_Z; z++) {
+			for (std::int32_t y = 0; y < SIZE_Y; y++) {
+				for (std::int32_t x = 0; x < SIZE_X; x++) {
+					bool leg = y < 8 && (x < 2 || x >= 16) && (z < 2 || z >= 16);
+					bool slab = y == 8 && x < 18 && z < 18;
+					bool tower = y > 8 && x >= 7 && x < 10 && z >= 7 && z < 10;
+					if (leg || slab || tower) {
+						ids[CellOf(x, y, z)] = store.Add(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z), 0.5f);
+					}
+				}
+			}
+		}
+	}
+
+	// Every cell a flood from the ground layer does not reach, grouped into
+	// the islands it forms, each island sorted
+	std::vector<std::vector<std::uint32_t>> BruteForceIslands(const std::vector<std::uint32_t>& ids)
+	{
+		std::vector<std::int32_t> label(ids.size(), -1);
+		std::vector<std::int32_t> stack;
+		auto flood = [&](std::int32_t seed, std::int32_t value) {
+			label[seed] = value;
+			stack.push_back(seed);
+			while (!stack.empty()) {
+				std::int32_t cell = stack.back();
+				stack.pop_back();
+				std::int32_t x = cell % SIZE_X;
+				std::int32_t y = cell / SIZE_X % SIZE_Y;
+				std::int32_t z = cell / (SIZE_X * SIZE_Y);
+				const std::int32_t neighbours[6][3] = { { x - 1, y, z }, { x + 1, y, z }, { x, y - 1, z }, { x, y + 1, z }, { x, y, z - 1 }, { x, y, z + 1 } };
+				for (const std::int32_t* n : neighbours) {
+					if (n[0] < 0 || n[0] >= SIZE_X || n[1] < 0 || n[1] >= SIZE_Y || n[2] < 0 || n[2] >= SIZE_Z) {
+						continue;
+					}
+					std::int32_t next = CellOf(n[0], n[1], n[2]);
+					if (ids[next] != ChunkConnectivity::EMPTY && label[next] < 0) {
+						label[next] = value;
+						stack.push_back(next);
+					}
+				}
+			}
+		};
+
+		for (std::int32_t z = 0; z < SIZE_Z; z++) {
+			for (std::int32_t x = 0; x < SIZE_X; x++) {
+				std::int32_t cell = CellOf(x, 0, z);
+				if (ids[cell] != ChunkConnectivity::EMPTY && label[cell] < 0) {
+					flood(cell, 0);
+				}
+			}
+		}
+
+		std::vector<std::vector<std::uint32_t>> islands;
+		for (std::int32_t cell = 0; cell < static_cast<std::int32_t>(ids.size()); cell++) {
+			if (ids[cell] != ChunkConnectivity::EMPTY && label[cell] < 0) {
+				flood(cell, static_cast<std::int32_t>(islands.size()) + 1);
+				islands.push_back(std::vector<std::uint32_t>());
+			}
+		}
+		for (std::int32_t cell = 0; cell < static_cast<std::int32_t>(ids.size()); cell++) {
+			if (label[cell] > 0) {
+				islands[label[cell] - 1].push_back(ids[cell]);
+			}
+		}
+		for (std::vector<std::uint32_t>& island : islands) {
+			std::sort(island.begin(), island.end());
+		}
+		std::sort(islands.begin(), islands.end());
+		return islands;
+	}
+}
+
+TEST(ChunkConnectivity, IslandsMatchBruteForce)
+{
+	std::uint32_t blasts = 0;
+	std::uint32_t islandsFound = 0;
+	std::uint32_t mismatches = 0;
+	for (std::uint32_t trial = 0; trial < 40; trial++) {
+		VoxelStore store;
+		std::vector<std::uint32_t> ids;
+		BuildTable(store, ids);
+		ChunkConnectivity connectivity;
+		connectivity.Build(store);
+
+		Random random(trial, 13);
+		for (int blast = 0; blast < 20; blast++, blasts++) {
+			// Knock out a ball of cells around a solid one, as a blast would
+			std::vector<std::int32_t> solid;
+			for (std::int32_t cell = 0; cell < static_cast<std::int32_t>(ids.size()); cell++) {
+				if (ids[cell] != ChunkConnectivity::EMPTY) {
+					solid.push_back(cell);
+				}
+			}
+			if (solid.empty()) {
+				break;
+			}
+			std::int32_t target = solid[random.Next() % solid.size()];
+			float centre[3] = { static_cast<float>(target % SIZE_X), static_cast<float>(target / SIZE_X % SIZE_Y), static_cast<float>(target / (SIZE_X * SIZE_Y)) };
+			float radius = random.NextRange(0.5f, 2.5f);
+			for (std::int32_t cell = 0; cell < static_cast<std::int32_t>(ids.size()); cell++) {
+				float dx = cell % SIZE_X - centre[0];
+				float dy = cell / SIZE_X % SIZE_Y - centre[1];
+				float dz = cell / (SIZE_X * SIZE_Y) - centre[2];
+				if (ids[cell] != ChunkConnectivity::EMPTY && dx * dx + dy * dy + dz * dz <= radius * radius) {
+					connectivity.Remove(ids[cell]);
+					ids[cell] = ChunkConnectivity::EMPTY;
+				}
+			}
+
+			std::vector<std::uint32_t> islands;
+			std::vector<std::uint32_t> ends;
+			std::uint32_t found = connectivity.FindIslands(GROUND, islands, ends);
+			std::vector<std::vector<std::uint32_t>> grouped;
+			std::uint32_t begin = 0;
+			for (std::uint32_t end : ends) {
+				grouped.push_back(std::vector<std::uint32_t>(islands.begin() + begin, islands.begin() + end));
+				std::sort(grouped.back().begin(), grouped.back().end());
+				begin = end;
+			}
+			std::sort(grouped.begin(), grouped.end());
+
+			std::vector<std::vector<std::uint32_t>> expected = BruteForceIslands(ids);
+			mismatches += (found == islands.size() && grouped == expected ? 0 : 1);
+			islandsFound += static_cast<std::uint32_t>(expected.size());
+
+			// What fell is no longer part of the chunk
+			for (std::uint32_t id : islands) {
+				CHECK(!connectivity.Contains(id));
+				std::replace(ids.begin(), ids.end(), id, ChunkConnectivity::EMPTY);
+			}
+		}
+	}
+
+	CHECK(mismatches == 0);
+	// The blasts have to cut pieces off for the comparison to mean anything
+	CHECK(islandsFound > blasts / 20);
+}
+
+TEST(ChunkConnectivity, DebrisIsLeftOutOfTheGrid)
+{
+	VoxelStore store;
+	std::uint32_t resting = store.Add(0.0f, 0.0f, 0.0f, 0.5f);
+	std::uint32_t loose = store.Add(1.0f, 0.0f, 0.0f, 0.5f);
+	store.Drop(store.Slot(loose));
+	ChunkConnectivity connectivity;
+	connectivity.Build(store);
+	CHECK(connectivity.Contains(resting));
+	CHECK(!connectivity.Contains(loose));
+}
+
+TEST(ChunkConnectivity, RemovingTheOnlySupportDropsEverythingAbove)
+{
+	// A column on one voxel
+	VoxelStore store;
+	std::vector<std::uint32_t> column;
+	for (int y = 0; y < 10; y++) {
+		column.push_back(store.Add(0.0f, static_cast<float>(y), 0.0f, 0.5f));
+	}
+	ChunkConnectivity connectivity;
+	connectivity.Build(store);
+
+	connectivity.Remove(column[0]);
+	std::vector<std::uint32_t> islands;
+	std::vector<std::uint32_t> ends;
+	CHECK(connectivity.FindIslands(GROUND, islands, ends) == 9);
+	CHECK(ends.size() == 1 && ends[0] == 9);
+
+	// Nothing is found twice
+	islands.clear();
+	ends.clear();
+	CHECK(connectivity.FindIslands(GROUND, islands, ends) == 0);
+}
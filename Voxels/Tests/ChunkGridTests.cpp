@@ -0,0 +1,185 @@
+#include "Test.h"
+#include "ChunkGrid.h"
+#include "Random.h"
+#include <cstdint>
+#include <vector>
+
+using namespace Rendering;
+
+namespace {
+	const std::uint32_t SIZE = ChunkGrid::SIZE;
+
+	std::uint32_t Cell(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+	{
+		return (z * SIZE + y) * SIZE + x;
+	}
+
+	bool Solid(const std::vector<std::uint16_t>& dense, int x, int y, int z)
+	{
+		bool inside = x >= 0 && y >= 0 && z >= 0 && x < static_cast<int>(SIZE) && y < static_cast<int>(SIZE) && z < static_cast<int>(SIZE);
+		return inside && dense[Cell(x, y, z)] != ChunkGrid::EMPTY_MATERIAL;
+	}
+
+	// Counts the cells where the grid and the dense copy disagree, through
+	// Get, IsSolid, Row and every face of ExposedRow, and checks the totals
+	std::uint32_t Differences(const ChunkGrid& grid, const std::vector<std::uint16_t>& dense)
+	{
+		const int offsets[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+		std::uint32_t differences = 0;
+		std::uint32_t solid = 0;
+		std::uint32_t exposed = 0;
+		for (std::uint32_t z = 0; z < SIZE; z++) {
+			for (std::uint32_t y = 0; y < SIZE; y++) {
+				std::uint32_t row = 0;
+				std::uint32_t exposedRows[6] = {};
+				for (std::uint32_t x = 0; x < SIZE; x++) {
+					differences += (grid.Get(x, y, z) != dense[Cell(x, y, z)] ? 1 : 0);
+					bool cellSolid = Solid(dense, x, y, z);
+					differences += (grid.IsSolid(x, y, z) != cellSolid ? 1 : 0);
+					if (!cellSolid) {
+						continue;
+					}
+
+					solid++;
+					row |= 1u << x;
+					for (int face = 0; face < 6; face++) {
+						if (!Solid(dense, x + offsets[face][0], y + offsets[face][1], z + offsets[face][2])) {
+							exposedRows[face] |= 1u << x;
+							exposed++;
+						}
+					}
+				}
+
+				differences += (grid.Row(y, z) != row ? 1 : 0);
+				for (int face = 0; face < 6; face++) {
+					differences += (grid.ExposedRow(y, z, static_cast<ChunkGrid::Face>(face)) != exposedRows[face] ? 1 : 0);
+				}
+			}
+		}
+
+		differences += (grid.SolidCount() != solid ? 1 : 0);
+		differences += (grid.ExposedFaceCount() != exposed ? 1 : 0);
+		return differences;
+	}
+
+	// Fewest of 1, 2, 4, 8 or 16 bits that can index that many palette entries
+	std::uint32_t BitsFor(std::uint32_t entries)
+	{
+		std::uint32_t bits = 1;
+		while ((1u << bits) < entries) {
+			bits *= 2;
+		}
+		return bits;
+	}
+}
+
+TEST(ChunkGrid, StartsAsUniformAir)
+{
+	ChunkGrid grid;
+	std::vector<std::uint16_t> dense(ChunkGrid::VOLUME, ChunkGrid::EMPTY_MATERIAL);
+	CHECK(grid.IsUniform());
+	CHECK(grid.BitsPerEntry() == 0);
+	CHECK(grid.PaletteSize() == 1);
+	CHECK(Differences(grid, dense) == 0);
+}
+
+// Random cells set from palettes of 2 to 1000 materials, air among them,
+// so entries are freed and reused and the bits per entry grow; Compact and
+// Fill come in between
+TEST(ChunkGrid, SetsMatchADenseGrid)
+{
+	const std::uint32_t paletteSizes[] = { 2, 3, 5, 16, 17, 200, 1000 };
+	ChunkGrid grid;
+	std::vector<std::uint16_t> dense(ChunkGrid::VOLUME, ChunkGrid::EMPTY_MATERIAL);
+	std::uint32_t differences = 0;
+	std::uint32_t notPacked = 0;
+
+	for (std::uint32_t materials : paletteSizes) {
+		Random random(materials, 0);
+		for (std::uint32_t round = 0; round < 4; round++) {
+			// Mostly in one corner, so some rows stay empty and others full
+			for (std::uint32_t set = 0; set < 20000; set++) {
+				std::uint32_t reach = (set % 2 == 0 ? SIZE : SIZE / 4);
+				std::uint32_t x = random.Next() % reach;
+				std::uint32_t y = random.Next() % reach;
+				std::uint32_t z = random.Next() % reach;
+				std::uint16_t material = static_cast<std::uint16_t>(random.Next() % materials);
+				grid.Set(x, y, z, material);
+				dense[Cell(x, y, z)] = material;
+			}
+			differences += Differences(grid, dense);
+
+			grid.Compact();
+			differences += Differences(grid, dense);
+			notPacked += (grid.IsUniform() || grid.BitsPerEntry() == BitsFor(grid.PaletteSize()) ? 0 : 1);
+		}
+
+		// The next palette starts from a solid chunk
+		std::uint16_t fill = static_cast<std::uint16_t>(1 + materials % 7);
+		grid.Fill(fill);
+		dense.assign(ChunkGrid::VOLUME, fill);
+		CHECK(grid.IsUniform());
+		differences += Differences(grid, dense);
+	}
+
+	CHECK(differences == 0);
+	CHECK(notPacked == 0);
+}
+
+TEST(ChunkGrid, PaletteGrowsAndCompactShrinksIt)
+{
+	ChunkGrid grid;
+	for (std::uint32_t material = 1; material <= 300; material++) {
+		grid.Set(material % SIZE, material / SIZE, 0, static_cast<std::uint16_t>(material));
+	}
+	CHECK(grid.PaletteSize() == 301);
+	CHECK(grid.BitsPerEntry() == 16);
+
+	// Freed entries are reused before the palette grows again
+	for (std::uint32_t material = 1; material <= 290; material++) {
+		grid.Set(material % SIZE, material / SIZE, 0, ChunkGrid::EMPTY_MATERIAL);
+	}
+	grid.Set(5, 5, 5, 1000);
+	CHECK(grid.PaletteSize() == 301);
+
+	grid.Compact();
+	CHECK(grid.PaletteSize() == 12);
+	CHECK(grid.BitsPerEntry() == 4);
+	CHECK(grid.Get(5, 5, 5) == 1000);
+	CHECK(grid.Get(295 % SIZE, 295 / SIZE, 0) == 295);
+	CHECK(grid.SolidCount() == 11);
+}
+
+// Setting every cell to one material collapses the chunk to that value
+TEST(ChunkGrid, OneMaterialCollapses)
+{
+	ChunkGrid grid;
+	grid.Set(1, 2, 3, 4);
+	CHECK(!grid.IsUniform());
+	std::size_t expandedBytes = grid.MemoryBytes();
+
+	for (std::uint32_t z = 0; z < SIZE; z++) {
+		for (std::uint32_t y = 0; y < SIZE; y++) {
+			for (std::uint32_t x = 0; x < SIZE; x++) {
+				grid.Set(x, y, z, 9);
+			}
+		}
+	}
+	CHECK(grid.IsUniform());
+	CHECK(grid.BitsPerEntry() == 0);
+	CHECK(grid.MemoryBytes() < expandedBytes / 10);
+	CHECK(grid.Get(1, 2, 3) == 9);
+	CHECK(grid.SolidCount() == ChunkGrid::VOLUME);
+	CHECK(grid.ExposedFaceCount() == 6 * SIZE * SIZE);
+
+	// The last odd cell going back collapses it again
+	grid.Set(0, 0, 0, 2);
+	grid.Set(31, 31, 31, ChunkGrid::EMPTY_MATERIAL);
+	CHECK(!grid.IsUniform());
+	CHECK(grid.SolidCount() == ChunkGrid::VOLUME - 1);
+	grid.Set(31, 31, 31, 9);
+	CHECK(!grid.IsUniform());
+	grid.Set(0, 0, 0, 9);
+	CHECK(grid.IsUniform());
+	CHECK(grid.Get(0, 0, 0) == 9);
+}
@@ -0,0 +1,334 @@
+#include "Test.h"
+#include "ChunkSimulation.h"
+#include "GameTime.h"
+#include "JobSystem.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace Library;
+using namespace Rendering;
+
+namespace {
+	// Everything a blast decides, by slot, so two runs compare bit for bit
+	struct Snapshot {
+		std::uint32_t Count;
+		std::uint32_t ActiveCount;
+		std::uint32_t VoxelCount;
+		std::uint32_t Clusters;
+		std::vector<std::uint32_t> Ids;
+		std::vector<float> State;
+		std::vector<std::uint8_t> Moving;
+		// Every voxel's matrix, members of rigid bodies included, body by body
+		std::vector<float> Matrices;
+	};
+
+	// A block of ground with a pillar standing on it and a slab on the pillar,
+	// one voxel per cell. A blast through the pillar cuts the slab off, and a
+	// blast into the block knocks loose more voxels than one update job takes.
+	void Build(ChunkSimulation& simulation)
+	{
+		VoxelDag world(6);
+		const std::uint32_t blockMinimum[3] = { 0, 0, 0 };
+		const std::uint32_t blockMaximum[3] = { 32, 10, 32 };
+		const std::uint32_t pillarMinimum[3] = { 12, 10, 12 };
+		const std::uint32_t pillarMaximum[3] = { 20, 30, 20 };
+		const std::uint32_t slabMinimum[3] = { 4, 30, 4 };
+		const std::uint32_t slabMaximum[3] = { 28, 33, 28 };
+		world.Fill(blockMinimum, blockMaximum, true);
+		world.Fill(pillarMinimum, pillarMaximum, true);
+		world.Fill(slabMinimum, slabMaximum, true);
+
+		const std::uint32_t maximum[3] = { 32, 33, 32 };
+		simulation.Store().Reserve(32 * 33 * 32);
+		simulation.AddVoxels(world, blockMinimum, maximum, 1.0f);
+		// The lowest voxels rest on the ground, so the block stays put
+		simulation.World().SetGroundHeight(-0.5f);
+		simulation.SetSeed(11);
+	}
+
+	Snapshot Take(ChunkSimulation& simulation)
+	{
+		Snapshot snapshot;
+		VoxelStore& store = simulation.Store();
+		snapshot.Count = store.Count();
+		snapshot.ActiveCount = store.ActiveCount();
+		snapshot.VoxelCount = simulation.VoxelCount();
+		snapshot.Clusters = simulation.Stats().Clusters;
+		for (std::uint32_t slot = 0; slot < store.Count(); slot++) {
+			snapshot.Ids.push_back(store.Id(slot));
+			snapshot.Moving.push_back(store.Moving()[slot]);
+			const float values[] = {
+				store.OriginX()[slot], store.OriginY()[slot], store.OriginZ()[slot],
+				store.VelocityX()[slot], store.VelocityY()[slot], store.VelocityZ()[slot], store.Gravity()[slot],
+				store.AngularX()[slot], store.AngularY()[slot], store.AngularZ()[slot],
+				store.OrientationX()[slot], store.OrientationY()[slot], store.OrientationZ()[slot], store.OrientationW()[slot],
+				store.LaunchTime()[slot]
+			};
+			snapshot.State.insert(snapshot.State.end(), values, values + sizeof(values) / sizeof(values[0]));
+		}
+		snapshot.Matrices.resize(simulation.VoxelCount() * 16);
+		simulation.GetPositionMatrices(snapshot.Matrices.data());
+		return snapshot;
+	}
+
+	bool SameBits(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0);
+	}
+
+	bool Same(const Snapshot& a, const Snapshot& b)
+	{
+		return a.Count == b.Count && a.ActiveCount == b.ActiveCount && a.VoxelCount == b.VoxelCount && a.Clusters == b.Clusters
+			&& a.Ids == b.Ids && a.Moving == b.Moving && SameBits(a.State, b.State) && SameBits(a.Matrices, b.Matrices);
+	}
+
+	void Step(ChunkSimulation& simulation, GameTime& gameTime, int frames)
+	{
+		for (int frame = 0; frame < frames; frame++) {
+			gameTime.SetElapsedGameTime(1.0 / 60.0);
+			gameTime.SetTotalGameTime(gameTime.TotalGameTime() + 1.0 / 60.0);
+			simulation.Update(gameTime);
+		}
+	}
+
+	// Blasts the pillar, lets the pieces move, then blasts the block, taking
+	// a snapshot after each blast and after the frames that follow it
+	std::vector<Snapshot> Run(JobSystem* jobSystem)
+	{
+		ChunkSimulation simulation(jobSystem);
+		Build(simulation);
+		GameTime gameTime;
+		std::vector<Snapshot> snapshots;
+
+		simulation.SetMotionVectors(16.0f, 20.0f, 16.0f);
+		Step(simulation, gameTime, 1);
+		snapshots.push_back(Take(simulation));
+		Step(simulation, gameTime, 10);
+		snapshots.push_back(Take(simulation));
+
+		simulation.SetMotionVectors(6.0f, 9.0f, 6.0f);
+		Step(simulation, gameTime, 1);
+		snapshots.push_back(Take(simulation));
+		Step(simulation, gameTime, 10);
+		snapshots.push_back(Take(simulation));
+		return snapshots;
+	}
+
+	// A ray from somewhere around the scene towards a point inside it; every
+	// eighth starts inside the scene instead, often inside a voxel
+	Ray RandomRay(Random& random)
+	{
+		Ray ray;
+		bool inside = (random.Next() % 8 == 0);
+		float target[3];
+		for (int a = 0; a < 3; a++) {
+			ray.Origin[a] = (inside ? random.NextRange(0.0f, 33.0f) : random.NextRange(-20.0f, 52.0f));
+			target[a] = random.NextRange(0.0f, 33.0f);
+		}
+		float length = 0.0f;
+		for (int a = 0; a < 3; a++) {
+			ray.Direction[a] = target[a] - ray.Origin[a];
+			length += ray.Direction[a] * ray.Direction[a];
+		}
+		length = std::sqrt(length);
+		for (int a = 0; a < 3; a++) {
+			ray.Direction[a] /= length;
+		}
+		return ray;
+	}
+
+	// Every voxel in the store as a cube, which is what a pick has to find;
+	// voxels held in rigid bodies are not in the store and are not picked
+	bool BruteForce(const VoxelStore& store, const Ray& ray, RayHit& hit)
+	{
+		float inverse[3];
+		VoxelRay::Inverse(ray.Direction, inverse);
+		hit.Distance = ChunkSimulation::PICK_DISTANCE;
+		for (std::uint32_t slot = 0; slot < store.Count(); slot++) {
+			const float centre[3] = { store.OriginX()[slot], store.OriginY()[slot], store.OriginZ()[slot] };
+			float distance;
+			int axis;
+			if (VoxelRay::HitBox(ray.Origin, inverse, centre, store.Size()[slot], distance, axis) && distance < hit.Distance) {
+				hit.Id = store.Id(slot);
+				hit.Distance = distance;
+				VoxelRay::FaceNormal(ray.Direction, axis, hit.Normal);
+			}
+		}
+		return hit.Distance < ChunkSimulation::PICK_DISTANCE;
+	}
+
+	// Distance along the ray to one voxel's cube, or -1
+	float DistanceTo(const VoxelStore& store, const Ray& ray, std::uint32_t id)
+	{
+		std::uint32_t slot = store.Slot(id);
+		if (slot == VoxelStore::INVALID_SLOT) {
+			return -1.0f;
+		}
+		float inverse[3];
+		VoxelRay::Inverse(ray.Direction, inverse);
+		const float centre[3] = { store.OriginX()[slot], store.OriginY()[slot], store.OriginZ()[slot] };
+		float distance;
+		int axis;
+		return (VoxelRay::HitBox(ray.Origin, inverse, centre, store.Size()[slot], distance, axis) ? distance : -1.0f);
+	}
+
+	struct PickErrors {
+		std::uint32_t Hits;
+		std::uint32_t Misses;
+		std::uint32_t Wrong;
+		std::uint32_t WrongNormals;
+	};
+
+	// Casts count rays and compares each pick with the brute-force one. Where
+	// two voxels are hit at the same distance either may be picked, so the
+	// picked voxel only has to be hit at the distance the brute force found.
+	// The normal is only compared for rays that start outside every voxel.
+	void ComparePicks(ChunkSimulation& simulation, std::uint32_t seed, std::uint32_t count, PickErrors& errors)
+	{
+		const VoxelStore& store = simulation.Store();
+		for (std::uint32_t r = 0; r < count; r++) {
+			Random random(seed, r);
+			Ray ray = RandomRay(random);
+			RayHit expected;
+			RayHit hit;
+			bool expectedHit = BruteForce(store, ray, expected);
+			bool picked = simulation.Raycast(ray.Origin, ray.Direction, hit);
+			if (picked != expectedHit) {
+				errors.Wrong++;
+				continue;
+			}
+			if (!picked) {
+				errors.Misses++;
+				continue;
+			}
+
+			errors.Hits++;
+			const float tolerance = 1e-4f * (1.0f + expected.Distance);
+			if (std::fabs(hit.Distance - expected.Distance) > tolerance || std::fabs(DistanceTo(store, ray, hit.Id) - expected.Distance) > tolerance) {
+				errors.Wrong++;
+			}
+			else if (expected.Distance > 0.0f && (hit.Normal[0] != expected.Normal[0] || hit.Normal[1] != expected.Normal[1] || hit.Normal[2] != expected.Normal[2])) {
+				errors.WrongNormals++;
+			}
+		}
+	}
+}
+
+TEST(ChunkSimulation, BlastsAreTheSameAtAnyThreadCount)
+{
+	std::vector<Snapshot> reference = Run(nullptr);
+
+	// The scene has to do what it is built for: blasts bigger than one update
+	// job, and pieces cut off as rigid bodies
+	REQUIRE(reference.size() == 4);
+	CHECK(reference[0].ActiveCount > ChunkSimulation::UPDATE_GRAIN);
+	CHECK(reference[0].Clusters > 0);
+	CHECK(reference[0].VoxelCount > reference[0].Count);
+	CHECK(reference[2].ActiveCount - reference[1].ActiveCount > ChunkSimulation::UPDATE_GRAIN);
+
+	const unsigned int threadCounts[] = { 1, 2, 4 };
+	for (unsigned int threads : threadCounts) {
+		JobSystem jobSystem(threads);
+		std::vector<Snapshot> snapshots = Run(&jobSystem);
+		REQUIRE(snapshots.size() == reference.size());
+		for (std::size_t s = 0; s < reference.size(); s++) {
+			CHECK(Same(snapshots[s], reference[s]));
+		}
+	}
+}
+
+TEST(ChunkSimulation, SeedChangesBlasts)
+{
+	ChunkSimulation first;
+	ChunkSimulation second;
+	Build(first);
+	Build(second);
+	second.SetSeed(12);
+	first.SetMotionVectors(6.0f, 9.0f, 6.0f);
+	second.SetMotionVectors(6.0f, 9.0f, 6.0f);
+	CHECK(!Same(Take(first), Take(second)));
+}
+
+// Picks across the life of a blast, against every voxel tested one by one:
+// the intact chunk, debris in flight, and debris that has settled
+TEST(ChunkSimulation, RaycastMatchesBruteForce)
+{
+	ChunkSimulation simulation;
+	Build(simulation);
+	GameTime gameTime;
+	PickErrors errors = {};
+
+	ComparePicks(simulation, 0, 1000, errors);
+	simulation.SetMotionVectors(16.0f, 20.0f, 16.0f);
+	simulation.SetMotionVectors(6.0f, 9.0f, 6.0f);
+	Step(simulation, gameTime, 1);
+	CHECK(simulation.Store().ActiveCount() > 0);
+	ComparePicks(simulation, 1, 1000, errors);
+	Step(simulation, gameTime, 20);
+	ComparePicks(simulation, 2, 1000, errors);
+	Step(simulation, gameTime, 1500);
+	CHECK(simulation.Store().ActiveCount() < simulation.Store().Count() / 100);
+	ComparePicks(simulation, 3, 1000, errors);
+
+	CHECK(errors.Hits > 2000);
+	CHECK(errors.Misses > 0);
+	CHECK(errors.Wrong == 0);
+	CHECK(errors.WrongNormals == 0);
+}
+
+// A batch sorts its rays into packets and spreads them over the job system,
+// and has to pick what the rays cast one at a time pick. Overlapping debris
+// can tie, so a pick only has to be at the same distance.
+TEST(ChunkSimulation, RaycastBatchMatchesSingleRays)
+{
+	JobSystem jobSystem(4);
+	JobSystem* jobSystems[] = { nullptr, &jobSystem };
+	for (JobSystem* batchJobs : jobSystems) {
+		ChunkSimulation simulation(batchJobs);
+		Build(simulation);
+		GameTime gameTime;
+		const std::uint32_t count = 3 * ChunkSimulation::RAY_GRAIN + 5;
+		std::vector<Ray> rays(count);
+		std::vector<RayHit> hits(count);
+		std::uint32_t wrong = 0;
+		std::uint32_t hitCount = 0;
+
+		const int frames[] = { 0, 1, 20, 120 };
+		for (int phase = 0; phase < 4; phase++) {
+			if (phase == 1) {
+				simulation.SetMotionVectors(16.0f, 20.0f, 16.0f);
+				simulation.SetMotionVectors(6.0f, 9.0f, 6.0f);
+			}
+			Step(simulation, gameTime, frames[phase]);
+
+			for (std::uint32_t r = 0; r < count; r++) {
+				Random random(10 + phase, r);
+				rays[r] = RandomRay(random);
+			}
+			std::uint32_t batchHits = simulation.RaycastBatch(rays.data(), count, hits.data());
+			hitCount += batchHits;
+
+			std::uint32_t singleHits = 0;
+			for (std::uint32_t r = 0; r < count; r++) {
+				RayHit single;
+				if (!simulation.Raycast(rays[r].Origin, rays[r].Direction, single)) {
+					wrong += (hits[r].Distance != -1.0f ? 1 : 0);
+					continue;
+				}
+
+				singleHits++;
+				const float tolerance = 1e-4f * (1.0f + single.Distance);
+				if (std::fabs(hits[r].Distance - single.Distance) > tolerance
+					|| std::fabs(DistanceTo(simulation.Store(), rays[r], hits[r].Id) - single.Distance) > tolerance) {
+					wrong++;
+				}
+			}
+			wrong += (batchHits != singleHits ? 1 : 0);
+		}
+
+		CHECK(hitCount > count);
+		CHECK(wrong == 0);
+	}
+}
@@ -0,0 +1,167 @@
+#include "Test.h"
+#include "ChunkTable.h"
+#include "Random.h"
+#include <cstdint>
+#include <map>
+#include <tuple>
+
+using namespace Rendering;
+
+namespace {
+	typedef std::map<std::tuple<std::int32_t, std::int32_t, std::int32_t>, std::uint32_t> Reference;
+
+	std::tuple<std::int32_t, std::int32_t, std::int32_t> Tuple(const ChunkKey& key)
+	{
+		return std::make_tuple(key.X, key.Y, key.Z);
+	}
+
+	// Keys in a cube of side keys around the origin, negative ones included
+	ChunkKey RandomKey(Random& random, std::uint32_t side)
+	{
+		std::int32_t half = static_cast<std::int32_t>(side / 2);
+		ChunkKey key = {
+			static_cast<std::int32_t>(random.Next() % side) - half,
+			static_cast<std::int32_t>(random.Next() % side) - half,
+			static_cast<std::int32_t>(random.Next() % side) - half
+		};
+		return key;
+	}
+
+	// Counts the keys of the cube whose value differs from the map's; keys the
+	// map does not hold must come back EMPTY
+	std::uint32_t Differences(const ChunkTable& table, const Reference& reference, std::uint32_t side)
+	{
+		std::uint32_t differences = (table.Count() != reference.size() ? 1 : 0);
+		std::int32_t half = static_cast<std::int32_t>(side / 2);
+		for (std::int32_t z = -half; z < half; z++) {
+			for (std::int32_t y = -half; y < half; y++) {
+				for (std::int32_t x = -half; x < half; x++) {
+					const ChunkKey key = { x, y, z };
+					Reference::const_iterator found = reference.find(Tuple(key));
+					std::uint32_t expected = (found != reference.end() ? found->second : ChunkTable::EMPTY);
+					differences += (table.Find(key) != expected ? 1 : 0);
+				}
+			}
+		}
+		return differences;
+	}
+}
+
+TEST(ChunkTable, EmptyTableFindsNothing)
+{
+	ChunkTable table;
+	const ChunkKey key = { 1, 2, 3 };
+	CHECK(table.Count() == 0);
+	CHECK(table.Find(key) == ChunkTable::EMPTY);
+	CHECK(!table.Erase(key));
+}
+
+// Random inserts, replacements, erases and finds over a small set of keys,
+// so probe runs collide, wrap around the end of the table and are closed
+// up by erases all the time
+TEST(ChunkTable, RandomOperationsMatchAMap)
+{
+	const std::uint32_t side = 16;
+	ChunkTable table;
+	Reference reference;
+	Random random(1, 0);
+	std::uint32_t differences = 0;
+	std::uint32_t erased = 0;
+	std::uint32_t mostCount = 0;
+
+	for (std::uint32_t operation = 0; operation < 200000; operation++) {
+		// Waves of mostly inserts then mostly erases, so the table grows and
+		// empties again more than once
+		bool growing = ((operation / 25000) % 2 == 0);
+		std::uint32_t choice = random.Next() % 10;
+		ChunkKey key = RandomKey(random, side);
+		if (choice < (growing ? 6u : 3u)) {
+			std::uint32_t value = random.Next() % 1000000;
+			table.Insert(key, value);
+			reference[Tuple(key)] = value;
+		}
+		else if (choice < 9) {
+			bool held = (reference.erase(Tuple(key)) != 0);
+			differences += (table.Erase(key) != held ? 1 : 0);
+			erased += (held ? 1 : 0);
+		}
+		else {
+			Reference::const_iterator found = reference.find(Tuple(key));
+			differences += (table.Find(key) != (found != reference.end() ? found->second : ChunkTable::EMPTY) ? 1 : 0);
+		}
+
+		differences += (table.Count() != reference.size() ? 1 : 0);
+		mostCount = (table.Count() > mostCount ? table.Count() : mostCount);
+		if (operation % 5000 == 0) {
+			differences += Differences(table, reference, side);
+		}
+	}
+	differences += Differences(table, reference, side);
+
+	CHECK(mostCount > 2000);
+	CHECK(erased > 20000);
+	CHECK(differences == 0);
+}
+
+// Chunks streaming through as a viewer walks: each step loads a slab of
+// chunks ahead and unloads the one behind, so the table keeps its size
+// while keys come and go
+TEST(ChunkTable, StreamingWindowMatchesAMap)
+{
+	const std::int32_t radius = 6;
+	ChunkTable table;
+	Reference reference;
+	std::uint32_t differences = 0;
+	for (std::int32_t step = 0; step < 200; step++) {
+		for (std::int32_t z = -radius; z <= radius; z++) {
+			for (std::int32_t y = -2; y <= 2; y++) {
+				const ChunkKey ahead = { step + radius, y, z };
+				const ChunkKey behind = { step - radius - 1, y, z };
+				std::uint32_t value = static_cast<std::uint32_t>(step * 1000 + (y + 2) * 100 + z + radius);
+				table.Insert(ahead, value);
+				reference[Tuple(ahead)] = value;
+				bool held = (reference.erase(Tuple(behind)) != 0);
+				differences += (table.Erase(behind) != held ? 1 : 0);
+			}
+		}
+
+		differences += (table.Count() != reference.size() ? 1 : 0);
+		for (const Reference::value_type& entry : reference) {
+			const ChunkKey key = { std::get<0>(entry.first), std::get<1>(entry.first), std::get<2>(entry.first) };
+			differences += (table.Find(key) != entry.second ? 1 : 0);
+		}
+		const ChunkKey gone = { step - radius - 1, 0, 0 };
+		differences += (table.Find(gone) != ChunkTable::EMPTY ? 1 : 0);
+	}
+
+	// The window holds its width in slabs, each a column of rows across z
+	CHECK(table.Count() == static_cast<std::uint32_t>((2 * radius + 1) * (2 * radius + 1) * 5));
+	CHECK(differences == 0);
+}
+
+// Growing from the initial capacity to tens of thousands of keys keeps
+// every entry, and Clear empties the table for reuse
+TEST(ChunkTable, GrowsAndClears)
+{
+	ChunkTable table;
+	const std::uint32_t count = 50000;
+	for (std::uint32_t i = 0; i < count; i++) {
+		const ChunkKey key = { static_cast<std::int32_t>(i % 37) - 18, static_cast<std::int32_t>(i / 37 % 41) - 20, static_cast<std::int32_t>(i / (37 * 41)) - 16 };
+		table.Insert(key, i);
+	}
+	CHECK(table.Count() == count);
+
+	std::uint32_t missing = 0;
+	for (std::uint32_t i = 0; i < count; i++) {
+		const ChunkKey key = { static_cast<std::int32_t>(i % 37) - 18, static_cast<std::int32_t>(i / 37 % 41) - 20, static_cast<std::int32_t>(i / (37 * 41)) - 16 };
+		missing += (table.Find(key) != i ? 1 : 0);
+	}
+	CHECK(missing == 0);
+
+	table.Clear();
+	const ChunkKey key = { 0, 0, 0 };
+	CHECK(table.Count() == 0);
+	CHECK(table.Find(key) == ChunkTable::EMPTY);
+	table.Insert(key, 7);
+	CHECK(table.Find(key) == 7);
+}
@@ -0,0 +1,319 @@
+#include "Test.h"
+#include "DebrisTree.h"
+#include "JobSystem.h"
+#include "SimdMath.h"
+#include "VoxelStore.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace Library;
+using namespace Rendering;
+
+namespace {
+	// Moving voxels of mixed sizes spread through a box, overlapping here and
+	// there; every tenth is left asleep and is not in the tree
+	void Scatter(VoxelStore& store, std::uint32_t count, std::uint32_t seed)
+	{
+		for (std::uint32_t i = 0; i < count; i++) {
+			Random random(seed, i);
+			std::uint32_t id = store.Add(random.NextRange(-20.0f, 20.0f), random.NextRange(0.0f, 20.0f), random.NextRange(-20.0f, 20.0f), random.NextRange(0.25f, 1.0f));
+			if (i % 10 != 0) {
+				store.Wake(store.Slot(id));
+			}
+		}
+	}
+
+	// Moves every moving voxel: most a little, some to anywhere in the box
+	void Move(VoxelStore& store, Random& random)
+	{
+		for (std::uint32_t slot = 0; slot < store.ActiveCount(); slot++) {
+			if (random.Next() % 20 == 0) {
+				store.OriginX()[slot] = random.NextRange(-20.0f, 20.0f);
+				store.OriginY()[slot] = random.NextRange(0.0f, 20.0f);
+				store.OriginZ()[slot] = random.NextRange(-20.0f, 20.0f);
+				continue;
+			}
+			store.OriginX()[slot] += random.NextRange(-0.5f, 0.5f);
+			store.OriginY()[slot] += random.NextRange(-0.5f, 0.5f);
+			store.OriginZ()[slot] += random.NextRange(-0.5f, 0.5f);
+		}
+	}
+
+	Ray RandomRay(Random& random)
+	{
+		Ray ray;
+		float length = 0.0f;
+		for (int a = 0; a < 3; a++) {
+			ray.Origin[a] = random.NextRange(-30.0f, 30.0f);
+			ray.Direction[a] = random.NextRange(-20.0f, 20.0f) - ray.Origin[a];
+			length += ray.Direction[a] * ray.Direction[a];
+		}
+		length = std::sqrt(length);
+		for (int a = 0; a < 3; a++) {
+			ray.Direction[a] /= length;
+		}
+		return ray;
+	}
+
+	// Distance along the ray to the cube of the voxel with this id, or -1
+	float DistanceTo(const VoxelStore& store, const Ray& ray, std::uint32_t id)
+	{
+		std::uint32_t slot = store.Slot(id);
+		float inverse[3];
+		VoxelRay::Inverse(ray.Direction, inverse);
+		const float centre[3] = { store.OriginX()[slot], store.OriginY()[slot], store.OriginZ()[slot] };
+		float distance;
+		int axis;
+		return (VoxelRay::HitBox(ray.Origin, inverse, centre, store.Size()[slot], distance, axis) ? distance : -1.0f);
+	}
+
+	// The nearest moving voxel nearer than maxDistance, or -1
+	float NearestLinear(const VoxelStore& store, const Ray& ray, float maxDistance)
+	{
+		float nearest = maxDistance;
+		for (std::uint32_t slot = 0; slot < store.ActiveCount(); slot++) {
+			float distance = DistanceTo(store, ray, store.Id(slot));
+			nearest = (distance >= 0.0f && distance < nearest ? distance : nearest);
+		}
+		return (nearest < maxDistance ? nearest : -1.0f);
+	}
+
+	bool Overlaps(const VoxelStore& store, std::uint32_t slot, const float minimum[3], const float maximum[3])
+	{
+		const float centre[3] = { store.OriginX()[slot], store.OriginY()[slot], store.OriginZ()[slot] };
+		float half = store.Size()[slot];
+		for (int a = 0; a < 3; a++) {
+			if (centre[a] - half > maximum[a] || centre[a] + half < minimum[a]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Overlaps(const VoxelStore& store, std::uint32_t slot, const float centre[3], float radius)
+	{
+		const float position[3] = { store.OriginX()[slot], store.OriginY()[slot], store.OriginZ()[slot] };
+		float half = store.Size()[slot];
+		float distanceSq = 0.0f;
+		for (int a = 0; a < 3; a++) {
+			float low = position[a] - half;
+			float high = position[a] + half;
+			float outside = (centre[a] < low ? low - centre[a] : (centre[a] > high ? centre[a] - high : 0.0f));
+			distanceSq += outside * outside;
+		}
+		return distanceSq <= radius * radius;
+	}
+
+	struct QueryErrors {
+		std::uint32_t Hits;
+		std::uint32_t Found;
+		std::uint32_t Wrong;
+	};
+
+	bool SameDistance(float a, float b)
+	{
+		return std::fabs(a - b) <= 1e-4f * (1.0f + std::fabs(b));
+	}
+
+	// Rays single and in packets, boxes and spheres, against a scan of every
+	// moving voxel. Overlapping voxels can be hit at the same distance, so a
+	// hit only has to be at the nearest distance and on a voxel found there.
+	void Compare(const DebrisTree& tree, const VoxelStore& store, std::uint32_t seed, QueryErrors& errors)
+	{
+		errors.Wrong += (tree.MemberCount() != store.ActiveCount() ? 1 : 0);
+
+		const std::uint32_t packets = 100;
+		for (std::uint32_t p = 0; p < packets; p++) {
+			Ray rays[Simd::FloatN::Width];
+			RayHit packetHits[Simd::FloatN::Width];
+			std::uint32_t size = 1 + p % DebrisTree::PACKET_SIZE;
+			for (std::uint32_t r = 0; r < size; r++) {
+				Random random(seed, p * DebrisTree::PACKET_SIZE + r);
+				rays[r] = RandomRay(random);
+				packetHits[r].Distance = (r % 4 == 0 ? 20.0f : 1000.0f);
+			}
+			tree.RaycastPacket(rays, size, packetHits);
+
+			for (std::uint32_t r = 0; r < size; r++) {
+				float maxDistance = (r % 4 == 0 ? 20.0f : 1000.0f);
+				float expected = NearestLinear(store, rays[r], maxDistance);
+				RayHit hit;
+				bool found = tree.Raycast(rays[r].Origin, rays[r].Direction, maxDistance, hit);
+				if (found != (expected >= 0.0f)) {
+					errors.Wrong++;
+					continue;
+				}
+				if (!found) {
+					errors.Wrong += (packetHits[r].Distance != maxDistance ? 1 : 0);
+					continue;
+				}
+
+				errors.Hits++;
+				const RayHit* results[2] = { &hit, &packetHits[r] };
+				for (const RayHit* result : results) {
+					if (!SameDistance(result->Distance, expected) || !SameDistance(DistanceTo(store, rays[r], result->Id), expected)) {
+						errors.Wrong++;
+					}
+				}
+			}
+		}
+
+		for (std::uint32_t q = 0; q < 40; q++) {
+			Random random(seed, 1000 + q);
+			float centre[3];
+			float minimum[3];
+			float maximum[3];
+			for (int a = 0; a < 3; a++) {
+				centre[a] = random.NextRange(-25.0f, 25.0f);
+				minimum[a] = centre[a] - random.NextRange(0.0f, 4.0f);
+				maximum[a] = centre[a] + random.NextRange(0.0f, 4.0f);
+			}
+			float radius = random.NextRange(0.0f, 5.0f);
+
+			std::vector<std::uint32_t> inBox;
+			std::vector<std::uint32_t> inSphere;
+			tree.ForEachInBox(minimum, maximum, [&inBox](std::uint32_t id) { inBox.push_back(id); });
+			tree.ForEachInSphere(centre, radius, [&inSphere](std::uint32_t id) { inSphere.push_back(id); });
+			std::vector<std::uint32_t> expectedBox;
+			std::vector<std::uint32_t> expectedSphere;
+			for (std::uint32_t slot = 0; slot < store.ActiveCount(); slot++) {
+				if (Overlaps(store, slot, minimum, maximum)) {
+					expectedBox.push_back(store.Id(slot));
+				}
+				if (Overlaps(store, slot, centre, radius)) {
+					expectedSphere.push_back(store.Id(slot));
+				}
+			}
+
+			std::sort(inBox.begin(), inBox.end());
+			std::sort(inSphere.begin(), inSphere.end());
+			std::sort(expectedBox.begin(), expectedBox.end());
+			std::sort(expectedSphere.begin(), expectedSphere.end());
+			errors.Wrong += (inBox != expectedBox ? 1 : 0);
+			errors.Wrong += (inSphere != expectedSphere ? 1 : 0);
+			errors.Found += static_cast<std::uint32_t>(inBox.size() + inSphere.size());
+		}
+	}
+
+	// What the tree answers, in the order it answers: rays and the ids a box
+	// visits, leaf by leaf
+	std::vector<float> Answers(const DebrisTree& tree)
+	{
+		std::vector<float> answers;
+		for (std::uint32_t r = 0; r < 200; r++) {
+			Random random(99, r);
+			Ray ray = RandomRay(random);
+			RayHit hit;
+			if (tree.Raycast(ray.Origin, ray.Direction, 1000.0f, hit)) {
+				answers.push_back(static_cast<float>(hit.Id));
+				answers.push_back(hit.Distance);
+			}
+		}
+		const float minimum[3] = { -10.0f, 0.0f, -10.0f };
+		const float maximum[3] = { 10.0f, 10.0f, 10.0f };
+		tree.ForEachInBox(minimum, maximum, [&answers](std::uint32_t id) { answers.push_back(static_cast<float>(id)); });
+		return answers;
+	}
+}
+
+TEST(DebrisTree, EmptyTreeFindsNothing)
+{
+	VoxelStore store;
+	DebrisTree tree;
+	tree.Build(store, nullptr);
+	CHECK(tree.MemberCount() == 0);
+
+	const float origin[3] = { 0.0f, 10.0f, 0.0f };
+	const float direction[3] = { 0.0f, -1.0f, 0.0f };
+	RayHit hit;
+	CHECK(!tree.Raycast(origin, direction, 1000.0f, hit));
+	std::uint32_t found = 0;
+	tree.ForEachInSphere(origin, 100.0f, [&found](std::uint32_t) { found++; });
+	CHECK(found == 0);
+}
+
+// Through a build, refits after moves, members falling asleep and being
+// removed, which closes up the leaves, and voxels waking, which rebuilds
+TEST(DebrisTree, QueriesMatchALinearScan)
+{
+	VoxelStore store;
+	Scatter(store, 3000, 1);
+	DebrisTree tree;
+	tree.Build(store, nullptr);
+	QueryErrors errors = {};
+	Compare(tree, store, 0, errors);
+
+	Random random(2, 0);
+	Move(store, random);
+	tree.Refit(store);
+	Compare(tree, store, 1, errors);
+
+	// Half the moving voxels come to rest and fall asleep, a tenth are removed
+	for (std::uint32_t slot = 0; slot < store.ActiveCount(); slot += 2) {
+		store.Contact()[slot] = 1;
+	}
+	for (std::uint8_t frame = 0; frame < VoxelStore::SLEEP_FRAMES; frame++) {
+		store.SleepResting();
+	}
+	std::uint32_t asleep = store.SleepingCount();
+	for (std::uint32_t slot = store.ActiveCount(); slot-- > 0;) {
+		if (slot % 10 == 3) {
+			store.Remove(slot);
+		}
+	}
+	CHECK(asleep > 1000);
+	Move(store, random);
+	tree.Refit(store);
+	Compare(tree, store, 2, errors);
+
+	// Waking voxels the tree has not seen makes Update rebuild
+	for (std::uint32_t slot = store.Count(); slot-- > store.ActiveCount();) {
+		if (slot % 3 == 0) {
+			store.Wake(slot);
+		}
+	}
+	tree.Update(store, nullptr);
+	Compare(tree, store, 3, errors);
+
+	// Past REBUILD_INTERVAL refits, with a voxel removed each time
+	for (std::uint32_t step = 0; step < DebrisTree::REBUILD_INTERVAL + 10; step++) {
+		Move(store, random);
+		store.Remove(random.Next() % store.ActiveCount());
+		tree.Update(store, nullptr);
+		if (step % 10 == 0) {
+			Compare(tree, store, 4 + step, errors);
+		}
+	}
+
+	CHECK(errors.Hits > 1000);
+	CHECK(errors.Found > 1000);
+	CHECK(errors.Wrong == 0);
+}
+
+// Large subtrees are built as jobs, each into a block of nodes fixed by its
+// size, so the tree and its answers do not depend on the thread count
+TEST(DebrisTree, ParallelBuildMatchesSerial)
+{
+	VoxelStore store;
+	Scatter(store, 5 * DebrisTree::BUILD_GRAIN, 3);
+	DebrisTree serial;
+	serial.Build(store, nullptr);
+	std::vector<float> expected = Answers(serial);
+	CHECK(expected.size() > 400);
+
+	const unsigned int threadCounts[] = { 1, 2, 4 };
+	for (unsigned int threads : threadCounts) {
+		JobSystem jobSystem(threads);
+		DebrisTree parallel;
+		parallel.Build(store, &jobSystem);
+		CHECK(parallel.MemberCount() == serial.MemberCount());
+		std::vector<float> answers = Answers(parallel);
+		CHECK(answers == expected);
+	}
+
+	QueryErrors errors = {};
+	Compare(serial, store, 5, errors);
+	CHECK(errors.Wrong == 0);
+}
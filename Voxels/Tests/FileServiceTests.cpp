@@ -0,0 +1,194 @@
+#include "Test.h"
+#include "FileService.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace Library;
+
+namespace {
+	struct Result {
+		bool Called;
+		bool Succeeded;
+		std::vector<std::uint8_t> Data;
+	};
+
+	// A file in the working directory, removed again when the test is done
+	class TemporaryFile {
+	public:
+		TemporaryFile(const std::string& name, std::uint64_t size)
+			: mPath("FileServiceTest_" + name + ".bin"), mBytes(static_cast<std::size_t>(size))
+		{
+			for (std::size_t i = 0; i < mBytes.size(); i++) {
+				mBytes[i] = static_cast<std::uint8_t>(i * 131 + i / 251);
+			}
+			std::FILE* file = std::fopen(mPath.c_str(), "wb");
+			if (file != nullptr) {
+				std::fwrite(mBytes.data(), 1, mBytes.size(), file);
+				std::fclose(file);
+			}
+		}
+
+		~TemporaryFile()
+		{
+			std::remove(mPath.c_str());
+		}
+
+		const std::string& Path() const { return mPath; }
+		const std::vector<std::uint8_t>& Bytes() const { return mBytes; }
+
+	private:
+		std::string mPath;
+		std::vector<std::uint8_t> mBytes;
+	};
+
+	FileService::ReadCallback Into(Result& result)
+	{
+		result.Called = false;
+		result.Succeeded = false;
+		return [&result](bool succeeded, const std::uint8_t* data, std::size_t size) {
+			result.Called = true;
+			result.Succeeded = succeeded;
+			result.Data.assign(data, data + size);
+		};
+	}
+
+	std::vector<std::uint8_t> Range(const TemporaryFile& file, std::uint64_t offset, std::uint64_t size)
+	{
+		return std::vector<std::uint8_t>(file.Bytes().begin() + static_cast<std::ptrdiff_t>(offset), file.Bytes().begin() + static_cast<std::ptrdiff_t>(offset + size));
+	}
+
+	// Every test runs through the ring, where the build and kernel have one,
+	// and through plain positioned reads
+	const bool UseRing[] = { true, false };
+}
+
+TEST(FileService, RingCanBeTurnedOff)
+{
+	FileService service(false);
+	CHECK(!service.UsesRing());
+}
+
+TEST(FileService, WholeFile)
+{
+	TemporaryFile small("small", 1000);
+	TemporaryFile large("large", 3 * 1024 * 1024 + 17);
+	TemporaryFile empty("empty", 0);
+	for (bool useRing : UseRing) {
+		FileService service(useRing);
+		Result results[3];
+		service.Read(small.Path(), Into(results[0]));
+		service.Read(large.Path(), Into(results[1]));
+		service.Read(empty.Path(), Into(results[2]));
+		service.Flush();
+		CHECK(service.PendingCount() == 0);
+		CHECK(service.AbandonedBuffers() == 0);
+
+		CHECK(results[0].Called && results[0].Succeeded);
+		CHECK(results[0].Data == small.Bytes());
+		CHECK(results[1].Called && results[1].Succeeded);
+		CHECK(results[1].Data == large.Bytes());
+		CHECK(results[2].Called && results[2].Succeeded);
+		CHECK(results[2].Data.empty());
+	}
+}
+
+TEST(FileService, Ranges)
+{
+	TemporaryFile file("ranges", 100000);
+	for (bool useRing : UseRing) {
+		FileService service(useRing);
+		Result start;
+		Result middle;
+		Result end;
+		Result nothing;
+		service.Read(file.Path(), 0, 4096, Into(start));
+		service.Read(file.Path(), 12345, 5000, Into(middle));
+		service.Read(file.Path(), 99000, 1000, Into(end));
+		service.Read(file.Path(), 500, 0, Into(nothing));
+		service.Flush();
+
+		CHECK(start.Succeeded && start.Data == Range(file, 0, 4096));
+		CHECK(middle.Succeeded && middle.Data == Range(file, 12345, 5000));
+		CHECK(end.Succeeded && end.Data == Range(file, 99000, 1000));
+		CHECK(nothing.Succeeded && nothing.Data.empty());
+	}
+}
+
+TEST(FileService, RangesPastTheEndFail)
+{
+	TemporaryFile file("short", 5000);
+	for (bool useRing : UseRing) {
+		FileService service(useRing);
+		Result overlapping;
+		Result beyond;
+		Result inside;
+		service.Read(file.Path(), 4000, 2000, Into(overlapping));
+		service.Read(file.Path(), 8000, 10, Into(beyond));
+		service.Read(file.Path(), 4000, 1000, Into(inside));
+		service.Flush();
+
+		CHECK(overlapping.Called && !overlapping.Succeeded && overlapping.Data.empty());
+		CHECK(beyond.Called && !beyond.Succeeded && beyond.Data.empty());
+		CHECK(inside.Succeeded && inside.Data == Range(file, 4000, 1000));
+	}
+}
+
+TEST(FileService, MissingFileFails)
+{
+	for (bool useRing : UseRing) {
+		FileService service(useRing);
+		Result whole;
+		Result ranged;
+		service.Read("FileServiceTest_missing.bin", Into(whole));
+		service.Read("FileServiceTest_missing.bin", 0, 10, Into(ranged));
+		service.Flush();
+		CHECK(whole.Called && !whole.Succeeded);
+		CHECK(ranged.Called && !ranged.Succeeded);
+	}
+}
+
+TEST(FileService, MoreReadsThanTheQueueHolds)
+{
+	TemporaryFile file("many", 64 * 1024);
+	const std::uint32_t reads = FileService::QueueDepth * 3 + 5;
+	for (bool useRing : UseRing) {
+		FileService service(useRing);
+		std::vector<Result> results(reads);
+		for (std::uint32_t r = 0; r < reads; r++) {
+			service.Read(file.Path(), r * 97, 1000 + r, Into(results[r]));
+		}
+
+		// Called back from Update() as they finish, not only from Flush()
+		std::uint32_t called = 0;
+		while (called < reads) {
+			called += service.Update();
+		}
+
+		std::uint32_t wrong = 0;
+		for (std::uint32_t r = 0; r < reads; r++) {
+			wrong += (!results[r].Succeeded || results[r].Data != Range(file, r * 97, 1000 + r) ? 1 : 0);
+		}
+		CHECK(wrong == 0);
+		CHECK(service.PendingCount() == 0);
+		CHECK(service.AbandonedBuffers() == 0);
+	}
+}
+
+TEST(FileService, CallbacksCanQueueMoreReads)
+{
+	TemporaryFile file("chain", 10000);
+	for (bool useRing : UseRing) {
+		FileService service(useRing);
+		Result second;
+		bool firstSucceeded = false;
+		service.Read(file.Path(), 0, 100, [&](bool succeeded, const std::uint8_t*, std::size_t) {
+			firstSucceeded = succeeded;
+			service.Read(file.Path(), 9000, 1000, Into(second));
+		});
+		service.Flush();
+		CHECK(firstSucceeded);
+		CHECK(second.Succeeded && second.Data == Range(file, 9000, 1000));
+	}
+}
@@ -0,0 +1,142 @@
+#include "Test.h"
+#include "FixedTimestep.h"
+#include "Random.h"
+#include <cstdint>
+
+using namespace Library;
+using namespace Rendering;
+
+namespace {
+	const double STEP = 1.0 / 60.0;
+
+	// Advances by one frame and takes the steps it asks for, as
+	// ChunkSimulation::Update does
+	unsigned int Frame(FixedTimestep& timestep, double elapsed)
+	{
+		GameTime gameTime;
+		gameTime.SetElapsedGameTime(elapsed);
+		unsigned int steps = timestep.Advance(gameTime);
+		for (unsigned int step = 0; step < steps; step++) {
+			timestep.CompleteStep();
+		}
+		return steps;
+	}
+
+	bool AlphaInRange(const FixedTimestep& timestep)
+	{
+		return timestep.Alpha() >= 0.0 && timestep.Alpha() < 1.0;
+	}
+}
+
+TEST(FixedTimestep, StepsAtTheFixedRateWhateverTheFrameRate)
+{
+	const double frameTimes[] = { 1.0 / 30.0, 1.0 / 60.0, 1.0 / 144.0, 1.0 / 300.0 };
+	for (double frameTime : frameTimes) {
+		FixedTimestep timestep;
+		unsigned int steps = 0;
+		int frames = static_cast<int>(10.0 / frameTime + 0.5);
+		for (int frame = 0; frame < frames; frame++) {
+			steps += Frame(timestep, frameTime);
+		}
+
+		// Ten seconds are 600 steps, give or take the one still accumulating
+		CHECK(steps >= 599 && steps <= 600);
+		CHECK_NEAR(timestep.StepTime().TotalGameTime(), steps * STEP, 1e-9);
+		CHECK_NEAR(timestep.StepTime().ElapsedGameTime(), STEP, 0.0);
+		CHECK(timestep.DroppedTime() == 0.0);
+	}
+}
+
+TEST(FixedTimestep, CapsSubstepsAtFourByDefault)
+{
+	FixedTimestep timestep;
+	CHECK(timestep.MaxSubsteps() == 4);
+	CHECK(timestep.StepSize() == FixedTimestep::DefaultStepSize);
+
+	CHECK(Frame(timestep, 4.0 * STEP) == 4);
+	CHECK(timestep.DroppedTime() == 0.0);
+
+	// A one second hitch takes four steps and drops the other whole steps
+	CHECK(Frame(timestep, 1.0) == 4);
+	CHECK_NEAR(timestep.DroppedTime(), 1.0 - 4.0 * STEP, STEP);
+	CHECK(timestep.DroppedTime() > 0.0);
+	CHECK(AlphaInRange(timestep));
+
+	// And the next frame is back to normal
+	CHECK(Frame(timestep, STEP) <= 2);
+	CHECK(timestep.DroppedTime() == 0.0);
+}
+
+TEST(FixedTimestep, KeepsTheFractionAfterALongFrame)
+{
+	FixedTimestep timestep;
+	Frame(timestep, 10.25 * STEP);
+	CHECK_NEAR(timestep.Alpha(), 0.25, 1e-9);
+	CHECK_NEAR(timestep.DroppedTime(), 6.0 * STEP, 1e-9);
+}
+
+TEST(FixedTimestep, CustomStepAndCap)
+{
+	FixedTimestep timestep(0.01, 2);
+	CHECK(Frame(timestep, 0.05) == 2);
+	CHECK_NEAR(timestep.DroppedTime(), 0.03, 1e-9);
+
+	timestep.SetMaxSubsteps(8);
+	timestep.SetStepSize(0.005);
+	CHECK(timestep.StepTime().ElapsedGameTime() == 0.005);
+	CHECK(Frame(timestep, 0.04) == 8);
+	CHECK(timestep.DroppedTime() == 0.0);
+}
+
+TEST(FixedTimestep, AlphaStaysInRange)
+{
+	FixedTimestep timestep;
+	Random random(1, 1);
+	std::uint32_t outside = 0;
+	for (int frame = 0; frame < 100000; frame++) {
+		// Mostly ordinary frames, with the odd hitch
+		double elapsed = (frame % 997 == 0 ? random.NextRange(0.1f, 2.0f) : random.NextRange(0.0f, 0.05f));
+		Frame(timestep, elapsed);
+		outside += (AlphaInRange(timestep) ? 0 : 1);
+	}
+	CHECK(outside == 0);
+
+	// Frame times that land on whole steps
+	for (int frame = 0; frame < 1000; frame++) {
+		Frame(timestep, STEP * (frame % 5));
+		outside += (AlphaInRange(timestep) ? 0 : 1);
+	}
+	CHECK(outside == 0);
+}
+
+TEST(FixedTimestep, ZeroAndNegativeFrameTimesTakeNoSteps)
+{
+	FixedTimestep timestep;
+	Frame(timestep, 2.5 * STEP);
+	double alpha = timestep.Alpha();
+	double total = timestep.StepTime().TotalGameTime();
+
+	CHECK(Frame(timestep, 0.0) == 0);
+	CHECK(timestep.Alpha() == alpha);
+
+	// A clock that steps backwards does not wind the simulation back
+	CHECK(Frame(timestep, -1.0) == 0);
+	CHECK(Frame(timestep, -STEP) == 0);
+	CHECK(timestep.Alpha() == alpha);
+	CHECK(timestep.DroppedTime() == 0.0);
+	CHECK(timestep.StepTime().TotalGameTime() == total);
+
+	CHECK(Frame(timestep, STEP) == 1);
+	CHECK_NEAR(timestep.Alpha(), alpha, 1e-9);
+}
+
+TEST(FixedTimestep, ResetClearsTheClock)
+{
+	FixedTimestep timestep;
+	Frame(timestep, 3.5 * STEP);
+	timestep.Reset();
+	CHECK(timestep.Alpha() == 0.0);
+	CHECK(timestep.DroppedTime() == 0.0);
+	CHECK(timestep.StepTime().TotalGameTime() == 0.0);
+	CHECK(Frame(timestep, STEP / 2.0) == 0);
+}
@@ -0,0 +1,241 @@
+#include "Test.h"
+#include "JobSystem.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace Library;
+
+namespace {
+	const unsigned int ThreadCounts[] = { 1, 2, 3, 4, 8 };
+}
+
+TEST(JobSystem, ParallelForCoversEveryIndexOnce)
+{
+	const std::uint32_t counts[] = { 1, 7, 64, 1000, 4099 };
+	const std::uint32_t grains[] = { 0, 1, 3, 64, 5000 };
+	for (unsigned int threads : ThreadCounts) {
+		JobSystem jobSystem(threads);
+		for (std::uint32_t count : counts) {
+			for (std::uint32_t grain : grains) {
+				std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[count]);
+				for (std::uint32_t i = 0; i < count; i++) {
+					visits[i] = 0;
+				}
+
+				std::atomic<bool> inOrder(true);
+				jobSystem.ParallelFor(count, grain, [&](std::uint32_t begin, std::uint32_t end) {
+					inOrder = inOrder && begin < end && end <= count;
+					for (std::uint32_t i = begin; i < end; i++) {
+						visits[i]++;
+					}
+				});
+
+				std::uint32_t wrong = 0;
+				for (std::uint32_t i = 0; i < count; i++) {
+					wrong += (visits[i] != 1 ? 1 : 0);
+				}
+				CHECK(inOrder);
+				CHECK(wrong == 0);
+			}
+		}
+	}
+}
+
+TEST(JobSystem, ManySmallJobs)
+{
+	const int jobs = 100000;
+	for (unsigned int threads : ThreadCounts) {
+		JobSystem jobSystem(threads);
+		std::atomic<int> done(0);
+		JobSystem::Job* root = jobSystem.CreateJob(JobSystem::JobFunction());
+		for (int i = 0; i < jobs; i++) {
+			JobSystem::Job* child = jobSystem.CreateChildJob(root, [&done]() { done++; });
+			jobSystem.Run(child);
+			jobSystem.Release(child);
+		}
+		jobSystem.Run(root);
+		jobSystem.Wait(root);
+		CHECK(done == jobs);
+	}
+}
+
+TEST(JobSystem, NestedParallelFor)
+{
+	for (unsigned int threads : ThreadCounts) {
+		JobSystem jobSystem(threads);
+		for (int repeat = 0; repeat < 20; repeat++) {
+			std::vector<std::uint64_t> sums(64, 0);
+			jobSystem.ParallelFor(64, 1, [&](std::uint32_t begin, std::uint32_t end) {
+				for (std::uint32_t outer = begin; outer < end; outer++) {
+					std::atomic<std::uint64_t> sum(0);
+					jobSystem.ParallelFor(1000, 16, [&](std::uint32_t innerBegin, std::uint32_t innerEnd) {
+						std::uint64_t local = 0;
+						for (std::uint32_t inner = innerBegin; inner < innerEnd; inner++) {
+							local += inner;
+						}
+						sum += local;
+					});
+					sums[outer] = sum;
+				}
+			});
+
+			std::uint32_t wrong = 0;
+			for (std::uint64_t sum : sums) {
+				wrong += (sum != 999 * 1000 / 2 ? 1 : 0);
+			}
+			CHECK(wrong == 0);
+		}
+	}
+}
+
+TEST(JobSystem, ContinuationRunsAfterJobAndChildren)
+{
+	for (unsigned int threads : ThreadCounts) {
+		JobSystem jobSystem(threads);
+		for (int repeat = 0; repeat < 200; repeat++) {
+			std::atomic<int> children(0);
+			std::atomic<int> seenByContinuation(-1);
+			std::atomic<int> seenByLast(-1);
+
+			JobSystem::Job* parent = jobSystem.CreateJob([&]() {
+				std::this_thread::yield();
+			});
+			for (int i = 0; i < 16; i++) {
+				JobSystem::Job* child = jobSystem.CreateChildJob(parent, [&children]() { children++; });
+				jobSystem.Run(child);
+				jobSystem.Release(child);
+			}
+
+			// A chain of two continuations, each of which must see all the work before it
+			JobSystem::Job* continuation = jobSystem.CreateJob([&]() { seenByContinuation = children.load(); });
+			JobSystem::Job* last = jobSystem.CreateJob([&]() { seenByLast = seenByContinuation.load(); });
+			jobSystem.AddContinuation(parent, continuation);
+			jobSystem.AddContinuation(continuation, last);
+			jobSystem.Run(last);
+			jobSystem.Run(continuation);
+			jobSystem.Run(parent);
+
+			jobSystem.Wait(last);
+			CHECK(seenByLast == 16);
+			CHECK(jobSystem.IsComplete(continuation));
+			CHECK(jobSystem.IsComplete(parent));
+			jobSystem.Release(continuation);
+			jobSystem.Release(parent);
+		}
+	}
+}
+
+TEST(JobSystem, ContinuationOfFinishedJobRunsAtOnce)
+{
+	JobSystem jobSystem(2);
+	JobSystem::Job* first = jobSystem.CreateJob(JobSystem::JobFunction());
+	jobSystem.Run(first);
+	while (!jobSystem.IsComplete(first)) {
+		std::this_thread::yield();
+	}
+
+	std::atomic<bool> ran(false);
+	JobSystem::Job* continuation = jobSystem.CreateJob([&ran]() { ran = true; });
+	jobSystem.AddContinuation(first, continuation);
+	jobSystem.Run(continuation);
+	jobSystem.Wait(continuation);
+	CHECK(ran);
+	jobSystem.Release(first);
+}
+
+TEST(JobSystem, WaitFromOutsideThreads)
+{
+	for (unsigned int threads : ThreadCounts) {
+		JobSystem jobSystem(threads);
+		std::atomic<int> total(0);
+		std::vector<std::thread> outsiders;
+		for (int t = 0; t < 4; t++) {
+			outsiders.push_back(std::thread([&]() {
+				for (int repeat = 0; repeat < 50; repeat++) {
+					JobSystem::Job* root = jobSystem.CreateJob(JobSystem::JobFunction());
+					for (int i = 0; i < 32; i++) {
+						JobSystem::Job* child = jobSystem.CreateChildJob(root, [&total]() { total++; });
+						jobSystem.Run(child);
+						jobSystem.Release(child);
+					}
+					jobSystem.Run(root);
+					jobSystem.Wait(root);
+
+					jobSystem.ParallelFor(100, 10, [&total](std::uint32_t begin, std::uint32_t end) {
+						total += static_cast<int>(end - begin);
+					});
+				}
+			}));
+		}
+
+		// The creating thread keeps helping at the same time
+		jobSystem.ParallelFor(1000, 1, [&total](std::uint32_t begin, std::uint32_t end) {
+			total += static_cast<int>(end - begin);
+		});
+		for (std::thread& outsider : outsiders) {
+			outsider.join();
+		}
+		CHECK(total == 4 * 50 * (32 + 100) + 1000);
+	}
+}
+
+TEST(JobSystem, BackgroundJobsStayOffTheCreatingThread)
+{
+	for (unsigned int threads : ThreadCounts) {
+		if (threads == 1) {
+			continue;
+		}
+
+		JobSystem jobSystem(threads);
+		std::thread::id creator = std::this_thread::get_id();
+		std::atomic<int> done(0);
+		std::atomic<int> onCreator(0);
+		std::vector<JobSystem::Job*> background;
+		for (int i = 0; i < 16; i++) {
+			JobSystem::Job* job = jobSystem.CreateJob([&]() {
+				onCreator += (std::this_thread::get_id() == creator ? 1 : 0);
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				done++;
+			});
+			JobSystem::Job* child = jobSystem.CreateChildJob(job, [&]() {
+				onCreator += (std::this_thread::get_id() == creator ? 1 : 0);
+				done++;
+			});
+			jobSystem.RunInBackground(job);
+			jobSystem.Run(child);
+			jobSystem.Release(child);
+			background.push_back(job);
+		}
+
+		// The frame's own work keeps the creating thread in Wait() and
+		// ParallelFor() the whole time the background jobs are queued
+		std::atomic<int> total(0);
+		while (done < 32) {
+			jobSystem.ParallelFor(64, 1, [&total](std::uint32_t begin, std::uint32_t end) {
+				total += static_cast<int>(end - begin);
+			});
+		}
+		for (JobSystem::Job* job : background) {
+			jobSystem.Wait(job);
+		}
+		CHECK(onCreator == 0);
+		CHECK(total > 0);
+	}
+}
+
+TEST(JobSystem, BackgroundJobsRunInWaitWithoutWorkers)
+{
+	JobSystem jobSystem(1);
+	std::atomic<int> done(0);
+	JobSystem::Job* job = jobSystem.CreateJob([&done]() { done++; });
+	JobSystem::Job* child = jobSystem.CreateChildJob(job, [&done]() { done++; });
+	jobSystem.RunInBackground(job);
+	jobSystem.Run(child);
+	jobSystem.Release(child);
+	jobSystem.Wait(job);
+	CHECK(done == 2);
+}
@@ -0,0 +1,84 @@
+#include "Test.h"
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace Testing {
+	namespace {
+		struct TestCase {
+			const char* Suite;
+			const char* Name;
+			TestFunction Function;
+		};
+
+		// Function-local so registrars in other files can use it during static
+		// initialisation
+		std::vector<TestCase>& Tests()
+		{
+			static std::vector<TestCase> tests;
+			return tests;
+		}
+
+		int sFailures = 0;
+
+		bool Selected(const TestCase& test, int argc, char* argv[])
+		{
+			if (argc < 2) {
+				return true;
+			}
+
+			std::string full = std::string(test.Suite) + "." + test.Name;
+			for (int i = 1; i < argc; i++) {
+				if (std::strcmp(argv[i], test.Suite) == 0 || full == argv[i]) {
+					return true;
+				}
+			}
+			return false;
+		}
+	}
+
+	Registrar::Registrar(const char* suite, const char* name, TestFunction function)
+	{
+		TestCase test = { suite, name, function };
+		Tests().push_back(test);
+	}
+
+	void Fail(const char* file, int line, const char* condition)
+	{
+		std::printf("%s:%d: failed: %s\n", file, line, condition);
+		sFailures++;
+	}
+}
+
+using namespace Testing;
+
+int main(int argc, char* argv[])
+{
+	int run = 0;
+	int failed = 0;
+	for (const TestCase& test : Tests()) {
+		if (!Selected(test, argc, argv)) {
+			continue;
+		}
+
+		int failures = sFailures;
+		try {
+			test.Function();
+		}
+		catch (const Stop&) {
+		}
+		catch (const std::exception& exception) {
+			Fail(test.Suite, 0, exception.what());
+		}
+
+		run++;
+		bool passed = (sFailures == failures);
+		failed += (passed ? 0 : 1);
+		std::printf("%s %s.%s\n", (passed ? "[  ok  ]" : "[ FAIL ]"), test.Suite, test.Name);
+	}
+
+	std::printf("%d tests, %d failed\n", run, failed);
+	return (run == 0 || failed > 0 ? 1 : 0);
+}
@@ -0,0 +1,202 @@
+#include "Test.h"
+#include "ChunkSimulation.h"
+#include "GameTime.h"
+#include "RigidClusters.h"
+#include "VoxelIntegrator.h"
+#include "VoxelStore.h"
+#include "WorldCollision.h"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace Rendering;
+
+namespace {
+	// A 2x2x2 cube of touching voxels with its lowest centres at height y
+	std::vector<std::uint32_t> AddCube(VoxelStore& store, float y)
+	{
+		std::vector<std::uint32_t> ids;
+		for (int x = 0; x < 2; x++) {
+			for (int dy = 0; dy < 2; dy++) {
+				for (int z = 0; z < 2; z++) {
+					ids.push_back(store.Add(static_cast<float>(x), y + dy, static_cast<float>(z), 0.5f));
+				}
+			}
+		}
+		return ids;
+	}
+
+	// Translations of the member matrices
+	std::vector<float> Centres(const RigidClusters& clusters)
+	{
+		std::vector<float> matrices(clusters.MemberCount() * 16);
+		clusters.GetPositionMatrices(1.0f, matrices.data());
+		std::vector<float> centres;
+		for (std::uint32_t m = 0; m < clusters.MemberCount(); m++) {
+			centres.insert(centres.end(), &matrices[m * 16 + 12], &matrices[m * 16 + 15]);
+		}
+		return centres;
+	}
+
+	float Distance(const float* a, const float* b)
+	{
+		float x = a[0] - b[0];
+		float y = a[1] - b[1];
+		float z = a[2] - b[2];
+		return std::sqrt(x * x + y * y + z * z);
+	}
+}
+
+TEST(RigidClusters, CreateTakesTheVoxelsOutOfTheStore)
+{
+	VoxelStore store;
+	store.Add(-5.0f, 0.0f, 0.0f, 0.5f);
+	std::uint32_t ids[3] = {
+		store.Add(0.0f, 0.0f, 0.0f, 0.5f),
+		store.Add(3.0f, 0.0f, 0.0f, 1.0f),
+		store.Add(0.0f, 6.0f, 0.0f, 0.5f)
+	};
+	store.Add(5.0f, 0.0f, 0.0f, 0.5f);
+
+	RigidClusters clusters;
+	clusters.Create(store, ids, 3, 2.0f);
+	CHECK(store.Count() == 2);
+	CHECK(clusters.Count() == 1);
+	CHECK(clusters.MemberCount() == 3);
+	CHECK(clusters.LaunchTime(0) == 2.0f);
+
+	// Mass goes with volume: the large voxel weighs as much as eight small ones
+	const float* position = clusters.Position(0);
+	CHECK_NEAR(position[0], 24.0f / 10.0f, 1e-5);
+	CHECK_NEAR(position[1], 6.0f / 10.0f, 1e-5);
+	CHECK_NEAR(position[2], 0.0f, 1e-5);
+
+	CHECK(clusters.Remove(0) == 3);
+	CHECK(clusters.Count() == 0);
+	CHECK(clusters.MemberCount() == 0);
+}
+
+// A body starts at rest and, with nothing to hit, its centre falls exactly as
+// a loose voxel dropped from the same point; it keeps no spin of its own
+TEST(RigidClusters, FallsLikeALooseVoxel)
+{
+	VoxelStore store;
+	std::vector<std::uint32_t> ids = AddCube(store, 20.0f);
+	RigidClusters clusters;
+	clusters.Create(store, ids.data(), static_cast<std::uint32_t>(ids.size()), 0.0f);
+	const float* position = clusters.Position(0);
+
+	VoxelStore loose;
+	std::uint32_t id = loose.Add(position[0], position[1], position[2], 0.5f);
+	loose.Drop(loose.Slot(id));
+
+	std::vector<float> before = Centres(clusters);
+	for (int step = 0; step < 120; step++) {
+		clusters.Integrate(1.0 / 60.0);
+		VoxelIntegrator::IntegrateScalar(loose, 0, 1, 1.0 / 60.0);
+	}
+	CHECK(position[0] == loose.OriginX()[0]);
+	CHECK(position[1] == loose.OriginY()[0]);
+	CHECK(position[2] == loose.OriginZ()[0]);
+	CHECK(position[1] < 20.0f);
+
+	// Every member moved by the same amount as the centre
+	std::vector<float> after = Centres(clusters);
+	REQUIRE(after.size() == before.size());
+	float drop = before[1] - after[1];
+	CHECK(drop > 0.0f);
+	for (std::size_t m = 0; m < after.size(); m += 3) {
+		CHECK_NEAR(after[m], before[m], 1e-5);
+		CHECK_NEAR(before[m + 1] - after[m + 1], drop, 1e-4);
+		CHECK_NEAR(after[m + 2], before[m + 2], 1e-5);
+	}
+}
+
+// Dropped corner first onto the ground, the cube bounces, tips and settles,
+// keeping its shape, then goes back into the store as sleeping debris
+TEST(RigidClusters, LandsKeepsItsShapeAndSleeps)
+{
+	VoxelStore store;
+	std::vector<std::uint32_t> ids = AddCube(store, 4.0f);
+	// Tilt it by putting one more voxel on a corner
+	ids.push_back(store.Add(2.0f, 4.0f, 0.0f, 0.5f));
+	RigidClusters clusters;
+	clusters.Create(store, ids.data(), static_cast<std::uint32_t>(ids.size()), 0.0f);
+	WorldCollision world;
+	world.SetGroundHeight(0.0f);
+
+	std::vector<float> shape = Centres(clusters);
+	std::uint32_t restored = 0;
+	std::uint32_t touched = 0;
+	float worst = 0.0f;
+	for (int step = 0; step < 3000 && restored == 0; step++) {
+		clusters.Integrate(1.0 / 60.0);
+		touched += clusters.Collide(world, store);
+		if (clusters.Count() == 1) {
+			std::vector<float> centres = Centres(clusters);
+			for (std::size_t a = 0; a < centres.size(); a += 3) {
+				for (std::size_t b = a + 3; b < centres.size(); b += 3) {
+					float error = std::fabs(Distance(&centres[a], &centres[b]) - Distance(&shape[a], &shape[b]));
+					worst = (error > worst ? error : worst);
+				}
+			}
+		}
+		restored += clusters.SleepResting(store);
+	}
+
+	CHECK(touched > 0);
+	CHECK(worst < 1e-3f);
+	CHECK(restored == ids.size());
+	CHECK(clusters.Count() == 0);
+	CHECK(clusters.MemberCount() == 0);
+	REQUIRE(store.Count() == ids.size());
+	CHECK(store.ActiveCount() == 0);
+	for (std::uint32_t slot = 0; slot < store.Count(); slot++) {
+		// Resting on the ground, not sunk into it or left hanging above it
+		CHECK(store.OriginY()[slot] > 0.5f - 0.1f);
+		CHECK(store.OriginY()[slot] < 2.0f);
+	}
+}
+
+// A table with two legs blasted away: the top comes off as bodies, and no
+// voxel is lost or duplicated while it falls, lands and sleeps
+TEST(RigidClusters, ChunkSimulationConservesVoxels)
+{
+	VoxelDag world(5);
+	const std::uint32_t legs[4][2] = { { 0, 0 }, { 0, 14 }, { 14, 0 }, { 14, 14 } };
+	for (const std::uint32_t* leg : legs) {
+		const std::uint32_t minimum[3] = { leg[0], 0, leg[1] };
+		const std::uint32_t maximum[3] = { leg[0] + 2, 8, leg[1] + 2 };
+		world.Fill(minimum, maximum, true);
+	}
+	const std::uint32_t topMinimum[3] = { 0, 8, 0 };
+	const std::uint32_t topMaximum[3] = { 16, 10, 16 };
+	world.Fill(topMinimum, topMaximum, true);
+
+	ChunkSimulation simulation;
+	const std::uint32_t minimum[3] = { 0, 0, 0 };
+	const std::uint32_t maximum[3] = { 16, 10, 16 };
+	simulation.AddVoxels(world, minimum, maximum, 1.0f);
+	simulation.World().SetGroundHeight(-0.5f);
+	simulation.SetDebrisLifetime(0.0f);
+	const std::uint32_t voxels = simulation.VoxelCount();
+	CHECK(voxels == world.SolidCount());
+
+	// Through the middle of two legs, so the top tips off the other two
+	simulation.SetMotionVectors(0.5f, 4.0f, 0.5f);
+	simulation.SetMotionVectors(14.5f, 4.0f, 0.5f);
+	GameTime gameTime;
+	std::uint32_t mostClusters = 0;
+	std::uint32_t miscounted = 0;
+	for (int frame = 0; frame < 1800; frame++) {
+		gameTime.SetElapsedGameTime(1.0 / 60.0);
+		gameTime.SetTotalGameTime(gameTime.TotalGameTime() + 1.0 / 60.0);
+		simulation.Update(gameTime);
+		mostClusters = (simulation.Stats().Clusters > mostClusters ? simulation.Stats().Clusters : mostClusters);
+		miscounted += (simulation.VoxelCount() != voxels ? 1 : 0);
+	}
+	CHECK(mostClusters > 0);
+	CHECK(miscounted == 0);
+	CHECK(simulation.Stats().Clusters == 0);
+	CHECK(simulation.Store().Count() == voxels);
+}
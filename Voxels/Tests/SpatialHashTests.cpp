@@ -0,0 +1,208 @@
+#include "Test.h"
+#include "ContactSolver.h"
+#include "JobSystem.h"
+#include "SpatialHash.h"
+#include "VoxelStore.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using namespace Rendering;
+
+namespace {
+	typedef std::pair<std::uint32_t, std::uint32_t> Pair;
+
+	struct Points {
+		std::vector<float> X;
+		std::vector<float> Y;
+		std::vector<float> Z;
+	};
+
+	// Clumps of points around centres spread over extent; a small extent packs
+	// them into one dense grid, a large one leaves the grid mostly empty
+	Points Scatter(std::uint32_t count, float extent, std::uint32_t clumps)
+	{
+		Points points;
+		for (std::uint32_t i = 0; i < count; i++) {
+			Random clump(i % clumps, 1);
+			Random random(i, 2);
+			points.X.push_back(clump.NextRange(-extent, extent) + random.NextRange(-4.0f, 4.0f));
+			points.Y.push_back(clump.NextRange(-extent, extent) + random.NextRange(-4.0f, 4.0f));
+			points.Z.push_back(clump.NextRange(-extent, extent) + random.NextRange(-4.0f, 4.0f));
+		}
+		return points;
+	}
+
+	float DistanceSq(const Points& points, std::uint32_t a, std::uint32_t b)
+	{
+		float dx = points.X[a] - points.X[b];
+		float dy = points.Y[a] - points.Y[b];
+		float dz = points.Z[a] - points.Z[b];
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	std::vector<Pair> BruteForcePairs(const Points& points, float distance)
+	{
+		std::vector<Pair> pairs;
+		std::uint32_t count = static_cast<std::uint32_t>(points.X.size());
+		for (std::uint32_t a = 0; a < count; a++) {
+			for (std::uint32_t b = a + 1; b < count; b++) {
+				if (DistanceSq(points, a, b) < distance * distance) {
+					pairs.push_back(Pair(a, b));
+				}
+			}
+		}
+		return pairs;
+	}
+
+	// Pairs closer than the cell size, as found through the hash; sorted, so
+	// a pair reported twice shows up as a duplicate
+	std::vector<Pair> HashPairs(const SpatialHash& hash, const Points& points)
+	{
+		std::vector<Pair> pairs;
+		float cellSize = hash.CellSize();
+		for (std::uint32_t p = 0; p < hash.EntryCount(); p++) {
+			std::uint32_t a = hash.Entry(p);
+			hash.ForEachNeighbourOf(p, [&](std::uint32_t q) {
+				std::uint32_t b = hash.Entry(q);
+				if (a < b && DistanceSq(points, a, b) < cellSize * cellSize) {
+					pairs.push_back(Pair(a, b));
+				}
+			});
+		}
+		std::sort(pairs.begin(), pairs.end());
+		return pairs;
+	}
+
+	void CheckPairs(float extent, bool dense)
+	{
+		const float cellSize = 2.0f;
+		Points points = Scatter(3000, extent, 40);
+		SpatialHash hash;
+		hash.Build(points.X.data(), points.Y.data(), points.Z.data(), 3000, cellSize);
+		REQUIRE(hash.IsDense() == dense);
+		REQUIRE(hash.EntryCount() == 3000);
+
+		std::vector<Pair> expected = BruteForcePairs(points, cellSize);
+		std::vector<Pair> found = HashPairs(hash, points);
+		CHECK(!expected.empty());
+		CHECK(found == expected);
+	}
+
+	void CheckBoxes(float extent, bool dense)
+	{
+		Points points = Scatter(2000, extent, 40);
+		SpatialHash hash;
+		hash.Build(points.X.data(), points.Y.data(), points.Z.data(), 2000, 4.0f);
+		REQUIRE(hash.IsDense() == dense);
+
+		std::uint32_t mismatches = 0;
+		for (std::uint32_t query = 0; query < 50; query++) {
+			Random random(query, 3);
+			float minimum[3];
+			float maximum[3];
+			for (int a = 0; a < 3; a++) {
+				float centre = random.NextRange(-extent, extent);
+				float half = random.NextRange(0.5f, (query < 40 ? 12.0f : extent * 2.0f));
+				minimum[a] = centre - half;
+				maximum[a] = centre + half;
+			}
+
+			// Every point in a cell the box overlaps, and nothing else, once
+			std::vector<std::uint32_t> found;
+			hash.ForEachInBox(minimum[0], minimum[1], minimum[2], maximum[0], maximum[1], maximum[2], [&](std::uint32_t position) {
+				found.push_back(hash.Entry(position));
+			});
+			std::sort(found.begin(), found.end());
+
+			std::vector<std::uint32_t> expected;
+			for (std::uint32_t i = 0; i < 2000; i++) {
+				const float point[3] = { points.X[i], points.Y[i], points.Z[i] };
+				bool inside = true;
+				for (int a = 0; a < 3; a++) {
+					float cell = std::floor(point[a] * 0.25f);
+					inside = inside && cell >= std::floor(minimum[a] * 0.25f) && cell <= std::floor(maximum[a] * 0.25f);
+				}
+				if (inside) {
+					expected.push_back(i);
+				}
+			}
+			mismatches += (found != expected ? 1 : 0);
+		}
+		CHECK(mismatches == 0);
+	}
+
+	void FillStore(VoxelStore& store, const Points& points, float size)
+	{
+		for (std::uint32_t i = 0; i < points.X.size(); i++) {
+			std::uint32_t id = store.Add(points.X[i], points.Y[i], points.Z[i], size);
+			store.Drop(store.Slot(id));
+		}
+	}
+}
+
+TEST(SpatialHash, DensePairsMatchBruteForce)
+{
+	CheckPairs(20.0f, true);
+}
+
+TEST(SpatialHash, HashedPairsMatchBruteForce)
+{
+	CheckPairs(5000.0f, false);
+}
+
+TEST(SpatialHash, DenseBoxQueriesMatchBruteForce)
+{
+	CheckBoxes(20.0f, true);
+}
+
+TEST(SpatialHash, HashedBoxQueriesMatchBruteForce)
+{
+	CheckBoxes(5000.0f, false);
+}
+
+TEST(SpatialHash, ContactPairsMatchBruteForce)
+{
+	const float size = 0.5f;
+	Points points = Scatter(2000, 40.0f, 20);
+	VoxelStore store;
+	FillStore(store, points, size);
+
+	// Overlapping pairs are counted before the solver moves anything
+	Points slots;
+	for (std::uint32_t slot = 0; slot < store.Count(); slot++) {
+		slots.X.push_back(store.OriginX()[slot]);
+		slots.Y.push_back(store.OriginY()[slot]);
+		slots.Z.push_back(store.OriginZ()[slot]);
+	}
+	std::uint32_t expected = static_cast<std::uint32_t>(BruteForcePairs(slots, size * 2.0f).size());
+
+	ContactSolver solver;
+	CHECK(expected > 0);
+	CHECK(solver.Solve(store, store.Count(), nullptr) == expected);
+}
+
+TEST(SpatialHash, ContactsSameOnAnyThreadCount)
+{
+	Points points = Scatter(5000, 30.0f, 10);
+	VoxelStore serial;
+	VoxelStore threaded;
+	FillStore(serial, points, 0.5f);
+	FillStore(threaded, points, 0.5f);
+
+	ContactSolver serialSolver;
+	ContactSolver threadedSolver;
+	Library::JobSystem jobSystem(4);
+	for (int step = 0; step < 5; step++) {
+		CHECK(serialSolver.Solve(serial, serial.Count(), nullptr) == threadedSolver.Solve(threaded, threaded.Count(), &jobSystem));
+	}
+
+	std::uint32_t mismatches = 0;
+	for (std::uint32_t slot = 0; slot < serial.Count(); slot++) {
+		mismatches += (serial.OriginX()[slot] != threaded.OriginX()[slot] || serial.OriginY()[slot] != threaded.OriginY()[slot]
+			|| serial.OriginZ()[slot] != threaded.OriginZ()[slot] || serial.Contact()[slot] != threaded.Contact()[slot] ? 1 : 0);
+	}
+	CHECK(mismatches == 0);
+}
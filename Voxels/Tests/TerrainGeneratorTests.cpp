@@ -0,0 +1,134 @@
+#include "Test.h"
+#include "JobSystem.h"
+#include "Random.h"
+#include "TerrainGenerator.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using namespace Library;
+using namespace Rendering;
+
+namespace {
+	const std::uint32_t SEED = 7;
+
+	// Every chunk the ground can pass through over a few columns of chunks,
+	// negative keys included
+	std::vector<ChunkKey> Keys()
+	{
+		std::vector<ChunkKey> keys;
+		for (std::int32_t z = -2; z < 2; z++) {
+			for (std::int32_t y = -2; y < 6; y++) {
+				for (std::int32_t x = -2; x < 2; x++) {
+					ChunkKey key = { x, y, z };
+					keys.push_back(key);
+				}
+			}
+		}
+		return keys;
+	}
+
+	// Generates keys[order[i]] into grids[order[i]], one chunk per job, taking
+	// the chunks in the given order
+	std::vector<ChunkGrid> Generate(JobSystem& jobSystem, const std::vector<ChunkKey>& keys, const std::vector<std::uint32_t>& order)
+	{
+		TerrainGenerator terrain(SEED);
+		std::vector<ChunkGrid> grids(keys.size());
+		jobSystem.ParallelFor(static_cast<std::uint32_t>(order.size()), 1, [&](std::uint32_t begin, std::uint32_t end) {
+			for (std::uint32_t i = begin; i < end; i++) {
+				terrain.Generate(keys[order[i]], grids[order[i]]);
+			}
+		});
+		return grids;
+	}
+
+	bool SameCells(const ChunkGrid& a, const ChunkGrid& b)
+	{
+		for (std::uint32_t z = 0; z < ChunkGrid::SIZE; z++) {
+			for (std::uint32_t y = 0; y < ChunkGrid::SIZE; y++) {
+				for (std::uint32_t x = 0; x < ChunkGrid::SIZE; x++) {
+					if (a.Get(x, y, z) != b.Get(x, y, z)) {
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	std::uint32_t Differing(const std::vector<ChunkGrid>& a, const std::vector<ChunkGrid>& b)
+	{
+		std::uint32_t differing = 0;
+		for (std::size_t i = 0; i < a.size(); i++) {
+			differing += (SameCells(a[i], b[i]) ? 0 : 1);
+		}
+		return differing;
+	}
+}
+
+TEST(TerrainGenerator, SameChunksAtAnyThreadCountAndOrder)
+{
+	std::vector<ChunkKey> keys = Keys();
+	std::vector<std::uint32_t> ascending(keys.size());
+	for (std::uint32_t i = 0; i < ascending.size(); i++) {
+		ascending[i] = i;
+	}
+	std::vector<std::uint32_t> descending(ascending.rbegin(), ascending.rend());
+	std::vector<std::uint32_t> shuffled = ascending;
+	Random random(SEED, 1);
+	for (std::uint32_t i = static_cast<std::uint32_t>(shuffled.size()) - 1; i > 0; i--) {
+		std::swap(shuffled[i], shuffled[random.Next() % (i + 1)]);
+	}
+
+	// One key at a time on the calling thread, as the reference
+	TerrainGenerator terrain(SEED);
+	std::vector<ChunkGrid> reference(keys.size());
+	std::uint32_t mixed = 0;
+	for (std::size_t i = 0; i < keys.size(); i++) {
+		terrain.Generate(keys[i], reference[i]);
+		mixed += (reference[i].IsUniform() ? 0 : 1);
+	}
+	// The keys have to reach the surface for the comparison to mean anything
+	REQUIRE(mixed > 0);
+
+	JobSystem one(1);
+	JobSystem four(4);
+	CHECK(Differing(reference, Generate(one, keys, ascending)) == 0);
+	CHECK(Differing(reference, Generate(one, keys, shuffled)) == 0);
+	CHECK(Differing(reference, Generate(four, keys, descending)) == 0);
+	CHECK(Differing(reference, Generate(four, keys, shuffled)) == 0);
+}
+
+TEST(TerrainGenerator, SeedChangesTheTerrain)
+{
+	TerrainGenerator first(SEED);
+	TerrainGenerator second(SEED + 1);
+	std::vector<ChunkKey> keys = Keys();
+	std::uint32_t differing = 0;
+	for (const ChunkKey& key : keys) {
+		ChunkGrid a;
+		ChunkGrid b;
+		first.Generate(key, a);
+		second.Generate(key, b);
+		differing += (SameCells(a, b) ? 0 : 1);
+	}
+	CHECK(differing > 0);
+}
+
+TEST(TerrainGenerator, GenerateReplacesTheGrid)
+{
+	TerrainGenerator terrain(SEED);
+	ChunkKey key = { 0, 1, 0 };
+	ChunkGrid fresh;
+	terrain.Generate(key, fresh);
+	REQUIRE(!fresh.IsUniform());
+
+	// A grid already holding another chunk, at another width
+	ChunkGrid reused;
+	for (std::uint32_t x = 0; x < ChunkGrid::SIZE; x++) {
+		reused.Set(x, x, x, static_cast<std::uint16_t>(100 + x));
+	}
+	terrain.Generate(key, reused);
+	CHECK(SameCells(fresh, reused));
+	CHECK(reused.SolidCount() == fresh.SolidCount());
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cmath>
+
+// A minimal test runner for the platform-neutral code, so VoxelsTests needs
+// nothing beyond the standard library. TEST(Suite, Name) defines a test and
+// registers it; CHECK reports a failed condition and carries on, REQUIRE
+// reports it and ends the test there.
+//
+// Usage: VoxelsTests [suite or Suite.Name ...]
+namespace Testing {
+	typedef void (*TestFunction)();
+
+	struct Registrar {
+		Registrar(const char* suite, const char* name, TestFunction function);
+	};
+
+	// Thrown by REQUIRE to end the test
+	struct Stop {
+	};
+
+	void Fail(const char* file, int line, const char* condition);
+
+	inline bool Near(double a, double b, double tolerance)
+	{
+		return std::fabs(a - b) <= tolerance;
+	}
+}
+
+#define TEST(suite, name) \
+	static void suite##_##name(); \
+	static Testing::Registrar suite##_##name##_Registrar(#suite, #name, &suite##_##name); \
+	static void suite##_##name()
+
+#define CHECK(condition) \
+	((condition) ? static_cast<void>(0) : Testing::Fail(__FILE__, __LINE__, #condition))
+
+#define CHECK_NEAR(a, b, tolerance) \
+	(Testing::Near((a), (b), (tolerance)) ? static_cast<void>(0) : Testing::Fail(__FILE__, __LINE__, "|" #a " - " #b "| <= " #tolerance))
+
+#define REQUIRE(condition) \
+	((condition) ? static_cast<void>(0) : (Testing::Fail(__FILE__, __LINE__, #condition), throw Testing::Stop()))
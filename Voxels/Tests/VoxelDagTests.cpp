@@ -0,0 +1,281 @@
+#include "Test.h"
+#include "Random.h"
+#include "VoxelDag.h"
+#include "VoxelRay.h"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace Rendering;
+
+namespace {
+	const std::uint32_t LEVELS = 5;
+	const std::uint32_t SIDE = 1u << LEVELS;
+
+	// The same world one bool per voxel
+	class Dense {
+	public:
+		Dense()
+			: mSolid(SIDE * SIDE * SIDE, false)
+		{
+		}
+
+		bool IsSolid(std::uint32_t x, std::uint32_t y, std::uint32_t z) const
+		{
+			return mSolid[Index(x, y, z)];
+		}
+
+		void Set(std::uint32_t x, std::uint32_t y, std::uint32_t z, bool solid)
+		{
+			mSolid[Index(x, y, z)] = solid;
+		}
+
+		void Fill(const std::uint32_t minimum[3], const std::uint32_t maximum[3], bool solid)
+		{
+			for (std::uint32_t z = minimum[2]; z < maximum[2]; z++) {
+				for (std::uint32_t y = minimum[1]; y < maximum[1]; y++) {
+					for (std::uint32_t x = minimum[0]; x < maximum[0]; x++) {
+						Set(x, y, z, solid);
+					}
+				}
+			}
+		}
+
+		std::uint64_t SolidCount() const
+		{
+			std::uint64_t count = 0;
+			for (bool solid : mSolid) {
+				count += (solid ? 1 : 0);
+			}
+			return count;
+		}
+
+		// Every solid voxel's unit cube tested one by one, or -1
+		float Raycast(const float origin[3], const float direction[3], float maxDistance) const
+		{
+			float inverse[3];
+			VoxelRay::Inverse(direction, inverse);
+			float nearest = maxDistance;
+			for (std::uint32_t z = 0; z < SIDE; z++) {
+				for (std::uint32_t y = 0; y < SIDE; y++) {
+					for (std::uint32_t x = 0; x < SIDE; x++) {
+						if (!IsSolid(x, y, z)) {
+							continue;
+						}
+						const float centre[3] = { x + 0.5f, y + 0.5f, z + 0.5f };
+						float distance;
+						int axis;
+						if (VoxelRay::HitBox(origin, inverse, centre, 0.5f, distance, axis) && distance < nearest) {
+							nearest = distance;
+						}
+					}
+				}
+			}
+			return (nearest < maxDistance ? nearest : -1.0f);
+		}
+
+	private:
+		static std::uint32_t Index(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+		{
+			return (z * SIDE + y) * SIDE + x;
+		}
+
+		std::vector<bool> mSolid;
+	};
+
+	// Boxes of up to a quarter of the world, some of them a single voxel
+	void RandomBox(Random& random, std::uint32_t minimum[3], std::uint32_t maximum[3])
+	{
+		for (int a = 0; a < 3; a++) {
+			minimum[a] = random.Next() % SIDE;
+			std::uint32_t extent = 1 + random.Next() % (SIDE / 4);
+			maximum[a] = (minimum[a] + extent < SIDE ? minimum[a] + extent : SIDE);
+		}
+	}
+
+	// Counts the voxels where the two worlds disagree, through IsSolid,
+	// SolidCount, ForEachSolid over the world and over a box, and rays
+	std::uint32_t Differences(const VoxelDag& world, const Dense& dense, std::uint32_t seed)
+	{
+		std::uint32_t differences = 0;
+		for (std::uint32_t z = 0; z < SIDE; z++) {
+			for (std::uint32_t y = 0; y < SIDE; y++) {
+				for (std::uint32_t x = 0; x < SIDE; x++) {
+					differences += (world.IsSolid(x, y, z) != dense.IsSolid(x, y, z) ? 1 : 0);
+				}
+			}
+		}
+		differences += (world.SolidCount() != dense.SolidCount() ? 1 : 0);
+
+		Random random(seed, 0);
+		std::uint32_t boxMinimum[3];
+		std::uint32_t boxMaximum[3];
+		RandomBox(random, boxMinimum, boxMaximum);
+		const std::uint32_t minimum[3] = { 0, 0, 0 };
+		const std::uint32_t maximum[3] = { SIDE, SIDE, SIDE };
+		std::uint64_t visited = 0;
+		std::uint64_t visitedInBox = 0;
+		std::uint64_t expectedInBox = 0;
+		world.ForEachSolid(minimum, maximum, [&](std::uint32_t x, std::uint32_t y, std::uint32_t z) {
+			differences += (dense.IsSolid(x, y, z) ? 0 : 1);
+			visited++;
+		});
+		world.ForEachSolid(boxMinimum, boxMaximum, [&](std::uint32_t x, std::uint32_t y, std::uint32_t z) {
+			bool inside = x >= boxMinimum[0] && x < boxMaximum[0] && y >= boxMinimum[1] && y < boxMaximum[1] && z >= boxMinimum[2] && z < boxMaximum[2];
+			differences += (inside && dense.IsSolid(x, y, z) ? 0 : 1);
+			visitedInBox++;
+		});
+		for (std::uint32_t z = boxMinimum[2]; z < boxMaximum[2]; z++) {
+			for (std::uint32_t y = boxMinimum[1]; y < boxMaximum[1]; y++) {
+				for (std::uint32_t x = boxMinimum[0]; x < boxMaximum[0]; x++) {
+					expectedInBox += (dense.IsSolid(x, y, z) ? 1 : 0);
+				}
+			}
+		}
+		differences += (visited != dense.SolidCount() ? 1 : 0);
+		differences += (visitedInBox != expectedInBox ? 1 : 0);
+
+		// Rays from inside and outside the world, some of them bounded short
+		for (std::uint32_t r = 0; r < 40; r++) {
+			float origin[3];
+			float direction[3];
+			float length = 0.0f;
+			for (int a = 0; a < 3; a++) {
+				origin[a] = random.NextRange(-16.0f, 48.0f);
+				direction[a] = random.NextRange(0.0f, 32.0f) - origin[a];
+				length += direction[a] * direction[a];
+			}
+			length = std::sqrt(length);
+			for (int a = 0; a < 3; a++) {
+				direction[a] /= length;
+			}
+			float maxDistance = (r % 4 == 0 ? 10.0f : 100.0f);
+
+			float expected = dense.Raycast(origin, direction, maxDistance);
+			VoxelDag::Hit hit;
+			bool found = world.Raycast(origin, direction, maxDistance, hit);
+			if (found != (expected >= 0.0f)) {
+				differences++;
+			}
+			else if (found) {
+				differences += (std::fabs(hit.Distance - expected) > 1e-4f * (1.0f + expected) ? 1 : 0);
+				differences += (dense.IsSolid(hit.Voxel[0], hit.Voxel[1], hit.Voxel[2]) ? 0 : 1);
+			}
+		}
+		return differences;
+	}
+}
+
+TEST(VoxelDag, EmptyAndFullWorlds)
+{
+	VoxelDag world(LEVELS);
+	CHECK(world.Size() == SIDE);
+	CHECK(world.SolidCount() == 0);
+	CHECK(world.NodeCount() == 0 && world.BrickCount() == 0);
+
+	// A solid world is one path of full nodes down to one full brick
+	const std::uint32_t minimum[3] = { 0, 0, 0 };
+	const std::uint32_t maximum[3] = { SIDE, SIDE, SIDE };
+	world.Fill(minimum, maximum, true);
+	CHECK(world.SolidCount() == SIDE * SIDE * SIDE);
+	CHECK(world.BrickCount() == 1);
+	CHECK(world.NodeCount() <= LEVELS);
+
+	world.Fill(minimum, maximum, false);
+	world.Compact();
+	CHECK(world.SolidCount() == 0);
+	CHECK(world.NodeCount() == 0 && world.BrickCount() == 0);
+}
+
+// Random sets and fills, with compactions between them, against the dense
+// world
+TEST(VoxelDag, EditsMatchADenseWorld)
+{
+	VoxelDag world(LEVELS);
+	Dense dense;
+	std::uint32_t differences = 0;
+	std::uint32_t checks = 0;
+	for (std::uint32_t edit = 0; edit < 3000; edit++) {
+		Random random(edit, 1);
+		bool solid = (random.Next() % 3 != 0);
+		if (random.Next() % 8 == 0) {
+			std::uint32_t minimum[3];
+			std::uint32_t maximum[3];
+			RandomBox(random, minimum, maximum);
+			world.Fill(minimum, maximum, solid);
+			dense.Fill(minimum, maximum, solid);
+		}
+		else {
+			std::uint32_t x = random.Next() % SIDE;
+			std::uint32_t y = random.Next() % SIDE;
+			std::uint32_t z = random.Next() % SIDE;
+			world.Set(x, y, z, solid);
+			dense.Set(x, y, z, solid);
+		}
+
+		if (edit % 500 == 250) {
+			world.Compact();
+		}
+		if (edit % 300 == 0) {
+			differences += Differences(world, dense, edit);
+			checks++;
+		}
+	}
+	differences += Differences(world, dense, 3000);
+	world.Compact();
+	differences += Differences(world, dense, 3001);
+
+	CHECK(checks == 10);
+	CHECK(dense.SolidCount() > 0 && dense.SolidCount() < SIDE * SIDE * SIDE);
+	CHECK(differences == 0);
+}
+
+// Identical regions share one subtree; an edit to one copies its path and
+// leaves the subtree the others still use as it was
+TEST(VoxelDag, EditsDoNotChangeSharedSubtrees)
+{
+	VoxelDag world(LEVELS);
+	Dense dense;
+	const std::uint32_t half = SIDE / 2;
+	for (std::uint32_t octant = 0; octant < 8; octant++) {
+		const std::uint32_t base[3] = { (octant & 1) * half, ((octant >> 1) & 1) * half, (octant >> 2) * half };
+		for (std::uint32_t voxel = 0; voxel < 200; voxel++) {
+			Random random(voxel, 2);
+			std::uint32_t x = base[0] + random.Next() % half;
+			std::uint32_t y = base[1] + random.Next() % half;
+			std::uint32_t z = base[2] + random.Next() % half;
+			world.Set(x, y, z, true);
+			dense.Set(x, y, z, true);
+		}
+	}
+	world.Compact();
+	std::uint32_t sharedNodes = world.NodeCount();
+	std::uint32_t sharedBricks = world.BrickCount();
+
+	// Eight octants the same cost what one does, plus the root
+	VoxelDag single(LEVELS);
+	for (std::uint32_t voxel = 0; voxel < 200; voxel++) {
+		Random random(voxel, 2);
+		std::uint32_t x = random.Next() % half;
+		std::uint32_t y = random.Next() % half;
+		std::uint32_t z = random.Next() % half;
+		single.Set(x, y, z, true);
+	}
+	single.Compact();
+	CHECK(sharedNodes == single.NodeCount());
+	CHECK(sharedBricks == single.BrickCount());
+
+	// Carve into every octant but the last, differently each time
+	for (std::uint32_t octant = 0; octant < 7; octant++) {
+		const std::uint32_t minimum[3] = { (octant & 1) * half + octant, ((octant >> 1) & 1) * half, (octant >> 2) * half };
+		const std::uint32_t maximum[3] = { minimum[0] + 3, minimum[1] + half / 2, minimum[2] + 5 };
+		world.Fill(minimum, maximum, false);
+		dense.Fill(minimum, maximum, false);
+		world.Set(minimum[0] + 1, minimum[1] + 2, minimum[2] + 3, true);
+		dense.Set(minimum[0] + 1, minimum[1] + 2, minimum[2] + 3, true);
+		CHECK(Differences(world, dense, octant) == 0);
+	}
+	world.Compact();
+	CHECK(Differences(world, dense, 8) == 0);
+	CHECK(world.NodeCount() > sharedNodes);
+}
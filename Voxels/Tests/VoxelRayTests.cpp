@@ -0,0 +1,143 @@
+#include "Test.h"
+#include "VoxelRay.h"
+#include "VoxelStore.h"
+#include <cstdint>
+#include <vector>
+
+using namespace Rendering;
+
+namespace {
+	struct Cubes {
+		std::vector<float> X;
+		std::vector<float> Y;
+		std::vector<float> Z;
+		std::vector<float> Half;
+
+		void Add(float x, float y, float z, float half)
+		{
+			X.push_back(x);
+			Y.push_back(y);
+			Z.push_back(z);
+			Half.push_back(half);
+		}
+	};
+
+	Cubes Scatter(std::uint32_t count, float extent, std::uint32_t stream)
+	{
+		Cubes cubes;
+		for (std::uint32_t i = 0; i < count; i++) {
+			Random random(i, stream);
+			cubes.Add(random.NextRange(-extent, extent), random.NextRange(-extent, extent), random.NextRange(-extent, extent), random.NextRange(0.25f, 1.0f));
+		}
+		return cubes;
+	}
+
+	// Casts rays from random points towards random targets, plus some along
+	// the axes, and counts the ones on which the kernel and the reference
+	// disagree on either the cube or the distance
+	std::uint32_t CountMismatches(const Cubes& cubes, std::uint32_t first, std::uint32_t last, float extent, std::uint32_t rays, std::uint32_t& hits)
+	{
+		std::uint32_t mismatches = 0;
+		for (std::uint32_t r = 0; r < rays; r++) {
+			Random random(r, 7);
+			float origin[3];
+			float direction[3];
+			for (int a = 0; a < 3; a++) {
+				origin[a] = random.NextRange(-extent * 1.5f, extent * 1.5f);
+				direction[a] = random.NextRange(-extent, extent) - origin[a];
+			}
+			if (r % 8 == 0) {
+				direction[0] = direction[1] = direction[2] = 0.0f;
+				direction[r / 8 % 3] = (r % 16 == 0 ? 1.0f : -1.0f);
+			}
+
+			float maxDistance = (r % 5 == 0 ? 0.5f : 1e6f);
+			float kernelDistance;
+			float scalarDistance;
+			std::uint32_t kernel = VoxelRay::NearestBox(origin, direction, cubes.X.data(), cubes.Y.data(), cubes.Z.data(), cubes.Half.data(),
+				first, last, maxDistance, kernelDistance);
+			std::uint32_t scalar = VoxelRay::NearestBoxScalar(origin, direction, cubes.X.data(), cubes.Y.data(), cubes.Z.data(), cubes.Half.data(),
+				first, last, maxDistance, scalarDistance);
+			mismatches += (kernel != scalar || kernelDistance != scalarDistance ? 1 : 0);
+			hits += (scalar != last ? 1 : 0);
+		}
+		return mismatches;
+	}
+}
+
+TEST(VoxelRay, KernelMatchesScalar)
+{
+	// Counts around the register widths leave every length of scalar tail
+	const std::uint32_t counts[] = { 0, 1, 7, 8, 9, 15, 16, 17, 31, 33, 1000 };
+	for (std::uint32_t count : counts) {
+		Cubes cubes = Scatter(count, 20.0f, 1);
+		std::uint32_t hits = 0;
+		CHECK(CountMismatches(cubes, 0, count, 20.0f, 500, hits) == 0);
+		CHECK(count < 100 || hits > 0);
+	}
+}
+
+TEST(VoxelRay, KernelMatchesScalarOnSubrange)
+{
+	Cubes cubes = Scatter(500, 10.0f, 2);
+	std::uint32_t hits = 0;
+	CHECK(CountMismatches(cubes, 3, 3, 10.0f, 50, hits) == 0);
+	CHECK(CountMismatches(cubes, 5, 42, 10.0f, 500, hits) == 0);
+	CHECK(CountMismatches(cubes, 137, 500, 10.0f, 500, hits) == 0);
+	CHECK(hits > 0);
+}
+
+TEST(VoxelRay, TiesGoToLowerIndex)
+{
+	// The same cube over and over, in and out of the vector blocks
+	Cubes cubes;
+	for (std::uint32_t i = 0; i < 40; i++) {
+		cubes.Add(0.0f, 0.0f, 10.0f, 1.0f);
+	}
+	const float origin[3] = { 0.0f, 0.0f, 0.0f };
+	const float direction[3] = { 0.0f, 0.0f, 1.0f };
+	const std::uint32_t firsts[] = { 0, 1, 5, 17, 39 };
+	for (std::uint32_t first : firsts) {
+		float kernelDistance;
+		float scalarDistance;
+		CHECK(VoxelRay::NearestBox(origin, direction, cubes.X.data(), cubes.Y.data(), cubes.Z.data(), cubes.Half.data(), first, 40, 100.0f, kernelDistance) == first);
+		CHECK(VoxelRay::NearestBoxScalar(origin, direction, cubes.X.data(), cubes.Y.data(), cubes.Z.data(), cubes.Half.data(), first, 40, 100.0f, scalarDistance) == first);
+		CHECK(kernelDistance == 9.0f);
+		CHECK(scalarDistance == 9.0f);
+	}
+
+	// A nearer cube in the tail still wins over the tied block
+	cubes.Add(0.0f, 0.0f, 5.0f, 1.0f);
+	float distance;
+	CHECK(VoxelRay::NearestBox(origin, direction, cubes.X.data(), cubes.Y.data(), cubes.Z.data(), cubes.Half.data(), 0, 41, 100.0f, distance) == 40);
+	CHECK(distance == 4.0f);
+}
+
+TEST(VoxelRay, StartInsideHitsAtZero)
+{
+	Cubes cubes = Scatter(20, 10.0f, 3);
+	cubes.X[13] = 1.0f;
+	cubes.Y[13] = 2.0f;
+	cubes.Z[13] = 3.0f;
+	const float origin[3] = { 1.25f, 2.0f, 2.75f };
+	const float direction[3] = { 0.3f, -0.2f, 0.9f };
+	float distance = -1.0f;
+	std::uint32_t nearest = VoxelRay::NearestBox(origin, direction, cubes.X.data(), cubes.Y.data(), cubes.Z.data(), cubes.Half.data(), 0, 20, 100.0f, distance);
+	CHECK(distance == 0.0f);
+	CHECK(cubes.X[nearest] - cubes.Half[nearest] <= origin[0] && origin[0] <= cubes.X[nearest] + cubes.Half[nearest]);
+}
+
+TEST(VoxelRay, MissReturnsLast)
+{
+	Cubes cubes = Scatter(50, 10.0f, 4);
+	const float origin[3] = { 0.0f, 100.0f, 0.0f };
+	const float direction[3] = { 0.0f, 1.0f, 0.0f };
+	float distance;
+	CHECK(VoxelRay::NearestBox(origin, direction, cubes.X.data(), cubes.Y.data(), cubes.Z.data(), cubes.Half.data(), 0, 50, 100.0f, distance) == 50);
+	CHECK(distance == 100.0f);
+
+	// Behind the ray
+	const float away[3] = { 0.0f, -1.0f, 0.0f };
+	const float below[3] = { 0.0f, -100.0f, 0.0f };
+	CHECK(VoxelRay::NearestBox(below, away, cubes.X.data(), cubes.Y.data(), cubes.Z.data(), cubes.Half.data(), 0, 50, 1e6f, distance) == 50);
+}
@@ -0,0 +1,183 @@
+#include "Test.h"
+#include "VoxelStore.h"
+#include <cstdint>
+#include <vector>
+
+using namespace Rendering;
+
+namespace {
+	bool IsAligned(const void* pointer)
+	{
+		return reinterpret_cast<std::uintptr_t>(pointer) % 32 == 0;
+	}
+}
+
+TEST(VoxelStore, AddStartsAsleepWithAlignedArrays)
+{
+	VoxelStore store;
+	for (int i = 0; i < 100; i++) {
+		CHECK(store.Add(static_cast<float>(i), 1.0f, 2.0f, 0.5f) == static_cast<std::uint32_t>(i));
+	}
+
+	CHECK(store.Count() == 100);
+	CHECK(store.ActiveCount() == 0);
+	CHECK(store.SleepingCount() == 100);
+	CHECK(store.OriginX()[42] == 42.0f);
+	CHECK(store.Size()[42] == 0.5f);
+	CHECK(store.OrientationW()[42] == 1.0f);
+	CHECK(store.Moving()[42] == 0);
+	CHECK(IsAligned(store.OriginX()));
+	CHECK(IsAligned(store.VelocityY()));
+	CHECK(IsAligned(store.OrientationW()));
+	CHECK(IsAligned(store.Moving()));
+}
+
+TEST(VoxelStore, RemoveKeepsArraysPackedAndReusesIds)
+{
+	VoxelStore store;
+	for (int i = 0; i < 10; i++) {
+		store.Add(static_cast<float>(i), 0.0f, 0.0f, 1.0f);
+	}
+
+	store.Remove(store.Slot(3));
+	CHECK(store.Count() == 9);
+	CHECK(store.Slot(3) == VoxelStore::INVALID_SLOT);
+	for (std::uint32_t slot = 0; slot < store.Count(); slot++) {
+		CHECK(store.Slot(store.Id(slot)) == slot);
+		CHECK(store.OriginX()[slot] == static_cast<float>(store.Id(slot)));
+	}
+
+	CHECK(store.Add(20.0f, 0.0f, 0.0f, 1.0f) == 3);
+	CHECK(store.OriginX()[store.Slot(3)] == 20.0f);
+	CHECK(store.Add(21.0f, 0.0f, 0.0f, 1.0f) == 10);
+}
+
+TEST(VoxelStore, WakeMovesVoxelsIntoActivePrefix)
+{
+	VoxelStore store;
+	for (int i = 0; i < 8; i++) {
+		store.Add(static_cast<float>(i), 0.0f, 0.0f, 1.0f);
+	}
+
+	store.Wake(store.Slot(5));
+	store.Drop(store.Slot(2));
+	CHECK(store.ActiveCount() == 2);
+	CHECK(store.Slot(5) < 2);
+	CHECK(store.Slot(2) < 2);
+	CHECK(store.SleepStamp(5) == 0);
+	CHECK(store.SleepStamp(4) != 0);
+	CHECK(store.Gravity()[store.Slot(2)] == VoxelStore::GRAVITY);
+	for (std::uint32_t slot = 0; slot < store.Count(); slot++) {
+		CHECK((store.Moving()[slot] != 0) == (slot < store.ActiveCount()));
+		CHECK(store.OriginX()[slot] == static_cast<float>(store.Id(slot)));
+	}
+}
+
+TEST(VoxelStore, MotionVectorOnlyReachesNearbyVoxels)
+{
+	VoxelStore store;
+	std::uint32_t nearId = store.Add(1.0f, 0.0f, 0.0f, 1.0f);
+	std::uint32_t farId = store.Add(VoxelStore::BLAST_REACH + 1.0f, 0.0f, 0.0f, 1.0f);
+
+	// Beyond the reach no random displacement can bring a voxel inside the cutoff
+	for (std::uint32_t blast = 0; blast < 100; blast++) {
+		Random random(blast, farId);
+		CHECK(!store.SetMotionVector(store.Slot(farId), 0.0f, 0.0f, 0.0f, random));
+	}
+
+	bool hit = false;
+	for (std::uint32_t blast = 0; blast < 100 && !hit; blast++) {
+		Random random(blast, nearId);
+		hit = store.SetMotionVector(store.Slot(nearId), 0.0f, 0.0f, 0.0f, random);
+	}
+	REQUIRE(hit);
+	CHECK(store.WakeMoving() == 1);
+	CHECK(store.Slot(nearId) == 0);
+	CHECK(store.Gravity()[0] == VoxelStore::GRAVITY);
+	CHECK(store.Moving()[store.Slot(farId)] == 0);
+}
+
+TEST(VoxelStore, IntegrateOnlyMovesActiveVoxels)
+{
+	VoxelStore store;
+	for (int i = 0; i < 37; i++) {
+		store.Add(static_cast<float>(i), 10.0f, 0.0f, 1.0f);
+	}
+	for (std::uint32_t id = 0; id < 37; id += 3) {
+		store.Drop(store.Slot(id));
+	}
+
+	std::uint32_t active = store.ActiveCount();
+	CHECK(store.Integrate(1.0 / 60.0) == active);
+	for (std::uint32_t slot = 0; slot < store.Count(); slot++) {
+		bool moving = slot < active;
+		CHECK((store.OriginY()[slot] < 10.0f) == moving);
+		CHECK((store.VelocityY()[slot] < 0.0f) == moving);
+		CHECK(store.OriginX()[slot] == static_cast<float>(store.Id(slot)));
+	}
+}
+
+TEST(VoxelStore, RestingVoxelsFallAsleep)
+{
+	VoxelStore store;
+	std::uint32_t id = store.Add(0.0f, 0.0f, 0.0f, 1.0f);
+	store.Wake(store.Slot(id));
+	std::uint32_t stamp = store.SleepStamp(id);
+	store.ClearSleepLog();
+
+	for (int frame = 0; frame < VoxelStore::SLEEP_FRAMES - 1; frame++) {
+		store.Contact()[store.Slot(id)] = 1;
+		store.SleepResting();
+	}
+	CHECK(store.ActiveCount() == 1);
+
+	store.Contact()[store.Slot(id)] = 1;
+	CHECK(store.SleepResting() == 1);
+	CHECK(store.ActiveCount() == 0);
+	CHECK(store.Moving()[store.Slot(id)] == 0);
+	CHECK(store.SleepStamp(id) != stamp);
+	REQUIRE(store.SleepLog().size() == 1);
+	CHECK(store.SleepLog()[0].Id == id);
+	CHECK(store.SleepLog()[0].Stamp == store.SleepStamp(id));
+}
+
+TEST(VoxelStore, PositionMatrixScalesAndTranslates)
+{
+	VoxelStore store;
+	store.Add(1.0f, 2.0f, 3.0f, 0.25f);
+
+	float matrix[16];
+	store.GetPositionMatrix(0, 1.0f, matrix);
+	const float expected[16] = {
+		0.25f, 0.0f, 0.0f, 0.0f,
+		0.0f, 0.25f, 0.0f, 0.0f,
+		0.0f, 0.0f, 0.25f, 0.0f,
+		1.0f, 2.0f, 3.0f, 1.0f
+	};
+	for (int element = 0; element < 16; element++) {
+		CHECK_NEAR(matrix[element], expected[element], 1e-6);
+	}
+}
+
+TEST(VoxelStore, PositionMatricesMatchOneAtATime)
+{
+	VoxelStore store;
+	for (std::uint32_t i = 0; i < 21; i++) {
+		Random random(i, 0);
+		store.Add(random.NextRange(-5.0f, 5.0f), random.NextRange(-5.0f, 5.0f), random.NextRange(-5.0f, 5.0f), 0.5f);
+		store.Wake(store.Slot(i));
+		store.SetAngularVelocity(store.Slot(i), random.NextRange(-1.0f, 1.0f), random.NextRange(-1.0f, 1.0f), random.NextRange(-1.0f, 1.0f));
+		store.VelocityX()[store.Slot(i)] = random.NextRange(-1.0f, 1.0f);
+	}
+	store.Integrate(1.0 / 60.0);
+
+	std::vector<float> matrices(store.Count() * 16);
+	store.GetPositionMatrices(0, store.Count(), 0.5f, matrices.data());
+	for (std::uint32_t slot = 0; slot < store.Count(); slot++) {
+		float matrix[16];
+		store.GetPositionMatrix(slot, 0.5f, matrix);
+		for (int element = 0; element < 16; element++) {
+			CHECK_NEAR(matrices[slot * 16 + element], matrix[element], 1e-6);
+		}
+	}
+}
@@ -0,0 +1,84 @@
+#include "Test.h"
+#include "JobSystem.h"
+#include "VoxelWorld.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+using namespace Rendering;
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	// Stands in for an expensive chunk: sleeps, so a slow frame can only come
+	// from the main thread running a load, not from sharing a core with one
+	const int GENERATE_MS = 40;
+}
+
+TEST(VoxelWorld, LoadsStayOffTheMainThread)
+{
+	JobSystem jobSystem(3);
+	std::thread::id main = std::this_thread::get_id();
+	std::atomic<int> generated(0);
+	std::atomic<int> onMain(0);
+	VoxelWorld world([&](const ChunkKey& key, ChunkGrid& grid) {
+		onMain += (std::this_thread::get_id() == main ? 1 : 0);
+		std::this_thread::sleep_for(std::chrono::milliseconds(GENERATE_MS));
+		grid.Fill(static_cast<std::uint16_t>(key.Y < 0 ? 1 : ChunkGrid::EMPTY_MATERIAL));
+		generated++;
+	}, 2.0f, &jobSystem);
+	world.SetViewDistance(1);
+
+	// Each frame starts a job, streams, does some parallel work and then waits
+	// for the job, so the main thread is in Wait() with the loads it just
+	// queued on top of its own work
+	const float position[3] = { 0.0f, 0.0f, 0.0f };
+	const float direction[3] = { 0.0f, 0.0f, 1.0f };
+	double worstMs = 0.0;
+	int busyFrames = 0;
+	std::atomic<std::uint32_t> total(0);
+	for (int frame = 0; frame < 1000 && (frame == 0 || world.LoadingCount() > 0); frame++) {
+		Clock::time_point start = Clock::now();
+		JobSystem::Job* job = jobSystem.CreateJob([]() { std::this_thread::sleep_for(std::chrono::milliseconds(2)); });
+		jobSystem.Run(job);
+		world.Update(position, direction);
+		jobSystem.ParallelFor(256, 16, [&total](std::uint32_t begin, std::uint32_t end) {
+			total += end - begin;
+		});
+		jobSystem.Wait(job);
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		worstMs = (ms > worstMs ? ms : worstMs);
+		busyFrames += (world.LoadingCount() > 0 ? 1 : 0);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	CHECK(onMain == 0);
+	CHECK(busyFrames > 0);
+	CHECK(worstMs < GENERATE_MS / 2);
+	world.Update(position, direction);
+	CHECK(generated == static_cast<int>(world.LoadedCount()));
+	CHECK(world.LoadedCount() > 0);
+}
+
+TEST(VoxelWorld, LoadsWithoutWorkers)
+{
+	JobSystem jobSystem(1);
+	VoxelWorld world([](const ChunkKey& key, ChunkGrid& grid) {
+		grid.Fill(static_cast<std::uint16_t>(key.Y < 0 ? 1 : ChunkGrid::EMPTY_MATERIAL));
+	}, 2.0f, &jobSystem);
+	world.SetViewDistance(1);
+
+	// One chunk per update, ready at once
+	const float position[3] = { 0.0f, 0.0f, 0.0f };
+	const float direction[3] = { 0.0f, 0.0f, 1.0f };
+	world.Update(position, direction);
+	CHECK(world.LoadedCount() == 1);
+	CHECK(world.LoadingCount() == 0);
+	for (int frame = 0; frame < 100; frame++) {
+		world.Update(position, direction);
+	}
+	CHECK(world.LoadedCount() == 7);
+	CHECK(world.IsSolid(0, -1, 0));
+	CHECK(!world.IsSolid(0, 0, 0));
+}
@@ -1,79 +1,66 @@
 #include "Chunk.h"
 #include "Game.h"
+#include "GameTime.h"
 #include "Camera.h"
+#include "JobSystem.h"
 
 namespace Rendering {
 	RTTI_DEFINITIONS(Chunk)
 
-	Chunk::Chunk(Game& game, Camera& camera, ID3DX11EffectMatrixVariable& positionVariable)
+	Chunk::Chunk(Game& game, Camera& camera, ID3DX11EffectMatrixVariable& positionVariable, ID3DX11EffectTechnique& technique)
 		: DrawableGameComponent(game, camera)
-		, mPositionVariable(&positionVariable)
+		, mSimulation((JobSystem*)game.Services().GetService(JobSystem::TypeIdClass())), mPositionVariable(&positionVariable)
 	{
-		mVoxels = std::vector<Voxel*>();
+		mVoxel = new Voxel(game, camera, technique);
 	}
 
 	Chunk::~Chunk()
 	{
-		for (int i = 0; i < mVoxels.size(); i++) {
-			DeleteObject(mVoxels[i]);
-		}
-		mVoxels.clear();
+		DeleteObject(mVoxel);
 	}
 
-	void Chunk::AddVoxel(Voxel* voxel)
+	void Chunk::AddVoxel(XMFLOAT3 origin, float size)
 	{
-		mVoxels.push_back(voxel);
+		mSimulation.AddVoxel(origin.x, origin.y, origin.z, size);
 	}
 
 	void Chunk::Update(const GameTime& gameTime)
 	{
-		for (auto it = mVoxels.begin(); it != mVoxels.end(); it++) {
-			(*it)->Update(gameTime);
-		}
+		mSimulation.Update(gameTime);
 	}
 
 	void Chunk::Draw(const GameTime& gameTime)
 	{
-		for (auto it = mVoxels.begin(); it != mVoxels.end(); it++) {
-			mPositionVariable->SetMatrix(reinterpret_cast<const float*>(&(*it)->GetPositionMatrix()));
-			(*it)->Draw(gameTime);
+		std::uint32_t count = mSimulation.VoxelCount();
+		mPositionMatrices.resize(count);
+		if (count > 0) {
+			mSimulation.GetPositionMatrices(reinterpret_cast<float*>(mPositionMatrices.data()));
 		}
-	}
 
-	void Chunk::SetMotionVectors(XMVECTOR point) {
-		for (auto it = mVoxels.begin(); it != mVoxels.end(); it++) {
-			(*it)->SetRotation();
-			(*it)->SetMotionVector(point);
+		for (std::uint32_t i = 0; i < count; i++) {
+			mPositionVariable->SetMatrix(reinterpret_cast<const float*>(&mPositionMatrices[i]));
+			mVoxel->Draw(gameTime);
 		}
 	}
 
-	float Chunk::FindClosestVoxel(XMVECTOR orig, XMVECTOR dir) {
-		float sMin = -1;
-		for (auto it = mVoxels.begin(); it != mVoxels.end(); it++) {
-			Voxel* vox = *it;
-			XMVECTOR v = orig - vox->GetOriginVector();
-
-			XMFLOAT3 bf;
-			XMStoreFloat3(&bf, XMVector3Dot(dir, v));
-			float b = 2.0f * bf.x;
-			XMStoreFloat3(&bf, XMVector3Dot(v, v));
-			float c = bf.x - vox->GetSize() * vox->GetSize();
-			float discriminant = (b * b) - (4.0f * c);
-
-			if (discriminant < 0.0f)
-				continue;
-
-			discriminant = sqrtf(discriminant);
+	void Chunk::SetMotionVectors(XMVECTOR point)
+	{
+		XMFLOAT3 p;
+		XMStoreFloat3(&p, point);
+		mSimulation.SetMotionVectors(p.x, p.y, p.z);
+	}
 
-			float s0 = (-b + discriminant) / 2.0f;
-			float s1 = (-b - discriminant) / 2.0f;
+	float Chunk::FindClosestVoxel(XMVECTOR orig, XMVECTOR dir)
+	{
+		XMFLOAT3 o;
+		XMFLOAT3 d;
+		XMStoreFloat3(&o, orig);
+		XMStoreFloat3(&d, dir);
+		return mSimulation.FindClosestVoxel(&o.x, &d.x);
+	}
 
-			if (s0 >= 0.0f || s1 >= 0.0f) {
-				if (sMin == -1 || s0 < sMin || s1 < sMin) {
-					sMin = s0 < s1 ? s0 : s1;
-				}
-			}
-		}
-		return sMin;
+	ChunkSimulation& Chunk::Simulation()
+	{
+		return mSimulation;
 	}
-}
\ No newline at end of file
+}
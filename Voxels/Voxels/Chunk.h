@@ -1,24 +1,33 @@
 #pragma once
 
 #include "DrawableGameComponent.h"
+#include "ChunkSimulation.h"
 #include "Voxel.h"
 
 using namespace Library;
 
 namespace Rendering {
+	// Draws a ChunkSimulation: one instance of the voxel mesh per voxel, placed
+	// with the matrices the simulation hands out. All the voxel logic lives in
+	// the simulation.
 	class Chunk : public DrawableGameComponent {
 		RTTI_DECLARATIONS(Chunk, DrawableGameComponent)
 	public:
-		Chunk(Game& game, Camera& camera, ID3DX11EffectMatrixVariable& positionVariable);
+		Chunk(Game& game, Camera& camera, ID3DX11EffectMatrixVariable& positionVariable, ID3DX11EffectTechnique& technique);
 		~Chunk();
 
-		void AddVoxel(Voxel* voxel);
+		void AddVoxel(XMFLOAT3 origin, float size);
 		virtual void Update(const GameTime& gameTime) override;
 		virtual void Draw(const GameTime& gameTime) override;
 		virtual void SetMotionVectors(XMVECTOR point);
 		virtual float FindClosestVoxel(XMVECTOR orig, XMVECTOR dir);
+
+		ChunkSimulation& Simulation();
+
 	private:
-		std::vector<Voxel*> mVoxels;
+		ChunkSimulation mSimulation;
+		std::vector<XMFLOAT4X4> mPositionMatrices;
+		Voxel* mVoxel;
 		ID3DX11EffectMatrixVariable* mPositionVariable;
 	};
-}
\ No newline at end of file
+}
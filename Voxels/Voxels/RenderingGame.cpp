@@ -5,6 +5,8 @@
 #include "FpsComponent.h"
 #include "ColorHelper.h"
 #include "FirstPersonCamera.h"
+#include "JobSystem.h"
+#include "FileService.h"
 #include "VoxelDemo.h"
 
 namespace Rendering
@@ -13,7 +15,7 @@ namespace Rendering
 
 	RenderingGame::RenderingGame(HINSTANCE instance, const std::wstring& windowClass, const std::wstring& windowTitle, int showCommand)
 		: Game(instance, windowClass, windowTitle, showCommand),
-		mFpsComponent(nullptr),
+		mFpsComponent(nullptr), mJobSystem(nullptr), mFileService(nullptr),
 		mDirectInput(nullptr), mKeyboard(nullptr), mMouse(nullptr),
 		mDemo(nullptr)
 	{
@@ -32,6 +34,12 @@ namespace Rendering
 			throw GameException("DirectInput8Create() failed");
 		}
 
+		mJobSystem = new JobSystem();
+		mServices.AddService(JobSystem::TypeIdClass(), mJobSystem);
+
+		mFileService = new FileService();
+		mServices.AddService(FileService::TypeIdClass(), mFileService);
+
 		mKeyboard = new Keyboard(*this, mDirectInput);
 		mComponents.push_back(mKeyboard);
 		mServices.AddService(Keyboard::TypeIdClass(), mKeyboard);
@@ -62,6 +70,8 @@ namespace Rendering
 		DeleteObject(mMouse);
 		DeleteObject(mFpsComponent);
 		DeleteObject(mCamera);
+		DeleteObject(mFileService);
+		DeleteObject(mJobSystem);
 
 		ReleaseObject(mDirectInput);
 
@@ -84,6 +94,10 @@ namespace Rendering
 			mDemo->SetMotionVectors(mMouse->X(), mMouse->Y());
 		}
 
+		// Files that finished loading since the last frame are handed over
+		// before the components update
+		mFileService->Update();
+
 		Game::Update(gameTime);
 	}
 
@@ -13,6 +13,8 @@ namespace Library
 	class FirstPersonCamera;
 	class FpsComponent;
 	class RenderStateHelper;
+	class JobSystem;
+	class FileService;
 }
 
 namespace Rendering
@@ -40,6 +42,8 @@ namespace Rendering
 		Mouse* mMouse;
 		FirstPersonCamera * mCamera;
 		FpsComponent* mFpsComponent;
+		JobSystem* mJobSystem;
+		FileService* mFileService;
 
 		VoxelDemo* mDemo;
 	};
@@ -2,18 +2,12 @@
 #include "Game.h"
 #include "GameException.h"
 #include "Camera.h"
-#include "MatrixHelper.h"
 
 namespace Rendering {
 	RTTI_DEFINITIONS(Voxel)
 
-	const float Voxel::DECAY_FACTOR = 0.98f;
-	const float Voxel::TIME_FACTOR = 5.0f;
-	const float Voxel::SCALE_FACTOR = 0.5f;
-
-	Voxel::Voxel(Game& game, Camera& camera, XMFLOAT3 origin, float size, ID3DX11EffectTechnique& technique)
-		: DrawableGameComponent(game, camera), mOrigin(origin), mSize(size), mTechnique(&technique)
-		, mPositionMatrix(XMLoadFloat4x4(&MatrixHelper::Identity)), mMoving(false)
+	Voxel::Voxel(Game& game, Camera& camera, ID3DX11EffectTechnique& technique)
+		: DrawableGameComponent(game, camera), mVertexBuffer(nullptr), mTechnique(&technique)
 	{
 		CreateVoxel();
 	}
@@ -30,9 +24,9 @@ namespace Rendering {
 
 	void Voxel::CreateVoxel()
 	{
-		XMFLOAT2 x = XMFLOAT2(mOrigin.x - mSize, mOrigin.x + mSize);
-		XMFLOAT2 y = XMFLOAT2(mOrigin.y - mSize, mOrigin.y + mSize);
-		XMFLOAT2 z = XMFLOAT2(mOrigin.z - mSize, mOrigin.z + mSize);
+		XMFLOAT2 x = XMFLOAT2(-1.0f, 1.0f);
+		XMFLOAT2 y = XMFLOAT2(-1.0f, 1.0f);
+		XMFLOAT2 z = XMFLOAT2(-1.0f, 1.0f);
 
 		BasicVertex vertices[] = {
 			// Front Face
@@ -99,30 +93,6 @@ namespace Rendering {
 		}
 	}
 
-	void Voxel::Update(const GameTime& gameTime)
-	{
-		if (mMoving) {
-			double time = gameTime.ElapsedGameTime() * TIME_FACTOR;
-			mPositionMatrix = XMMatrixMultiply(mPositionMatrix, XMMatrixTranslation(-mOrigin.x, -mOrigin.y, -mOrigin.z));
-			mPositionMatrix = XMMatrixMultiply(mPositionMatrix, XMMatrixRotationX(mRotationAngle.x));
-			mPositionMatrix = XMMatrixMultiply(mPositionMatrix, XMMatrixRotationY(mRotationAngle.y));
-			mPositionMatrix = XMMatrixMultiply(mPositionMatrix, XMMatrixRotationZ(mRotationAngle.z));
-			mPositionMatrix = XMMatrixMultiply(mPositionMatrix, XMMatrixTranslation(mOrigin.x, mOrigin.y, mOrigin.z));
-
-			float rotFalloff = pow(DECAY_FACTOR, 3);
-			mRotationAngle = XMFLOAT3(mRotationAngle.x * rotFalloff, mRotationAngle.y * rotFalloff, mRotationAngle.z * rotFalloff);
-
-			XMVECTOR v = (mVector * time) + (mGravity * time);
-			XMFLOAT3 newOrigin;
-			XMStoreFloat3(&newOrigin, v);
-			mOrigin = XMFLOAT3(mOrigin.x + newOrigin.x, mOrigin.y + newOrigin.y, mOrigin.z + newOrigin.z);
-			XMMATRIX movementMatrix = XMMatrixTranslationFromVector(v);
-			mPositionMatrix = XMMatrixMultiply(mPositionMatrix, movementMatrix);
-			mVector = mVector * (DECAY_FACTOR);
-			mGravity = mGravity / (DECAY_FACTOR);
-		}
-	}
-
 	void Voxel::Draw(const GameTime& gameTime)
 	{
 		//As in OpenCL we need a context
@@ -143,49 +113,4 @@ namespace Rendering {
 			direct3DDeviceContext->Draw(36, 0);
 		}
 	}
-
-	void Voxel::SetMotionVector(XMVECTOR point)
-	{
-		XMFLOAT3 pFloat;
-		XMStoreFloat3(&pFloat, point);
-		XMFLOAT3 adj;
-		adj.x = (mOrigin.x - pFloat.x + GetRandomDisplacement()) * SCALE_FACTOR;
-		adj.y = (mOrigin.y - pFloat.y + GetRandomDisplacement()) * SCALE_FACTOR;
-		adj.z = (mOrigin.z - pFloat.z + GetRandomDisplacement()) * SCALE_FACTOR;
-		float length = sqrt(adj.x * adj.x + adj.y * adj.y + adj.z * adj.z);
-		if (length < 5.0f) {
-			mVector = XMLoadFloat3(&adj);
-			XMFLOAT3 gravityFloat = XMFLOAT3(0.0f, -9.81f, 0.0f);
-			mGravity = XMLoadFloat3(&gravityFloat);
-			mMoving = true;
-		}
-	}
-
-	double Voxel::GetRandomDisplacement()
-	{
-		return (((std::rand() % 1000) / 5000.0f) - 0.1) * 50;
-	}
-
-	XMVECTOR Voxel::GetOriginVector()
-	{
-		return XMLoadFloat3(&mOrigin);
-	}
-
-	float Voxel::GetSize()
-	{
-		return mSize;
-	}
-
-	XMMATRIX Voxel::GetPositionMatrix()
-	{
-		return mPositionMatrix;
-	}
-
-	void Voxel::SetRotation()
-	{
-		float x = (std::rand() % 61) / 2.0f - 30.0f;
-		float y = (std::rand() % 61) / 2.0f - 30.0f;
-		float z = (std::rand() % 61) / 2.0f - 30.0f;
-		mRotationAngle = XMFLOAT3(x, y, z);
-	}
 }
\ No newline at end of file
@@ -9,23 +9,14 @@ namespace Rendering {
 		RTTI_DECLARATIONS(Voxel, DrawableGameComponent)
 
 	public:
-		Voxel(Game& game, Camera& camera, XMFLOAT3 origin, float size, ID3DX11EffectTechnique& technique);
+		// A unit cube centred on the origin; each voxel is drawn with this mesh and
+		// its own position matrix, so no per-voxel GPU resources are created
+		Voxel(Game& game, Camera& camera, ID3DX11EffectTechnique& technique);
 		~Voxel();
 		ID3D11Buffer* GetVertexBuffer() const;
 
 		void CreateVoxel();
-		virtual void Update(const GameTime& gameTime) override;
 		virtual void Draw(const GameTime& gameTime) override;
-		virtual void SetMotionVector(XMVECTOR point);
-
-		virtual XMVECTOR GetOriginVector();
-		virtual float GetSize();
-		virtual XMMATRIX GetPositionMatrix();
-		virtual void SetRotation();
-
-		static const float DECAY_FACTOR;
-		static const float TIME_FACTOR;
-		static const float SCALE_FACTOR;
 
 	private:
 		typedef struct _BasicVertex
@@ -40,16 +31,7 @@ namespace Rendering {
 				: Position(position), Normal(normal), Texture(texture) { }
 		} BasicVertex;
 
-		double GetRandomDisplacement();
-
-		XMFLOAT3 mOrigin;
-		XMVECTOR mVector;
-		XMVECTOR mGravity;
-		XMMATRIX mPositionMatrix;
-		float mSize;
 		ID3D11Buffer* mVertexBuffer;
 		ID3DX11EffectTechnique* mTechnique;
-		bool mMoving;
-		XMFLOAT3 mRotationAngle;
 	};
 }
\ No newline at end of file
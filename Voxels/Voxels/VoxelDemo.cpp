@@ -6,13 +6,21 @@
 #include "Camera.h"
 #include "Utility.h"
 #include "D3DCompiler.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
 
 namespace Rendering
 {
 	RTTI_DEFINITIONS(VoxelDemo)
 
+	namespace
+	{
+		const std::uint32_t TERRAIN_SEED = 1;
+	}
+
 	VoxelDemo::VoxelDemo(Game& game, Camera& camera)
-		: DrawableGameComponent(game, camera), mWorldMatrix(MatrixHelper::Identity)
+		: DrawableGameComponent(game, camera), mWorldMatrix(MatrixHelper::Identity), mChunk(nullptr),
+		mTerrain(TERRAIN_SEED, -(TerrainGenerator::HEIGHT_RANGE + TerrainGenerator::DENSITY_STRENGTH)), mWorld(nullptr)
 	{
 	}
 
@@ -25,6 +33,7 @@ namespace Rendering
 		ReleaseObject(mVertexBuffer);
 		ReleaseObject(mEffect);
 		DeleteObject(mChunk);
+		DeleteObject(mWorld);
 	}
 
 	void VoxelDemo::Initialize()
@@ -39,13 +48,20 @@ namespace Rendering
 		shaderFlags |= D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
 
-		// Load in the effect (shader) file and compile it
+		// Map the effect (shader) file and compile it straight from the mapping
+		MappedFile source;
+		if (!source.Open("Content\\Effects\\Outline.fx"))
+		{
+			throw GameException("Could not open Content\\Effects\\Outline.fx.");
+		}
+
 		ID3D10Blob* compiledShader = nullptr;
 		ID3D10Blob* errorMessages = nullptr;
-		HRESULT hr = D3DCompileFromFile(L"Content\\Effects\\Outline.fx", nullptr, nullptr, nullptr, "fx_5_0", shaderFlags, 0, &compiledShader, &errorMessages);
+		HRESULT hr = D3DCompile(source.Data(), static_cast<SIZE_T>(source.Size()), "Outline.fx", nullptr, nullptr, nullptr, "fx_5_0", shaderFlags, 0, &compiledShader, &errorMessages);
+		source.Close();
 		if (FAILED(hr))
 		{
-			const char* errorMessage = (errorMessages != nullptr ? (char*)errorMessages->GetBufferPointer() : "D3DX11CompileFromFile() failed");
+			const char* errorMessage = (errorMessages != nullptr ? (char*)errorMessages->GetBufferPointer() : "D3DCompile() failed");
 			GameException ex(errorMessage, hr);
 			ReleaseObject(errorMessages);
 
@@ -117,11 +133,21 @@ namespace Rendering
 		}
 
 		CreateChunk();
+
+		// Same lattice as the chunk: cells two units apart
+		mWorld = new VoxelWorld([this](const ChunkKey& key, ChunkGrid& grid) { mTerrain.Generate(key, grid); }, 2.0f, (JobSystem*)mGame->Services().GetService(JobSystem::TypeIdClass()));
 	}
 
 	void VoxelDemo::Update(const GameTime& gameTime)
 	{
 		mChunk->Update(gameTime);
+
+		// The world is only streamed for now; it is not drawn
+		const XMFLOAT3& position = mCamera->Position();
+		const XMFLOAT3& direction = mCamera->Direction();
+		const float eye[3] = { position.x, position.y, position.z };
+		const float heading[3] = { direction.x, direction.y, direction.z };
+		mWorld->Update(eye, heading);
 	}
 
 	void VoxelDemo::Draw(const GameTime& gameTime)
@@ -143,13 +169,13 @@ namespace Rendering
 	void VoxelDemo::CreateChunk()
 	{
 		ID3DX11EffectMatrixVariable* positionVariable = mEffect->GetVariableByName("PositionMatrix")->AsMatrix();
-		mChunk = new Chunk(*mGame, *mCamera, *positionVariable);
+		mChunk = new Chunk(*mGame, *mCamera, *positionVariable, *mTechnique);
 		float numCubes = 32;
+		mChunk->Simulation().Store().Reserve(16 * 16 * 16);
 		for (int x = 0; x < numCubes; x += 2) {
 			for (int y = 0; y < numCubes; y += 2) {
 				for (int z = 0; z < numCubes; z += 2) {
-					Voxel* voxel = new Voxel(*mGame, *mCamera, XMFLOAT3(x, y, z), 1, *mTechnique);
-					mChunk->AddVoxel(voxel);
+					mChunk->AddVoxel(XMFLOAT3(x, y, z), 1);
 				}
 			}
 		}
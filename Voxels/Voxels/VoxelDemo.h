@@ -2,6 +2,8 @@
 
 #include "DrawableGameComponent.h"
 #include "Chunk.h"
+#include "TerrainGenerator.h"
+#include "VoxelWorld.h"
 
 using namespace Library;
 
@@ -39,5 +41,9 @@ namespace Rendering
 		ID3D11Buffer* mIndexBuffer;
 
 		Chunk* mChunk;
+		// Hills that top out at the ground plane the chunk's lowest voxels rest on
+		TerrainGenerator mTerrain;
+		// Terrain streamed in around the camera
+		VoxelWorld* mWorld;
 	};
 }